@@ -1,8 +1,13 @@
 #include <stdint.h>
 #include <unordered_map>
-#include <queue>
+#include <map>
+#include <algorithm>
+#include "../Engine/DrawList.h"
+#include "../Engine/JobSystem.h"
 
 #include "../Engine/Renderer.h"
+#include "../Engine/RenderGraph.h"
+#include "../Engine/TextureStreaming.h"
 #include "../Engine/ModelLoader.h"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -37,10 +42,83 @@ struct ModelMatrixDynamicBuffer
 static const std::vector<std::pair<const char*, VkShaderStageFlagBits>> shaderList = {
 	{ "basic.vert", VK_SHADER_STAGE_VERTEX_BIT }, {"basic.frag", VK_SHADER_STAGE_FRAGMENT_BIT },
 	{ "pbr.vert", VK_SHADER_STAGE_VERTEX_BIT }, {"pbr.frag", VK_SHADER_STAGE_FRAGMENT_BIT },
+	{ "pbr_instanced.vert", VK_SHADER_STAGE_VERTEX_BIT },
 	{ "skybox.vert", VK_SHADER_STAGE_VERTEX_BIT }, {"skybox.frag", VK_SHADER_STAGE_FRAGMENT_BIT },
-	{ "debugdraw.vert", VK_SHADER_STAGE_VERTEX_BIT }, {"debugdraw.frag", VK_SHADER_STAGE_FRAGMENT_BIT }
+	{ "debugdraw.vert", VK_SHADER_STAGE_VERTEX_BIT }, {"debugdraw.frag", VK_SHADER_STAGE_FRAGMENT_BIT },
+	{ "cull.comp", VK_SHADER_STAGE_COMPUTE_BIT },
+	{ "skin.comp", VK_SHADER_STAGE_COMPUTE_BIT }
 };
 
+// model matrices per frame for instanced draws, 1MB per frame in flight
+#define MAX_MODEL_INSTANCES 16384
+// indirect draws culled per frame, each one a primitive of an instanced model. a bucket has at least one
+#define MAX_CULLED_DRAWS 4096
+// visible instances of all culled draws, a draw only takes slots for the instances that pass. 4MB per frame in flight
+#define MAX_VISIBLE_INSTANCES 65536
+// local_size_x of skin.comp
+#define SKIN_GROUP_SIZE 64
+// vertices of all skinned entities, a whole model per entity. 6MB per frame in flight
+#define MAX_SKINNED_VERTICES 262144
+// joints of all skinned entities, 2MB per frame in flight
+#define MAX_SKIN_JOINTS 8192
+// upper bound on the threads recording the forward pass
+#define MAX_RECORDING_SLICES 8
+// smaller slices cost more in job and vkCmdExecuteCommands overhead than they save
+#define MIN_RENDERABLES_PER_SLICE 32
+
+// matches CullDraw in cull.comp
+struct GpuCullDraw
+{
+	glm::mat4	node;
+	glm::vec4	boundsMin;
+	glm::vec4	boundsMax;
+	uint32_t	firstSourceInstance;
+	uint32_t	instanceCount;
+	uint32_t	indexCount;
+	uint32_t	firstIndex;
+	int32_t		vertexOffset;
+	uint32_t	bucket;
+	uint32_t	firstCommand;
+	uint32_t	noCull;
+};
+
+// commands [firstCommand, firstCommand + drawCount) of the indirect buffer, the cull writes the visible ones first
+struct CulledBucket
+{
+	uint32_t	firstCommand;
+	uint32_t	drawCount;
+};
+
+// Frustum push constant of cull.comp
+struct CullConstants
+{
+	glm::vec4	planes[6];
+	uint32_t	drawCount;
+	uint32_t	maxVisibleInstances;
+};
+
+// SkinRange push constant of skin.comp
+struct SkinConstants
+{
+	uint32_t	firstVertex;
+	uint32_t	vertexCount;
+	uint32_t	firstSkinnedVertex;
+	uint32_t	firstJoint;
+};
+
+struct ForwardSliceJobData
+{
+	AppRenderer*	pAppRenderer;
+	CommandBuffer*	pPrimary;
+	uint32_t		extentWidth;
+	uint32_t		extentHeight;
+};
+
+// pbr.frag variant of the descriptor indexing path, used when supported
+static const char* pbrBindlessDefines = "BINDLESS";
+// filled by UpdateTextureStreaming every frame
+static std::vector<TextureResidencyChange> textureResidencyChanges;
+
 #if defined(_WIN32)
 static int lastMouseX = 0;
 static int lastMouseY = 0;
@@ -117,6 +195,20 @@ void AppRenderer::Init(IApp* a_pApp)
 		cmdBfrs[i] = new(cmdBfrs[i]) CommandBuffer();
 	}
 
+	recordingSliceCount = GetJobWorkerCount() + 1;
+	if (recordingSliceCount > MAX_RECORDING_SLICES)
+		recordingSliceCount = MAX_RECORDING_SLICES;
+	const uint32_t recordingCnt = pRenderer->maxInFlightFrames * recordingSliceCount;
+	ppRecordingPools = (CommandPool**)malloc(sizeof(CommandPool*) * recordingCnt);
+	CommandPool* recordingPoolPool = (CommandPool*)malloc(sizeof(CommandPool) * recordingCnt);
+	ppSecondaryCmdBfrs = (CommandBuffer**)malloc(sizeof(CommandBuffer*) * recordingCnt);
+	CommandBuffer* secondaryCmdBfrPool = (CommandBuffer*)malloc(sizeof(CommandBuffer) * recordingCnt);
+	for (uint32_t i = 0; i < recordingCnt; ++i)
+	{
+		ppRecordingPools[i] = new(recordingPoolPool + i) CommandPool();
+		ppSecondaryCmdBfrs[i] = new(secondaryCmdBfrPool + i) CommandBuffer();
+	}
+
 	ppSceneUniformBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
 	Buffer* pUniformBufferPool = (Buffer*)malloc(sizeof(Buffer) * pRenderer->maxInFlightFrames);
 	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
@@ -125,32 +217,78 @@ void AppRenderer::Init(IApp* a_pApp)
 		ppSceneUniformBuffers[i] = new(ppSceneUniformBuffers[i]) Buffer();
 	}
 
+	ppInstanceBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	Buffer* pInstanceBufferPool = (Buffer*)malloc(sizeof(Buffer) * pRenderer->maxInFlightFrames);
+	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
+		ppInstanceBuffers[i] = new(pInstanceBufferPool + i) Buffer();
+	pInstanceMatrices = (glm::mat4*)malloc(sizeof(glm::mat4) * MAX_MODEL_INSTANCES);
+
+	ppCullDrawBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	ppIndirectCommandBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	ppVisibleInstanceBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	ppDrawCountBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	Buffer* pCullBufferPool = (Buffer*)malloc(sizeof(Buffer) * pRenderer->maxInFlightFrames * 4);
+	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
+	{
+		ppCullDrawBuffers[i] = new(pCullBufferPool + i * 4) Buffer();
+		ppIndirectCommandBuffers[i] = new(pCullBufferPool + i * 4 + 1) Buffer();
+		ppVisibleInstanceBuffers[i] = new(pCullBufferPool + i * 4 + 2) Buffer();
+		ppDrawCountBuffers[i] = new(pCullBufferPool + i * 4 + 3) Buffer();
+	}
+	pCullDraws = (GpuCullDraw*)malloc(sizeof(GpuCullDraw) * MAX_CULLED_DRAWS);
+	pIndirectCommands = (VkDrawIndexedIndirectCommand*)malloc(sizeof(VkDrawIndexedIndirectCommand) * MAX_CULLED_DRAWS);
+	pCulledBuckets = (CulledBucket*)malloc(sizeof(CulledBucket) * MAX_CULLED_DRAWS);
+
+	ppSkinnedVertexBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	ppSkinJointBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
+	Buffer* pSkinBufferPool = (Buffer*)malloc(sizeof(Buffer) * pRenderer->maxInFlightFrames * 2);
+	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
+	{
+		ppSkinnedVertexBuffers[i] = new(pSkinBufferPool + i * 2) Buffer();
+		ppSkinJointBuffers[i] = new(pSkinBufferPool + i * 2 + 1) Buffer();
+	}
+	pSkinJoints = (glm::mat4*)malloc(sizeof(glm::mat4) * 2 * MAX_SKIN_JOINTS);
+
 	/*ppSceneBuffers = (Buffer**)malloc(pRenderer->maxInFlightFrames * sizeof(Buffer*));
 	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
 		ppSceneBuffers[i] = new Buffer();*/
 
 	pPBRResDesc = new ResourceDescriptor(8);
 	pPBRPipeline = new Pipeline();
+	pPBRInstancedPipeline = new Pipeline();
 	pSkyboxResDesc = new ResourceDescriptor(8);
 	pSkyboxPipeline = new Pipeline();
 	pDebugDrawResDesc = new ResourceDescriptor(2);
 	pDebugDrawPipeline = new Pipeline();
+	pCullResDesc = new ResourceDescriptor(5);
+	pCullPipeline = new Pipeline();
+	pSkinResDesc = new ResourceDescriptor(4);
+	pSkinPipeline = new Pipeline();
 
 	pSceneDescriptorSet = new DescriptorSet();
-	pDepthBuffer = new RenderTarget();
-	pDepthBuffer->pTexture = new Texture();
+	pCullDescriptorSet = new DescriptorSet();
+	pBindlessTextureSet = new DescriptorSet();
+	pRenderGraph = new RenderGraph();
+	pTextureStreamer = new TextureStreamer();
 }
 
 void AppRenderer::Exit()
 {
-	delete pDepthBuffer->pTexture;
-	delete pDepthBuffer;
+	delete pTextureStreamer;
+	delete pRenderGraph;
+	delete pCullDescriptorSet;
+	delete pBindlessTextureSet;
 	delete pSceneDescriptorSet;
 
+	delete pSkinPipeline;
+	delete pSkinResDesc;
+	delete pCullPipeline;
+	delete pCullResDesc;
 	delete pDebugDrawPipeline;
 	delete pDebugDrawResDesc;
 	delete pSkyboxPipeline;
 	delete pSkyboxResDesc;
+	delete pPBRInstancedPipeline;
 	delete pPBRPipeline;
 	delete pPBRResDesc;
 
@@ -158,9 +296,32 @@ void AppRenderer::Exit()
 		delete ppSceneBuffers[i];
 	free(ppSceneBuffers);*/
 
+	free(pSkinJoints);
+	free(ppSkinnedVertexBuffers[0]);
+	free(ppSkinJointBuffers);
+	free(ppSkinnedVertexBuffers);
+
+	free(pCulledBuckets);
+	free(pIndirectCommands);
+	free(pCullDraws);
+	free(ppCullDrawBuffers[0]);
+	free(ppDrawCountBuffers);
+	free(ppVisibleInstanceBuffers);
+	free(ppIndirectCommandBuffers);
+	free(ppCullDrawBuffers);
+
+	free(pInstanceMatrices);
+	free(ppInstanceBuffers[0]);
+	free(ppInstanceBuffers);
+
 	free(ppSceneUniformBuffers[0]);
 	free(ppSceneUniformBuffers);
 
+	free(ppSecondaryCmdBfrs[0]);
+	free(ppSecondaryCmdBfrs);
+	free(ppRecordingPools[0]);
+	free(ppRecordingPools);
+
 	free(cmdBfrs[0]);
 	free(cmdBfrs);
 
@@ -173,10 +334,20 @@ void AppRenderer::Load()
 	if (pRenderer->window.reset)
 	{
 		InitRenderer(&pRenderer);
+		InitTextureStreamer(pTextureStreamer, pRenderer);
+		pRenderer->pTextureStreamer = pTextureStreamer;
 
 		const uint32_t cmdBfrCnt = pRenderer->maxInFlightFrames;
 		CreateCommandBuffers(pRenderer, cmdBfrCnt, cmdBfrs);
 
+		// a pool per slice so recording threads never share one
+		const uint32_t recordingCnt = pRenderer->maxInFlightFrames * recordingSliceCount;
+		for (uint32_t i = 0; i < recordingCnt; ++i)
+		{
+			CreateCommandPool(pRenderer, &ppRecordingPools[i]);
+			CreateSecondaryCommandBuffers(pRenderer, ppRecordingPools[i], 1, &ppSecondaryCmdBfrs[i]);
+		}
+
 		for (std::pair<const char*, VkShaderStageFlagBits> pair : shaderList)
 		{
 			ShaderModule* pShaderModule = new ShaderModule();
@@ -184,6 +355,22 @@ void AppRenderer::Load()
 			GetShaderModule(GetResourceLoader(), pair.first, &pShaderModule);
 		}
 
+		useBindless = pRenderer->bindlessSupported;
+		if (useBindless)
+		{
+			ShaderModule* pShaderModule = new ShaderModule();
+			pShaderModule->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			GetShaderModule(GetResourceLoader(), "pbr.frag", &pShaderModule, pbrBindlessDefines);
+		}
+
+		useGpuCulling = pRenderer->indirectFirstInstanceSupported;
+		LOG(LogSeverity::INFO, "GPU culling of instanced draws %s", useGpuCulling ? "enabled" : "unsupported, instances are drawn unculled");
+		if (useGpuCulling)
+		{
+			LOG(LogSeverity::INFO, "Culled draws are drawn %s", pRenderer->drawIndirectCountSupported ? "with an indirect count per material" :
+				(pRenderer->multiDrawIndirectSupported ? "as a multi draw per material" : "one indirect command at a time"));
+		}
+
 		for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
 		{
 			ppSceneUniformBuffers[i]->desc = {
@@ -193,6 +380,68 @@ void AppRenderer::Load()
 				(void*)(&ubo)
 			};
 			CreateBuffer(pRenderer, &ppSceneUniformBuffers[i]);
+
+			ppInstanceBuffers[i]->desc = {
+				(uint64_t)(sizeof(glm::mat4) * MAX_MODEL_INSTANCES),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				nullptr
+			};
+			CreateBuffer(pRenderer, &ppInstanceBuffers[i]);
+
+			// only written by the skinning pass
+			ppSkinnedVertexBuffers[i]->desc = {
+				(uint64_t)(sizeof(Model::PackedVertex) * MAX_SKINNED_VERTICES),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				nullptr
+			};
+			CreateBuffer(pRenderer, &ppSkinnedVertexBuffers[i]);
+
+			ppSkinJointBuffers[i]->desc = {
+				(uint64_t)(sizeof(glm::mat4) * 2 * MAX_SKIN_JOINTS),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				nullptr
+			};
+			CreateBuffer(pRenderer, &ppSkinJointBuffers[i]);
+
+			if (useGpuCulling)
+			{
+				ppCullDrawBuffers[i]->desc = {
+					(uint64_t)(sizeof(GpuCullDraw) * MAX_CULLED_DRAWS),
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+					nullptr
+				};
+				CreateBuffer(pRenderer, &ppCullDrawBuffers[i]);
+
+				// zeroed by the upload, the cull writes the visible draws of every bucket
+				ppIndirectCommandBuffers[i]->desc = {
+					(uint64_t)(sizeof(VkDrawIndexedIndirectCommand) * MAX_CULLED_DRAWS),
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+					nullptr
+				};
+				CreateBuffer(pRenderer, &ppIndirectCommandBuffers[i]);
+
+				// only written by the cull
+				ppVisibleInstanceBuffers[i]->desc = {
+					(uint64_t)(sizeof(glm::mat4) * MAX_VISIBLE_INSTANCES),
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					nullptr
+				};
+				CreateBuffer(pRenderer, &ppVisibleInstanceBuffers[i]);
+
+				ppDrawCountBuffers[i]->desc = {
+					(uint64_t)(sizeof(uint32_t) * (1 + MAX_CULLED_DRAWS)),
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+					nullptr
+				};
+				CreateBuffer(pRenderer, &ppDrawCountBuffers[i]);
+			}
 		}
 
 		/* ----------------------------------- PBR Resource Desc ----------------------------------- */
@@ -256,23 +505,40 @@ void AppRenderer::Load()
 		};
 
 		// Set 3
-		const char* pbrSamplerNames[5] = {
-			"colorMap",
-			"physicalDescriptorMap",
-			"normalMap",
-			"aoMap",
-			"emissiveMap"
-		};
-
-		for (uint32_t i = 0; i < 5; ++i)
+		if (useBindless)
 		{
-			pPBRResDesc->desc.descriptors[i + 3] =
+			// one variable sized array shared by all materials
+			pPBRResDesc->desc.descriptorCount = 4;
+			pPBRResDesc->desc.descriptors[3] =
 			{
-				(uint32_t)DescriptorUpdateFrequency::SET_3,	
-				{ i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-				pbrSamplerNames[i]
+				(uint32_t)DescriptorUpdateFrequency::SET_3,
+				{ 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pRenderer->maxBindlessTextures, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+				"textures",
+				VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT |
+				VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
 			};
 		}
+		else
+		{
+			const char* pbrSamplerNames[5] = {
+				"colorMap",
+				"physicalDescriptorMap",
+				"normalMap",
+				"aoMap",
+				"emissiveMap"
+			};
+
+			pPBRResDesc->desc.descriptorCount = 8;
+			for (uint32_t i = 0; i < 5; ++i)
+			{
+				pPBRResDesc->desc.descriptors[i + 3] =
+				{
+					(uint32_t)DescriptorUpdateFrequency::SET_3,	
+					{ i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+					pbrSamplerNames[i]
+				};
+			}
+		}
 
 		pPBRResDesc->desc.pushConstantCount = 1;
 		pPBRResDesc->desc.pushConstants[0] = {
@@ -288,6 +554,19 @@ void AppRenderer::Load()
 
 		pSceneDescriptorSet->desc = { pPBRResDesc, DescriptorUpdateFrequency::SET_0, (uint32_t)pRenderer->maxInFlightFrames };
 		CreateDescriptorSet(pRenderer, &pSceneDescriptorSet);
+
+		if (useBindless)
+		{
+			pBindlessTextureSet->desc = { pPBRResDesc, DescriptorUpdateFrequency::SET_3, 1 };
+			CreateDescriptorSet(pRenderer, &pBindlessTextureSet);
+
+			// slot 0 is the default texture, used by materials without a texture
+			VkDescriptorImageInfo defaultImageInfo = {};
+			defaultImageInfo.imageView = pRenderer->defaultResources.defaultImage.imageView;
+			defaultImageInfo.imageLayout = pRenderer->defaultResources.defaultImage.desc.initialLayout;
+			defaultImageInfo.sampler = pRenderer->defaultResources.defaultSampler.sampler;
+			AddBindlessTexture(defaultImageInfo);
+		}
 		/* ----------------------------------------------------------------------------------------- */
 
 		/* ----------------------------------- Skybox Resource Desc ----------------------------------- */
@@ -319,6 +598,84 @@ void AppRenderer::Load()
 		resourceDescriptorNameMap.insert({ (uint32_t)std::hash<std::string>{}("DebugDraw"), pDebugDrawResDesc });
 		/* ----------------------------------------------------------------------------------------- */
 
+		/* ----------------------------------- Cull Resource Desc ----------------------------------- */
+		if (useGpuCulling)
+		{
+			const char* cullBufferNames[5] = {
+				"CullDraws",
+				"SourceInstances",
+				"DrawCommands",
+				"VisibleInstances",
+				"DrawCounts"
+			};
+			// Set 0
+			for (uint32_t i = 0; i < 5; ++i)
+			{
+				pCullResDesc->desc.descriptors[i] = {
+					(uint32_t)DescriptorUpdateFrequency::SET_0,
+					{ i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+					cullBufferNames[i]
+				};
+			}
+			pCullResDesc->desc.pushConstantCount = 1;
+			pCullResDesc->desc.pushConstants[0] = {
+				"Frustum", {
+					VK_SHADER_STAGE_COMPUTE_BIT,
+					0,
+					sizeof(CullConstants)
+				}
+			};
+			CreateResourceDescriptor(pRenderer, &pCullResDesc);
+
+			pCullDescriptorSet->desc = { pCullResDesc, DescriptorUpdateFrequency::SET_0, (uint32_t)pRenderer->maxInFlightFrames };
+			CreateDescriptorSet(pRenderer, &pCullDescriptorSet);
+
+			DescriptorUpdateInfo descUpdateInfos[5] = {};
+			for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
+			{
+				Buffer* cullBuffers[5] = { ppCullDrawBuffers[i], ppInstanceBuffers[i], ppIndirectCommandBuffers[i], ppVisibleInstanceBuffers[i], ppDrawCountBuffers[i] };
+				for (uint32_t j = 0; j < 5; ++j)
+				{
+					descUpdateInfos[j].name = cullBufferNames[j];
+					descUpdateInfos[j].mBufferInfo.buffer = cullBuffers[j]->buffer;
+					descUpdateInfos[j].mBufferInfo.offset = 0;
+					descUpdateInfos[j].mBufferInfo.range = cullBuffers[j]->desc.bufferSize;
+				}
+				UpdateDescriptorSet(pRenderer, i, pCullDescriptorSet, 5, descUpdateInfos);
+			}
+		}
+		/* ----------------------------------------------------------------------------------------- */
+
+		/* ----------------------------------- Skinning Resource Desc ----------------------------------- */
+		{
+			const char* skinBufferNames[4] = {
+				"SourceVertices",
+				"SkinnedVertices",
+				"SkinJoints",
+				"SkinWeights"
+			};
+			// Set 0, written per skinned model by the resource loader
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				pSkinResDesc->desc.descriptors[i] = {
+					(uint32_t)DescriptorUpdateFrequency::SET_0,
+					{ i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+					skinBufferNames[i]
+				};
+			}
+			pSkinResDesc->desc.pushConstantCount = 1;
+			pSkinResDesc->desc.pushConstants[0] = {
+				"SkinRange", {
+					VK_SHADER_STAGE_COMPUTE_BIT,
+					0,
+					sizeof(SkinConstants)
+				}
+			};
+			CreateResourceDescriptor(pRenderer, &pSkinResDesc);
+			resourceDescriptorNameMap.insert({ (uint32_t)std::hash<std::string>{}("Skinning"), pSkinResDesc });
+		}
+		/* ----------------------------------------------------------------------------------------- */
+
 		/* ----------------------------------- View Projection Scene Descriptors ----------------------------------- */
 		{
 			DescriptorUpdateInfo descUpdateInfos[5] = {};
@@ -370,20 +727,11 @@ void AppRenderer::Load()
 	for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
 		UpdateBuffer(pRenderer, ppSceneUniformBuffers[i], &ubo, sizeof(UniformBufferObject));
 
-	pDepthBuffer->pTexture->desc.width = pRenderer->window.width;
-	pDepthBuffer->pTexture->desc.height = pRenderer->window.height;
-	pDepthBuffer->pTexture->desc.format = VK_FORMAT_D32_SFLOAT;
-	pDepthBuffer->pTexture->desc.tiling = VK_IMAGE_TILING_OPTIMAL;
-	pDepthBuffer->pTexture->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-	pDepthBuffer->pTexture->desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	pDepthBuffer->pTexture->desc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-	pDepthBuffer->pTexture->desc.aspectBits = VK_IMAGE_ASPECT_DEPTH_BIT;
-	pDepthBuffer->pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	CreateRenderTarget(pRenderer, &pDepthBuffer);
+	CreateRenderGraph(pRenderer, &pRenderGraph);
 
 	ShaderModule *pPBRVertexShader = nullptr, *pPBRFragmentShader = nullptr;
 	GetShaderModule(GetResourceLoader(), "pbr.vert", &pPBRVertexShader);
-	GetShaderModule(GetResourceLoader(), "pbr.frag", &pPBRFragmentShader);
+	GetShaderModule(GetResourceLoader(), "pbr.frag", &pPBRFragmentShader, useBindless ? pbrBindlessDefines : "");
 
 	pPBRPipeline->desc.shaderCount = 2;
 	ShaderModule* pbrShaders[2] = {
@@ -392,57 +740,42 @@ void AppRenderer::Load()
 	};
 	pPBRPipeline->desc.shaders = pbrShaders;
 
-	VertexAttribute pbrAttribs[6] = {};
+	// Model::PackedVertex, joints and weights only feed the skinning pass and are not vertex attributes
+	VertexAttribute pbrAttribs[4] = {};
 	pbrAttribs[0] = {
-		0,									// binding
-		sizeof(glm::vec3),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		0,									// location
-		VK_FORMAT_R32G32B32_SFLOAT,			// format
-		offsetof(Model::Vertex, pos)		// offset
+		0,											// binding
+		sizeof(glm::vec3),							// stride
+		VK_VERTEX_INPUT_RATE_VERTEX,				// inputrate
+		0,											// location
+		VK_FORMAT_R32G32B32_SFLOAT,					// format
+		offsetof(Model::PackedVertex, pos)			// offset
 	};
 	pbrAttribs[1] = {
-		0,									// binding
-		sizeof(glm::vec3),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		1,									// location
-		VK_FORMAT_R32G32B32_SFLOAT,			// format
-		offsetof(Model::Vertex, normal)		// offset
+		0,											// binding
+		sizeof(uint32_t),							// stride
+		VK_VERTEX_INPUT_RATE_VERTEX,				// inputrate
+		1,											// location
+		VK_FORMAT_R16G16_SNORM,						// format
+		offsetof(Model::PackedVertex, normal)		// offset
 	};
 	pbrAttribs[2] = {
-		0,									// binding
-		sizeof(glm::vec2),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		2,									// location
-		VK_FORMAT_R32G32_SFLOAT,			// format
-		offsetof(Model::Vertex, uv0)		// offset
+		0,											// binding
+		sizeof(uint32_t),							// stride
+		VK_VERTEX_INPUT_RATE_VERTEX,				// inputrate
+		2,											// location
+		VK_FORMAT_R16G16_SFLOAT,					// format
+		offsetof(Model::PackedVertex, uv0)			// offset
 	};
 	pbrAttribs[3] = {
-		0,									// binding
-		sizeof(glm::vec2),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		3,									// location
-		VK_FORMAT_R32G32_SFLOAT,			// format
-		offsetof(Model::Vertex, uv1)		// offset
-	};
-	pbrAttribs[4] = {
-		0,									// binding
-		sizeof(glm::vec4),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		4,									// location
-		VK_FORMAT_R32G32B32A32_SFLOAT,		// format
-		offsetof(Model::Vertex, joint0)		// offset
-	};
-	pbrAttribs[5] = {
-		0,									// binding
-		sizeof(glm::vec4),					// stride
-		VK_VERTEX_INPUT_RATE_VERTEX,		// inputrate
-		5,									// location
-		VK_FORMAT_R32G32B32A32_SFLOAT,		// format
-		offsetof(Model::Vertex, weight0)	// offset
+		0,											// binding
+		sizeof(uint32_t),							// stride
+		VK_VERTEX_INPUT_RATE_VERTEX,				// inputrate
+		3,											// location
+		VK_FORMAT_R16G16_SFLOAT,					// format
+		offsetof(Model::PackedVertex, uv1)			// offset
 	};
 
-	pPBRPipeline->desc.attribCount = 6;
+	pPBRPipeline->desc.attribCount = 4;
 	pPBRPipeline->desc.attribs = pbrAttribs;
 	pPBRPipeline->desc.colorAttachmentCount = 1;
 	pPBRPipeline->desc.colorFormats[0] = pRenderer->swapchainRenderTargets[0]->pTexture->desc.format;
@@ -461,6 +794,36 @@ void AppRenderer::Load()
 	pPBRPipeline->desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	CreateGraphicsPipeline(pRenderer, &pPBRPipeline);
 
+	// PBR INSTANCED PIPELINE, same state with the model matrix as a per instance attribute
+	ShaderModule* pPBRInstancedVertexShader = nullptr;
+	GetShaderModule(GetResourceLoader(), "pbr_instanced.vert", &pPBRInstancedVertexShader);
+	ShaderModule* pbrInstancedShaders[2] = {
+		pPBRInstancedVertexShader,
+		pPBRFragmentShader
+	};
+
+	VertexAttribute pbrInstancedAttribs[8] = {};
+	for (uint32_t i = 0; i < 4; ++i)
+		pbrInstancedAttribs[i] = pbrAttribs[i];
+	// a mat4 attribute takes one location per column
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		pbrInstancedAttribs[4 + i] = {
+			1,									// binding
+			sizeof(glm::vec4),					// stride
+			VK_VERTEX_INPUT_RATE_INSTANCE,		// inputrate
+			6 + i,								// location
+			VK_FORMAT_R32G32B32A32_SFLOAT,		// format
+			i * (uint32_t)sizeof(glm::vec4)		// offset
+		};
+	}
+
+	pPBRInstancedPipeline->desc = pPBRPipeline->desc;
+	pPBRInstancedPipeline->desc.shaders = pbrInstancedShaders;
+	pPBRInstancedPipeline->desc.attribCount = 8;
+	pPBRInstancedPipeline->desc.attribs = pbrInstancedAttribs;
+	CreateGraphicsPipeline(pRenderer, &pPBRInstancedPipeline);
+
 	// SKYBOX PIPELINE
 	ShaderModule* pSkyboxVertexShader = nullptr, * pSkyboxFragmentShader = nullptr;
 	GetShaderModule(GetResourceLoader(), "skybox.vert", &pSkyboxVertexShader);
@@ -539,6 +902,25 @@ void AppRenderer::Load()
 	pDebugDrawPipeline->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
 	pDebugDrawPipeline->desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	CreateGraphicsPipeline(pRenderer, &pDebugDrawPipeline);
+
+	// CULL PIPELINE
+	if (useGpuCulling)
+	{
+		ShaderModule* pCullShader = nullptr;
+		GetShaderModule(GetResourceLoader(), "cull.comp", &pCullShader);
+		pCullPipeline->desc.shaderCount = 1;
+		pCullPipeline->desc.shaders = &pCullShader;
+		pCullPipeline->desc.pResourceDescriptor = pCullResDesc;
+		CreateComputePipeline(pRenderer, &pCullPipeline);
+	}
+
+	// SKINNING PIPELINE
+	ShaderModule* pSkinShader = nullptr;
+	GetShaderModule(GetResourceLoader(), "skin.comp", &pSkinShader);
+	pSkinPipeline->desc.shaderCount = 1;
+	pSkinPipeline->desc.shaders = &pSkinShader;
+	pSkinPipeline->desc.pResourceDescriptor = pSkinResDesc;
+	CreateComputePipeline(pRenderer, &pSkinPipeline);
 }
 
 void AppRenderer::Unload()
@@ -548,27 +930,67 @@ void AppRenderer::Unload()
 
 	WaitDeviceIdle(pRenderer);
 
+	DestroyComputePipeline(pRenderer, &pSkinPipeline);
+	if (useGpuCulling)
+		DestroyComputePipeline(pRenderer, &pCullPipeline);
 	DestroyGraphicsPipeline(pRenderer, &pDebugDrawPipeline);
 	DestroyGraphicsPipeline(pRenderer, &pSkyboxPipeline);
+	DestroyGraphicsPipeline(pRenderer, &pPBRInstancedPipeline);
 	DestroyGraphicsPipeline(pRenderer, &pPBRPipeline);
-	DestroyRenderTarget(pRenderer, &pDepthBuffer);
+	DestroyRenderGraph(pRenderer, &pRenderGraph);
 	DestroySwapchain(&pRenderer);
 
 	pPBRPipeline->desc.colorAttachmentCount = 0;
 
 	if (pRenderer->window.reset)
 	{
+		if (useBindless)
+		{
+			DestroyDescriptorSet(pRenderer, &pBindlessTextureSet);
+			bindlessTextureSlots.clear();
+			freeBindlessTextureSlots.clear();
+			retiredBindlessTextureSlots.clear();
+			bindlessTextureCount = 0;
+		}
+
+		if (useGpuCulling)
+		{
+			DestroyDescriptorSet(pRenderer, &pCullDescriptorSet);
+			DestroyResourceDescriptor(pRenderer, &pCullResDesc);
+		}
+		DestroyResourceDescriptor(pRenderer, &pSkinResDesc);
 		DestroyResourceDescriptor(pRenderer, &pDebugDrawResDesc);
 		DestroyResourceDescriptor(pRenderer, &pSkyboxResDesc);
 		DestroyResourceDescriptor(pRenderer, &pPBRResDesc);
 		resourceDescriptorNameMap.clear();
 
 		for (uint32_t i = 0; i < pRenderer->maxInFlightFrames; ++i)
+		{
+			if (useGpuCulling)
+			{
+				DestroyBuffer(pRenderer, &ppDrawCountBuffers[i]);
+				DestroyBuffer(pRenderer, &ppVisibleInstanceBuffers[i]);
+				DestroyBuffer(pRenderer, &ppIndirectCommandBuffers[i]);
+				DestroyBuffer(pRenderer, &ppCullDrawBuffers[i]);
+			}
+			DestroyBuffer(pRenderer, &ppSkinJointBuffers[i]);
+			DestroyBuffer(pRenderer, &ppSkinnedVertexBuffers[i]);
+			DestroyBuffer(pRenderer, &ppInstanceBuffers[i]);
 			DestroyBuffer(pRenderer, &ppSceneUniformBuffers[i]);
+		}
 
 		const uint32_t cmdBfrCnt = pRenderer->maxInFlightFrames;
 		DestroyCommandBuffers(pRenderer, cmdBfrCnt, cmdBfrs);
 
+		const uint32_t recordingCnt = pRenderer->maxInFlightFrames * recordingSliceCount;
+		for (uint32_t i = 0; i < recordingCnt; ++i)
+		{
+			DestroySecondaryCommandBuffers(pRenderer, ppRecordingPools[i], 1, &ppSecondaryCmdBfrs[i]);
+			DestroyCommandPool(pRenderer, &ppRecordingPools[i]);
+		}
+
+		ExitTextureStreamer(pTextureStreamer);
+		pRenderer->pTextureStreamer = nullptr;
 		ExitRenderer(&pRenderer);
 
 		renderSystemInitialized = false;
@@ -674,6 +1096,13 @@ void AppRenderer::DrawScene()
 	uint32_t imageIndex = GetNextSwapchainImage(pRenderer);
 	if (imageIndex == -1)
 	{
+		std::vector<DrawPacket, FrameAllocator<DrawPacket>>().swap(renderQueue);
+		instanceCount = 0;
+		cullDrawCount = 0;
+		culledBucketCount = 0;
+		skinnedVertexCount = 0;
+		skinJointCount = 0;
+		skinningQueue.clear();
 		Unload();
 		Load();
 		return;
@@ -681,10 +1110,30 @@ void AppRenderer::DrawScene()
 
 	uint32_t currentFrame = pRenderer->currentFrame;
 	CommandBuffer* pCmd = cmdBfrs[currentFrame];
-	RenderTarget* pRenderTarget = pRenderer->swapchainRenderTargets[imageIndex];
 
+	// the fence of this frame has been waited on, the frames that sampled the slots it retired are done
+	if (!retiredBindlessTextureSlots.empty())
+		FreeRetiredBindlessTextureSlots(currentFrame);
+
+	// texture streaming copies ahead of every pass, a texture that got a new image is written into the descriptors
+	// again before anything binds them
 	BeginCommandBuffer(pCmd);
-	TransitionImageLayout(pCmd, pRenderTarget->pTexture, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	UpdateTextureStreaming(pTextureStreamer, pCmd, textureResidencyChanges);
+	if (!textureResidencyChanges.empty())
+	{
+		if (useBindless)
+		{
+			for (const TextureResidencyChange& change : textureResidencyChanges)
+				UpdateBindlessTexture(change);
+		}
+		else
+		{
+			// the material sets are shared by the frames in flight and can only be written once none of them runs
+			WaitForInFlightFrames(pRenderer);
+		}
+		UpdateTextureDescriptors(GetResourceLoader(), textureResidencyChanges.data(), (uint32_t)textureResidencyChanges.size());
+	}
+	RenderTarget* pRenderTarget = pRenderer->swapchainRenderTargets[imageIndex];
 
 	VkClearValue clearColor = {};
 	clearColor.color.float32[0] = 0.3f;
@@ -692,34 +1141,322 @@ void AppRenderer::DrawScene()
 	clearColor.color.float32[2] = 0.3f;
 	clearColor.color.float32[3] = 1.0f;
 
-	LoadActionsDesc loadDesc;
-	loadDesc.clearColors[0] = clearColor;
-	loadDesc.loadColorActions[0] = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	loadDesc.clearDepth.depthStencil.depth = 1.0f;
-	loadDesc.clearDepth.depthStencil.stencil = 0;
-	loadDesc.loadDepthAction = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	BindRenderTargets(pCmd, 1, &pRenderTarget, &loadDesc, pDepthBuffer);
+	VkClearValue clearDepth = {};
+	clearDepth.depthStencil.depth = 1.0f;
+	clearDepth.depthStencil.stencil = 0;
+
+	const TextureDesc& swapchainDesc = pRenderTarget->pTexture->desc;
+	ResetRenderGraph(pRenderGraph);
+	uint32_t backBuffer = ImportRenderGraphTarget(pRenderGraph, "BackBuffer", pRenderTarget, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	uint32_t depthBuffer = CreateRenderGraphTarget(pRenderGraph, "DepthBuffer", RenderGraphTargetDesc(swapchainDesc.width, swapchainDesc.height, VK_FORMAT_D32_SFLOAT));
+
+	// the fence of this frame has been waited on, its instance buffer is free
+	if (instanceCount)
+		UpdateBuffer(pRenderer, ppInstanceBuffers[currentFrame], pInstanceMatrices, sizeof(glm::mat4) * instanceCount);
+	if (skinJointCount)
+		UpdateBuffer(pRenderer, ppSkinJointBuffers[currentFrame], pSkinJoints, sizeof(glm::mat4) * 2 * skinJointCount);
+	if (cullDrawCount)
+	{
+		UpdateBuffer(pRenderer, ppCullDrawBuffers[currentFrame], pCullDraws, sizeof(GpuCullDraw) * cullDrawCount);
+		UpdateBuffer(pRenderer, ppIndirectCommandBuffers[currentFrame], pIndirectCommands, sizeof(VkDrawIndexedIndirectCommand) * cullDrawCount);
 
-	SetViewport(pCmd, 0.0f, 0.0f, (float)pRenderTarget->pTexture->desc.width, (float)pRenderTarget->pTexture->desc.height, 0.0f, 1.0f);
-	SetScissors(pCmd, 0, 0, pRenderTarget->pTexture->desc.width, pRenderTarget->pTexture->desc.height);
+		const uint32_t countBytes = sizeof(uint32_t) * (1 + culledBucketCount);
+		void* pZeroCounts = LinearAlloc(GetFrameAllocator(), countBytes, alignof(uint32_t));
+		memset(pZeroCounts, 0, countBytes);
+		UpdateBuffer(pRenderer, ppDrawCountBuffers[currentFrame], pZeroCounts, countBytes);
+	}
 
-	while (!renderQueue.empty())
+	if (!renderQueue.empty())
 	{
-		renderQueue.front()->Draw(pCmd);
-		renderQueue.pop();
+		DrawPacket* pScratch = (DrawPacket*)LinearAlloc(GetFrameAllocator(), sizeof(DrawPacket) * renderQueue.size(), alignof(DrawPacket));
+		SortDrawPackets(renderQueue.data(), pScratch, (uint32_t)renderQueue.size());
 	}
 
-	BindRenderTargets(pCmd, 0, nullptr);
-	TransitionImageLayout(pCmd, pRenderTarget->pTexture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	// the fence of this frame has been waited on, its secondaries can be recorded again
+	for (uint32_t i = 0; i < recordingSliceCount; ++i)
+		ResetCommandPool(pRenderer, ppRecordingPools[currentFrame * recordingSliceCount + i]);
+
+	activeSliceCount = (uint32_t)renderQueue.size() / MIN_RENDERABLES_PER_SLICE;
+	if (activeSliceCount > recordingSliceCount)
+		activeSliceCount = recordingSliceCount;
+	if (activeSliceCount < 2)
+		activeSliceCount = 0;
+
+	uint32_t forwardPass = AddRenderGraphPass(pRenderGraph, "Forward", ExecuteForwardPass, this, activeSliceCount > 0);
+	WriteRenderGraphColor(pRenderGraph, forwardPass, backBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor);
+	WriteRenderGraphDepth(pRenderGraph, forwardPass, depthBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, clearDepth);
+
+	CompileRenderGraph(pRenderGraph);
+
+	// a compute only pass would be culled by the graph, skinning and the cull are recorded ahead of it
+	if (!skinningQueue.empty())
+		RecordSkinning(pCmd);
+	if (cullDrawCount)
+		RecordInstanceCulling(pCmd);
+	ExecuteRenderGraph(pRenderGraph, pCmd);
 	EndCommandBuffer(pCmd);
 
 	Submit(pCmd);
 	Present(pCmd);
+
+	instanceCount = 0;
+	cullDrawCount = 0;
+	culledBucketCount = 0;
+	skinnedVertexCount = 0;
+	skinJointCount = 0;
+	skinningQueue.clear();
+}
+
+void AppRenderer::RecordSkinning(CommandBuffer* a_pCommandBuffer)
+{
+	// the frame's pool was last read by the draws this frame's fence waited for, no barrier before the writes
+	const uint32_t currentFrame = pRenderer->currentFrame;
+	BindPipeline(a_pCommandBuffer, pSkinPipeline);
+	for (const SkinnedInstance& instance : skinningQueue)
+	{
+		BindDescriptorSet(a_pCommandBuffer, currentFrame, instance.pAppModel->pSkinDescriptorSet, NULL, 0, NULL, VK_PIPELINE_BIND_POINT_COMPUTE);
+		for (Node* node : instance.pAppModel->pModel->linearNodes)
+		{
+			if (!node->mesh)
+				continue;
+
+			for (Primitive* primitive : node->mesh->primitives)
+			{
+				SkinConstants constants = { primitive->firstVertex, primitive->vertexCount, instance.firstSkinnedVertex, instance.pFirstJoints[node->mesh->indexInDescriptorSet] };
+				BindPushConstants(a_pCommandBuffer, pSkinResDesc, "SkinRange", &constants);
+				Dispatch(a_pCommandBuffer, (primitive->vertexCount + SKIN_GROUP_SIZE - 1) / SKIN_GROUP_SIZE);
+			}
+		}
+	}
+
+	BufferBarrier(a_pCommandBuffer, ppSkinnedVertexBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void AppRenderer::RecordInstanceCulling(CommandBuffer* a_pCommandBuffer)
+{
+	CullConstants constants = {};
+	memcpy(constants.planes, pCamera->frustum.planes, sizeof(constants.planes));
+	constants.drawCount = cullDrawCount;
+	constants.maxVisibleInstances = MAX_VISIBLE_INSTANCES;
+
+	const uint32_t currentFrame = pRenderer->currentFrame;
+	BindPipeline(a_pCommandBuffer, pCullPipeline);
+	BindDescriptorSet(a_pCommandBuffer, currentFrame, pCullDescriptorSet, NULL, 0, NULL, VK_PIPELINE_BIND_POINT_COMPUTE);
+	BindPushConstants(a_pCommandBuffer, pCullResDesc, "Frustum", &constants);
+	// one work group per draw
+	Dispatch(a_pCommandBuffer, cullDrawCount);
+
+	BufferBarrier(a_pCommandBuffer, ppIndirectCommandBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	BufferBarrier(a_pCommandBuffer, ppDrawCountBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	BufferBarrier(a_pCommandBuffer, ppVisibleInstanceBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void AppRenderer::ExecuteForwardPass(CommandBuffer* a_pCommandBuffer, void* a_pUserData)
+{
+	AppRenderer* pAppRenderer = (AppRenderer*)a_pUserData;
+	if (pAppRenderer->activeSliceCount)
+	{
+		Texture* pExtent = pAppRenderer->pRenderer->swapchainRenderTargets[0]->pTexture;
+		ForwardSliceJobData data = { pAppRenderer, a_pCommandBuffer, pExtent->desc.width, pExtent->desc.height };
+
+		JobCounter counter;
+		RunJobs(RecordForwardSlice, &data, pAppRenderer->activeSliceCount, &counter);
+		WaitForJobs(&counter);
+
+		// slices are executed in queue order, draw order stays the same as inline recording
+		CommandBuffer** ppSecondaries = pAppRenderer->ppSecondaryCmdBfrs + pAppRenderer->pRenderer->currentFrame * pAppRenderer->recordingSliceCount;
+		ExecuteCommandBuffers(a_pCommandBuffer, pAppRenderer->activeSliceCount, ppSecondaries);
+	}
+	else
+	{
+		for (const DrawPacket& packet : pAppRenderer->renderQueue)
+			((Renderable*)packet.pItem)->Draw(a_pCommandBuffer);
+	}
+	// release the storage before the frame allocator gets reset
+	std::vector<DrawPacket, FrameAllocator<DrawPacket>>().swap(pAppRenderer->renderQueue);
+}
+
+void AppRenderer::RecordForwardSlice(void* a_pData, uint32_t a_uSlice)
+{
+	ForwardSliceJobData* pData = (ForwardSliceJobData*)a_pData;
+	AppRenderer* pAppRenderer = pData->pAppRenderer;
+	CommandBuffer* pSecondary = pAppRenderer->ppSecondaryCmdBfrs[pAppRenderer->pRenderer->currentFrame * pAppRenderer->recordingSliceCount + a_uSlice];
+
+	// contiguous slices, the remainder is spread over the first ones
+	const uint32_t queueSize = (uint32_t)pAppRenderer->renderQueue.size();
+	const uint32_t sliceSize = queueSize / pAppRenderer->activeSliceCount;
+	const uint32_t remainder = queueSize % pAppRenderer->activeSliceCount;
+	const uint32_t begin = a_uSlice * sliceSize + (a_uSlice < remainder ? a_uSlice : remainder);
+	const uint32_t end = begin + sliceSize + (a_uSlice < remainder ? 1 : 0);
+
+	BeginSecondaryCommandBuffer(pSecondary, pData->pPrimary);
+	SetViewport(pSecondary, 0.0f, 0.0f, (float)pData->extentWidth, (float)pData->extentHeight, 0.0f, 1.0f);
+	SetScissors(pSecondary, 0, 0, pData->extentWidth, pData->extentHeight);
+	for (uint32_t i = begin; i < end; ++i)
+		((Renderable*)pAppRenderer->renderQueue[i].pItem)->Draw(pSecondary);
+	EndCommandBuffer(pSecondary);
+}
+
+void AppRenderer::PushToRenderQueue(Renderable* a_pRenderable, uint64_t a_uSortKey)
+{
+	DrawPacket packet = { a_uSortKey, a_pRenderable };
+	renderQueue.push_back(packet);
+}
+
+uint32_t AppRenderer::AllocateInstances(uint32_t a_uCount, glm::mat4** a_ppMatrices)
+{
+	if (instanceCount + a_uCount > MAX_MODEL_INSTANCES)
+	{
+		LOG(LogSeverity::WARNING, "Instance buffer full, %d instances dropped", a_uCount);
+		return (uint32_t)-1;
+	}
+
+	const uint32_t firstInstance = instanceCount;
+	instanceCount += a_uCount;
+	*a_ppMatrices = pInstanceMatrices + firstInstance;
+	return firstInstance;
+}
+
+Buffer* AppRenderer::GetInstanceBuffer()
+{
+	return ppInstanceBuffers[pRenderer->currentFrame];
+}
+
+uint32_t AppRenderer::AllocateCulledBucket(uint32_t a_uDrawCount)
+{
+	LOG_IF(useGpuCulling, LogSeverity::ERR, "GPU culling is not supported on this device");
+
+	if (a_uDrawCount == 0 || cullDrawCount + a_uDrawCount > MAX_CULLED_DRAWS)
+		return (uint32_t)-1;
+
+	const uint32_t bucket = culledBucketCount++;
+	pCulledBuckets[bucket].firstCommand = cullDrawCount;
+	pCulledBuckets[bucket].drawCount = a_uDrawCount;
+	// commands the cull leaves alone draw nothing, the fallback without a draw count draws the whole bucket
+	memset(pIndirectCommands + cullDrawCount, 0, sizeof(VkDrawIndexedIndirectCommand) * a_uDrawCount);
+	for (uint32_t i = 0; i < a_uDrawCount; ++i)
+	{
+		GpuCullDraw& draw = pCullDraws[cullDrawCount + i];
+		draw.instanceCount = 0;
+		draw.bucket = bucket;
+		draw.firstCommand = cullDrawCount;
+	}
+
+	cullDrawCount += a_uDrawCount;
+	return bucket;
+}
+
+void AppRenderer::SetCulledDraw(uint32_t a_uBucket, uint32_t a_uDraw, uint32_t a_uFirstInstance, uint32_t a_uInstanceCount, const glm::mat4& a_NodeMatrix,
+	uint32_t a_uIndexCount, uint32_t a_uFirstIndex, int32_t a_iVertexOffset, const glm::vec3& a_BoundsMin, const glm::vec3& a_BoundsMax, bool a_bCull)
+{
+	LOG_IF(a_uBucket < culledBucketCount && a_uDraw < pCulledBuckets[a_uBucket].drawCount, LogSeverity::ERR, "Culled draw %u of bucket %u was not allocated", a_uDraw, a_uBucket);
+
+	GpuCullDraw& draw = pCullDraws[pCulledBuckets[a_uBucket].firstCommand + a_uDraw];
+	draw.node = a_NodeMatrix;
+	draw.boundsMin = glm::vec4(a_BoundsMin, 0.0f);
+	draw.boundsMax = glm::vec4(a_BoundsMax, 0.0f);
+	draw.firstSourceInstance = a_uFirstInstance;
+	draw.instanceCount = a_uInstanceCount;
+	draw.indexCount = a_uIndexCount;
+	draw.firstIndex = a_uFirstIndex;
+	draw.vertexOffset = a_iVertexOffset;
+	draw.noCull = a_bCull ? 0 : 1;
+}
+
+void AppRenderer::DrawCulledBucket(CommandBuffer* a_pCommandBuffer, uint32_t a_uBucket)
+{
+	const CulledBucket& bucket = pCulledBuckets[a_uBucket];
+	const uint32_t currentFrame = pRenderer->currentFrame;
+	const uint64_t offset = (uint64_t)bucket.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+	if (pRenderer->drawIndirectCountSupported)
+	{
+		DrawIndexedIndirectCount(a_pCommandBuffer, ppIndirectCommandBuffers[currentFrame], offset, ppDrawCountBuffers[currentFrame],
+			sizeof(uint32_t) * (1 + a_uBucket), bucket.drawCount);
+	}
+	else if (pRenderer->multiDrawIndirectSupported)
+	{
+		DrawIndexedIndirect(a_pCommandBuffer, ppIndirectCommandBuffers[currentFrame], offset, bucket.drawCount);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < bucket.drawCount; ++i)
+			DrawIndexedIndirect(a_pCommandBuffer, ppIndirectCommandBuffers[currentFrame], offset + i * sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+Buffer* AppRenderer::GetVisibleInstanceBuffer()
+{
+	return ppVisibleInstanceBuffers[pRenderer->currentFrame];
+}
+
+uint32_t AppRenderer::AllocateSkinJoints(uint32_t a_uCount, glm::mat4** a_ppJoints)
+{
+	if (skinJointCount + a_uCount > MAX_SKIN_JOINTS)
+	{
+		LOG(LogSeverity::WARNING, "Skin joint buffer full, %d joints dropped", a_uCount);
+		return (uint32_t)-1;
+	}
+
+	const uint32_t firstJoint = skinJointCount;
+	skinJointCount += a_uCount;
+	*a_ppJoints = pSkinJoints + firstJoint * 2;
+	return firstJoint;
+}
+
+uint32_t AppRenderer::QueueSkinning(AppModel* a_pAppModel, const uint32_t* a_pFirstJoints)
+{
+	if (!a_pAppModel->pSkinDescriptorSet)
+		return (uint32_t)-1;
+
+	const uint32_t vertexCount = (uint32_t)(a_pAppModel->pModel->vertices->desc.bufferSize / sizeof(Model::PackedVertex));
+	if (skinnedVertexCount + vertexCount > MAX_SKINNED_VERTICES)
+	{
+		LOG(LogSeverity::WARNING, "Skinned vertex buffer full, %d vertices dropped", vertexCount);
+		return (uint32_t)-1;
+	}
+
+	const uint32_t firstSkinnedVertex = skinnedVertexCount;
+	skinnedVertexCount += vertexCount;
+	skinningQueue.push_back({ a_pAppModel, a_pFirstJoints, firstSkinnedVertex });
+	return firstSkinnedVertex;
+}
+
+Buffer* AppRenderer::GetSkinnedVertexBuffer(uint32_t a_uFrame)
+{
+	return ppSkinnedVertexBuffers[a_uFrame];
+}
+
+Buffer* AppRenderer::GetSkinJointBuffer(uint32_t a_uFrame)
+{
+	return ppSkinJointBuffers[a_uFrame];
+}
+
+const FrustumPlanes& AppRenderer::GetViewFrustum()
+{
+	return pCamera->frustum;
+}
+
+glm::mat4 AppRenderer::GetViewProjection()
+{
+	return pCamera->matrices.perspective * pCamera->matrices.view;
+}
+
+float AppRenderer::GetViewDepth(const glm::vec3& a_Position)
+{
+	// the camera looks down -z in view space
+	return -(pCamera->matrices.view * glm::vec4(a_Position, 1.0f)).z;
 }
 
-void AppRenderer::PushToRenderQueue(Renderable* a_pRenderable)
+float AppRenderer::GetScreenSize(const glm::vec3& a_Center, float a_fRadius)
 {
-	renderQueue.push(a_pRenderable);
+	const float depth = GetViewDepth(a_Center);
+	if (depth <= a_fRadius)
+		return 1.0f;
+	return std::min(a_fRadius * pCamera->matrices.perspective[1][1] / depth, 1.0f);
 }
 
 void AppRenderer::GetResourceDescriptorByName(const char* a_sName, ResourceDescriptor** a_ppResourceDescriptor)
@@ -874,4 +1611,94 @@ void AppRenderer::BindModelMatrixDescriptorSet(CommandBuffer* a_pCommandBuffer,
 
 	const uint32_t offsets[1] = { a_pIndex * (uint32_t)sizeof(glm::mat4) };
 	BindDescriptorSet(a_pCommandBuffer, pRenderer->currentFrame, itr->second->pDescriptorSet, NULL, 1, offsets);
+}
+
+uint32_t AppRenderer::AddBindlessTexture(const VkDescriptorImageInfo& a_ImageInfo)
+{
+	LOG_IF(useBindless, LogSeverity::ERR, "Bindless textures are not supported on this device");
+
+	std::pair<VkImageView, VkSampler> key = { a_ImageInfo.imageView, a_ImageInfo.sampler };
+	std::map<std::pair<VkImageView, VkSampler>, uint32_t>::const_iterator itr = bindlessTextureSlots.find(key);
+	if (itr != bindlessTextureSlots.end())
+		return itr->second;
+
+	if (freeBindlessTextureSlots.empty() && bindlessTextureCount >= pRenderer->maxBindlessTextures)
+	{
+		LOG(LogSeverity::ERR, "Bindless texture array is full (%u textures)", pRenderer->maxBindlessTextures);
+		return 0;
+	}
+
+	// the set is update after bind, new slots can be written while earlier frames are in flight
+	uint32_t slot = 0;
+	if (!freeBindlessTextureSlots.empty())
+	{
+		slot = freeBindlessTextureSlots.back();
+		freeBindlessTextureSlots.pop_back();
+	}
+	else
+		slot = bindlessTextureCount++;
+	UpdateDescriptorSetArray(pRenderer, 0, pBindlessTextureSet, "textures", slot, 1, &a_ImageInfo);
+	bindlessTextureSlots.insert({ key, slot });
+	return slot;
+}
+
+void AppRenderer::UpdateBindlessTexture(const TextureResidencyChange& a_Change)
+{
+	// one slot per sampler the view was paired with. the frames in flight may still sample the old slots, they are only
+	// retired here
+	std::vector<VkSampler> samplers;
+	std::map<std::pair<VkImageView, VkSampler>, uint32_t>::iterator itr = bindlessTextureSlots.lower_bound({ a_Change.oldImageView, VK_NULL_HANDLE });
+	while (itr != bindlessTextureSlots.end() && itr->first.first == a_Change.oldImageView)
+	{
+		samplers.push_back(itr->first.second);
+		retiredBindlessTextureSlots.push_back({ pRenderer->currentFrame, itr->second });
+		itr = bindlessTextureSlots.erase(itr);
+	}
+
+	for (VkSampler sampler : samplers)
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = a_Change.pTexture->imageView;
+		imageInfo.imageLayout = a_Change.pTexture->desc.initialLayout;
+		AddBindlessTexture(imageInfo);
+	}
+}
+
+void AppRenderer::FreeRetiredBindlessTextureSlots(uint32_t a_uFrame)
+{
+	VkDescriptorImageInfo defaultImageInfo = {};
+	defaultImageInfo.imageView = pRenderer->defaultResources.defaultImage.imageView;
+	defaultImageInfo.imageLayout = pRenderer->defaultResources.defaultImage.desc.initialLayout;
+	defaultImageInfo.sampler = pRenderer->defaultResources.defaultSampler.sampler;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < retiredBindlessTextureSlots.size(); ++i)
+	{
+		const std::pair<uint32_t, uint32_t>& retired = retiredBindlessTextureSlots[i];
+		if (retired.first != a_uFrame)
+		{
+			retiredBindlessTextureSlots[kept++] = retired;
+			continue;
+		}
+		UpdateDescriptorSetArray(pRenderer, 0, pBindlessTextureSet, "textures", retired.second, 1, &defaultImageInfo);
+		freeBindlessTextureSlots.push_back(retired.second);
+	}
+	retiredBindlessTextureSlots.resize(kept);
+}
+
+void AppRenderer::RemoveBindlessTexture(const Texture* a_pTexture)
+{
+	VkDescriptorImageInfo defaultImageInfo = {};
+	defaultImageInfo.imageView = pRenderer->defaultResources.defaultImage.imageView;
+	defaultImageInfo.imageLayout = pRenderer->defaultResources.defaultImage.desc.initialLayout;
+	defaultImageInfo.sampler = pRenderer->defaultResources.defaultSampler.sampler;
+
+	std::map<std::pair<VkImageView, VkSampler>, uint32_t>::iterator itr = bindlessTextureSlots.lower_bound({ a_pTexture->imageView, VK_NULL_HANDLE });
+	while (itr != bindlessTextureSlots.end() && itr->first.first == a_pTexture->imageView)
+	{
+		UpdateDescriptorSetArray(pRenderer, 0, pBindlessTextureSet, "textures", itr->second, 1, &defaultImageInfo);
+		freeBindlessTextureSlots.push_back(itr->second);
+		itr = bindlessTextureSlots.erase(itr);
+	}
 }
\ No newline at end of file
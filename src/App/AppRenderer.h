@@ -1,13 +1,30 @@
 #pragma once
 
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include "../Engine/LinearAllocator.h"
+#include "../Engine/DrawList.h"
+
 // Engine Renderer
 struct Renderer;
 struct CommandBuffer;
+struct CommandPool;
 struct ShaderModule;
 struct DescriptorSet;
 struct ResourceDescriptor;
 struct RenderTarget;
 struct Pipeline;
+struct RenderGraph;
+struct TextureStreamer;
+struct TextureResidencyChange;
+struct Texture;
+struct VkDescriptorImageInfo;
+struct VkDrawIndexedIndirectCommand;
+// VkImageView and VkSampler are pointers to these on 64 bit targets
+struct VkImageView_T;
+struct VkSampler_T;
+struct FrustumPlanes;
 
 // Engine ModelLoader
 struct Node;
@@ -34,11 +51,19 @@ struct PushConstBlockMaterial {
 	float roughnessFactor;
 	float alphaMask;
 	float alphaMaskCutoff;
+	// bindless texture array indices, unused by the descriptor set path
+	int colorTextureIndex;
+	int physicalDescriptorTextureIndex;
+	int normalTextureIndex;
+	int occlusionTextureIndex;
+	int emissiveTextureIndex;
 };
 
 enum PBRWorkflows { PBR_WORKFLOW_METALLIC_ROUGHNESS = 0, PBR_WORKFLOW_SPECULAR_GLOSINESS = 1 };
 
 struct ModelMatrixDynamicBuffer;
+struct GpuCullDraw;
+struct CulledBucket;
 
 class Renderable
 {
@@ -74,18 +99,36 @@ struct AppModel
 	Model*			pModel;
 	DescriptorSet*	pNodeDescriptorSet;
 	DescriptorSet*	pMaterialDescriptorSet;
+	// skinning pass, one set per frame in flight. nullptr without skins
+	DescriptorSet*	pSkinDescriptorSet;
+	// false while GetModelAsync loads it and for files that failed to load, nothing of pModel is drawn then
+	bool			ready;
 
 	AppModel() :
-		pModel(nullptr), pNodeDescriptorSet(nullptr), pMaterialDescriptorSet(nullptr)
+		pModel(nullptr), pNodeDescriptorSet(nullptr), pMaterialDescriptorSet(nullptr), pSkinDescriptorSet(nullptr), ready(false)
 	{}
 };
 
+// an entity of a skinned model posed by the skinning pass of this frame, see QueueSkinning
+struct SkinnedInstance
+{
+	AppModel*		pAppModel;
+	// per mesh by indexInDescriptorSet, -1 for meshes without a skin
+	const uint32_t*	pFirstJoints;
+	uint32_t		firstSkinnedVertex;
+};
+
 class AppRenderer
 {
 public:
 	AppRenderer() :
-		pRenderer(nullptr), pCamera(nullptr), pDepthBuffer(nullptr), cmdBfrs(nullptr), renderSystemInitialized(false),
-		ppSceneUniformBuffers(nullptr), pSceneDescriptorSet(nullptr), pPBRResDesc(nullptr), pPBRPipeline(nullptr),
+		pRenderer(nullptr), pCamera(nullptr), pRenderGraph(nullptr), pTextureStreamer(nullptr), cmdBfrs(nullptr), ppRecordingPools(nullptr), ppSecondaryCmdBfrs(nullptr), recordingSliceCount(0), activeSliceCount(0),
+		renderSystemInitialized(false),
+		ppSceneUniformBuffers(nullptr), pSceneDescriptorSet(nullptr), pPBRResDesc(nullptr), pPBRPipeline(nullptr), pPBRInstancedPipeline(nullptr),
+		useBindless(false), pBindlessTextureSet(nullptr), ppInstanceBuffers(nullptr), pInstanceMatrices(nullptr), instanceCount(0), bindlessTextureSlots(), freeBindlessTextureSlots(), retiredBindlessTextureSlots(), bindlessTextureCount(0),
+		useGpuCulling(false), pCullPipeline(nullptr), pCullResDesc(nullptr), pCullDescriptorSet(nullptr), ppCullDrawBuffers(nullptr), ppIndirectCommandBuffers(nullptr), ppVisibleInstanceBuffers(nullptr),
+		ppDrawCountBuffers(nullptr), pCullDraws(nullptr), pIndirectCommands(nullptr), pCulledBuckets(nullptr), cullDrawCount(0), culledBucketCount(0),
+		pSkinPipeline(nullptr), pSkinResDesc(nullptr), ppSkinnedVertexBuffers(nullptr), ppSkinJointBuffers(nullptr), pSkinJoints(nullptr), skinnedVertexCount(0), skinJointCount(0), skinningQueue(),
 		resourceDescriptorNameMap(), modelMatrixDynamicBufferMap(), renderQueue()
 	{}
 	~AppRenderer() {}
@@ -98,7 +141,16 @@ public:
 	void DrawScene();
 
 	Renderer* GetRenderer() { return pRenderer; }
-	void PushToRenderQueue(Renderable* a_pRenderable);
+	// a_uSortKey from MakeDrawSortKey, the queue is drawn in key order
+	void PushToRenderQueue(Renderable* a_pRenderable, uint64_t a_uSortKey);
+	// distance along the view direction, for sort keys
+	float GetViewDepth(const glm::vec3& a_Position);
+	// height of a world space sphere on screen as a fraction of the screen height, 1 when the camera is inside it
+	float GetScreenSize(const glm::vec3& a_Center, float a_fRadius);
+	// world space, matches the matrices in the scene uniform buffer
+	const FrustumPlanes& GetViewFrustum();
+	// camera projection times view, the frustum planes come from it
+	glm::mat4 GetViewProjection();
 	
 	void GetResourceDescriptorByName(const char* a_sName, ResourceDescriptor** a_ppResourceDescriptor);
 
@@ -110,18 +162,83 @@ public:
 	void UpdateModelMatrixGpuBufferForIndex(const char* a_sName, const uint32_t a_pIndex);
 	void BindModelMatrixDescriptorSet(CommandBuffer* a_pCommandBuffer, const char* a_sName, const uint32_t a_pIndex);
 
+	// returns the slot of the image/sampler pair in the bindless texture array, adding it if needed
+	uint32_t AddBindlessTexture(const VkDescriptorImageInfo& a_ImageInfo);
+	// gives the new image view slots of its own, the slots of the old one are freed once no frame in flight samples them.
+	// UpdateTextureDescriptors points the materials at the new slots
+	void UpdateBindlessTexture(const TextureResidencyChange& a_Change);
+	// frees the slots of a texture that is about to be destroyed, no frame in flight may still sample them
+	void RemoveBindlessTexture(const Texture* a_pTexture);
+
+	// reserves a_uCount consecutive model matrices of this frame's instance buffer, returns the first
+	// instance to draw with or -1 when the buffer is full. uploaded in DrawScene
+	uint32_t AllocateInstances(uint32_t a_uCount, glm::mat4** a_ppMatrices);
+	// vertex buffer of the instanced pipeline, binding 1
+	Buffer* GetInstanceBuffer();
+
+	// reserves a_uDrawCount culled draws that share their pipeline, buffers and material, returns the bucket or -1 when full.
+	// the cull runs in DrawScene before the forward pass and compacts the draws with a visible instance to the front of the bucket
+	uint32_t AllocateCulledBucket(uint32_t a_uDrawCount);
+	// draw a_uDraw of a bucket, instances [a_uFirstInstance, a_uFirstInstance + a_uInstanceCount) from AllocateInstances times a_NodeMatrix.
+	// bounds are in mesh space, draws with a_bCull false keep every instance
+	void SetCulledDraw(uint32_t a_uBucket, uint32_t a_uDraw, uint32_t a_uFirstInstance, uint32_t a_uInstanceCount, const glm::mat4& a_NodeMatrix,
+		uint32_t a_uIndexCount, uint32_t a_uFirstIndex, int32_t a_iVertexOffset, const glm::vec3& a_BoundsMin, const glm::vec3& a_BoundsMax, bool a_bCull);
+	// the visible draws of a bucket, one indirect count draw when the device has them
+	void DrawCulledBucket(CommandBuffer* a_pCommandBuffer, uint32_t a_uBucket);
+	// instances that survived culling, binding 1 of the instanced pipeline for culled draws
+	Buffer* GetVisibleInstanceBuffer();
+
+	// reserves a_uCount joints of this frame's joint pool, each one a joint matrix followed by its inverse transpose.
+	// returns the first joint or -1 when the pool is full. uploaded in DrawScene
+	uint32_t AllocateSkinJoints(uint32_t a_uCount, glm::mat4** a_ppJoints);
+	// poses one entity of a skinned model into this frame's skinned vertex pool before the passes of the frame, a_pFirstJoints
+	// from AllocateSkinJoints per mesh. returns the vertex offset its draws use or -1 when the pool is full
+	uint32_t QueueSkinning(AppModel* a_pAppModel, const uint32_t* a_pFirstJoints);
+	// vertex buffer of skinned draws, the skinning pass writes the one of the current frame
+	Buffer* GetSkinnedVertexBuffer(uint32_t a_uFrame);
+	Buffer* GetSkinJointBuffer(uint32_t a_uFrame);
+
 	// Pipelines
 	Pipeline* pPBRPipeline;
+	// per instance model matrix from a vertex buffer instead of the dynamic uniform buffer
+	Pipeline* pPBRInstancedPipeline;
 	Pipeline* pSkyboxPipeline;
 	Pipeline* pDebugDrawPipeline;
 	//
 	DescriptorSet* pSceneDescriptorSet;
 
+	// material textures are indexed from a single array when descriptor indexing is supported
+	bool useBindless;
+	DescriptorSet* pBindlessTextureSet;
+
+	// instanced draws are frustum culled on the GPU and drawn indirectly when the device can draw them
+	bool useGpuCulling;
+
 private:
+	// render graph pass callback, a_pUserData is the AppRenderer
+	static void ExecuteForwardPass(CommandBuffer* a_pCommandBuffer, void* a_pUserData);
+	// job system callback, records one slice of the render queue into a secondary command buffer
+	static void RecordForwardSlice(void* a_pData, uint32_t a_uSlice);
+	// dispatches the cull of this frame's culled draws, outside of the render pass
+	void RecordInstanceCulling(CommandBuffer* a_pCommandBuffer);
+	// dispatches skin.comp for every primitive of the queued entities, outside of the render pass
+	void RecordSkinning(CommandBuffer* a_pCommandBuffer);
+	// writes the slots a_uFrame retired with the default texture and hands them to AddBindlessTexture again
+	void FreeRetiredBindlessTextureSlots(uint32_t a_uFrame);
+
 	Renderer*			pRenderer;
 	Camera*				pCamera;
-	RenderTarget*		pDepthBuffer;
+	// rebuilt every frame in DrawScene, owns the transient depth buffer
+	RenderGraph*		pRenderGraph;
+	// mips of the model textures, updated in DrawScene before recording
+	TextureStreamer*	pTextureStreamer;
 	CommandBuffer**		cmdBfrs;
+	// one pool and secondary per recording slice per frame in flight, indexed [frame * recordingSliceCount + slice]
+	CommandPool**		ppRecordingPools;
+	CommandBuffer**		ppSecondaryCmdBfrs;
+	uint32_t			recordingSliceCount;
+	// slices recorded this frame, 0 when the queue is drawn inline
+	uint32_t			activeSliceCount;
 	bool				renderSystemInitialized;
 
 	// projection and view matrices
@@ -134,7 +251,47 @@ private:
 	ResourceDescriptor*	pDebugDrawResDesc;
 	//
 
+	// per frame in flight, rewritten every frame
+	Buffer**			ppInstanceBuffers;
+	glm::mat4*			pInstanceMatrices;
+	uint32_t			instanceCount;
+
+	// image/sampler pairs already written to the bindless texture array
+	std::map<std::pair<VkImageView_T*, VkSampler_T*>, uint32_t>	bindlessTextureSlots;
+	// slots of removed textures, written with the default texture until AddBindlessTexture hands them out again
+	std::vector<uint32_t>	freeBindlessTextureSlots;
+	// frame in flight and slot of views a streamed texture replaced, freed when that frame is recorded again
+	std::vector<std::pair<uint32_t, uint32_t>>	retiredBindlessTextureSlots;
+	uint32_t			bindlessTextureCount;
+
+	// GPU culling, buffers per frame in flight
+	Pipeline*						pCullPipeline;
+	ResourceDescriptor*				pCullResDesc;
+	DescriptorSet*					pCullDescriptorSet;
+	Buffer**						ppCullDrawBuffers;
+	Buffer**						ppIndirectCommandBuffers;
+	Buffer**						ppVisibleInstanceBuffers;
+	// visible instances taken so far, then the command count of every bucket
+	Buffer**						ppDrawCountBuffers;
+	GpuCullDraw*					pCullDraws;
+	VkDrawIndexedIndirectCommand*	pIndirectCommands;
+	CulledBucket*					pCulledBuckets;
+	uint32_t						cullDrawCount;
+	uint32_t						culledBucketCount;
+
+	// compute skinning, pools per frame in flight
+	Pipeline*					pSkinPipeline;
+	ResourceDescriptor*			pSkinResDesc;
+	Buffer**					ppSkinnedVertexBuffers;
+	Buffer**					ppSkinJointBuffers;
+	glm::mat4*					pSkinJoints;
+	uint32_t					skinnedVertexCount;
+	uint32_t					skinJointCount;
+	// entities to skin this frame
+	std::vector<SkinnedInstance>	skinningQueue;
+
 	std::unordered_map<uint32_t, ResourceDescriptor*>			resourceDescriptorNameMap;
 	std::unordered_map<uint32_t, ModelMatrixDynamicBuffer*>		modelMatrixDynamicBufferMap;
-	std::queue<Renderable*>	renderQueue;
+	// filled during Update, sorted and drained in DrawScene; backed by the frame allocator
+	std::vector<DrawPacket, FrameAllocator<DrawPacket>>		renderQueue;
 };
\ No newline at end of file
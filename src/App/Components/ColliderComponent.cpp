@@ -4,7 +4,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../../../include/glm/glm.hpp"
 
-#include <queue>
+#include <unordered_map>
 
 #include "ColliderComponent.h"
 #include "../Systems.h"
@@ -14,6 +14,7 @@
 #include "../AppRenderer.h"
 #include "../../Engine/ModelLoader.h"
 #include "../Systems/Physics.h"
+#include "../ResourceLoader.h"
 
 DEFINE_COMPONENT(ColliderComponent)
 
@@ -30,66 +31,80 @@ void ColliderComponent::Exit()
 
 void ColliderComponent::Load()
 {
+	// the model may still be loading, the collider is fitted once it is there
 	AppModel* pModel = GetEntityManager()->getEntityByID(GetOwnerID())->GetComponent<ModelComponent>()->GetModel();
 	if (pModel)
-	{
-		float maxBound[3] = { FLT_MIN, FLT_MIN, FLT_MIN };
-		float minBound[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		OnResourceReady(GetResourceLoader(), pModel, OnModelReady, this);
 
-		for (uint32_t i = 0; i < pModel->pModel->vertexBuffer.size(); ++i)
+	GetAppRenderer()->GetModelMatrixFreeIndex("DebugDraw", &modelMatrixIndexInBuffer);
+	GetPhysics()->AddColliderComponent(this);
+}
+
+void ColliderComponent::OnModelReady(void* a_pUserData)
+{
+	((ColliderComponent*)a_pUserData)->FitToModel();
+}
+
+void ColliderComponent::FitToModel()
+{
+	AppModel* pModel = GetEntityManager()->getEntityByID(GetOwnerID())->GetComponent<ModelComponent>()->GetModel();
+	if (!pModel->ready)
+		return;
+
+	float maxBound[3] = { FLT_MIN, FLT_MIN, FLT_MIN };
+	float minBound[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+
+	for (uint32_t i = 0; i < pModel->pModel->positions.size(); ++i)
+	{
+		glm::vec3 pos = pModel->pModel->positions[i];
+		// X MAX
+		if (maxBound[0] < pos.x)
 		{
-			glm::vec3 pos = pModel->pModel->vertexBuffer[i].pos;
-			// X MAX
-			if (maxBound[0] < pos.x)
-			{
-				maxBound[0] = pos.x;
-			}
-			// X MIN
-			if (minBound[0] > pos.x)
-			{
-				minBound[0] = pos.x;
-			}
-			// Y MAX
-			if (maxBound[1] < pos.y)
-			{
-				maxBound[1] = pos.y;
-			}
-			// Y MIN
-			if (minBound[1] > pos.y)
-			{
-				minBound[1] = pos.y;
-			}
-			// Z MAX
-			if (maxBound[2] < pos.z)
-			{
-				maxBound[2] = pos.z;
-			}
-			// Z MIN
-			if (minBound[2] > pos.z)
-			{
-				minBound[2] = pos.z;
-			}
+			maxBound[0] = pos.x;
+		}
+		// X MIN
+		if (minBound[0] > pos.x)
+		{
+			minBound[0] = pos.x;
+		}
+		// Y MAX
+		if (maxBound[1] < pos.y)
+		{
+			maxBound[1] = pos.y;
+		}
+		// Y MIN
+		if (minBound[1] > pos.y)
+		{
+			minBound[1] = pos.y;
+		}
+		// Z MAX
+		if (maxBound[2] < pos.z)
+		{
+			maxBound[2] = pos.z;
+		}
+		// Z MIN
+		if (minBound[2] > pos.z)
+		{
+			minBound[2] = pos.z;
 		}
-
-		mCollider.mCenter[0] = abs(abs(maxBound[0]) - abs(minBound[0])) / 2.0f;
-		mCollider.mCenter[0] *= abs(maxBound[0]) > abs(minBound[0]) ? -1 : 1;
-		mCollider.mCenter[1] = abs(abs(maxBound[1]) - abs(minBound[1])) / 2.0f;
-		mCollider.mCenter[1] *= abs(maxBound[1]) > abs(minBound[1]) ? -1 : 1;
-		mCollider.mCenter[2] = abs(abs(maxBound[2]) - abs(minBound[2])) / 2.0f;
-		mCollider.mCenter[2] *= abs(maxBound[2]) > abs(minBound[2]) ? -1 : 1;
-		mCollider.mR[0] = (maxBound[0] - minBound[0]) / 2.0f;
-		mCollider.mR[1] = (maxBound[1] - minBound[1]) / 2.0f;
-		mCollider.mR[2] = (maxBound[2] - minBound[2]) / 2.0f;
-
-		UpdateScaledCollider();
 	}
 
-	GetAppRenderer()->GetModelMatrixFreeIndex("DebugDraw", &modelMatrixIndexInBuffer);
-	GetPhysics()->AddColliderComponent(this);
+	mCollider.mCenter[0] = abs(abs(maxBound[0]) - abs(minBound[0])) / 2.0f;
+	mCollider.mCenter[0] *= abs(maxBound[0]) > abs(minBound[0]) ? -1 : 1;
+	mCollider.mCenter[1] = abs(abs(maxBound[1]) - abs(minBound[1])) / 2.0f;
+	mCollider.mCenter[1] *= abs(maxBound[1]) > abs(minBound[1]) ? -1 : 1;
+	mCollider.mCenter[2] = abs(abs(maxBound[2]) - abs(minBound[2])) / 2.0f;
+	mCollider.mCenter[2] *= abs(maxBound[2]) > abs(minBound[2]) ? -1 : 1;
+	mCollider.mR[0] = (maxBound[0] - minBound[0]) / 2.0f;
+	mCollider.mR[1] = (maxBound[1] - minBound[1]) / 2.0f;
+	mCollider.mR[2] = (maxBound[2] - minBound[2]) / 2.0f;
+
+	UpdateScaledCollider();
 }
 
 void ColliderComponent::Unload()
 {
+	CancelResourceCallbacks(GetResourceLoader(), this);
 	GetPhysics()->RemoveColliderComponent(this);
 	GetAppRenderer()->RevokeModelMatrixIndex("DebugDraw", modelMatrixIndexInBuffer);
 }
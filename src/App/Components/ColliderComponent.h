@@ -28,6 +28,10 @@ public:
 	Collider mScaledCollider;
 
 private:
+	static void OnModelReady(void* a_pUserData);
+	// mCollider around the vertices of the entity's model
+	void FitToModel();
+
 	Collider mCollider;
 	uint32_t modelMatrixIndexInBuffer;
 END
@@ -7,7 +7,6 @@
 #include "../../Engine/Renderer.h"
 #include "../../Engine/ModelLoader.h"
 
-#include <queue>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../../../include/glm/glm.hpp"
@@ -21,7 +20,7 @@ DEFINE_COMPONENT(ModelComponent)
 ModelComponent::ModelComponent() :
 	modelPath(nullptr), pModel(nullptr), modelMatrixIndexInBuffer(-1), currentAnimationIndex(1), currentAnimationTime(0.0f),
 	transitioningAnimationIndex(-1), transitioningAnimationTime(0.0f), transitioningTime(0.0f),
-	blendFactor(0.0f)
+	blendFactor(0.0f), currentAnimationCursor(), transitioningAnimationCursor(), occluder(false), lod(0)
 {
 }
 
@@ -36,7 +35,8 @@ void ModelComponent::Exit()
 
 void ModelComponent::Load()
 {
-	::GetModel(GetResourceLoader(), modelPath, &pModel);
+	// drawn once the model is loaded, entities streamed in don't wait for their files
+	::GetModelAsync(GetResourceLoader(), modelPath, &pModel);
 	GetAppRenderer()->GetModelMatrixFreeIndex("PBR", &modelMatrixIndexInBuffer);
 	GetModelRenderSystem()->AddModelComponent(this);
 }
@@ -45,7 +45,7 @@ void ModelComponent::Unload()
 {
 	GetModelRenderSystem()->RemoveModelComponent(this);
 	GetAppRenderer()->RevokeModelMatrixIndex("PBR", modelMatrixIndexInBuffer);
-	pModel = nullptr;
+	ReleaseModel(GetResourceLoader(), &pModel);
 	modelMatrixIndexInBuffer = -1;
 }
 
@@ -53,8 +53,10 @@ START_REGISTRATION(ModelComponent)
 
 DEFINE_VARIABLE(ModelComponent, modelPath)
 DEFINE_VARIABLE(ModelComponent, currentAnimationIndex)
+DEFINE_VARIABLE(ModelComponent, occluder)
 
 START_REFERENCES(ModelComponent)
 REFERENCE_STRING_VARIABLE(ModelComponent, modelPath)
 REFERENCE_VARIABLE(ModelComponent, currentAnimationIndex)
+REFERENCE_VARIABLE(ModelComponent, occluder)
 END
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 struct AppModel;
 struct DescriptorSet;
 class PositionComponent;
@@ -22,6 +24,13 @@ public:
 	float transitioningAnimationTime;
 	float transitioningTime;
 	float blendFactor;
+	// AnimationCursor of the current and transitioning animation, the model and its animations are shared by entities
+	std::vector<uint32_t> currentAnimationCursor;
+	std::vector<uint32_t> transitioningAnimationCursor;
+	// drawn into the software depth buffer that hides other entities, large static models are picked without it
+	bool occluder;
+	// detail level drawn last frame, selection keeps it until the screen size moves past a threshold
+	uint32_t lod;
 
 private:
 	AppModel* pModel;
@@ -33,4 +42,5 @@ END
 REGISTER_COMPONENT_CLASS(ModelComponent)
 	REGISTER_VARIABLE(modelPath)
 	REGISTER_VARIABLE(currentAnimationIndex)
+	REGISTER_VARIABLE(occluder)
 END
\ No newline at end of file
@@ -6,7 +6,6 @@
 #include "../../../include/glm/gtc/matrix_transform.hpp"
 
 #include <unordered_map>
-#include <queue>
 
 #include "SkyboxComponent.h"
 #include "../Systems.h"
@@ -32,12 +31,12 @@ void SkyboxComponent::Exit()
 
 void SkyboxComponent::Load()
 {
-	GetTexture(GetResourceLoader(), rightTexPath, &rightTex);
-	GetTexture(GetResourceLoader(), leftTexPath, &leftTex);
-	GetTexture(GetResourceLoader(), topTexPath, &topTex);
-	GetTexture(GetResourceLoader(), botTexPath, &botTex);
-	GetTexture(GetResourceLoader(), frontTexPath, &frontTex);
-	GetTexture(GetResourceLoader(), backTexPath, &backTex);
+	GetTextureAsync(GetResourceLoader(), rightTexPath, &rightTex);
+	GetTextureAsync(GetResourceLoader(), leftTexPath, &leftTex);
+	GetTextureAsync(GetResourceLoader(), topTexPath, &topTex);
+	GetTextureAsync(GetResourceLoader(), botTexPath, &botTex);
+	GetTextureAsync(GetResourceLoader(), frontTexPath, &frontTex);
+	GetTextureAsync(GetResourceLoader(), backTexPath, &backTex);
 
 	ResourceDescriptor* pSkyboxResDesc = nullptr;
 	GetAppRenderer()->GetResourceDescriptorByName("Skybox", &pSkyboxResDesc);
@@ -47,6 +46,27 @@ void SkyboxComponent::Load()
 	pSkyboxDescriptorSet->desc = { pSkyboxResDesc, DescriptorUpdateFrequency::SET_2, 1 };
 	CreateDescriptorSet(pRenderer, &pSkyboxDescriptorSet);
 
+	WriteDescriptorSet();
+	// every texture that finishes writes the set again
+	Texture* pTextures[6] = { rightTex, leftTex, topTex, botTex, frontTex, backTex };
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		if (!IsResourceReady(GetResourceLoader(), pTextures[i]))
+			OnResourceReady(GetResourceLoader(), pTextures[i], OnTextureReady, this);
+	}
+
+	GetAppRenderer()->GetModelMatrixFreeIndex("Skybox", &modelMatrixIndexInBuffer);
+	GetSkyboxRenderSystem()->AddSkyboxComponent(this);
+}
+
+void SkyboxComponent::OnTextureReady(void* a_pUserData)
+{
+	((SkyboxComponent*)a_pUserData)->WriteDescriptorSet();
+}
+
+void SkyboxComponent::WriteDescriptorSet()
+{
+	Renderer* pRenderer = GetAppRenderer()->GetRenderer();
 	const char* skyboxSamplerNames[6] = {
 		"rightSampler",
 		"leftSampler",
@@ -67,32 +87,30 @@ void SkyboxComponent::Load()
 	DescriptorUpdateInfo descUpdateInfos[6] = {};
 	for (uint32_t i = 0; i < 6; ++i)
 	{
+		const Texture* pTexture = IsResourceReady(GetResourceLoader(), pTextures[i]) ? pTextures[i] : &pRenderer->defaultResources.defaultImage;
 		descUpdateInfos[i].name = skyboxSamplerNames[i];
-		descUpdateInfos[i].mImageInfo.imageView = pTextures[i]->imageView;
-		descUpdateInfos[i].mImageInfo.imageLayout = pTextures[i]->desc.initialLayout;
+		descUpdateInfos[i].mImageInfo.imageView = pTexture->imageView;
+		descUpdateInfos[i].mImageInfo.imageLayout = pTexture->desc.initialLayout;
 		descUpdateInfos[i].mImageInfo.sampler = pRenderer->defaultResources.defaultSampler.sampler;
 	}
 	UpdateDescriptorSet(pRenderer, 0, pSkyboxDescriptorSet, 6, descUpdateInfos);
-
-	GetAppRenderer()->GetModelMatrixFreeIndex("Skybox", &modelMatrixIndexInBuffer);
-	GetSkyboxRenderSystem()->AddSkyboxComponent(this);
 }
 
 void SkyboxComponent::Unload()
 {
+	CancelResourceCallbacks(GetResourceLoader(), this);
 	DestroyDescriptorSet(GetAppRenderer()->GetRenderer(), &pSkyboxDescriptorSet);
 	delete pSkyboxDescriptorSet;
 
 	GetSkyboxRenderSystem()->RemoveSkyboxComponent(this);
 	GetAppRenderer()->RevokeModelMatrixIndex("Skybox", modelMatrixIndexInBuffer);
 
-
-	rightTex = nullptr;
-	leftTex = nullptr;
-	topTex = nullptr;
-	botTex = nullptr;
-	frontTex = nullptr;
-	botTex = nullptr;
+	ReleaseTexture(GetResourceLoader(), &rightTex);
+	ReleaseTexture(GetResourceLoader(), &leftTex);
+	ReleaseTexture(GetResourceLoader(), &topTex);
+	ReleaseTexture(GetResourceLoader(), &botTex);
+	ReleaseTexture(GetResourceLoader(), &frontTex);
+	ReleaseTexture(GetResourceLoader(), &backTex);
 }
 
 
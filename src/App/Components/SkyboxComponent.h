@@ -30,6 +30,10 @@ public:
 	DescriptorSet* pSkyboxDescriptorSet;
 
 private:
+	static void OnTextureReady(void* a_pUserData);
+	// textures still loading are bound as the renderer's default image
+	void WriteDescriptorSet();
+
 	uint32_t modelMatrixIndexInBuffer;
 END
 
@@ -3,10 +3,21 @@
 #include "../Engine/Renderer.h"
 #include "../Engine/ModelLoader.h"
 #include "../Engine/Log.h"
-#include <queue>
+#include "../Engine/TextureStreaming.h"
+#include "../Engine/JobSystem.h"
+#include "../Engine/FileSystem.h"
+#include "../Engine/FileIO.h"
+#include "../Engine/Hash.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
 #include "../App/AppRenderer.h"
 #include "../App/Systems.h"
 
+// debug builds report the stats every this many updates
+#define RESOURCE_REPORT_UPDATES 60
+
 const std::string resourcePath = {
 #if defined(_WIN32)
 	"../../src/App/Resources/"
@@ -97,27 +108,101 @@ struct ModelMatrixDynamicBuffer
 	{}
 };
 
+enum class ResourceLoadType
+{
+	MODEL,
+	TEXTURE
+};
+
+// one GetModelAsync or GetTextureAsync, its job reads the file into the resource and UpdateResourceLoader creates the rest
+struct ResourceLoad
+{
+	ResourceLoadType	type;
+	Renderer*			pRenderer;
+	std::string			path;
+	AppModel*			pAppModel;
+	Texture*			pTexture;
+	// what LoadModelFromFile returned
+	bool				loaded;
+	// source image of a texture, read ahead of its decode job
+	FileReadRequest		fileRead;
+	JobCounter			counter;
+
+	ResourceLoad() :
+		type(ResourceLoadType::MODEL), pRenderer(nullptr), path(), pAppModel(nullptr), pTexture(nullptr), loaded(false), fileRead(), counter()
+	{}
+};
+
+static void FinishResourceLoads(ResourceLoader* a_pResourceLoader);
+static void EvictResources(ResourceLoader* a_pResourceLoader, bool a_bAll);
+
+static uint64_t HashPath(const char* a_sPath)
+{
+	return HashFnv1a64(a_sPath, strlen(a_sPath));
+}
+
+static void DeleteResource(ResourceEntry* a_pEntry)
+{
+	switch (a_pEntry->type)
+	{
+	case ResourceType::MODEL:
+	{
+		AppModel* pAppModel = (AppModel*)a_pEntry->pResource;
+		delete pAppModel->pNodeDescriptorSet;
+		delete pAppModel->pMaterialDescriptorSet;
+		delete pAppModel->pSkinDescriptorSet;
+		delete pAppModel->pModel;
+		delete pAppModel;
+		break;
+	}
+	case ResourceType::TEXTURE:
+		delete (Texture*)a_pEntry->pResource;
+		break;
+	case ResourceType::SHADER:
+		delete (ShaderModule*)a_pEntry->pResource;
+		break;
+	}
+	delete a_pEntry;
+}
+
 void InitResourceLoader(ResourceLoader** a_ppResourceLoader)
-{}
+{
+	// debug builds read the loose files, an archive left from a release build would hide edits to them
+#if !defined(_DEBUG)
+	const std::string archivePath = resourcePath + RESOURCE_ARCHIVE_NAME;
+	if (ExistFile(archivePath.c_str()))
+		MountArchive(archivePath.c_str(), resourcePath.c_str());
+#endif
+}
 
 void ExitResourceLoader(ResourceLoader** a_ppResourceLoader)
 {
-	for (std::pair<uint32_t, AppModel*> model : (*a_ppResourceLoader)->modelMap)
+	// loads still running are dropped, their jobs write into the resources deleted below
+	for (ResourceLoad* pLoad : (*a_ppResourceLoader)->pendingLoads)
 	{
-		delete model.second->pNodeDescriptorSet;
-		delete model.second->pMaterialDescriptorSet;
-		delete model.second->pModel;
-		delete model.second;
+		WaitForJobs(&pLoad->counter);
+		if (pLoad->pTexture && pLoad->pTexture->desc.rawData)
+			FreeTextureData(pLoad->pTexture);
+		if (pLoad->pAppModel)
+			DestroyModel(pLoad->pAppModel->pModel);
+		delete pLoad;
 	}
-	(*a_ppResourceLoader)->modelMap.clear();
+	(*a_ppResourceLoader)->pendingLoads.clear();
+	(*a_ppResourceLoader)->listeners.clear();
 
-	for (std::pair<uint32_t, ShaderModule*> shader : (*a_ppResourceLoader)->shaderMap)
-		delete shader.second;
+	for (std::pair<const void* const, ResourceEntry*>& entry : (*a_ppResourceLoader)->entries)
+		DeleteResource(entry.second);
+	(*a_ppResourceLoader)->entries.clear();
+	(*a_ppResourceLoader)->unreferenced.clear();
+	(*a_ppResourceLoader)->modelMap.clear();
 	(*a_ppResourceLoader)->shaderMap.clear();
-
-	for (std::pair<uint32_t, Texture*> texture : (*a_ppResourceLoader)->textureMap)
-		delete texture.second;
 	(*a_ppResourceLoader)->textureMap.clear();
+
+#if !defined(_DEBUG)
+	const std::string archivePath = resourcePath + RESOURCE_ARCHIVE_NAME;
+	if (ExistFile(archivePath.c_str()))
+		UnmountArchive(archivePath.c_str());
+#endif
 }
 
 void LoadResourceLoader(ResourceLoader** a_ppResourceLoader)
@@ -133,23 +218,33 @@ void UnloadResourceLoader(ResourceLoader** a_ppResourceLoader)
 	if (pRenderer->window.reset)
 	{
 		ResourceLoader* pResourceLoader = *a_ppResourceLoader;
-		for (std::pair<uint32_t, AppModel*> model : pResourceLoader->modelMap)
+		FinishResourceLoads(pResourceLoader);
+		// the components released their resources before this, the device is idle and everything unreferenced can go
+		EvictResources(pResourceLoader, true);
+		for (std::pair<const uint64_t, ResourceEntry*>& model : pResourceLoader->modelMap)
 		{
-			DestroyModel(model.second->pModel);
-			DestroyDescriptorSet(pRenderer, &model.second->pMaterialDescriptorSet);
-			DestroyDescriptorSet(pRenderer, &model.second->pNodeDescriptorSet);
+			AppModel* pAppModel = (AppModel*)model.second->pResource;
+			DestroyModel(pAppModel->pModel);
+			DestroyDescriptorSet(pRenderer, &pAppModel->pMaterialDescriptorSet);
+			DestroyDescriptorSet(pRenderer, &pAppModel->pNodeDescriptorSet);
+			if (pAppModel->pSkinDescriptorSet)
+				DestroyDescriptorSet(pRenderer, &pAppModel->pSkinDescriptorSet);
 		}
 
-		for (std::pair<uint32_t, ShaderModule*> shader : pResourceLoader->shaderMap)
+		for (std::pair<const uint64_t, ResourceEntry*>& shader : pResourceLoader->shaderMap)
 		{
-			DestroyShaderModule(pRenderer, &shader.second);
-			VkShaderStageFlagBits stage = shader.second->stage;
-			shader.second = new(shader.second) ShaderModule();
-			shader.second->stage = stage;
+			ShaderModule* pShaderModule = (ShaderModule*)shader.second->pResource;
+			DestroyShaderModule(pRenderer, &pShaderModule);
+			VkShaderStageFlagBits stage = pShaderModule->stage;
+			pShaderModule = new(pShaderModule) ShaderModule();
+			pShaderModule->stage = stage;
 		}
 
-		for (std::pair<uint32_t, Texture*> texture : (*a_ppResourceLoader)->textureMap)
-			DestroyTexture(pRenderer, &texture.second);
+		for (std::pair<const uint64_t, ResourceEntry*>& texture : pResourceLoader->textureMap)
+		{
+			Texture* pTexture = (Texture*)texture.second->pResource;
+			DestroyTexture(pRenderer, &pTexture);
+		}
 
 		for (std::pair<uint32_t, AppMesh*> mesh : (*a_ppResourceLoader)->meshMap)
 			DestroyMesh(&mesh.second);
@@ -177,116 +272,531 @@ void updateNodeDescriptor(Renderer* a_pRenderer, Node* node, uint32_t& nodeCount
 		updateNodeDescriptor(a_pRenderer, child, nodeCounter, pNodeDescriptorSet);
 }
 
-void GetModel(ResourceLoader* a_pResourceLoader, const char* a_sPath, AppModel** a_ppAppModel)
+void updateMaterialDescriptors(Renderer* a_pRenderer, Model* a_pModel, DescriptorSet* pMaterialDescriptorSet)
 {
-	LOG_IF(!(*a_ppAppModel), LogSeverity::ERR, "(*a_ppAppModel) should be nullptr");
+	const bool useBindless = GetAppRenderer()->useBindless;
+
+	const char* samplerNames[5] = {
+		"colorMap",
+		"physicalDescriptorMap",
+		"normalMap",
+		"aoMap",
+		"emissiveMap"
+	};
+
+	DescriptorUpdateInfo descUpdateInfos[5] = {};
+	for (uint32_t i = 0; i < 5; ++i)
+	{
+		descUpdateInfos[i].name = samplerNames[i];
+		descUpdateInfos[i].mImageInfo.imageView = a_pRenderer->defaultResources.defaultImage.imageView;
+		descUpdateInfos[i].mImageInfo.imageLayout = a_pRenderer->defaultResources.defaultImage.desc.initialLayout;
+		descUpdateInfos[i].mImageInfo.sampler = a_pRenderer->defaultResources.defaultSampler.sampler;
+	}
 
-	std::unordered_map<uint32_t, AppModel*>& modelMap = a_pResourceLoader->modelMap;
-	std::unordered_map<uint32_t, AppModel*>::const_iterator itr = modelMap.find((uint32_t)std::hash<std::string>{}(a_sPath));
-	if (itr == modelMap.end())
+	uint32_t matrialIndex = 0;
+	for (Material& material : a_pModel->materials)
 	{
-		*a_ppAppModel = new AppModel();
-		Model*& pModel = (*a_ppAppModel)->pModel;
-		pModel = new Model();
-		DescriptorSet*& pMaterialDescriptorSet = (*a_ppAppModel)->pMaterialDescriptorSet;
-		pMaterialDescriptorSet = new DescriptorSet();
-		DescriptorSet*& pNodeDescriptorSet = (*a_ppAppModel)->pNodeDescriptorSet;
-		pNodeDescriptorSet = new DescriptorSet();
+		if (material.normalTexture)
+		{
+			descUpdateInfos[2].mImageInfo.imageView = material.normalTexture->texture->imageView;
+			descUpdateInfos[2].mImageInfo.sampler = material.normalTexture->sampler->sampler;
+			descUpdateInfos[2].mImageInfo.imageLayout = material.normalTexture->texture->desc.initialLayout;
+		}
+		if (material.occlusionTexture)
+		{
+			descUpdateInfos[3].mImageInfo.imageView = material.occlusionTexture->texture->imageView;
+			descUpdateInfos[3].mImageInfo.sampler = material.occlusionTexture->sampler->sampler;
+			descUpdateInfos[3].mImageInfo.imageLayout = material.occlusionTexture->texture->desc.initialLayout;
+		}
+		if (material.emissiveTexture)
+		{
+			descUpdateInfos[4].mImageInfo.imageView = material.emissiveTexture->texture->imageView;
+			descUpdateInfos[4].mImageInfo.sampler = material.emissiveTexture->sampler->sampler;
+			descUpdateInfos[4].mImageInfo.imageLayout = material.emissiveTexture->texture->desc.initialLayout;
+		}
 
-		Renderer* pRenderer = GetAppRenderer()->GetRenderer();
-		CreateModelFromFile(pRenderer, resourcePath + a_sPath, pModel);
-		modelMap.insert({ (uint32_t)std::hash<std::string>{}(a_sPath), *a_ppAppModel });
+		if (material.pbrWorkflows.metallicRoughness) {
+			if (material.baseColorTexture) {
+				descUpdateInfos[0].mImageInfo.imageView = material.baseColorTexture->texture->imageView;
+				descUpdateInfos[0].mImageInfo.sampler = material.baseColorTexture->sampler->sampler;
+				descUpdateInfos[0].mImageInfo.imageLayout = material.baseColorTexture->texture->desc.initialLayout;
+			}
+			if (material.metallicRoughnessTexture) {
+				descUpdateInfos[1].mImageInfo.imageView = material.metallicRoughnessTexture->texture->imageView;
+				descUpdateInfos[1].mImageInfo.sampler = material.metallicRoughnessTexture->sampler->sampler;
+				descUpdateInfos[1].mImageInfo.imageLayout = material.metallicRoughnessTexture->texture->desc.initialLayout;
+			}
+		}
 
-		// Set 2
-		ResourceDescriptor* pPBRResDesc = nullptr;
-		GetAppRenderer()->GetResourceDescriptorByName("PBR", &pPBRResDesc);
-		pNodeDescriptorSet->desc = { pPBRResDesc, DescriptorUpdateFrequency::SET_2, (uint32_t)pModel->linearNodes.size() };
-		CreateDescriptorSet(pRenderer, &pNodeDescriptorSet);
+		else if (material.pbrWorkflows.specularGlossiness) {
+			if (material.extension.diffuseTexture) {
+				descUpdateInfos[0].mImageInfo.imageView = material.extension.diffuseTexture->texture->imageView;
+				descUpdateInfos[0].mImageInfo.sampler = material.extension.diffuseTexture->sampler->sampler;
+				descUpdateInfos[0].mImageInfo.imageLayout = material.extension.diffuseTexture->texture->desc.initialLayout;
+			}
+			if (material.extension.specularGlossinessTexture) {
+				descUpdateInfos[1].mImageInfo.imageView = material.extension.specularGlossinessTexture->texture->imageView;
+				descUpdateInfos[1].mImageInfo.sampler = material.extension.specularGlossinessTexture->sampler->sampler;
+				descUpdateInfos[1].mImageInfo.imageLayout = material.extension.specularGlossinessTexture->texture->desc.initialLayout;
+			}
+		}
+
+		if (useBindless)
+		{
+			for (uint32_t i = 0; i < 5; ++i)
+				material.textureIndices[i] = GetAppRenderer()->AddBindlessTexture(descUpdateInfos[i].mImageInfo);
+			continue;
+		}
 
-		uint32_t nodeCounter = 0;
-		for (Node* node : pModel->nodes)
-			updateNodeDescriptor(pRenderer, node, nodeCounter, pNodeDescriptorSet);
+		uint32_t index = matrialIndex++;
+		UpdateDescriptorSet(a_pRenderer, index, pMaterialDescriptorSet, 5, descUpdateInfos);
 
-		// Set 3
+		material.descriptorSet = pMaterialDescriptorSet;
+		material.indexInDescriptorSet = index;
+	}
+}
+
+// node, skinning and material sets of a model with its GPU resources, the model is drawn from here on
+static void CreateModelDescriptors(Renderer* a_pRenderer, AppModel* a_pAppModel)
+{
+	Model* pModel = a_pAppModel->pModel;
+	DescriptorSet* pNodeDescriptorSet = a_pAppModel->pNodeDescriptorSet;
+	DescriptorSet* pMaterialDescriptorSet = a_pAppModel->pMaterialDescriptorSet;
+
+	// Set 2
+	ResourceDescriptor* pPBRResDesc = nullptr;
+	GetAppRenderer()->GetResourceDescriptorByName("PBR", &pPBRResDesc);
+	pNodeDescriptorSet->desc = { pPBRResDesc, DescriptorUpdateFrequency::SET_2, (uint32_t)pModel->linearNodes.size() };
+	CreateDescriptorSet(a_pRenderer, &pNodeDescriptorSet);
+
+	uint32_t nodeCounter = 0;
+	for (Node* node : pModel->nodes)
+		updateNodeDescriptor(a_pRenderer, node, nodeCounter, pNodeDescriptorSet);
+
+	// skinning pass, one set per frame in flight writing into the pools of that frame
+	if (pModel->skinVertices)
+	{
+		ResourceDescriptor* pSkinResDesc = nullptr;
+		GetAppRenderer()->GetResourceDescriptorByName("Skinning", &pSkinResDesc);
+		DescriptorSet*& pSkinDescriptorSet = a_pAppModel->pSkinDescriptorSet;
+		pSkinDescriptorSet = new DescriptorSet();
+		pSkinDescriptorSet->desc = { pSkinResDesc, DescriptorUpdateFrequency::SET_0, (uint32_t)a_pRenderer->maxInFlightFrames };
+		CreateDescriptorSet(a_pRenderer, &pSkinDescriptorSet);
+
+		DescriptorUpdateInfo descUpdateInfos[4] = {};
+		descUpdateInfos[0].name = "SourceVertices";
+		descUpdateInfos[0].mBufferInfo.buffer = pModel->vertices->buffer;
+		descUpdateInfos[0].mBufferInfo.range = pModel->vertices->desc.bufferSize;
+		descUpdateInfos[1].name = "SkinnedVertices";
+		descUpdateInfos[2].name = "SkinJoints";
+		descUpdateInfos[3].name = "SkinWeights";
+		descUpdateInfos[3].mBufferInfo.buffer = pModel->skinVertices->buffer;
+		descUpdateInfos[3].mBufferInfo.range = pModel->skinVertices->desc.bufferSize;
+
+		for (uint32_t i = 0; i < a_pRenderer->maxInFlightFrames; ++i)
+		{
+			Buffer* pSkinnedVertices = GetAppRenderer()->GetSkinnedVertexBuffer(i);
+			Buffer* pSkinJoints = GetAppRenderer()->GetSkinJointBuffer(i);
+			descUpdateInfos[1].mBufferInfo.buffer = pSkinnedVertices->buffer;
+			descUpdateInfos[1].mBufferInfo.range = pSkinnedVertices->desc.bufferSize;
+			descUpdateInfos[2].mBufferInfo.buffer = pSkinJoints->buffer;
+			descUpdateInfos[2].mBufferInfo.range = pSkinJoints->desc.bufferSize;
+			UpdateDescriptorSet(a_pRenderer, i, pSkinDescriptorSet, 4, descUpdateInfos);
+		}
+	}
+
+	// Set 3, not needed when the materials index into the bindless texture array
+	const bool useBindless = GetAppRenderer()->useBindless;
+	if (!useBindless)
+	{
 		pMaterialDescriptorSet->desc = { pPBRResDesc, DescriptorUpdateFrequency::SET_3, (uint32_t)pModel->materials.size() };
-		CreateDescriptorSet(pRenderer, &pMaterialDescriptorSet);
-
-		const char* samplerNames[5] = {
-			"colorMap",
-			"physicalDescriptorMap",
-			"normalMap",
-			"aoMap",
-			"emissiveMap"
-		};
+		CreateDescriptorSet(a_pRenderer, &pMaterialDescriptorSet);
+	}
+
+	updateMaterialDescriptors(a_pRenderer, pModel, pMaterialDescriptorSet);
+	a_pAppModel->ready = true;
+}
+
+static AppModel* NewAppModel()
+{
+	AppModel* pAppModel = new AppModel();
+	pAppModel->pModel = new Model();
+	pAppModel->pMaterialDescriptorSet = new DescriptorSet();
+	pAppModel->pNodeDescriptorSet = new DescriptorSet();
+	return pAppModel;
+}
+
+static Texture* NewTexture(const char* a_sTexturePath)
+{
+	Texture* pTexture = new Texture;
+	pTexture->desc.filePath = resourcePath + a_sTexturePath;
+	pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	pTexture->desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+	pTexture->desc.tiling = VK_IMAGE_TILING_OPTIMAL;
+	pTexture->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	pTexture->desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	pTexture->desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	pTexture->desc.aspectBits = VK_IMAGE_ASPECT_COLOR_BIT;
+	return pTexture;
+}
+
+static void LoadResource(void* a_pData, uint32_t a_uIndex)
+{
+	ResourceLoad* pLoad = (ResourceLoad*)a_pData;
+	if (pLoad->type == ResourceLoadType::MODEL)
+		pLoad->loaded = LoadModelFromFile(pLoad->pRenderer, pLoad->path, pLoad->pAppModel->pModel);
+	else
+		LoadTextureData(pLoad->pRenderer, pLoad->pTexture);
+}
 
+static void DecodeTexture(void* a_pData, uint32_t a_uIndex)
+{
+	ResourceLoad* pLoad = (ResourceLoad*)a_pData;
+	FileReadRequest& fileRead = pLoad->fileRead;
+	// a failed read leaves the texture to CreateTexture, which reports the file
+	if (fileRead.success)
+		LoadTextureData(pLoad->pRenderer, pLoad->pTexture, fileRead.pBuffer, fileRead.bytesRead);
+	free(fileRead.pBuffer);
+	fileRead.pBuffer = nullptr;
+}
+
+// on an I/O thread, the decode keeps the load's counter pending so the next files are read while this one decodes
+static void OnTextureRead(FileReadRequest* a_pRequest)
+{
+	ResourceLoad* pLoad = (ResourceLoad*)a_pRequest->pUserData;
+	RunBackgroundJob(DecodeTexture, pLoad, &pLoad->counter);
+}
+
+static void StartResourceLoad(ResourceLoader* a_pResourceLoader, ResourceLoad* a_pLoad)
+{
+	a_pLoad->pRenderer = GetAppRenderer()->GetRenderer();
+	a_pResourceLoader->pendingLoads.push_back(a_pLoad);
+
+	// textures with a block compressed copy are only uploaded, models read their files while they parse them
+	if (a_pLoad->type == ResourceLoadType::TEXTURE && FindCompressedTexture(a_pLoad->pRenderer, a_pLoad->pTexture->desc.filePath).empty())
+	{
+		FileReadRequest& fileRead = a_pLoad->fileRead;
+		fileRead.path = a_pLoad->pTexture->desc.filePath;
+		fileRead.priority = FileReadPriority::CRITICAL;
+		fileRead.pCallback = OnTextureRead;
+		fileRead.pUserData = a_pLoad;
+		ReadFileAsync(&fileRead, 1, &a_pLoad->counter);
+		return;
+	}
+	RunBackgroundJob(LoadResource, a_pLoad, &a_pLoad->counter);
+}
+
+static size_t FindResourceLoad(const ResourceLoader* a_pResourceLoader, const void* a_pResource)
+{
+	const std::vector<ResourceLoad*>& pendingLoads = a_pResourceLoader->pendingLoads;
+	for (size_t i = 0; i < pendingLoads.size(); ++i)
+	{
+		if (pendingLoads[i]->pAppModel == a_pResource || pendingLoads[i]->pTexture == a_pResource)
+			return i;
+	}
+	return pendingLoads.size();
+}
+
+// the cached entry of a_sPath with one more reference, nullptr when it has to be loaded
+static ResourceEntry* AcquireResource(ResourceLoader* a_pResourceLoader, std::unordered_map<uint64_t, ResourceEntry*>& a_Map, const char* a_sPath)
+{
+	std::unordered_map<uint64_t, ResourceEntry*>::const_iterator itr = a_Map.find(HashPath(a_sPath));
+	if (itr != a_Map.end())
+	{
+		ResourceEntry* pEntry = itr->second;
+		if (pEntry->path == a_sPath)
 		{
-			DescriptorUpdateInfo descUpdateInfos[5] = {};
-			for (uint32_t i = 0; i < 5; ++i)
-			{
-				descUpdateInfos[i].name = samplerNames[i];
-				descUpdateInfos[i].mImageInfo.imageView = pRenderer->defaultResources.defaultImage.imageView;
-				descUpdateInfos[i].mImageInfo.imageLayout = pRenderer->defaultResources.defaultImage.desc.initialLayout;
-				descUpdateInfos[i].mImageInfo.sampler = pRenderer->defaultResources.defaultSampler.sampler;
-			}
+			if (pEntry->refCount++ == 0)
+				a_pResourceLoader->unreferenced.erase(pEntry->lruPosition);
+			++a_pResourceLoader->stats.hits;
+			return pEntry;
+		}
+
+		// the entry in the map keeps the key, this path gets a resource of its own every time
+		LOG(LogSeverity::WARNING, "Resource key collision between %s and %s", pEntry->path.c_str(), a_sPath);
+		++a_pResourceLoader->stats.collisions;
+	}
+
+	++a_pResourceLoader->stats.misses;
+	return nullptr;
+}
+
+// a new resource with one reference
+static void AddResource(ResourceLoader* a_pResourceLoader, std::unordered_map<uint64_t, ResourceEntry*>& a_Map, ResourceType a_eType, const char* a_sPath, void* a_pResource)
+{
+	ResourceEntry* pEntry = new ResourceEntry();
+	pEntry->type = a_eType;
+	pEntry->path = a_sPath;
+	pEntry->pResource = a_pResource;
+	pEntry->refCount = 1;
+	a_Map.insert({ HashPath(a_sPath), pEntry });
+	a_pResourceLoader->entries.insert({ a_pResource, pEntry });
+	++a_pResourceLoader->stats.resourceCount;
+}
+
+static void ReleaseResource(ResourceLoader* a_pResourceLoader, const void* a_pResource)
+{
+	std::unordered_map<const void*, ResourceEntry*>::const_iterator itr = a_pResourceLoader->entries.find(a_pResource);
+	LOG_IF(itr != a_pResourceLoader->entries.end(), LogSeverity::ERR, "Released a resource the loader doesn't have");
+	if (itr == a_pResourceLoader->entries.end())
+		return;
+
+	ResourceEntry* pEntry = itr->second;
+	LOG_IF(pEntry->refCount > 0, LogSeverity::ERR, "%s released more often than it was asked for", pEntry->path.c_str());
+	if (pEntry->refCount == 0 || --pEntry->refCount > 0)
+		return;
+
+	pEntry->releaseFrame = a_pResourceLoader->frame;
+	a_pResourceLoader->unreferenced.push_front(pEntry);
+	pEntry->lruPosition = a_pResourceLoader->unreferenced.begin();
+}
+
+// what a resource whose load is done takes, counted against the budgets
+static void MeasureResource(ResourceLoader* a_pResourceLoader, const void* a_pResource)
+{
+	std::unordered_map<const void*, ResourceEntry*>::const_iterator itr = a_pResourceLoader->entries.find(a_pResource);
+	if (itr == a_pResourceLoader->entries.end())
+		return;
+
+	ResourceEntry* pEntry = itr->second;
+	Renderer* pRenderer = GetAppRenderer()->GetRenderer();
+	uint64_t cpuBytes = 0, gpuBytes = 0;
+	if (pEntry->type == ResourceType::MODEL)
+	{
+		const Model* pModel = ((AppModel*)pEntry->pResource)->pModel;
+		cpuBytes += pModel->positions.size() * sizeof(glm::vec3) + pModel->indexBuffer.size() * sizeof(uint32_t);
+		for (const Animation& animation : pModel->animations)
+		{
+			for (const AnimationSampler& sampler : animation.samplers)
+				cpuBytes += sampler.inputs.size() * sizeof(float) + sampler.outputsVec4.size() * sizeof(glm::vec4) + sampler.outputsPacked.size() * sizeof(uint16_t);
+		}
+
+		const Buffer* pBuffers[3] = { pModel->vertices, pModel->indices, pModel->skinVertices };
+		for (const Buffer* pBuffer : pBuffers)
+		{
+			if (pBuffer)
+				gpuBytes += pBuffer->desc.bufferSize;
+		}
+
+		for (const Node* pNode : pModel->linearNodes)
+		{
+			cpuBytes += sizeof(Node);
+			if (!pNode->mesh)
+				continue;
+			cpuBytes += sizeof(Mesh) + (pNode->mesh->pSkinPalette ? sizeof(Mesh::SkinPalette) : 0);
+			if (pNode->mesh->uniformBuffer)
+				gpuBytes += pNode->mesh->uniformBuffer->desc.bufferSize;
+		}
+
+		for (const TextureSampler* pTextureSampler : pModel->textures)
+			gpuBytes += GetTextureMemorySize(pRenderer, pTextureSampler->texture);
+	}
+	else if (pEntry->type == ResourceType::TEXTURE)
+		gpuBytes = GetTextureMemorySize(pRenderer, (Texture*)pEntry->pResource);
+
+	a_pResourceLoader->stats.cpuBytes += cpuBytes - pEntry->cpuBytes;
+	a_pResourceLoader->stats.gpuBytes += gpuBytes - pEntry->gpuBytes;
+	pEntry->cpuBytes = cpuBytes;
+	pEntry->gpuBytes = gpuBytes;
+}
 
-			uint32_t matrialIndex = 0;
-			for (Material& material : pModel->materials)
+// destroys an unreferenced resource, no frame in flight may use it any more
+static void EvictResource(ResourceLoader* a_pResourceLoader, ResourceEntry* a_pEntry)
+{
+	Renderer* pRenderer = GetAppRenderer()->GetRenderer();
+	std::unordered_map<uint64_t, ResourceEntry*>* pMap = nullptr;
+	switch (a_pEntry->type)
+	{
+	case ResourceType::MODEL:
+	{
+		AppModel* pAppModel = (AppModel*)a_pEntry->pResource;
+		if (pAppModel->ready)
+		{
+			if (GetAppRenderer()->useBindless)
 			{
-				if (material.normalTexture)
-				{
-					descUpdateInfos[2].mImageInfo.imageView = material.normalTexture->texture->imageView;
-					descUpdateInfos[2].mImageInfo.sampler = material.normalTexture->sampler->sampler;
-					descUpdateInfos[2].mImageInfo.imageLayout = material.normalTexture->texture->desc.initialLayout;
-				}
-				if (material.occlusionTexture)
-				{
-					descUpdateInfos[3].mImageInfo.imageView = material.occlusionTexture->texture->imageView;
-					descUpdateInfos[3].mImageInfo.sampler = material.occlusionTexture->sampler->sampler;
-					descUpdateInfos[3].mImageInfo.imageLayout = material.occlusionTexture->texture->desc.initialLayout;
-				}
-				if (material.emissiveTexture)
-				{
-					descUpdateInfos[4].mImageInfo.imageView = material.emissiveTexture->texture->imageView;
-					descUpdateInfos[4].mImageInfo.sampler = material.emissiveTexture->sampler->sampler;
-					descUpdateInfos[4].mImageInfo.imageLayout = material.emissiveTexture->texture->desc.initialLayout;
-				}
-
-				if (material.pbrWorkflows.metallicRoughness) {
-					if (material.baseColorTexture) {
-						descUpdateInfos[0].mImageInfo.imageView = material.baseColorTexture->texture->imageView;
-						descUpdateInfos[0].mImageInfo.sampler = material.baseColorTexture->sampler->sampler;
-						descUpdateInfos[0].mImageInfo.imageLayout = material.baseColorTexture->texture->desc.initialLayout;
-					}
-					if (material.metallicRoughnessTexture) {
-						descUpdateInfos[1].mImageInfo.imageView = material.metallicRoughnessTexture->texture->imageView;
-						descUpdateInfos[1].mImageInfo.sampler = material.metallicRoughnessTexture->sampler->sampler;
-						descUpdateInfos[1].mImageInfo.imageLayout = material.metallicRoughnessTexture->texture->desc.initialLayout;
-					}
-				}
-
-				else if (material.pbrWorkflows.specularGlossiness) {
-					if (material.extension.diffuseTexture) {
-						descUpdateInfos[0].mImageInfo.imageView = material.extension.diffuseTexture->texture->imageView;
-						descUpdateInfos[0].mImageInfo.sampler = material.extension.diffuseTexture->sampler->sampler;
-						descUpdateInfos[0].mImageInfo.imageLayout = material.extension.diffuseTexture->texture->desc.initialLayout;
-					}
-					if (material.extension.specularGlossinessTexture) {
-						descUpdateInfos[1].mImageInfo.imageView = material.extension.specularGlossinessTexture->texture->imageView;
-						descUpdateInfos[1].mImageInfo.sampler = material.extension.specularGlossinessTexture->sampler->sampler;
-						descUpdateInfos[1].mImageInfo.imageLayout = material.extension.specularGlossinessTexture->texture->desc.initialLayout;
-					}
-				}
-
-				uint32_t index = matrialIndex++;
-				UpdateDescriptorSet(pRenderer, index, pMaterialDescriptorSet, 5, descUpdateInfos);
-
-				material.descriptorSet = pMaterialDescriptorSet;
-				material.indexInDescriptorSet = index;
+				for (TextureSampler* pTextureSampler : pAppModel->pModel->textures)
+					GetAppRenderer()->RemoveBindlessTexture(pTextureSampler->texture);
 			}
+			else
+				DestroyDescriptorSet(pRenderer, &pAppModel->pMaterialDescriptorSet);
+			DestroyDescriptorSet(pRenderer, &pAppModel->pNodeDescriptorSet);
+			if (pAppModel->pSkinDescriptorSet)
+				DestroyDescriptorSet(pRenderer, &pAppModel->pSkinDescriptorSet);
+		}
+		DestroyModel(pAppModel->pModel);
+		pMap = &a_pResourceLoader->modelMap;
+		break;
+	}
+	case ResourceType::TEXTURE:
+	{
+		Texture* pTexture = (Texture*)a_pEntry->pResource;
+		DestroyTexture(pRenderer, &pTexture);
+		pMap = &a_pResourceLoader->textureMap;
+		break;
+	}
+	case ResourceType::SHADER:
+	{
+		ShaderModule* pShaderModule = (ShaderModule*)a_pEntry->pResource;
+		DestroyShaderModule(pRenderer, &pShaderModule);
+		pMap = &a_pResourceLoader->shaderMap;
+		break;
+	}
+	}
+
+	// an uncached entry of a colliding path isn't in the map
+	std::unordered_map<uint64_t, ResourceEntry*>::const_iterator itr = pMap->find(HashPath(a_pEntry->path.c_str()));
+	if (itr != pMap->end() && itr->second == a_pEntry)
+		pMap->erase(itr);
+	a_pResourceLoader->entries.erase(a_pEntry->pResource);
+
+	ResourceLoaderStats& stats = a_pResourceLoader->stats;
+	stats.cpuBytes -= a_pEntry->cpuBytes;
+	stats.gpuBytes -= a_pEntry->gpuBytes;
+	--stats.resourceCount;
+	++stats.evictions;
+	DeleteResource(a_pEntry);
+}
+
+// least recently released first until the loader is under budget, a_bAll evicts every unreferenced resource that is done
+// loading and expects the device to be idle
+static void EvictResources(ResourceLoader* a_pResourceLoader, bool a_bAll)
+{
+	const uint64_t inFlightFrames = GetAppRenderer()->GetRenderer()->maxInFlightFrames;
+	std::list<ResourceEntry*>& unreferenced = a_pResourceLoader->unreferenced;
+	std::list<ResourceEntry*>::iterator itr = unreferenced.end();
+	while (itr != unreferenced.begin())
+	{
+		const ResourceLoaderStats& stats = a_pResourceLoader->stats;
+		if (!a_bAll && stats.cpuBytes <= a_pResourceLoader->cpuBudget && stats.gpuBytes <= a_pResourceLoader->gpuBudget)
+			break;
+
+		ResourceEntry* pEntry = *--itr;
+		// still loading, or the frames recorded before the release may still use it
+		if (!IsResourceReady(a_pResourceLoader, pEntry->pResource) || (!a_bAll && a_pResourceLoader->frame <= pEntry->releaseFrame + inFlightFrames))
+			continue;
+
+		itr = unreferenced.erase(itr);
+		EvictResource(a_pResourceLoader, pEntry);
+	}
+}
+
+// creates what the job of a_pLoad read, false while the job runs or once a_pUploadBudget is used up.
+// nullptr waits for the job and creates everything
+static bool FinishResourceLoad(ResourceLoad* a_pLoad, uint32_t* a_pUploadBudget)
+{
+	if (!a_pUploadBudget)
+		WaitForJobs(&a_pLoad->counter);
+	else if (!AreJobsDone(&a_pLoad->counter) || *a_pUploadBudget == 0)
+		return false;
+
+	if (a_pLoad->type == ResourceLoadType::TEXTURE)
+	{
+		CreateTexture(a_pLoad->pRenderer, &a_pLoad->pTexture);
+		if (a_pLoad->pTexture->desc.rawData)
+			FreeTextureData(a_pLoad->pTexture);
+		if (a_pUploadBudget)
+			--*a_pUploadBudget;
+		return true;
+	}
+
+	// a model that failed to load stays in the map without being drawn, LoadModelFromFile logged why
+	if (!a_pLoad->loaded)
+		return true;
+	if (!CreateModelResources(a_pLoad->pAppModel->pModel, a_pUploadBudget))
+		return false;
+	CreateModelDescriptors(a_pLoad->pRenderer, a_pLoad->pAppModel);
+	return true;
+}
+
+// removes a finished load and runs the callbacks waiting for it, they may start or cancel other loads
+static void CompleteResourceLoad(ResourceLoader* a_pResourceLoader, size_t a_uIndex)
+{
+	ResourceLoad* pLoad = a_pResourceLoader->pendingLoads[a_uIndex];
+	a_pResourceLoader->pendingLoads.erase(a_pResourceLoader->pendingLoads.begin() + a_uIndex);
+	const void* pResource = (pLoad->type == ResourceLoadType::MODEL) ? (const void*)pLoad->pAppModel : (const void*)pLoad->pTexture;
+	delete pLoad;
+	MeasureResource(a_pResourceLoader, pResource);
+
+	std::vector<ResourceListener>& listeners = a_pResourceLoader->listeners;
+	std::vector<ResourceListener> callbacks;
+	for (size_t i = 0; i < listeners.size();)
+	{
+		if (listeners[i].pResource == pResource)
+		{
+			callbacks.push_back(listeners[i]);
+			listeners.erase(listeners.begin() + i);
 		}
+		else
+			++i;
+	}
+	for (const ResourceListener& callback : callbacks)
+		callback.pCallback(callback.pUserData);
+}
+
+static void WaitForResource(ResourceLoader* a_pResourceLoader, const void* a_pResource)
+{
+	const size_t index = FindResourceLoad(a_pResourceLoader, a_pResource);
+	if (index == a_pResourceLoader->pendingLoads.size())
+		return;
+
+	FinishResourceLoad(a_pResourceLoader->pendingLoads[index], nullptr);
+	CompleteResourceLoad(a_pResourceLoader, index);
+}
+
+static void FinishResourceLoads(ResourceLoader* a_pResourceLoader)
+{
+	while (!a_pResourceLoader->pendingLoads.empty())
+	{
+		FinishResourceLoad(a_pResourceLoader->pendingLoads[0], nullptr);
+		CompleteResourceLoad(a_pResourceLoader, 0);
+	}
+}
+
+void GetModel(ResourceLoader* a_pResourceLoader, const char* a_sPath, AppModel** a_ppAppModel)
+{
+	LOG_IF(!(*a_ppAppModel), LogSeverity::ERR, "(*a_ppAppModel) should be nullptr");
+
+	ResourceEntry* pEntry = AcquireResource(a_pResourceLoader, a_pResourceLoader->modelMap, a_sPath);
+	if (!pEntry)
+	{
+		*a_ppAppModel = NewAppModel();
+		AddResource(a_pResourceLoader, a_pResourceLoader->modelMap, ResourceType::MODEL, a_sPath, *a_ppAppModel);
+
+		Renderer* pRenderer = GetAppRenderer()->GetRenderer();
+		Model* pModel = (*a_ppAppModel)->pModel;
+		if (LoadModelFromFile(pRenderer, resourcePath + a_sPath, pModel))
+		{
+			CreateModelResources(pModel);
+			CreateModelDescriptors(pRenderer, *a_ppAppModel);
+		}
+		MeasureResource(a_pResourceLoader, *a_ppAppModel);
 	}
 	else
-		*a_ppAppModel = itr->second;
+	{
+		*a_ppAppModel = (AppModel*)pEntry->pResource;
+		WaitForResource(a_pResourceLoader, pEntry->pResource);
+	}
+}
+
+void GetModelAsync(ResourceLoader* a_pResourceLoader, const char* a_sPath, AppModel** a_ppAppModel)
+{
+	LOG_IF(!(*a_ppAppModel), LogSeverity::ERR, "(*a_ppAppModel) should be nullptr");
+
+	ResourceEntry* pEntry = AcquireResource(a_pResourceLoader, a_pResourceLoader->modelMap, a_sPath);
+	if (pEntry)
+	{
+		*a_ppAppModel = (AppModel*)pEntry->pResource;
+		return;
+	}
+
+	*a_ppAppModel = NewAppModel();
+	AddResource(a_pResourceLoader, a_pResourceLoader->modelMap, ResourceType::MODEL, a_sPath, *a_ppAppModel);
+
+	ResourceLoad* pLoad = new ResourceLoad();
+	pLoad->type = ResourceLoadType::MODEL;
+	pLoad->path = resourcePath + a_sPath;
+	pLoad->pAppModel = *a_ppAppModel;
+	StartResourceLoad(a_pResourceLoader, pLoad);
 }
 
 void CreateMesh(MeshType e_MeshType, AppMesh** a_ppAppMesh)
@@ -357,43 +867,139 @@ void GetMesh(ResourceLoader* a_pResourceLoader, MeshType e_MeshType, AppMesh** a
 	}
 }
 
-void GetShaderModule(ResourceLoader* a_pResourceLoader, const char* a_sShaderName, ShaderModule** a_ppShaderModule)
+void GetShaderModule(ResourceLoader* a_pResourceLoader, const char* a_sShaderName, ShaderModule** a_ppShaderModule, const char* a_sDefines)
 {
-	std::unordered_map<uint32_t, ShaderModule*>::const_iterator itr = a_pResourceLoader->shaderMap.find((uint32_t)std::hash<std::string>{}(a_sShaderName));
-
-	if (itr == a_pResourceLoader->shaderMap.end())
+	// variants are cached under the shader name followed by their defines
+	const std::string name = (*a_sDefines) ? std::string(a_sShaderName) + " " + a_sDefines : std::string(a_sShaderName);
+	ResourceEntry* pEntry = AcquireResource(a_pResourceLoader, a_pResourceLoader->shaderMap, name.c_str());
+	if (!pEntry)
 	{
 		LOG_IF(*a_ppShaderModule, LogSeverity::ERR, "ShaderModule memory not allocated");
-		CreateShaderModule(GetAppRenderer()->GetRenderer(), (resourcePath + "Shaders/" + a_sShaderName).c_str(), a_ppShaderModule);
-		a_pResourceLoader->shaderMap.insert({ (uint32_t)std::hash<std::string>{}(a_sShaderName), *a_ppShaderModule });
+		CreateShaderModule(GetAppRenderer()->GetRenderer(), (resourcePath + "Shaders/" + a_sShaderName).c_str(), a_ppShaderModule, a_sDefines);
+		AddResource(a_pResourceLoader, a_pResourceLoader->shaderMap, ResourceType::SHADER, name.c_str(), *a_ppShaderModule);
 	}
 	else
 	{
-		*a_ppShaderModule = itr->second;
+		*a_ppShaderModule = (ShaderModule*)pEntry->pResource;
 	}
 }
 
 void GetTexture(ResourceLoader* a_pResourceLoader, const char* a_sTexturePath, Texture** a_ppTexture)
 {
-	std::unordered_map<uint32_t, Texture*>::const_iterator itr = a_pResourceLoader->textureMap.find((uint32_t)std::hash<std::string>{}(a_sTexturePath));
-	if (itr == a_pResourceLoader->textureMap.end())
+	ResourceEntry* pEntry = AcquireResource(a_pResourceLoader, a_pResourceLoader->textureMap, a_sTexturePath);
+	if (!pEntry)
 	{
 		// Load Texture
-		Texture* pTexture = new Texture;
-		pTexture->desc.filePath = resourcePath + a_sTexturePath;
-		pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		pTexture->desc.format = VK_FORMAT_R8G8B8A8_UNORM;
-		pTexture->desc.tiling = VK_IMAGE_TILING_OPTIMAL;
-		pTexture->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-		pTexture->desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		pTexture->desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		pTexture->desc.aspectBits = VK_IMAGE_ASPECT_COLOR_BIT;
+		Texture* pTexture = NewTexture(a_sTexturePath);
 		CreateTexture(GetAppRenderer()->GetRenderer(), &pTexture);
-		a_pResourceLoader->textureMap.insert({ (uint32_t)std::hash<std::string>{}(a_sTexturePath), pTexture });
+		AddResource(a_pResourceLoader, a_pResourceLoader->textureMap, ResourceType::TEXTURE, a_sTexturePath, pTexture);
+		MeasureResource(a_pResourceLoader, pTexture);
 		*a_ppTexture = pTexture;
 	}
 	else
 	{
-		*a_ppTexture = itr->second;
+		*a_ppTexture = (Texture*)pEntry->pResource;
+		WaitForResource(a_pResourceLoader, pEntry->pResource);
+	}
+}
+
+void GetTextureAsync(ResourceLoader* a_pResourceLoader, const char* a_sTexturePath, Texture** a_ppTexture)
+{
+	ResourceEntry* pEntry = AcquireResource(a_pResourceLoader, a_pResourceLoader->textureMap, a_sTexturePath);
+	if (pEntry)
+	{
+		*a_ppTexture = (Texture*)pEntry->pResource;
+		return;
+	}
+
+	Texture* pTexture = NewTexture(a_sTexturePath);
+	AddResource(a_pResourceLoader, a_pResourceLoader->textureMap, ResourceType::TEXTURE, a_sTexturePath, pTexture);
+	*a_ppTexture = pTexture;
+
+	ResourceLoad* pLoad = new ResourceLoad();
+	pLoad->type = ResourceLoadType::TEXTURE;
+	pLoad->path = pTexture->desc.filePath;
+	pLoad->pTexture = pTexture;
+	StartResourceLoad(a_pResourceLoader, pLoad);
+}
+
+void ReleaseModel(ResourceLoader* a_pResourceLoader, AppModel** a_ppModel)
+{
+	ReleaseResource(a_pResourceLoader, *a_ppModel);
+	*a_ppModel = nullptr;
+}
+
+void ReleaseTexture(ResourceLoader* a_pResourceLoader, Texture** a_ppTexture)
+{
+	ReleaseResource(a_pResourceLoader, *a_ppTexture);
+	*a_ppTexture = nullptr;
+}
+
+bool IsResourceReady(const ResourceLoader* a_pResourceLoader, const void* a_pResource)
+{
+	return FindResourceLoad(a_pResourceLoader, a_pResource) == a_pResourceLoader->pendingLoads.size();
+}
+
+void OnResourceReady(ResourceLoader* a_pResourceLoader, const void* a_pResource, ResourceCallback a_pCallback, void* a_pUserData)
+{
+	if (IsResourceReady(a_pResourceLoader, a_pResource))
+		a_pCallback(a_pUserData);
+	else
+		a_pResourceLoader->listeners.push_back({ a_pResource, a_pCallback, a_pUserData });
+}
+
+void CancelResourceCallbacks(ResourceLoader* a_pResourceLoader, void* a_pUserData)
+{
+	std::vector<ResourceListener>& listeners = a_pResourceLoader->listeners;
+	listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [a_pUserData](const ResourceListener& listener) { return listener.pUserData == a_pUserData; }),
+		listeners.end());
+}
+
+void UpdateResourceLoader(ResourceLoader* a_pResourceLoader)
+{
+	++a_pResourceLoader->frame;
+	EvictResources(a_pResourceLoader, false);
+
+	// in request order, a model that runs out of uploads continues next frame
+	uint32_t uploads = MAX_RESOURCE_UPLOADS_PER_UPDATE;
+	for (size_t i = 0; i < a_pResourceLoader->pendingLoads.size() && uploads > 0;)
+	{
+		if (FinishResourceLoad(a_pResourceLoader->pendingLoads[i], &uploads))
+			CompleteResourceLoad(a_pResourceLoader, i);
+		else
+			++i;
+	}
+
+	if (a_pResourceLoader->frame % RESOURCE_REPORT_UPDATES == 0)
+	{
+		LOG(LogSeverity::INFO, "Resources %u cached, %u hits, %u misses, %u evictions, %u of %u MB CPU, %u of %u MB GPU",
+			a_pResourceLoader->stats.resourceCount, a_pResourceLoader->stats.hits, a_pResourceLoader->stats.misses, a_pResourceLoader->stats.evictions,
+			(uint32_t)(a_pResourceLoader->stats.cpuBytes >> 20), (uint32_t)(a_pResourceLoader->cpuBudget >> 20),
+			(uint32_t)(a_pResourceLoader->stats.gpuBytes >> 20), (uint32_t)(a_pResourceLoader->gpuBudget >> 20));
+	}
+}
+
+void UpdateTextureDescriptors(ResourceLoader* a_pResourceLoader, const TextureResidencyChange* a_pChanges, uint32_t a_uChangeCount)
+{
+	Renderer* pRenderer = GetAppRenderer()->GetRenderer();
+	for (std::pair<const void* const, ResourceEntry*>& entry : a_pResourceLoader->entries)
+	{
+		if (entry.second->type != ResourceType::MODEL)
+			continue;
+		AppModel* pAppModel = (AppModel*)entry.second->pResource;
+		if (!pAppModel->ready)
+			continue;
+
+		bool changed = false;
+		for (TextureSampler* pTextureSampler : pAppModel->pModel->textures)
+		{
+			for (uint32_t i = 0; i < a_uChangeCount && !changed; ++i)
+				changed = pTextureSampler->texture == a_pChanges[i].pTexture;
+		}
+
+		// every material of the model is written again, the sets keep their indices. bindless materials look up the
+		// slots UpdateBindlessTexture gave the new views
+		if (changed)
+			updateMaterialDescriptors(pRenderer, pAppModel->pModel, pAppModel->pMaterialDescriptorSet);
 	}
 }
\ No newline at end of file
@@ -1,17 +1,103 @@
 #pragma once
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+
 struct ShaderModule;
 struct AppModel;
 struct AppMesh;
 struct Texture;
+struct TextureResidencyChange;
 enum class MeshType;
+struct ResourceLoad;
+
+// finished loads UpdateResourceLoader creates on the GPU per frame, every texture and the buffers of a model count once.
+// each of them waits for the queue like any other upload
+#define MAX_RESOURCE_UPLOADS_PER_UPDATE 4
+// models and textures nothing holds any more stay cached until the loader is over one of these, see ReleaseModel
+#define DEFAULT_RESOURCE_CPU_BUDGET (256ull * 1024 * 1024)
+#define DEFAULT_RESOURCE_GPU_BUDGET (512ull * 1024 * 1024)
+// packed by the AssetPacker tool in release builds, mounted over the loose resources when it exists
+#define RESOURCE_ARCHIVE_NAME "Resources.apak"
+
+typedef void (*ResourceCallback)(void* a_pUserData);
+
+struct ResourceListener
+{
+	const void*			pResource;
+	ResourceCallback	pCallback;
+	void*				pUserData;
+};
+
+enum class ResourceType
+{
+	MODEL,
+	TEXTURE,
+	SHADER
+};
+
+// a model, texture or shader module of the loader. every Get hands out the typed pointer as a handle and takes a reference,
+// the Release functions drop it
+struct ResourceEntry
+{
+	ResourceType						type;
+	// what it was asked for with, two paths with the same key are told apart by it
+	std::string							path;
+	void*								pResource;
+	uint32_t							refCount;
+	// measured once the load is done
+	uint64_t							cpuBytes;
+	uint64_t							gpuBytes;
+	// update of the last release, frames in flight may still use the resource for maxInFlightFrames updates
+	uint64_t							releaseFrame;
+	// position in ResourceLoader::unreferenced while refCount is 0
+	std::list<ResourceEntry*>::iterator	lruPosition;
+
+	ResourceEntry() :
+		type(ResourceType::MODEL), path(), pResource(nullptr), refCount(0), cpuBytes(0), gpuBytes(0), releaseFrame(0), lruPosition()
+	{}
+};
+
+struct ResourceLoaderStats
+{
+	// Get calls that found the resource cached and ones that loaded it, since InitResourceLoader
+	uint32_t	hits;
+	uint32_t	misses;
+	uint32_t	evictions;
+	// paths whose key another path already had, their resources are loaded without being cached
+	uint32_t	collisions;
+	uint32_t	resourceCount;
+	// of every resource including unreferenced ones, against ResourceLoader::cpuBudget and gpuBudget
+	uint64_t	cpuBytes;
+	uint64_t	gpuBytes;
+};
 
 struct ResourceLoader
 {
-	std::unordered_map<uint32_t, AppModel*>			modelMap;
+	// keyed by a 64 bit hash of the path
+	std::unordered_map<uint64_t, ResourceEntry*>	modelMap;
 	std::unordered_map<uint32_t, AppMesh*>			meshMap;
-	std::unordered_map<uint32_t, ShaderModule*>		shaderMap;
-	std::unordered_map<uint32_t, Texture*>			textureMap;
+	std::unordered_map<uint64_t, ResourceEntry*>	shaderMap;
+	std::unordered_map<uint64_t, ResourceEntry*>	textureMap;
+	// every entry by its resource, including the uncached ones of colliding paths
+	std::unordered_map<const void*, ResourceEntry*>	entries;
+	// entries without references, the most recently released first. the last ones are evicted when over budget
+	std::list<ResourceEntry*>						unreferenced;
+	uint64_t										cpuBudget;
+	uint64_t										gpuBudget;
+	// UpdateResourceLoader calls
+	uint64_t										frame;
+	ResourceLoaderStats								stats;
+	// loads of GetModelAsync and GetTextureAsync in the order they were asked for
+	std::vector<ResourceLoad*>						pendingLoads;
+	std::vector<ResourceListener>					listeners;
+
+	ResourceLoader() :
+		modelMap(), meshMap(), shaderMap(), textureMap(), entries(), unreferenced(), cpuBudget(DEFAULT_RESOURCE_CPU_BUDGET),
+		gpuBudget(DEFAULT_RESOURCE_GPU_BUDGET), frame(0), stats(), pendingLoads(), listeners()
+	{}
 };
 
 void InitResourceLoader(ResourceLoader** a_ppResourceLoader);
@@ -21,5 +107,28 @@ void UnloadResourceLoader(ResourceLoader** a_ppResourceLoader);
 
 void GetModel(ResourceLoader* a_pResourceLoader, const char* a_sPath, AppModel** a_ppModel);
 void GetMesh(ResourceLoader* a_pResourceLoader, MeshType e_MeshType, AppMesh** a_ppAppMesh);
-void GetShaderModule(ResourceLoader* a_pResourceLoader, const char* a_sShaderName, ShaderModule** a_ppShaderModule);
-void GetTexture(ResourceLoader* a_pResourceLoader, const char* a_sTexturePath, Texture** a_ppTexture);
\ No newline at end of file
+// every set of a_sDefines is a module of its own, see CreateShaderModule
+void GetShaderModule(ResourceLoader* a_pResourceLoader, const char* a_sShaderName, ShaderModule** a_ppShaderModule, const char* a_sDefines = "");
+void GetTexture(ResourceLoader* a_pResourceLoader, const char* a_sTexturePath, Texture** a_ppTexture);
+// Return at once, reading and decoding the file runs on a background job and UpdateResourceLoader creates the GPU resources.
+// A model isn't drawn before AppModel::ready, a texture has no image view before IsResourceReady and users sample
+// Renderer::defaultResources.defaultImage in its place. The synchronous versions wait for a resource that is still loading
+// shader modules have no async version, they are only created while AppRenderer::Load builds the pipelines
+void GetModelAsync(ResourceLoader* a_pResourceLoader, const char* a_sPath, AppModel** a_ppModel);
+void GetTextureAsync(ResourceLoader* a_pResourceLoader, const char* a_sTexturePath, Texture** a_ppTexture);
+// drop the reference a Get took and set the handle to nullptr. a resource without references stays cached and a later Get
+// takes it back, UpdateResourceLoader destroys the least recently released ones once the loader is over budget
+void ReleaseModel(ResourceLoader* a_pResourceLoader, AppModel** a_ppModel);
+void ReleaseTexture(ResourceLoader* a_pResourceLoader, Texture** a_ppTexture);
+// a_pResource is an AppModel or Texture of the loader, false while it loads. a model that failed to load is done but not ready
+bool IsResourceReady(const ResourceLoader* a_pResourceLoader, const void* a_pResource);
+// a_pCallback(a_pUserData) on the main thread once a_pResource is done, right away when it already is
+void OnResourceReady(ResourceLoader* a_pResourceLoader, const void* a_pResource, ResourceCallback a_pCallback, void* a_pUserData);
+// drops the callbacks of a_pUserData, for owners that go away before their resources are done
+void CancelResourceCallbacks(ResourceLoader* a_pResourceLoader, void* a_pUserData);
+// once per frame before anything is recorded, evicts what is over budget and creates at most MAX_RESOURCE_UPLOADS_PER_UPDATE
+// finished loads
+void UpdateResourceLoader(ResourceLoader* a_pResourceLoader);
+// writes the material descriptors or bindless texture indices of the models using the changed textures again, see
+// TextureStreaming.h
+void UpdateTextureDescriptors(ResourceLoader* a_pResourceLoader, const TextureResidencyChange* a_pChanges, uint32_t a_uChangeCount);
\ No newline at end of file
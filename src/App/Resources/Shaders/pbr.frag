@@ -1,6 +1,11 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// BINDLESS selects the descriptor indexing variant, see AppRenderer
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 layout (location = 0) in vec3 inWorldPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV0;
@@ -30,11 +35,17 @@ layout (set = 0, binding = 0) uniform UniformBufferObject {
 
 // Material bindings
 
+#ifdef BINDLESS
+// all material textures live in one array, the material picks its slots via push constants
+// the indices are uniform for a draw, so no nonuniformEXT is needed
+layout (set = 3, binding = 0) uniform sampler2D textures[];
+#else
 layout (set = 3, binding = 0) uniform sampler2D colorMap;
 layout (set = 3, binding = 1) uniform sampler2D physicalDescriptorMap;
 layout (set = 3, binding = 2) uniform sampler2D normalMap;
 layout (set = 3, binding = 3) uniform sampler2D aoMap;
 layout (set = 3, binding = 4) uniform sampler2D emissiveMap;
+#endif
 
 layout (push_constant) uniform Material {
 	vec4 baseColorFactor;
@@ -51,8 +62,23 @@ layout (push_constant) uniform Material {
 	float roughnessFactor;	
 	float alphaMask;	
 	float alphaMaskCutoff;
+#ifdef BINDLESS
+	int colorTextureIndex;
+	int physicalDescriptorTextureIndex;
+	int normalTextureIndex;
+	int occlusionTextureIndex;
+	int emissiveTextureIndex;
+#endif
 } material;
 
+#ifdef BINDLESS
+#define colorMap				textures[material.colorTextureIndex]
+#define physicalDescriptorMap	textures[material.physicalDescriptorTextureIndex]
+#define normalMap				textures[material.normalTextureIndex]
+#define aoMap					textures[material.occlusionTextureIndex]
+#define emissiveMap				textures[material.emissiveTextureIndex]
+#endif
+
 layout (location = 0) out vec4 outColor;
 
 // Encapsulate the various inputs used by the various functions in the shading equation
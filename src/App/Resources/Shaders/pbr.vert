@@ -2,11 +2,10 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
+// octahedral encoded
+layout (location = 1) in vec2 inNormal;
 layout (location = 2) in vec2 inUV0;
 layout (location = 3) in vec2 inUV1;
-layout (location = 4) in vec4 inJoint0;
-layout (location = 5) in vec4 inWeight0;
 
 layout (set = 0, binding = 0) uniform UniformBufferObject 
 {
@@ -20,12 +19,11 @@ layout (set = 1, binding = 0) uniform UBOModelMatrix
 	mat4 model;
 } uboModel;
 
-#define MAX_NUM_JOINTS 128
-
+// skinned meshes are posed by skin.comp, every vertex arrives here in mesh space
 layout (set = 2, binding = 0) uniform UBONode {
 	mat4 matrix;
-	mat4 jointMatrix[MAX_NUM_JOINTS];
-	float jointCount;
+	// inverse transpose of matrix
+	mat4 normalMatrix;
 } node;
 
 layout (location = 0) out vec3 outWorldPos;
@@ -38,23 +36,19 @@ out gl_PerVertex
 	vec4 gl_Position;
 };
 
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() 
 {
-	vec4 locPos;
-	if (node.jointCount > 0.0) {
-		// Mesh is skinned
-		mat4 skinMat = 
-			inWeight0.x * node.jointMatrix[int(inJoint0.x)] +
-			inWeight0.y * node.jointMatrix[int(inJoint0.y)] +
-			inWeight0.z * node.jointMatrix[int(inJoint0.z)] +
-			inWeight0.w * node.jointMatrix[int(inJoint0.w)];
-
-		locPos = uboModel.model * node.matrix * skinMat * vec4(inPos, 1.0);
-		outNormal = normalize(transpose(inverse(mat3(uboModel.model * node.matrix * skinMat))) * inNormal);
-	} else {
-		locPos = uboModel.model * node.matrix * vec4(inPos, 1.0);
-		outNormal = normalize(transpose(inverse(mat3(uboModel.model * node.matrix))) * inNormal);
-	}
+	vec4 locPos = uboModel.model * node.matrix * vec4(inPos, 1.0);
+	outNormal = normalize(transpose(inverse(mat3(uboModel.model))) * mat3(node.normalMatrix) * octahedralDecode(inNormal));
 	locPos.y = -locPos.y;
 	outWorldPos = locPos.xyz / locPos.w;
 	outUV0 = inUV0;
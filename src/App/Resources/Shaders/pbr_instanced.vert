@@ -0,0 +1,49 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) in vec3 inPos;
+// octahedral encoded
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV0;
+layout (location = 3) in vec2 inUV1;
+// per instance, vertex binding 1, takes locations 6 to 9. model times node matrix, one instance per entity and mesh
+layout (location = 6) in mat4 inModel;
+
+layout (set = 0, binding = 0) uniform UniformBufferObject 
+{
+	mat4 view;
+	mat4 projection;
+	//vec3 camPos;
+} ubo;
+
+// skinned meshes are posed by skin.comp, every vertex arrives here in mesh space
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outUV0;
+layout (location = 3) out vec2 outUV1;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() 
+{
+	vec4 locPos = inModel * vec4(inPos, 1.0);
+	outNormal = normalize(transpose(inverse(mat3(inModel))) * octahedralDecode(inNormal));
+	locPos.y = -locPos.y;
+	outWorldPos = locPos.xyz / locPos.w;
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	gl_Position =  ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
+}
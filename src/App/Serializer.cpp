@@ -25,15 +25,15 @@ void LoadLevel(Serializer* a_pSerializer, const char* a_sPath, EntityManager* a_
 		return;
 
 	char* str = 0;
-	uint32_t length = 0;
+	uint64_t length = 0;
 
 	FileHandle file = FileOpen(a_sPath, "r");
 	if (!file)
 		return;
 	
 	length = FileSize(file);
-	str = (char*)malloc(length * sizeof(char));
-	int bytesRead = FileRead(file, &str, length);
+	str = (char*)malloc((size_t)length * sizeof(char));
+	uint64_t bytesRead = FileRead(file, &str, length);
 	FileClose(file);
 
 	nlohmann::json* pJson = new nlohmann::json;
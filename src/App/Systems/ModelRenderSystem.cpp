@@ -16,7 +16,13 @@
 #include "../../../include/glm/gtc/matrix_transform.hpp"
 
 #include "../Systems.h"
-#include <queue>
+#include <algorithm>
+#include <string.h>
+#include "../../Engine/DrawList.h"
+#include "../../Engine/FrustumCull.h"
+#include "../../Engine/OcclusionCull.h"
+#include "../../Engine/TextureStreaming.h"
+#include "../../Engine/Log.h"
 #include "../AppRenderer.h"
 
 class ModelRenderable : public Renderable
@@ -25,75 +31,165 @@ public:
 	void SetModel(Model* a_pModel) { pModel = a_pModel; }
 	void SetModelMatrixIndex(uint32_t a_ModelMatrixIndex) { modelMatrixIndex = a_ModelMatrixIndex; }
 	void SetNodeDescriptorSet(DescriptorSet* a_DescriptorSet) { pNodeDescriptorSet = a_DescriptorSet; }
+	// frustum test result per primitive from CullModelPrimitives, nullptr draws every primitive
+	void SetPrimitiveVisibility(const uint8_t* a_pVisible) { pPrimitiveVisibility = a_pVisible; }
+	void SetLod(uint32_t a_uLod) { lod = a_uLod; }
 	void Draw(CommandBuffer* a_pCommandBuffer);
 
 private:
 	uint32_t modelMatrixIndex;
+	uint32_t lod;
+	const uint8_t* pPrimitiveVisibility;
 	DescriptorSet* pNodeDescriptorSet;
 	Model* pModel;
 };
 
-void renderNode(CommandBuffer* pCommandBuffer, Node* node, Material::AlphaMode alphaMode)
+// models drawn by at least this many entities use the instanced pipeline
+#define MIN_INSTANCED_DRAW_COUNT 2
+
+// the primitives of one material of a GPU culled model, drawn together
+struct CulledMaterialDraws
+{
+	Material*	pMaterial;
+	uint32_t	bucket;
+};
+
+class InstancedModelRenderable : public Renderable
+{
+public:
+	void SetModel(Model* a_pModel) { pModel = a_pModel; }
+	// draw from a_pVertices at a_uVertexOffset instead of the model vertices, skinned entities read the skinned vertex pool
+	void SetVertices(Buffer* a_pVertices, uint32_t a_uVertexOffset) { pVertices = a_pVertices; vertexOffset = a_uVertexOffset; }
+	// a_uInstanceCount model times node matrices per mesh, the ones of mesh i from a_uFirstInstance + i * a_uInstanceCount on
+	void SetInstances(uint32_t a_uFirstInstance, uint32_t a_uInstanceCount) { firstInstance = a_uFirstInstance; instanceCount = a_uInstanceCount; }
+	// draw the GPU culled instances instead, one bucket per material
+	void SetCulledBuckets(const CulledMaterialDraws* a_pBuckets, uint32_t a_uCount) { pCulledBuckets = a_pBuckets; culledBucketCount = a_uCount; }
+	// primitives visible from any of the instances, nullptr draws every primitive
+	void SetPrimitiveVisibility(const uint8_t* a_pVisible) { pPrimitiveVisibility = a_pVisible; }
+	// one detail level for every instance
+	void SetLod(uint32_t a_uLod) { lod = a_uLod; }
+	void Draw(CommandBuffer* a_pCommandBuffer);
+
+private:
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+	uint32_t lod;
+	const CulledMaterialDraws* pCulledBuckets;
+	uint32_t culledBucketCount;
+	const uint8_t* pPrimitiveVisibility;
+	Buffer* pVertices;
+	uint32_t vertexOffset;
+	Model* pModel;
+};
+
+// primitives are numbered in the order renderNode visits them, opaque ones first
+struct PrimitiveCursor
+{
+	uint32_t		next;
+	// CPU culling result per primitive, nullptr draws all of them
+	const uint8_t*	pVisible;
+	// instanced draws read one matrix per mesh and instance instead of binding the node set
+	bool			meshInstances;
+	// primitives without that many lods draw their coarsest one
+	uint32_t		lod;
+	uint32_t		vertexOffset;
+};
+
+struct DrawnPrimitive
+{
+	Primitive*	pPrimitive;
+	Mesh*		pMesh;
+};
+typedef std::vector<DrawnPrimitive, FrameAllocator<DrawnPrimitive>> DrawnPrimitives;
+
+// renderables only live until the queue is drawn
+template <typename T>
+static T* NewFrameRenderable()
+{
+	return new(LinearAlloc(GetFrameAllocator(), sizeof(T), alignof(T))) T();
+}
+
+// material parameters as push constants, and the material set without bindless textures
+static void BindMaterial(CommandBuffer* a_pCommandBuffer, Material& a_Material)
+{
+	// with bindless textures the material only selects its slots in the texture array
+	if (!GetAppRenderer()->useBindless)
+		BindDescriptorSet(a_pCommandBuffer, a_Material.indexInDescriptorSet, a_Material.descriptorSet);
+
+	// Pass material parameters as push constants
+	PushConstBlockMaterial pushConstBlockMaterial{};
+	pushConstBlockMaterial.colorTextureIndex = (int)a_Material.textureIndices[0];
+	pushConstBlockMaterial.physicalDescriptorTextureIndex = (int)a_Material.textureIndices[1];
+	pushConstBlockMaterial.normalTextureIndex = (int)a_Material.textureIndices[2];
+	pushConstBlockMaterial.occlusionTextureIndex = (int)a_Material.textureIndices[3];
+	pushConstBlockMaterial.emissiveTextureIndex = (int)a_Material.textureIndices[4];
+	pushConstBlockMaterial.emissiveFactor = a_Material.emissiveFactor;
+	// To save push constant space, availabilty and texture coordiante set are combined
+	// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
+	pushConstBlockMaterial.colorTextureSet = a_Material.baseColorTexture != nullptr ? a_Material.texCoordSets.baseColor : -1;
+	pushConstBlockMaterial.normalTextureSet = a_Material.normalTexture != nullptr ? a_Material.texCoordSets.normal : -1;
+	pushConstBlockMaterial.occlusionTextureSet = a_Material.occlusionTexture != nullptr ? a_Material.texCoordSets.occlusion : -1;
+	pushConstBlockMaterial.emissiveTextureSet = a_Material.emissiveTexture != nullptr ? a_Material.texCoordSets.emissive : -1;
+	pushConstBlockMaterial.alphaMask = static_cast<float>(a_Material.alphaMode == Material::AlphaMode::ALPHAMODE_MASK);
+	pushConstBlockMaterial.alphaMaskCutoff = a_Material.alphaCutoff;
+
+	// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
+
+	if (a_Material.pbrWorkflows.metallicRoughness) {
+		// Metallic roughness workflow
+		pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
+		pushConstBlockMaterial.baseColorFactor = a_Material.baseColorFactor;
+		pushConstBlockMaterial.metallicFactor = a_Material.metallicFactor;
+		pushConstBlockMaterial.roughnessFactor = a_Material.roughnessFactor;
+		pushConstBlockMaterial.PhysicalDescriptorTextureSet = a_Material.metallicRoughnessTexture != nullptr ? a_Material.texCoordSets.metallicRoughness : -1;
+		pushConstBlockMaterial.colorTextureSet = a_Material.baseColorTexture != nullptr ? a_Material.texCoordSets.baseColor : -1;
+	}
+
+	if (a_Material.pbrWorkflows.specularGlossiness) {
+		// Specular glossiness workflow
+		pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_SPECULAR_GLOSINESS);
+		pushConstBlockMaterial.PhysicalDescriptorTextureSet = a_Material.extension.specularGlossinessTexture != nullptr ? a_Material.texCoordSets.specularGlossiness : -1;
+		pushConstBlockMaterial.colorTextureSet = a_Material.extension.diffuseTexture != nullptr ? a_Material.texCoordSets.baseColor : -1;
+		pushConstBlockMaterial.diffuseFactor = a_Material.extension.diffuseFactor;
+		pushConstBlockMaterial.specularFactor = glm::vec4(a_Material.extension.specularFactor, 1.0f);
+	}
+
+	ResourceDescriptor* pPBRResourceDescriptor = nullptr;
+	GetAppRenderer()->GetResourceDescriptorByName("PBR", &pPBRResourceDescriptor);
+	BindPushConstants(a_pCommandBuffer, pPBRResourceDescriptor, "Material", &pushConstBlockMaterial);
+}
+
+void renderNode(CommandBuffer* pCommandBuffer, Node* node, Material::AlphaMode alphaMode, uint32_t instanceCount = 1, uint32_t firstInstance = 0, PrimitiveCursor* pCursor = nullptr)
 {
 	if (node->mesh) {
-		// Bind Mesh's descriptor set
-		BindDescriptorSet(pCommandBuffer, node->mesh->indexInDescriptorSet, node->mesh->descriptorSet);
+		// Bind Mesh's descriptor set, instanced draws have the node matrix in their instances
+		const bool meshInstances = pCursor && pCursor->meshInstances;
+		if (!meshInstances)
+			BindDescriptorSet(pCommandBuffer, node->mesh->indexInDescriptorSet, node->mesh->descriptorSet);
+		const uint32_t meshFirstInstance = meshInstances ? firstInstance + node->mesh->indexInDescriptorSet * instanceCount : firstInstance;
 
 		// Render mesh primitives
 		for (Primitive* primitive : node->mesh->primitives) {
 			if (primitive->material.alphaMode == alphaMode) {
+				const uint32_t primitiveIndex = pCursor ? pCursor->next++ : 0;
+				if (pCursor && pCursor->pVisible && !pCursor->pVisible[primitiveIndex])
+					continue;
 
-				BindDescriptorSet(pCommandBuffer, primitive->material.indexInDescriptorSet, primitive->material.descriptorSet);
-
-				// Pass material parameters as push constants
-				PushConstBlockMaterial pushConstBlockMaterial{};
-				pushConstBlockMaterial.emissiveFactor = primitive->material.emissiveFactor;
-				// To save push constant space, availabilty and texture coordiante set are combined
-				// -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
-				pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-				pushConstBlockMaterial.normalTextureSet = primitive->material.normalTexture != nullptr ? primitive->material.texCoordSets.normal : -1;
-				pushConstBlockMaterial.occlusionTextureSet = primitive->material.occlusionTexture != nullptr ? primitive->material.texCoordSets.occlusion : -1;
-				pushConstBlockMaterial.emissiveTextureSet = primitive->material.emissiveTexture != nullptr ? primitive->material.texCoordSets.emissive : -1;
-				pushConstBlockMaterial.alphaMask = static_cast<float>(primitive->material.alphaMode == Material::AlphaMode::ALPHAMODE_MASK);
-				pushConstBlockMaterial.alphaMaskCutoff = primitive->material.alphaCutoff;
-
-				// TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
-
-				if (primitive->material.pbrWorkflows.metallicRoughness) {
-					// Metallic roughness workflow
-					pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_METALLIC_ROUGHNESS);
-					pushConstBlockMaterial.baseColorFactor = primitive->material.baseColorFactor;
-					pushConstBlockMaterial.metallicFactor = primitive->material.metallicFactor;
-					pushConstBlockMaterial.roughnessFactor = primitive->material.roughnessFactor;
-					pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.metallicRoughnessTexture != nullptr ? primitive->material.texCoordSets.metallicRoughness : -1;
-					pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-				}
-
-				if (primitive->material.pbrWorkflows.specularGlossiness) {
-					// Specular glossiness workflow
-					pushConstBlockMaterial.workflow = static_cast<float>(PBR_WORKFLOW_SPECULAR_GLOSINESS);
-					pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.extension.specularGlossinessTexture != nullptr ? primitive->material.texCoordSets.specularGlossiness : -1;
-					pushConstBlockMaterial.colorTextureSet = primitive->material.extension.diffuseTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-					pushConstBlockMaterial.diffuseFactor = primitive->material.extension.diffuseFactor;
-					pushConstBlockMaterial.specularFactor = glm::vec4(primitive->material.extension.specularFactor, 1.0f);
-				}
-
-				ResourceDescriptor* pPBRResourceDescriptor = nullptr;
-				GetAppRenderer()->GetResourceDescriptorByName("PBR", &pPBRResourceDescriptor);
-				BindPushConstants(pCommandBuffer, pPBRResourceDescriptor, "Material", &pushConstBlockMaterial);
+				BindMaterial(pCommandBuffer, primitive->material);
 
 				if (primitive->hasIndices) {
-					DrawIndexed(pCommandBuffer, primitive->indexCount, primitive->firstIndex, 0);
+					const PrimitiveLod& lod = primitive->lods[std::min(pCursor ? pCursor->lod : 0u, primitive->lodCount - 1)];
+					DrawIndexed(pCommandBuffer, lod.indexCount, lod.firstIndex, pCursor ? pCursor->vertexOffset : 0, instanceCount, meshFirstInstance);
 				}
 				else {
-					Draw(pCommandBuffer, primitive->vertexCount, 0);
+					Draw(pCommandBuffer, primitive->vertexCount, pCursor ? pCursor->vertexOffset : 0, instanceCount, meshFirstInstance);
 				}
 			}
 		}
 
 	};
 	for (Node* child : node->children) {
-		renderNode(pCommandBuffer, child, alphaMode);
+		renderNode(pCommandBuffer, child, alphaMode, instanceCount, firstInstance, pCursor);
 	}
 }
 
@@ -107,26 +203,346 @@ void ModelRenderable::Draw(CommandBuffer* a_pCommandBuffer)
 
 	GetAppRenderer()->BindModelMatrixDescriptorSet(a_pCommandBuffer, "PBR", modelMatrixIndex);
 
-	BindVertexBuffers(a_pCommandBuffer, 1, &(pModel->vertices));
+	// all material textures in one set, bound once for the whole model
+	if (GetAppRenderer()->useBindless)
+		BindDescriptorSet(a_pCommandBuffer, 0, GetAppRenderer()->pBindlessTextureSet, pPBRResourceDescriptor);
+
+	BindVertexBuffers(a_pCommandBuffer, 1, &pModel->vertices);
 	if (pModel->indices->buffer != VK_NULL_HANDLE) {
 		BindIndexBuffer(a_pCommandBuffer, pModel->indices, VK_INDEX_TYPE_UINT32);
 	}
 
+	PrimitiveCursor cursor = { 0, pPrimitiveVisibility, false, lod, 0 };
 	// Opaque primitives first
 	for (Node* node : pModel->nodes) {
 		BindDescriptorSet(a_pCommandBuffer, node->index, pNodeDescriptorSet, pPBRResourceDescriptor);
-		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_OPAQUE);
+		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_OPAQUE, 1, 0, &cursor);
 	}
 	// Alpha masked primitives
 	for (Node* node : pModel->nodes) {
 		BindDescriptorSet(a_pCommandBuffer, node->index, pNodeDescriptorSet, pPBRResourceDescriptor);
-		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_MASK);
+		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_MASK, 1, 0, &cursor);
+	}
+}
+
+void InstancedModelRenderable::Draw(CommandBuffer* a_pCommandBuffer)
+{
+	BindPipeline(a_pCommandBuffer, GetAppRenderer()->pPBRInstancedPipeline);
+
+	ResourceDescriptor* pPBRResourceDescriptor = nullptr;
+	GetAppRenderer()->GetResourceDescriptorByName("PBR", &pPBRResourceDescriptor);
+	BindDescriptorSet(a_pCommandBuffer, GetAppRenderer()->GetRenderer()->currentFrame, GetAppRenderer()->pSceneDescriptorSet, pPBRResourceDescriptor);
+
+	if (GetAppRenderer()->useBindless)
+		BindDescriptorSet(a_pCommandBuffer, 0, GetAppRenderer()->pBindlessTextureSet, pPBRResourceDescriptor);
+
+	// model matrices come from the instance buffer, no per entity uniform. culled draws read the visible ones
+	Buffer* vertexBuffers[2] = { pVertices ? pVertices : pModel->vertices, pCulledBuckets ? GetAppRenderer()->GetVisibleInstanceBuffer() : GetAppRenderer()->GetInstanceBuffer() };
+	BindVertexBuffers(a_pCommandBuffer, 2, vertexBuffers);
+	if (pModel->indices->buffer != VK_NULL_HANDLE) {
+		BindIndexBuffer(a_pCommandBuffer, pModel->indices, VK_INDEX_TYPE_UINT32);
+	}
+
+	// one draw per material, the cull left only the primitives and instances in view
+	if (pCulledBuckets) {
+		for (uint32_t i = 0; i < culledBucketCount; ++i) {
+			BindMaterial(a_pCommandBuffer, *pCulledBuckets[i].pMaterial);
+			GetAppRenderer()->DrawCulledBucket(a_pCommandBuffer, pCulledBuckets[i].bucket);
+		}
+		return;
+	}
+
+	PrimitiveCursor cursor = { 0, pPrimitiveVisibility, true, lod, vertexOffset };
+	for (Node* node : pModel->nodes) {
+		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_OPAQUE, instanceCount, firstInstance, &cursor);
+	}
+	for (Node* node : pModel->nodes) {
+		renderNode(a_pCommandBuffer, node, Material::AlphaMode::ALPHAMODE_MASK, instanceCount, firstInstance, &cursor);
+	}
+}
+
+static void GatherNodePrimitives(Node* a_pNode, Material::AlphaMode a_AlphaMode, DrawnPrimitives* a_pPrimitives)
+{
+	if (a_pNode->mesh)
+	{
+		for (Primitive* primitive : a_pNode->mesh->primitives)
+		{
+			if (primitive->material.alphaMode == a_AlphaMode)
+				a_pPrimitives->push_back({ primitive, a_pNode->mesh });
+		}
 	}
+	for (Node* child : a_pNode->children)
+		GatherNodePrimitives(child, a_AlphaMode, a_pPrimitives);
+}
+
+// the primitives in the order renderNode draws them
+static void GatherModelPrimitives(Model* a_pModel, DrawnPrimitives* a_pPrimitives)
+{
+	const Material::AlphaMode alphaModes[2] = { Material::AlphaMode::ALPHAMODE_OPAQUE, Material::AlphaMode::ALPHAMODE_MASK };
+	for (Material::AlphaMode alphaMode : alphaModes)
+		for (Node* node : a_pModel->nodes)
+			GatherNodePrimitives(node, alphaMode, a_pPrimitives);
 }
 
-static ModelRenderable renderables[32] = {};
 static std::vector<ModelComponent*> modelComponents;
 
+// entity drawn this frame, grouped by model before the draws are queued
+struct ModelInstance
+{
+	AppModel*	pAppModel;
+	uint32_t	component;
+	float		viewDepth;
+	// box in the entity cull batch, -1 for entities that are only culled per primitive
+	uint32_t	boundsIndex;
+	uint32_t	lod;
+	// projected radius over half the screen height, sizes the streamed textures
+	float		screenSize;
+	// node matrix per mesh of animated and skinned models, see CapturePose. nullptr draws the model's own
+	const glm::mat4*	pPose;
+	// joint pool slot per mesh of skinned models, nullptr without skins
+	const uint32_t*		pFirstJoints;
+};
+
+// the node matrix of a mesh in the pose of this entity
+static const glm::mat4& GetMeshMatrix(const ModelInstance& a_Instance, const Mesh* a_pMesh)
+{
+	return a_Instance.pPose ? a_Instance.pPose[a_pMesh->indexInDescriptorSet] : a_pMesh->uniformBlock.matrix;
+}
+
+// skinning moves vertices out of the primitive bounds
+static bool IsCullable(const DrawnPrimitive& a_Primitive)
+{
+	return a_Primitive.pPrimitive->bb.valid && a_Primitive.pMesh->uniformBlock.jointcount == 0.0f;
+}
+
+// world space box as the pbr shaders see it, they flip y after the model transform
+static uint32_t AddWorldBounds(CullBounds* a_pBounds, BoundingBox a_Box, const glm::mat4& a_World)
+{
+	const BoundingBox world = a_Box.getAABB(a_World);
+	const float min[3] = { world.min.x, -world.max.y, world.min.z };
+	const float max[3] = { world.max.x, -world.min.y, world.max.z };
+	return AddCullBounds(a_pBounds, min, max);
+}
+
+static OcclusionBuffer occlusionBuffer;
+
+// static models with a world box diagonal this long are drawn as occluders without being marked
+#define OCCLUDER_MIN_SIZE 10.0f
+
+static void GetCullBox(const CullBounds& a_Bounds, uint32_t a_uIndex, float a_Min[3], float a_Max[3])
+{
+	a_Min[0] = a_Bounds.centerX[a_uIndex] - a_Bounds.extentX[a_uIndex];
+	a_Min[1] = a_Bounds.centerY[a_uIndex] - a_Bounds.extentY[a_uIndex];
+	a_Min[2] = a_Bounds.centerZ[a_uIndex] - a_Bounds.extentZ[a_uIndex];
+	a_Max[0] = a_Bounds.centerX[a_uIndex] + a_Bounds.extentX[a_uIndex];
+	a_Max[1] = a_Bounds.centerY[a_uIndex] + a_Bounds.extentY[a_uIndex];
+	a_Max[2] = a_Bounds.centerZ[a_uIndex] + a_Bounds.extentZ[a_uIndex];
+}
+
+// opaque indexed primitives from the CPU copies of the model buffers, skinned meshes are left out
+static void AddModelOccluder(Model* a_pModel, const ModelInstance& a_Instance, const glm::mat4& a_World)
+{
+	if (a_pModel->indexBuffer.empty())
+		return;
+
+	// same y flip as the bounds, occluders and boxes live in the space the pbr shaders draw in
+	const glm::mat4 flipY = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+	for (Node* node : a_pModel->linearNodes)
+	{
+		if (!node->mesh || node->mesh->uniformBlock.jointcount != 0.0f)
+			continue;
+
+		const glm::mat4 world = flipY * a_World * GetMeshMatrix(a_Instance, node->mesh);
+		for (Primitive* primitive : node->mesh->primitives)
+		{
+			if (!primitive->hasIndices || primitive->material.alphaMode != Material::AlphaMode::ALPHAMODE_OPAQUE)
+				continue;
+			AddOccluder(&occlusionBuffer, &world[0][0], &a_pModel->positions[0].x, sizeof(glm::vec3),
+				a_pModel->indexBuffer.data() + primitive->firstIndex, primitive->indexCount);
+		}
+	}
+}
+
+// frustum and occlusion tests every primitive of the a_uCount entities under their world matrices, one batch for the whole model.
+// returns a frame allocated mask with 1 for primitives visible from any instance
+static const uint8_t* CullModelPrimitives(const DrawnPrimitives& a_Primitives, const ModelInstance* a_pInstances, const glm::mat4* a_pMatrices, uint32_t a_uCount,
+	uint32_t* a_pVisibleCount)
+{
+	const uint32_t primitiveCount = (uint32_t)a_Primitives.size();
+	uint8_t* pVisible = (uint8_t*)LinearAlloc(GetFrameAllocator(), primitiveCount, 1);
+
+	CullBounds bounds;
+	InitCullBounds(&bounds, GetFrameAllocator(), primitiveCount * a_uCount);
+	for (const DrawnPrimitive& primitive : a_Primitives)
+	{
+		if (!IsCullable(primitive))
+			continue;
+		// the node matrix is animated, bounds follow the pose of each entity
+		for (uint32_t i = 0; i < a_uCount; ++i)
+			AddWorldBounds(&bounds, primitive.pPrimitive->bb, a_pMatrices[i] * GetMeshMatrix(a_pInstances[i], primitive.pMesh));
+	}
+
+	uint8_t* pBoxVisible = (uint8_t*)LinearAlloc(GetFrameAllocator(), bounds.count, 1);
+	if (bounds.count)
+		CullBoundsAgainstFrustum(&bounds, GetAppRenderer()->GetViewFrustum(), pBoxVisible);
+	for (uint32_t b = 0; b < bounds.count; ++b)
+	{
+		if (!pBoxVisible[b])
+			continue;
+		float min[3], max[3];
+		GetCullBox(bounds, b, min, max);
+		pBoxVisible[b] = (uint8_t)IsBoxVisible(&occlusionBuffer, min, max);
+	}
+
+	uint32_t box = 0;
+	*a_pVisibleCount = 0;
+	for (uint32_t p = 0; p < primitiveCount; ++p)
+	{
+		pVisible[p] = 1;
+		if (IsCullable(a_Primitives[p]))
+		{
+			pVisible[p] = 0;
+			for (uint32_t i = 0; i < a_uCount; ++i)
+				pVisible[p] |= pBoxVisible[box++];
+		}
+		*a_pVisibleCount += pVisible[p];
+	}
+	return pVisible;
+}
+
+// one culled bucket per material of the model at detail level a_uLod, each primitive of the material a draw of all the instances.
+// posed entities draw every primitive on their own with their node matrices, from a_pVertexOffsets when they are skinned, -1 skips
+// the entity. opaque materials come first. returns the bucket count, 0 for models with non indexed primitives and when the cull is full
+static uint32_t AddCulledModelDraws(const DrawnPrimitives& a_Primitives, const ModelInstance* a_pInstances, uint32_t a_uFirstInstance, uint32_t a_uInstanceCount,
+	uint32_t a_uLod, const uint32_t* a_pVertexOffsets, CulledMaterialDraws** a_ppBuckets)
+{
+	for (const DrawnPrimitive& primitive : a_Primitives)
+	{
+		if (!primitive.pPrimitive->hasIndices)
+			return 0;
+	}
+
+	const uint32_t primitiveCount = (uint32_t)a_Primitives.size();
+	const uint32_t drawsPerPrimitive = a_pInstances[0].pPose ? a_uInstanceCount : 1;
+	CulledMaterialDraws* pBuckets = (CulledMaterialDraws*)LinearAlloc(GetFrameAllocator(), sizeof(CulledMaterialDraws) * primitiveCount, alignof(CulledMaterialDraws));
+	uint8_t* pAdded = (uint8_t*)LinearAlloc(GetFrameAllocator(), primitiveCount, 1);
+	memset(pAdded, 0, primitiveCount);
+
+	// a material has one alpha mode, the primitives are already in alpha mode order
+	uint32_t bucketCount = 0;
+	for (uint32_t first = 0; first < primitiveCount; ++first)
+	{
+		if (pAdded[first])
+			continue;
+
+		Material* pMaterial = &a_Primitives[first].pPrimitive->material;
+		uint32_t drawCount = 0;
+		for (uint32_t i = first; i < primitiveCount; ++i)
+			drawCount += (&a_Primitives[i].pPrimitive->material == pMaterial) ? drawsPerPrimitive : 0;
+
+		const uint32_t bucket = GetAppRenderer()->AllocateCulledBucket(drawCount);
+		if (bucket == (uint32_t)-1)
+			return 0;
+
+		uint32_t draw = 0;
+		for (uint32_t i = first; i < primitiveCount; ++i)
+		{
+			Primitive* pPrimitive = a_Primitives[i].pPrimitive;
+			if (&pPrimitive->material != pMaterial)
+				continue;
+
+			pAdded[i] = 1;
+			const PrimitiveLod& lod = pPrimitive->lods[std::min(a_uLod, pPrimitive->lodCount - 1)];
+			if (drawsPerPrimitive == 1)
+			{
+				GetAppRenderer()->SetCulledDraw(bucket, draw++, a_uFirstInstance, a_uInstanceCount, a_Primitives[i].pMesh->uniformBlock.matrix,
+					lod.indexCount, lod.firstIndex, 0, pPrimitive->bb.min, pPrimitive->bb.max, IsCullable(a_Primitives[i]));
+				continue;
+			}
+
+			// draws left unset have no instances
+			for (uint32_t e = 0; e < a_uInstanceCount; ++e, ++draw)
+			{
+				const uint32_t vertexOffset = a_pVertexOffsets ? a_pVertexOffsets[e] : 0;
+				if (vertexOffset == (uint32_t)-1)
+					continue;
+				GetAppRenderer()->SetCulledDraw(bucket, draw, a_uFirstInstance + e, 1, GetMeshMatrix(a_pInstances[e], a_Primitives[i].pMesh),
+					lod.indexCount, lod.firstIndex, (int32_t)vertexOffset, pPrimitive->bb.min, pPrimitive->bb.max, IsCullable(a_Primitives[i]));
+			}
+		}
+		pBuckets[bucketCount++] = { pMaterial, bucket };
+	}
+
+	*a_ppBuckets = pBuckets;
+	return bucketCount;
+}
+
+// meshes of the model, numbered by their indexInDescriptorSet
+static uint32_t GetModelMeshCount(Model* a_pModel)
+{
+	uint32_t meshCount = 0;
+	for (Node* node : a_pModel->linearNodes)
+		meshCount += (node->mesh != nullptr);
+	return meshCount;
+}
+
+// the node matrices and skin palettes the last animation update left in the model, copied out for one entity before the next one
+// is animated. palettes go to the joint pool of the frame, meshes without a skin or a free joint slot get -1
+static void CapturePose(Model* a_pModel, const glm::mat4** a_ppPose, const uint32_t** a_ppFirstJoints)
+{
+	const uint32_t meshCount = GetModelMeshCount(a_pModel);
+	glm::mat4* pPose = (glm::mat4*)LinearAlloc(GetFrameAllocator(), sizeof(glm::mat4) * meshCount, alignof(glm::mat4));
+	uint32_t* pFirstJoints = nullptr;
+	if (a_pModel->skinVertices)
+		pFirstJoints = (uint32_t*)LinearAlloc(GetFrameAllocator(), sizeof(uint32_t) * meshCount, alignof(uint32_t));
+
+	for (Node* node : a_pModel->linearNodes)
+	{
+		if (!node->mesh)
+			continue;
+
+		const uint32_t mesh = node->mesh->indexInDescriptorSet;
+		pPose[mesh] = node->mesh->uniformBlock.matrix;
+		if (!pFirstJoints)
+			continue;
+
+		pFirstJoints[mesh] = (uint32_t)-1;
+		const uint32_t jointCount = (uint32_t)node->mesh->uniformBlock.jointcount;
+		if (!node->mesh->pSkinPalette || jointCount == 0)
+			continue;
+
+		glm::mat4* pJoints = nullptr;
+		pFirstJoints[mesh] = GetAppRenderer()->AllocateSkinJoints(jointCount, &pJoints);
+		if (pFirstJoints[mesh] == (uint32_t)-1)
+			continue;
+		for (uint32_t j = 0; j < jointCount; ++j)
+		{
+			pJoints[j * 2] = node->mesh->pSkinPalette->jointMatrix[j];
+			pJoints[j * 2 + 1] = node->mesh->pSkinPalette->jointNormalMatrix[j];
+		}
+	}
+
+	*a_ppPose = pPose;
+	*a_ppFirstJoints = pFirstJoints;
+}
+
+// a lod switch waits until the screen size is this far past the threshold, entities near one do not flicker
+#define LOD_HYSTERESIS 0.1f
+
+// the coarsest lod whose screen size threshold the model is below, a_uCurrent is the lod drawn last frame
+static uint32_t SelectLod(const Model::LodDesc& a_Desc, uint32_t a_uCurrent, float a_fScreenSize)
+{
+	uint32_t lod = 0;
+	while (lod + 1 < std::min(a_Desc.lodCount, (uint32_t)MAX_PRIMITIVE_LODS))
+	{
+		const float threshold = a_Desc.screenSizes[lod] * (a_uCurrent > lod ? 1.0f + LOD_HYSTERESIS : 1.0f - LOD_HYSTERESIS);
+		if (a_fScreenSize >= threshold)
+			break;
+		++lod;
+	}
+	return lod;
+}
+
 class DebugDrawRenderable : public Renderable
 {
 public:
@@ -168,17 +584,124 @@ void DebugDrawRenderable::Draw(CommandBuffer* a_pCommandBuffer)
 	//SetViewport(a_pCommandBuffer, 0.0f, 0.0f, (float)w, (float)h, 0.0f, 1.0f);
 }
 
-static DebugDrawRenderable debugDrawRenderables[32] = {};
+
+// the entities of a model in one instanced renderable. GPU culled models are drawn one material at a time, the others get one
+// model times node matrix per mesh and entity. skinned entities are posed into the skinned vertex pool and draw from their own
+// vertices, one renderable each without GPU culling. returns false when the instance buffer is full
+static bool QueueInstancedModel(AppModel* a_pAppModel, const DrawnPrimitives& a_Primitives, const ModelInstance* a_pInstances, uint32_t a_uCount,
+	uint32_t a_uLod, uint64_t a_uSortKey)
+{
+	Model* pModel = a_pAppModel->pModel;
+	glm::mat4* pEntityMatrices = (glm::mat4*)LinearAlloc(GetFrameAllocator(), sizeof(glm::mat4) * a_uCount, alignof(glm::mat4));
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		glm::mat4* pModelMatrix = nullptr;
+		GetAppRenderer()->GetModelMatrixCpuBufferForIndex("PBR", modelComponents[a_pInstances[i].component]->GetModelMatrixIndexInBuffer(), &pModelMatrix);
+		pEntityMatrices[i] = *pModelMatrix;
+	}
+
+	// -1 for entities that did not fit, they are not drawn
+	uint32_t* pVertexOffsets = nullptr;
+	Buffer* pSkinnedVertices = nullptr;
+	if (a_pInstances[0].pFirstJoints)
+	{
+		pVertexOffsets = (uint32_t*)LinearAlloc(GetFrameAllocator(), sizeof(uint32_t) * a_uCount, alignof(uint32_t));
+		for (uint32_t i = 0; i < a_uCount; ++i)
+			pVertexOffsets[i] = GetAppRenderer()->QueueSkinning(a_pAppModel, a_pInstances[i].pFirstJoints);
+		pSkinnedVertices = GetAppRenderer()->GetSkinnedVertexBuffer(GetAppRenderer()->GetRenderer()->currentFrame);
+	}
+
+	// the cull applies the node matrices itself, one source matrix per entity. non indexed models and a full cull budget
+	// fall back to the CPU results
+	glm::mat4* pMatrices = nullptr;
+	uint32_t firstInstance = (uint32_t)-1;
+	if (GetAppRenderer()->useGpuCulling)
+	{
+		firstInstance = GetAppRenderer()->AllocateInstances(a_uCount, &pMatrices);
+		if (firstInstance == (uint32_t)-1)
+			return false;
+		memcpy(pMatrices, pEntityMatrices, sizeof(glm::mat4) * a_uCount);
+
+		CulledMaterialDraws* pBuckets = nullptr;
+		const uint32_t bucketCount = AddCulledModelDraws(a_Primitives, a_pInstances, firstInstance, a_uCount, a_uLod, pVertexOffsets, &pBuckets);
+		if (bucketCount)
+		{
+			InstancedModelRenderable* pRenderable = NewFrameRenderable<InstancedModelRenderable>();
+			pRenderable->SetLod(a_uLod);
+			pRenderable->SetModel(pModel);
+			pRenderable->SetCulledBuckets(pBuckets, bucketCount);
+			if (pSkinnedVertices)
+				pRenderable->SetVertices(pSkinnedVertices, 0);
+			GetAppRenderer()->PushToRenderQueue(pRenderable, a_uSortKey);
+			return true;
+		}
+	}
+
+	// the instances share one CPU result, a primitive outside every instance is skipped
+	uint32_t visibleCount = 0;
+	const uint8_t* pVisible = CullModelPrimitives(a_Primitives, a_pInstances, pEntityMatrices, a_uCount, &visibleCount);
+	if (visibleCount == 0)
+		return true;
+
+	const uint32_t meshCount = GetModelMeshCount(pModel);
+	firstInstance = GetAppRenderer()->AllocateInstances(a_uCount * meshCount, &pMatrices);
+	if (firstInstance == (uint32_t)-1)
+		return false;
+
+	// one renderable for all entities, or one per skinned entity with a block of mesh matrices each
+	const uint32_t renderableCount = pVertexOffsets ? a_uCount : 1;
+	const uint32_t instanceCount = a_uCount / renderableCount;
+	for (uint32_t r = 0; r < renderableCount; ++r)
+	{
+		glm::mat4* pRenderableMatrices = pMatrices + r * meshCount * instanceCount;
+		for (Node* node : pModel->linearNodes)
+		{
+			if (!node->mesh)
+				continue;
+			glm::mat4* pMeshMatrices = pRenderableMatrices + node->mesh->indexInDescriptorSet * instanceCount;
+			for (uint32_t i = 0; i < instanceCount; ++i)
+			{
+				const uint32_t entity = r * instanceCount + i;
+				pMeshMatrices[i] = pEntityMatrices[entity] * GetMeshMatrix(a_pInstances[entity], node->mesh);
+			}
+		}
+		if (pVertexOffsets && pVertexOffsets[r] == (uint32_t)-1)
+			continue;
+
+		InstancedModelRenderable* pRenderable = NewFrameRenderable<InstancedModelRenderable>();
+		pRenderable->SetLod(a_uLod);
+		pRenderable->SetModel(pModel);
+		pRenderable->SetPrimitiveVisibility(pVisible);
+		pRenderable->SetInstances(firstInstance + r * meshCount * instanceCount, instanceCount);
+		if (pVertexOffsets)
+			pRenderable->SetVertices(pSkinnedVertices, pVertexOffsets[r]);
+		GetAppRenderer()->PushToRenderQueue(pRenderable, a_uSortKey);
+	}
+	return true;
+}
 
 ModelRenderSystem::ModelRenderSystem()
-{}
+{
+	InitOcclusionBuffer(&occlusionBuffer);
+}
 
 ModelRenderSystem::~ModelRenderSystem()
-{}
+{
+	ExitOcclusionBuffer(&occlusionBuffer);
+}
+
+const OcclusionStats& ModelRenderSystem::GetOcclusionStats()
+{
+	return occlusionBuffer.stats;
+}
 
 void ModelRenderSystem::Update(float dt)
 {
-	static uint32_t renderablesCount = (uint32_t)modelComponents.size();
+	const uint32_t renderablesCount = (uint32_t)modelComponents.size();
+	std::vector<ModelInstance, FrameAllocator<ModelInstance>> instances;
+	instances.reserve(renderablesCount);
+	CullBounds entityBounds;
+	InitCullBounds(&entityBounds, GetFrameAllocator(), renderablesCount);
 	for (uint32_t i=0; i < renderablesCount; ++i)
 	{
 		ModelComponent* pModelComponent = modelComponents[i];
@@ -191,9 +714,14 @@ void ModelRenderSystem::Update(float dt)
 		*modelMatrix = glm::rotate(*modelMatrix, pPositionComponent->rotation,
 			glm::vec3(pPositionComponent->rotationAxisX, pPositionComponent->rotationAxisY, pPositionComponent->rotationAxisZ));
 		*modelMatrix = glm::scale(*modelMatrix, glm::vec3(pPositionComponent->scaleX, pPositionComponent->scaleY, pPositionComponent->scaleZ));
-		GetAppRenderer()->UpdateModelMatrixGpuBufferForIndex("PBR", pModelComponent->GetModelMatrixIndexInBuffer());
+		// uploaded below, only for entities that are not instanced
 
 		AppModel* pAppModel = pModelComponent->GetModel();
+		// still loading, see GetModelAsync
+		if (!pAppModel->ready)
+			continue;
+
+		Model* pModel = pAppModel->pModel;
 		if (pAppModel->pModel->animations.size())
 		{
 			int& curAnimIndex = pModelComponent->currentAnimationIndex;
@@ -204,7 +732,7 @@ void ModelRenderSystem::Update(float dt)
 
 			if (transAnimIndex == -1)
 			{
-				UpdateAnimation(curAnimIndex, curAnimTime, pAppModel->pModel);
+				UpdateAnimation(curAnimIndex, curAnimTime, pAppModel->pModel, &pModelComponent->currentAnimationCursor);
 			}
 			else
 			{
@@ -221,12 +749,14 @@ void ModelRenderSystem::Update(float dt)
 				{
 					transitionTime += dt;
 					blendFactor = transitionTime / std::max(curAnimLength, transAnimLength);
-					BlendAnimation(curAnimIndex, transAnimIndex, curAnimTime, transAnimTime, blendFactor, pAppModel->pModel);
+					BlendAnimation(curAnimIndex, transAnimIndex, curAnimTime, transAnimTime, blendFactor, pAppModel->pModel,
+						&pModelComponent->currentAnimationCursor, &pModelComponent->transitioningAnimationCursor);
 				}
 				else
 				{
 					curAnimIndex = transAnimIndex;
 					curAnimTime = transAnimTime;
+					pModelComponent->currentAnimationCursor.swap(pModelComponent->transitioningAnimationCursor);
 					transAnimIndex = -1;
 					transAnimTime = 0.0f;
 					transitionTime = 0.0f;
@@ -239,11 +769,30 @@ void ModelRenderSystem::Update(float dt)
 				curAnimTime -= curAnimLength;
 		}
 
-		ModelRenderable* pRenderable = &renderables[i];
-		pRenderable->SetModelMatrixIndex(pModelComponent->GetModelMatrixIndexInBuffer());
-		pRenderable->SetNodeDescriptorSet(pModelComponent->GetModel()->pNodeDescriptorSet);
-		pRenderable->SetModel(pAppModel->pModel);
-		GetAppRenderer()->PushToRenderQueue(pRenderable);
+		// every entity of the model is animated in the same nodes, its pose is copied out before the next one
+		const glm::mat4* pPose = nullptr;
+		const uint32_t* pFirstJoints = nullptr;
+		if (!pModel->animations.empty() || pModel->skinVertices)
+			CapturePose(pModel, &pPose, &pFirstJoints);
+
+		// animated nodes and skins move geometry away from the bind pose model bounds
+		uint32_t boundsIndex = (uint32_t)-1;
+		if (pModel->animations.empty() && pModel->skins.empty() && pModel->dimensions.min.x <= pModel->dimensions.max.x)
+			boundsIndex = AddWorldBounds(&entityBounds, BoundingBox(pModel->dimensions.min, pModel->dimensions.max), *modelMatrix);
+
+		// bounding sphere of the bind pose, y flipped like the culling bounds
+		float screenSize = 1.0f;
+		if (pModel->dimensions.min.x <= pModel->dimensions.max.x)
+		{
+			const BoundingBox world = BoundingBox(pModel->dimensions.min, pModel->dimensions.max).getAABB(*modelMatrix);
+			const glm::vec3 center = (world.min + world.max) * 0.5f;
+			screenSize = GetAppRenderer()->GetScreenSize(glm::vec3(center.x, -center.y, center.z), glm::length(world.max - world.min) * 0.5f);
+			pModelComponent->lod = SelectLod(pModel->lodDesc, pModelComponent->lod, screenSize);
+		}
+
+		const glm::vec3 position(pPositionComponent->x, pPositionComponent->y, pPositionComponent->z);
+		ModelInstance instance = { pAppModel, i, GetAppRenderer()->GetViewDepth(position), boundsIndex, pModelComponent->lod, screenSize, pPose, pFirstJoints };
+		instances.push_back(instance);
 
 		ColliderComponent* pColliderComponent = GetEntityManager()->getEntityByID(pModelComponent->GetOwnerID())->GetComponent<ColliderComponent>();
 		pColliderComponent->UpdateScaledCollider();
@@ -258,13 +807,143 @@ void ModelRenderSystem::Update(float dt)
 			*modelMatrix = glm::scale(*modelMatrix, glm::vec3(pColliderComponent->mScaledCollider.mR[0], pColliderComponent->mScaledCollider.mR[1], pColliderComponent->mScaledCollider.mR[2]));
 			GetAppRenderer()->UpdateModelMatrixGpuBufferForIndex("DebugDraw", pColliderComponent->GetModelMatrixIndexInBuffer());
 
-			DebugDrawRenderable* pDebugDrawRenderable = &debugDrawRenderables[i];
+			DebugDrawRenderable* pDebugDrawRenderable = NewFrameRenderable<DebugDrawRenderable>();
 			AppMesh* pAppMesh = nullptr;
 			GetMesh(GetResourceLoader(), MeshType::DEBUG_BOX, &pAppMesh);
 			pDebugDrawRenderable->SetAppMesh(pAppMesh);
 			pDebugDrawRenderable->SetModelMatrixIndex(pColliderComponent->GetModelMatrixIndexInBuffer());
-			GetAppRenderer()->PushToRenderQueue(pDebugDrawRenderable);
+			// no depth test, drawn over the scene
+			GetAppRenderer()->PushToRenderQueue(pDebugDrawRenderable, MakeDrawSortKey(DrawLayer::OVERLAY, GetAppRenderer()->pDebugDrawPipeline->id, 0, GetAppRenderer()->GetViewDepth(position)));
+		}
+	}
+
+	// entities outside the view frustum never reach the render queue
+	if (entityBounds.count)
+	{
+		uint8_t* pEntityVisible = (uint8_t*)LinearAlloc(GetFrameAllocator(), entityBounds.count, 1);
+		CullBoundsAgainstFrustum(&entityBounds, GetAppRenderer()->GetViewFrustum(), pEntityVisible);
+		instances.erase(std::remove_if(instances.begin(), instances.end(), [pEntityVisible](const ModelInstance& a_Instance)
+			{ return a_Instance.boundsIndex != (uint32_t)-1 && !pEntityVisible[a_Instance.boundsIndex]; }), instances.end());
+	}
+
+	// occluders in view are drawn into the software depth buffer, entities and primitives behind them are dropped
+	const glm::mat4 viewProjection = GetAppRenderer()->GetViewProjection();
+	BeginOcclusionFrame(&occlusionBuffer, &viewProjection[0][0]);
+	uint8_t* pOccluder = (uint8_t*)LinearAlloc(GetFrameAllocator(), instances.size(), 1);
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		ModelComponent* pModelComponent = modelComponents[instances[i].component];
+		pOccluder[i] = (uint8_t)pModelComponent->occluder;
+		if (!pOccluder[i] && instances[i].boundsIndex != (uint32_t)-1)
+		{
+			float min[3], max[3];
+			GetCullBox(entityBounds, instances[i].boundsIndex, min, max);
+			const glm::vec3 size(max[0] - min[0], max[1] - min[1], max[2] - min[2]);
+			pOccluder[i] = (uint8_t)(glm::length(size) >= OCCLUDER_MIN_SIZE);
+		}
+		if (!pOccluder[i])
+			continue;
+
+		glm::mat4* pModelMatrix = nullptr;
+		GetAppRenderer()->GetModelMatrixCpuBufferForIndex("PBR", pModelComponent->GetModelMatrixIndexInBuffer(), &pModelMatrix);
+		AddModelOccluder(instances[i].pAppModel->pModel, instances[i], *pModelMatrix);
+	}
+	RasterizeOccluders(&occlusionBuffer);
+
+	// occluders are kept, their own box is never in front of their surface but may tie with it
+	size_t kept = 0;
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		if (!pOccluder[i] && instances[i].boundsIndex != (uint32_t)-1)
+		{
+			float min[3], max[3];
+			GetCullBox(entityBounds, instances[i].boundsIndex, min, max);
+			if (!IsBoxVisible(&occlusionBuffer, min, max))
+				continue;
+		}
+		instances[kept++] = instances[i];
+	}
+	instances.resize(kept);
+
+	// the textures of a visible model are asked for at about the size of the model on screen, the streamer keeps
+	// the largest request of the frame
+	Renderer* pRenderer = GetAppRenderer()->GetRenderer();
+	if (pRenderer->pTextureStreamer)
+	{
+		const float screenHeight = (float)pRenderer->swapchainRenderTargets[0]->pTexture->desc.height;
+		for (const ModelInstance& instance : instances)
+		{
+			const uint32_t texels = (uint32_t)(instance.screenSize * screenHeight);
+			for (TextureSampler* pTextureSampler : instance.pAppModel->pModel->textures)
+				RequestTextureSize(pRenderer->pTextureStreamer, pTextureSampler->texture, texels);
+		}
+	}
+
+	// one draw per model, the materials come with the model so its entities can share every draw
+	std::sort(instances.begin(), instances.end(), [](const ModelInstance& a, const ModelInstance& b)
+		{ return (a.pAppModel != b.pAppModel) ? (a.pAppModel < b.pAppModel) : (a.component < b.component); });
+
+	for (size_t first = 0; first < instances.size();)
+	{
+		AppModel* pAppModel = instances[first].pAppModel;
+		size_t last = first + 1;
+		float nearestDepth = instances[first].viewDepth;
+		// instances share the draw, the most detailed one wins
+		uint32_t lod = instances[first].lod;
+		while (last < instances.size() && instances[last].pAppModel == pAppModel)
+		{
+			nearestDepth = std::min(nearestDepth, instances[last].viewDepth);
+			lod = std::min(lod, instances[last].lod);
+			++last;
 		}
+		const uint32_t count = (uint32_t)(last - first);
+		// models sharing buffers and materials end up next to each other, then front-to-back
+		const uint32_t modelId = (uint32_t)((uintptr_t)pAppModel->pModel >> 4);
+
+		DrawnPrimitives primitives;
+		GatherModelPrimitives(pAppModel->pModel, &primitives);
+
+		// the node set of a model holds a single pose, posed entities read theirs from the instance buffer and are dropped when it is full
+		const bool posed = instances[first].pPose != nullptr;
+		const bool instanced = posed || count >= MIN_INSTANCED_DRAW_COUNT;
+		const uint64_t instancedSortKey = MakeDrawSortKey(DrawLayer::SOLID, GetAppRenderer()->pPBRInstancedPipeline->id, modelId, nearestDepth);
+		if (!instanced || (!QueueInstancedModel(pAppModel, primitives, instances.data() + first, count, lod, instancedSortKey) && !posed))
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				const uint32_t modelMatrixIndex = modelComponents[instances[i].component]->GetModelMatrixIndexInBuffer();
+				glm::mat4* pModelMatrix = nullptr;
+				GetAppRenderer()->GetModelMatrixCpuBufferForIndex("PBR", modelMatrixIndex, &pModelMatrix);
+
+				uint32_t visibleCount = 0;
+				const uint8_t* pVisible = CullModelPrimitives(primitives, &instances[i], pModelMatrix, 1, &visibleCount);
+				if (visibleCount == 0)
+					continue;
+
+				GetAppRenderer()->UpdateModelMatrixGpuBufferForIndex("PBR", modelMatrixIndex);
+
+				ModelRenderable* pRenderable = NewFrameRenderable<ModelRenderable>();
+				pRenderable->SetModelMatrixIndex(modelMatrixIndex);
+				pRenderable->SetLod(instances[i].lod);
+				pRenderable->SetPrimitiveVisibility(pVisible);
+				pRenderable->SetNodeDescriptorSet(pAppModel->pNodeDescriptorSet);
+				pRenderable->SetModel(pAppModel->pModel);
+				GetAppRenderer()->PushToRenderQueue(pRenderable,
+					MakeDrawSortKey(DrawLayer::SOLID, GetAppRenderer()->pPBRPipeline->id, modelId, instances[i].viewDepth));
+			}
+		}
+
+		first = last;
+	}
+
+	// debug builds report the occlusion results once a second
+	static float occlusionReportTime = 0.0f;
+	occlusionReportTime += dt;
+	if (occlusionReportTime >= 1.0f)
+	{
+		occlusionReportTime = 0.0f;
+		LOG(LogSeverity::INFO, "Occlusion culled %u of %u boxes, %u occluder triangles",
+			occlusionBuffer.stats.culled, occlusionBuffer.stats.tested, occlusionBuffer.stats.occluderTriangles);
 	}
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 class ModelComponent;
+struct OcclusionStats;
 
 class ModelRenderSystem
 {
@@ -12,4 +13,7 @@ public:
 
 	void AddModelComponent(ModelComponent* a_pModelComponent);
 	void RemoveModelComponent(ModelComponent* a_pModelComponent);
+
+	// tested and culled boxes of the last Update, entities and primitives together
+	const OcclusionStats& GetOcclusionStats();
 };
\ No newline at end of file
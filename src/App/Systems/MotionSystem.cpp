@@ -18,7 +18,6 @@
 #include "../../../include/glm/gtc/matrix_transform.hpp"
 
 #include "../Systems.h"
-#include <queue>
 #include "../AppRenderer.h"
 #include <WinUser.h>
 
@@ -12,7 +12,6 @@
 #include "../../../include/glm/gtc/matrix_transform.hpp"
 
 #include "../Systems.h"
-#include <queue>
 #include "../AppRenderer.h"
 #include "../ResourceLoader.h"
 
@@ -92,7 +91,8 @@ void SkyboxRenderSystem::Update()
 		GetMesh(GetResourceLoader(), MeshType::SKYBOX, &pAppMesh);
 		pRenderable->SetAppMesh(pAppMesh);
 		pRenderable->SetModelMatrixIndex(pSkyboxComponent->GetModelMatrixIndexInBuffer());
-		GetAppRenderer()->PushToRenderQueue(pRenderable);
+		// drawn first without depth test, behind everything else
+		GetAppRenderer()->PushToRenderQueue(pRenderable, MakeDrawSortKey(DrawLayer::BACKGROUND, GetAppRenderer()->pSkyboxPipeline->id, 0, 0.0f));
 	}
 }
 
@@ -6,7 +6,8 @@
 #include "../Engine/Log.h"
 #include "Serializer.h"
 
-#include <queue>
+#include "../Engine/JobSystem.h"
+#include "../Engine/FileIO.h"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../../include/glm/glm.hpp"
@@ -89,6 +90,9 @@ public:
 
 	void Init()
 	{
+		InitJobSystem();
+		InitFileIO();
+
 		pAppRenderer = new AppRenderer();
 		pResourceLoader = new ResourceLoader();
 		pFRC = new FrameRateController(60);
@@ -143,6 +147,9 @@ public:
 		ExitSerializer(&pSerializer);
 		ExitResourceLoader(&pResourceLoader);
 		pAppRenderer->Exit();
+		ExitFileIO();
+		ExitJobSystem();
+		ExitFrameAllocators();
 
 		delete pMotionSystem;
 		delete pPhysics;
@@ -217,12 +224,14 @@ public:
 		float dt = pFRC->GetFrameTime();
 		pFRC->FrameStart();
 
+		UpdateResourceLoader(pResourceLoader);
 		pMotionSystem->Update(dt);
 		pPhysics->Update(dt);
 		pSkyboxRenderSystem->Update();
 		pModelRenderSystem->Update(dt);
 		pAppRenderer->Update(dt);
 		pAppRenderer->DrawScene();
+		ResetFrameAllocators();
 
 		pFRC->FrameEnd();
 	}
@@ -0,0 +1,184 @@
+#include "AnimationCompression.h"
+#include "Log.h"
+
+#define GLM_FORCE_RADIANS
+#include "../../include/glm/glm.hpp"
+#include "../../include/glm/gtc/quaternion.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// 15 bits of a smallest three component, the three smallest of a unit quaternion lie within +-1 / sqrt(2)
+#define QUATERNION_COMPONENT_MAX 32767
+#define VECTOR_COMPONENT_MAX 65535
+
+static const float smallestThreeRange = 0.70710678f;
+
+void PackAnimationKey(uint16_t* a_pDestination, const float* a_pValue, AnimationTrackType a_eType, const AnimationTrackRange& a_Range)
+{
+	if (a_eType == AnimationTrackType::VECTOR)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const float normalized = a_Range.extent[c] > 0.0f ? (a_pValue[c] - a_Range.min[c]) / a_Range.extent[c] : 0.0f;
+			a_pDestination[c] = (uint16_t)std::min(std::max(normalized, 0.0f) * VECTOR_COMPONENT_MAX + 0.5f, (float)VECTOR_COMPONENT_MAX);
+		}
+		return;
+	}
+
+	float q[4] = { a_pValue[0], a_pValue[1], a_pValue[2], a_pValue[3] };
+	const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	uint32_t largest = 0;
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		q[c] = length > 0.0f ? q[c] / length : (c == 3 ? 1.0f : 0.0f);
+		if (fabsf(q[c]) > fabsf(q[largest]))
+			largest = c;
+	}
+	// q and -q are the same rotation, the largest component is left out as a positive one
+	const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint64_t bits = (uint64_t)largest << 45;
+	uint32_t shift = 30;
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		if (c == largest)
+			continue;
+		const float normalized = (q[c] * sign / smallestThreeRange) * 0.5f + 0.5f;
+		bits |= (uint64_t)std::min(std::max(normalized, 0.0f) * QUATERNION_COMPONENT_MAX + 0.5f, (float)QUATERNION_COMPONENT_MAX) << shift;
+		shift -= 15;
+	}
+	a_pDestination[0] = (uint16_t)(bits >> 32);
+	a_pDestination[1] = (uint16_t)(bits >> 16);
+	a_pDestination[2] = (uint16_t)bits;
+}
+
+void UnpackAnimationKey(float* a_pDestination, const uint16_t* a_pKey, AnimationTrackType a_eType, const AnimationTrackRange& a_Range)
+{
+	if (a_eType == AnimationTrackType::VECTOR)
+	{
+		for (int c = 0; c < 3; ++c)
+			a_pDestination[c] = a_Range.min[c] + a_Range.extent[c] * ((float)a_pKey[c] / VECTOR_COMPONENT_MAX);
+		return;
+	}
+
+	const uint64_t bits = ((uint64_t)a_pKey[0] << 32) | ((uint64_t)a_pKey[1] << 16) | a_pKey[2];
+	const uint32_t largest = (uint32_t)(bits >> 45) & 3;
+	uint32_t shift = 30;
+	float squares = 0.0f;
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		if (c == largest)
+			continue;
+		const float normalized = (float)((bits >> shift) & QUATERNION_COMPONENT_MAX) / QUATERNION_COMPONENT_MAX;
+		a_pDestination[c] = (normalized * 2.0f - 1.0f) * smallestThreeRange;
+		squares += a_pDestination[c] * a_pDestination[c];
+		shift -= 15;
+	}
+	a_pDestination[largest] = sqrtf(std::max(1.0f - squares, 0.0f));
+}
+
+static glm::vec4 GetValue(const float* a_pValue)
+{
+	return glm::vec4(a_pValue[0], a_pValue[1], a_pValue[2], a_pValue[3]);
+}
+
+// what sampling gives between two unpacked keys, see GetUpdatedSRT
+static glm::vec4 Interpolate(const glm::vec4& a_First, const glm::vec4& a_Second, float a_fU, AnimationTrackType a_eType)
+{
+	if (a_eType == AnimationTrackType::VECTOR)
+		return glm::mix(a_First, a_Second, a_fU);
+
+	const glm::quat q = glm::normalize(glm::slerp(glm::quat(a_First.w, a_First.x, a_First.y, a_First.z), glm::quat(a_Second.w, a_Second.x, a_Second.y, a_Second.z), a_fU));
+	return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+// distance of vectors, angle between rotations. acos of the dot product loses too much near zero
+static float GetError(const glm::vec4& a_Value, const glm::vec4& a_Source, AnimationTrackType a_eType)
+{
+	if (a_eType == AnimationTrackType::VECTOR)
+		return glm::length(glm::vec3(a_Value) - glm::vec3(a_Source));
+
+	const glm::dvec4 source = glm::normalize(glm::dvec4(a_Source));
+	glm::dvec4 value = glm::normalize(glm::dvec4(a_Value));
+	if (glm::dot(value, source) < 0.0)
+		value = -value;
+	return (float)(4.0 * asin(std::min(glm::length(value - source) * 0.5, 1.0)));
+}
+
+static float GetSegmentU(const float* a_pTimes, uint32_t a_uFirst, uint32_t a_uLast, uint32_t a_uKey)
+{
+	return a_pTimes[a_uLast] > a_pTimes[a_uFirst] ? (a_pTimes[a_uKey] - a_pTimes[a_uFirst]) / (a_pTimes[a_uLast] - a_pTimes[a_uFirst]) : 0.0f;
+}
+
+uint32_t CompressAnimationTrack(float* a_pDestinationTimes, uint16_t* a_pDestinationKeys, AnimationTrackRange* a_pRange, const float* a_pTimes, const float* a_pValues,
+	uint32_t a_uKeyCount, AnimationTrackType a_eType, float a_fTolerance, bool a_bRemoveKeys, float* a_pResultError)
+{
+	LOG_IF(a_pDestinationTimes && a_pDestinationKeys && a_pRange && ((a_pTimes && a_pValues) || !a_uKeyCount), LogSeverity::ERR, "CompressAnimationTrack called without keys");
+
+	AnimationTrackRange& range = *a_pRange;
+	for (int c = 0; c < 3; ++c)
+	{
+		float minimum = a_uKeyCount ? a_pValues[c] : 0.0f, maximum = minimum;
+		for (uint32_t k = 1; k < a_uKeyCount; ++k)
+		{
+			minimum = std::min(minimum, a_pValues[k * 4 + c]);
+			maximum = std::max(maximum, a_pValues[k * 4 + c]);
+		}
+		range.min[c] = minimum;
+		range.extent[c] = maximum - minimum;
+	}
+
+	// the keys are compared to the source as sampling gives them, after packing
+	std::vector<glm::vec4> unpacked(a_uKeyCount);
+	std::vector<uint16_t> packed((size_t)a_uKeyCount * ANIMATION_PACKED_KEY_SIZE);
+	for (uint32_t k = 0; k < a_uKeyCount; ++k)
+	{
+		uint16_t* pKey = &packed[(size_t)k * ANIMATION_PACKED_KEY_SIZE];
+		PackAnimationKey(pKey, a_pValues + k * 4, a_eType, range);
+		float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		UnpackAnimationKey(value, pKey, a_eType, range);
+		unpacked[k] = GetValue(value);
+	}
+
+	// greedy, the segment from the last kept key grows until a key in between is off by more than the tolerance
+	std::vector<uint32_t> kept;
+	kept.reserve(a_uKeyCount);
+	if (a_uKeyCount)
+		kept.push_back(0);
+	for (uint32_t last = 2; last < a_uKeyCount; ++last)
+	{
+		const uint32_t first = kept.back();
+		bool fits = a_bRemoveKeys;
+		for (uint32_t k = first + 1; fits && k < last; ++k)
+		{
+			const glm::vec4 value = Interpolate(unpacked[first], unpacked[last], GetSegmentU(a_pTimes, first, last, k), a_eType);
+			fits = GetError(value, GetValue(a_pValues + k * 4), a_eType) <= a_fTolerance;
+		}
+		if (!fits)
+			kept.push_back(last - 1);
+	}
+	if (a_uKeyCount > 1)
+		kept.push_back(a_uKeyCount - 1);
+
+	float error = 0.0f;
+	for (size_t i = 0; i < kept.size(); ++i)
+	{
+		const uint32_t first = kept[i];
+		a_pDestinationTimes[i] = a_pTimes[first];
+		memcpy(a_pDestinationKeys + i * ANIMATION_PACKED_KEY_SIZE, &packed[(size_t)first * ANIMATION_PACKED_KEY_SIZE], ANIMATION_PACKED_KEY_SIZE * sizeof(uint16_t));
+
+		error = std::max(error, GetError(unpacked[first], GetValue(a_pValues + first * 4), a_eType));
+		const uint32_t last = i + 1 < kept.size() ? kept[i + 1] : first;
+		for (uint32_t k = first + 1; k < last; ++k)
+		{
+			const glm::vec4 value = Interpolate(unpacked[first], unpacked[last], GetSegmentU(a_pTimes, first, last, k), a_eType);
+			error = std::max(error, GetError(value, GetValue(a_pValues + k * 4), a_eType));
+		}
+	}
+	if (a_pResultError)
+		*a_pResultError = error;
+	return (uint32_t)kept.size();
+}
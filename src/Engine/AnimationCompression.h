@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Animation track compression for glTF imports. Keys the linear interpolation of their neighbours reproduces within a
+// tolerance are removed and the ones left are packed into 48 bits: rotations as smallest three quaternions, translations
+// and scales quantized to 16 bits per component between the smallest and largest value of their track.
+// Tracks stay packed in memory, UnpackAnimationKey decodes the two keys around the sampled time.
+
+// uint16 per packed key
+#define ANIMATION_PACKED_KEY_SIZE 3
+
+enum class AnimationTrackType : uint32_t
+{
+	// translation or scale, xyz
+	VECTOR,
+	// unit quaternion, xyzw. the index of the largest component in 2 bits and the other three in 15 bits each
+	ROTATION
+};
+
+// VECTOR keys are min + extent * packed / 65535, unused by ROTATION ones
+struct AnimationTrackRange
+{
+	float min[3];
+	float extent[3];
+};
+
+// a_pValue is three floats for vectors and four for rotations
+void PackAnimationKey(uint16_t* a_pDestination, const float* a_pValue, AnimationTrackType a_eType, const AnimationTrackRange& a_Range);
+void UnpackAnimationKey(float* a_pDestination, const uint16_t* a_pKey, AnimationTrackType a_eType, const AnimationTrackRange& a_Range);
+
+// a_uKeyCount keys at a_pTimes with four floats per value, the w of vectors is ignored. without a_bRemoveKeys every key is
+// packed, otherwise the ones the interpolation of the keys left reproduces within a_fTolerance are removed, the first and
+// last key always stay. a_pDestinationTimes and a_pDestinationKeys need room for every key, returns the key count written.
+// a_pResultError gets the largest error at any source key after packing, in the units of the values or radians for rotations
+uint32_t CompressAnimationTrack(float* a_pDestinationTimes, uint16_t* a_pDestinationKeys, AnimationTrackRange* a_pRange, const float* a_pTimes, const float* a_pValues,
+	uint32_t a_uKeyCount, AnimationTrackType a_eType, float a_fTolerance, bool a_bRemoveKeys, float* a_pResultError = nullptr);
@@ -0,0 +1,499 @@
+#include "AssetArchive.h"
+#include "FileSystem.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const char assetArchiveMagic[4] = { 'A', 'P', 'A', 'K' };
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+// a match starts at least this many bytes before the end of a block and the last bytes are literals, as LZ4 decoders expect
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+
+static char NormalizeSlash(char a_cChar)
+{
+	return a_cChar == '\\' ? '/' : a_cChar;
+}
+
+uint64_t HashArchivePath(const char* a_sPath, size_t a_uLength)
+{
+	uint64_t hash = FNV1A_64_OFFSET_BASIS;
+	size_t start = 0;
+	for (size_t i = 0; i < a_uLength; ++i)
+	{
+		if (NormalizeSlash(a_sPath[i]) == a_sPath[i])
+			continue;
+		hash = HashFnv1a64(a_sPath + start, i - start, hash);
+		hash = HashFnv1a64("/", 1, hash);
+		start = i + 1;
+	}
+	return HashFnv1a64(a_sPath + start, a_uLength - start, hash);
+}
+
+bool ReadAssetArchive(const void* a_pData, uint64_t a_uSize, AssetArchive* a_pArchive)
+{
+	if (a_uSize < sizeof(AssetArchiveHeader))
+		return false;
+
+	const uint8_t* pData = (const uint8_t*)a_pData;
+	const AssetArchiveHeader* pHeader = (const AssetArchiveHeader*)pData;
+	if (memcmp(pHeader->magic, assetArchiveMagic, sizeof(assetArchiveMagic)) != 0 || pHeader->version != ASSET_ARCHIVE_VERSION)
+		return false;
+
+	const uint64_t entriesSize = (uint64_t)pHeader->entryCount * sizeof(AssetArchiveEntry);
+	if ((pHeader->entriesOffset % ASSET_ARCHIVE_ALIGNMENT) != 0 || pHeader->entriesOffset > a_uSize || entriesSize > a_uSize - pHeader->entriesOffset ||
+		pHeader->pathsOffset > a_uSize || pHeader->pathsSize > a_uSize - pHeader->pathsOffset)
+		return false;
+
+	const AssetArchiveEntry* pEntries = (const AssetArchiveEntry*)(pData + pHeader->entriesOffset);
+	for (uint32_t i = 0; i < pHeader->entryCount; ++i)
+	{
+		const AssetArchiveEntry& entry = pEntries[i];
+		const bool stored = entry.compression == (uint32_t)AssetArchiveCompression::NONE;
+		if (entry.offset > a_uSize || entry.size > a_uSize - entry.offset || (stored && entry.size != entry.originalSize) ||
+			(!stored && entry.compression != (uint32_t)AssetArchiveCompression::LZ4) ||
+			entry.pathOffset > pHeader->pathsSize || entry.pathLength > pHeader->pathsSize - entry.pathOffset ||
+			(i > 0 && pEntries[i - 1].pathHash > entry.pathHash))
+			return false;
+	}
+
+	a_pArchive->pData = pData;
+	a_pArchive->size = a_uSize;
+	a_pArchive->pHeader = pHeader;
+	a_pArchive->pEntries = pEntries;
+	a_pArchive->pPaths = (const char*)(pData + pHeader->pathsOffset);
+	return true;
+}
+
+const AssetArchiveEntry* FindAssetArchiveEntry(const AssetArchive* a_pArchive, const char* a_sPath, size_t a_uLength)
+{
+	const uint64_t hash = HashArchivePath(a_sPath, a_uLength);
+	const AssetArchiveEntry* pEnd = a_pArchive->pEntries + a_pArchive->pHeader->entryCount;
+	const AssetArchiveEntry* pEntry = std::lower_bound(a_pArchive->pEntries, pEnd, hash,
+		[](const AssetArchiveEntry& a_Entry, uint64_t a_uHash) { return a_Entry.pathHash < a_uHash; });
+
+	for (; pEntry != pEnd && pEntry->pathHash == hash; ++pEntry)
+	{
+		if (pEntry->pathLength != a_uLength)
+			continue;
+
+		const char* pPath = a_pArchive->pPaths + pEntry->pathOffset;
+		size_t i = 0;
+		while (i < a_uLength && NormalizeSlash(pPath[i]) == NormalizeSlash(a_sPath[i]))
+			++i;
+		if (i == a_uLength)
+			return pEntry;
+	}
+	return nullptr;
+}
+
+static uint32_t Read32(const uint8_t* a_pData)
+{
+	uint32_t value;
+	memcpy(&value, a_pData, sizeof(value));
+	return value;
+}
+
+uint64_t GetCompressBound(uint64_t a_uSize)
+{
+	return a_uSize + a_uSize / 255 + 16;
+}
+
+// one LZ4 sequence, literals followed by a match. a_uMatchLength 0 is the last sequence of a block, literals only
+static bool WriteSequence(uint8_t** a_ppOutput, const uint8_t* a_pEnd, const uint8_t* a_pLiterals, uint64_t a_uLiteralLength, uint64_t a_uOffset, uint64_t a_uMatchLength)
+{
+	uint8_t* pOutput = *a_ppOutput;
+	const uint64_t worstCase = 1 + a_uLiteralLength / 255 + 1 + a_uLiteralLength + 2 + a_uMatchLength / 255 + 1;
+	if ((uint64_t)(a_pEnd - pOutput) < worstCase)
+		return false;
+
+	// lengths of 15 and more continue in bytes of up to 255 after the token
+	uint8_t* pToken = pOutput++;
+	*pToken = (uint8_t)((a_uLiteralLength < 15 ? a_uLiteralLength : 15) << 4);
+	if (a_uLiteralLength >= 15)
+	{
+		uint64_t length = a_uLiteralLength - 15;
+		for (; length >= 255; length -= 255)
+			*pOutput++ = 255;
+		*pOutput++ = (uint8_t)length;
+	}
+	if (a_uLiteralLength)
+		memcpy(pOutput, a_pLiterals, (size_t)a_uLiteralLength);
+	pOutput += a_uLiteralLength;
+
+	if (a_uMatchLength)
+	{
+		*pOutput++ = (uint8_t)a_uOffset;
+		*pOutput++ = (uint8_t)(a_uOffset >> 8);
+		uint64_t length = a_uMatchLength - LZ4_MIN_MATCH;
+		*pToken |= (uint8_t)(length < 15 ? length : 15);
+		if (length >= 15)
+		{
+			for (length -= 15; length >= 255; length -= 255)
+				*pOutput++ = 255;
+			*pOutput++ = (uint8_t)length;
+		}
+	}
+
+	*a_ppOutput = pOutput;
+	return true;
+}
+
+// greedy, the most recent position of every hashed 4 byte sequence is the only match candidate
+uint64_t CompressArchiveData(const void* a_pSource, uint64_t a_uSize, void* a_pDestination, uint64_t a_uCapacity)
+{
+	// positions are 32 bit
+	if (a_uSize > UINT32_MAX)
+		return 0;
+
+	const uint8_t* pSource = (const uint8_t*)a_pSource;
+	uint8_t* pOutput = (uint8_t*)a_pDestination;
+	const uint8_t* pEnd = pOutput + a_uCapacity;
+
+	// position + 1 of the last sequence with each hash, 0 for none
+	std::vector<uint32_t> positions((size_t)1 << LZ4_HASH_BITS, 0);
+	const uint64_t matchLimit = a_uSize > LZ4_MATCH_LIMIT ? a_uSize - LZ4_MATCH_LIMIT : 0;
+	uint64_t anchor = 0;
+	uint64_t position = 0;
+	while (position < matchLimit)
+	{
+		const uint32_t sequence = Read32(pSource + position);
+		const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+		const uint64_t candidate = positions[hash];
+		positions[hash] = (uint32_t)(position + 1);
+		if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || Read32(pSource + candidate - 1) != sequence)
+		{
+			++position;
+			continue;
+		}
+
+		const uint64_t match = candidate - 1;
+		uint64_t length = LZ4_MIN_MATCH;
+		while (position + length < a_uSize - LZ4_LAST_LITERALS && pSource[match + length] == pSource[position + length])
+			++length;
+
+		if (!WriteSequence(&pOutput, pEnd, pSource + anchor, position - anchor, position - match, length))
+			return 0;
+		position += length;
+		anchor = position;
+	}
+
+	if (!WriteSequence(&pOutput, pEnd, pSource + anchor, a_uSize - anchor, 0, 0))
+		return 0;
+	return (uint64_t)(pOutput - (uint8_t*)a_pDestination);
+}
+
+static bool ReadLength(const uint8_t** a_ppInput, const uint8_t* a_pEnd, uint64_t* a_pLength)
+{
+	const uint8_t* pInput = *a_ppInput;
+	uint8_t byte = 0;
+	do
+	{
+		if (pInput == a_pEnd)
+			return false;
+		byte = *pInput++;
+		*a_pLength += byte;
+	} while (byte == 255);
+
+	*a_ppInput = pInput;
+	return true;
+}
+
+bool DecompressArchiveData(const void* a_pSource, uint64_t a_uSourceSize, void* a_pDestination, uint64_t a_uSize)
+{
+	const uint8_t* pInput = (const uint8_t*)a_pSource;
+	const uint8_t* pInputEnd = pInput + a_uSourceSize;
+	uint8_t* pOutput = (uint8_t*)a_pDestination;
+	const uint8_t* pOutputEnd = pOutput + a_uSize;
+
+	while (pInput < pInputEnd)
+	{
+		const uint8_t token = *pInput++;
+		uint64_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(&pInput, pInputEnd, &literalLength))
+			return false;
+		if ((uint64_t)(pInputEnd - pInput) < literalLength || (uint64_t)(pOutputEnd - pOutput) < literalLength)
+			return false;
+		memcpy(pOutput, pInput, (size_t)literalLength);
+		pInput += literalLength;
+		pOutput += literalLength;
+
+		// the last sequence ends after its literals
+		if (pInput == pInputEnd)
+			break;
+		if (pInputEnd - pInput < 2)
+			return false;
+		const uint64_t offset = (uint64_t)pInput[0] | ((uint64_t)pInput[1] << 8);
+		pInput += 2;
+		if (offset == 0 || offset > (uint64_t)(pOutput - (uint8_t*)a_pDestination))
+			return false;
+
+		uint64_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(&pInput, pInputEnd, &matchLength))
+			return false;
+		matchLength += LZ4_MIN_MATCH;
+		if ((uint64_t)(pOutputEnd - pOutput) < matchLength)
+			return false;
+
+		// a match closer than its length repeats what it writes, byte by byte
+		const uint8_t* pMatch = pOutput - offset;
+		if (offset >= matchLength)
+			memcpy(pOutput, pMatch, (size_t)matchLength);
+		else
+		{
+			for (uint64_t i = 0; i < matchLength; ++i)
+				pOutput[i] = pMatch[i];
+		}
+		pOutput += matchLength;
+	}
+	return pOutput == pOutputEnd;
+}
+
+static void AlignArchiveData(std::vector<uint8_t>& a_Data)
+{
+	a_Data.resize((a_Data.size() + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(size_t)(ASSET_ARCHIVE_ALIGNMENT - 1), 0);
+}
+
+std::vector<uint8_t> WriteAssetArchive(const std::vector<AssetArchiveFile>& a_Files)
+{
+	static_assert((sizeof(AssetArchiveEntry) % ASSET_ARCHIVE_ALIGNMENT) == 0, "entries have to stay aligned");
+
+	std::vector<uint8_t> data(sizeof(AssetArchiveHeader), 0);
+	std::vector<AssetArchiveEntry> entries(a_Files.size());
+	std::vector<char> paths;
+	std::vector<uint8_t> compressed;
+	for (size_t i = 0; i < a_Files.size(); ++i)
+	{
+		const AssetArchiveFile& file = a_Files[i];
+		AssetArchiveEntry& entry = entries[i];
+		entry = {};
+		entry.pathHash = HashArchivePath(file.path.c_str(), file.path.size());
+		entry.pathOffset = (uint32_t)paths.size();
+		entry.pathLength = (uint32_t)file.path.size();
+		paths.insert(paths.end(), file.path.begin(), file.path.end());
+
+		const uint8_t* pData = file.data.data();
+		uint64_t size = file.data.size();
+		entry.originalSize = size;
+		entry.compression = (uint32_t)AssetArchiveCompression::NONE;
+		if (file.compress && size > 0)
+		{
+			compressed.resize((size_t)GetCompressBound(size));
+			const uint64_t compressedSize = CompressArchiveData(pData, size, compressed.data(), size - size / ASSET_ARCHIVE_MIN_SAVING);
+			if (compressedSize)
+			{
+				pData = compressed.data();
+				size = compressedSize;
+				entry.compression = (uint32_t)AssetArchiveCompression::LZ4;
+			}
+		}
+
+		AlignArchiveData(data);
+		entry.offset = data.size();
+		entry.size = size;
+		data.insert(data.end(), pData, pData + size);
+	}
+
+	// FindAssetArchiveEntry searches them by hash
+	std::sort(entries.begin(), entries.end(), [](const AssetArchiveEntry& a_First, const AssetArchiveEntry& a_Second) { return a_First.pathHash < a_Second.pathHash; });
+
+	AssetArchiveHeader header = {};
+	memcpy(header.magic, assetArchiveMagic, sizeof(assetArchiveMagic));
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.pathsSize = (uint32_t)paths.size();
+
+	AlignArchiveData(data);
+	header.entriesOffset = data.size();
+	data.insert(data.end(), (const uint8_t*)entries.data(), (const uint8_t*)entries.data() + entries.size() * sizeof(AssetArchiveEntry));
+	header.pathsOffset = data.size();
+	data.insert(data.end(), paths.begin(), paths.end());
+
+	memcpy(data.data(), &header, sizeof(header));
+	return data;
+}
+
+struct MountedArchive
+{
+	std::string		path;
+	// with forward slashes, empty matches every path
+	std::string		mountPoint;
+	MappedFile		file;
+	AssetArchive	archive;
+};
+
+static std::vector<MountedArchive*> mountedArchives;
+
+bool MountArchive(const char* a_sArchivePath, const char* a_sMountPoint)
+{
+	LOG_IF(a_sArchivePath, LogSeverity::ERR, "Empty Archive Name");
+
+	MountedArchive* pMounted = new MountedArchive();
+	pMounted->file = {};
+	if (!MapFile(a_sArchivePath, &pMounted->file))
+	{
+		delete pMounted;
+		return false;
+	}
+	if (!ReadAssetArchive(pMounted->file.pData, pMounted->file.size, &pMounted->archive))
+	{
+		LOG(LogSeverity::WARNING, "%s is not an asset archive of version %d", a_sArchivePath, ASSET_ARCHIVE_VERSION);
+		UnmapFile(&pMounted->file);
+		delete pMounted;
+		return false;
+	}
+
+	pMounted->path = a_sArchivePath;
+	pMounted->mountPoint = a_sMountPoint;
+	std::replace(pMounted->mountPoint.begin(), pMounted->mountPoint.end(), '\\', '/');
+	mountedArchives.push_back(pMounted);
+	return true;
+}
+
+void UnmountArchive(const char* a_sArchivePath)
+{
+	for (size_t i = 0; i < mountedArchives.size(); ++i)
+	{
+		if (mountedArchives[i]->path != a_sArchivePath)
+			continue;
+
+		UnmapFile(&mountedArchives[i]->file);
+		delete mountedArchives[i];
+		mountedArchives.erase(mountedArchives.begin() + i);
+		return;
+	}
+	LOG(LogSeverity::WARNING, "%s is not mounted", a_sArchivePath);
+}
+
+static const AssetArchiveEntry* FindMountedFile(const char* a_sPath, const AssetArchive** a_ppArchive)
+{
+	if (mountedArchives.empty())
+		return nullptr;
+
+	const size_t length = strlen(a_sPath);
+	for (size_t i = mountedArchives.size(); i-- > 0;)
+	{
+		const std::string& mountPoint = mountedArchives[i]->mountPoint;
+		if (length < mountPoint.size())
+			continue;
+
+		size_t c = 0;
+		while (c < mountPoint.size() && NormalizeSlash(a_sPath[c]) == mountPoint[c])
+			++c;
+		if (c < mountPoint.size())
+			continue;
+
+		const AssetArchiveEntry* pEntry = FindAssetArchiveEntry(&mountedArchives[i]->archive, a_sPath + c, length - c);
+		if (pEntry)
+		{
+			*a_ppArchive = &mountedArchives[i]->archive;
+			return pEntry;
+		}
+	}
+	return nullptr;
+}
+
+// the file data in the archive for stored entries, a decompressed copy in *a_ppDecompressed for compressed ones
+static bool GetEntryData(const AssetArchive* a_pArchive, const AssetArchiveEntry* a_pEntry, const uint8_t** a_ppData, uint8_t** a_ppDecompressed)
+{
+	const uint8_t* pData = a_pArchive->pData + a_pEntry->offset;
+	*a_ppDecompressed = nullptr;
+	if (a_pEntry->compression == (uint32_t)AssetArchiveCompression::NONE)
+	{
+		*a_ppData = pData;
+		return true;
+	}
+
+	uint8_t* pDecompressed = (uint8_t*)malloc((size_t)(a_pEntry->originalSize ? a_pEntry->originalSize : 1));
+	if (!pDecompressed || !DecompressArchiveData(pData, a_pEntry->size, pDecompressed, a_pEntry->originalSize))
+	{
+		LOG(LogSeverity::ERR, "Could not decompress %.*s", (int)a_pEntry->pathLength, a_pArchive->pPaths + a_pEntry->pathOffset);
+		free(pDecompressed);
+		return false;
+	}
+	*a_ppData = pDecompressed;
+	*a_ppDecompressed = pDecompressed;
+	return true;
+}
+
+bool ExistArchiveFile(const char* a_sPath)
+{
+	const AssetArchive* pArchive = nullptr;
+	return FindMountedFile(a_sPath, &pArchive) != nullptr;
+}
+
+bool GetArchiveFileSize(const char* a_sPath, uint64_t* a_pSize)
+{
+	const AssetArchive* pArchive = nullptr;
+	const AssetArchiveEntry* pEntry = FindMountedFile(a_sPath, &pArchive);
+	if (!pEntry)
+		return false;
+
+	*a_pSize = pEntry->originalSize;
+	return true;
+}
+
+bool OpenArchiveFile(const char* a_sPath, ArchiveFile* a_pFile)
+{
+	const AssetArchive* pArchive = nullptr;
+	const AssetArchiveEntry* pEntry = FindMountedFile(a_sPath, &pArchive);
+	if (!pEntry || !GetEntryData(pArchive, pEntry, &a_pFile->pData, &a_pFile->pDecompressed))
+		return false;
+
+	a_pFile->size = pEntry->originalSize;
+	a_pFile->position = 0;
+	return true;
+}
+
+void CloseArchiveFile(ArchiveFile* a_pFile)
+{
+	free(a_pFile->pDecompressed);
+	*a_pFile = {};
+}
+
+uint64_t ReadArchiveFile(ArchiveFile* a_pFile, void* a_pBuffer, uint64_t a_uSize)
+{
+	const uint64_t size = std::min(a_uSize, a_pFile->size - a_pFile->position);
+	memcpy(a_pBuffer, a_pFile->pData + a_pFile->position, (size_t)size);
+	a_pFile->position += size;
+	return size;
+}
+
+void SeekArchiveFile(ArchiveFile* a_pFile, int64_t a_iOffset, int a_iOrigin)
+{
+	int64_t position = a_iOffset;
+	if (a_iOrigin == SEEK_CUR)
+		position += (int64_t)a_pFile->position;
+	else if (a_iOrigin == SEEK_END)
+		position += (int64_t)a_pFile->size;
+	a_pFile->position = (uint64_t)std::max<int64_t>(0, std::min<int64_t>(position, (int64_t)a_pFile->size));
+}
+
+bool MapArchiveFile(const char* a_sPath, MappedFile* a_pFile)
+{
+	const AssetArchive* pArchive = nullptr;
+	const AssetArchiveEntry* pEntry = FindMountedFile(a_sPath, &pArchive);
+	const uint8_t* pData = nullptr;
+	uint8_t* pDecompressed = nullptr;
+	if (!pEntry || pEntry->originalSize == 0 || !GetEntryData(pArchive, pEntry, &pData, &pDecompressed))
+		return false;
+
+	a_pFile->pData = pData;
+	a_pFile->size = pEntry->originalSize;
+	a_pFile->pHandle = pDecompressed;
+	a_pFile->archived = true;
+	return true;
+}
+
+void UnmapArchiveFile(MappedFile* a_pFile)
+{
+	free(a_pFile->pHandle);
+	*a_pFile = {};
+}
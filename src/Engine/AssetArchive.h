@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Asset archives, the files of a resource directory packed into one file by the AssetPacker tool so a cold start maps
+// a single file instead of opening every asset on its own. A header is followed by the file data, a table of entries
+// sorted by the hash of their path and the chars of every path. Paths are relative to the packed directory with
+// forward slashes, entries with the same hash are told apart by their path.
+// Data of every entry starts 16 byte aligned. Stored entries are read in place from the mapped archive, compressed
+// ones are LZ4 blocks decompressed whole when the file is opened. The layout is little endian, the byte order of every target.
+// Archives are mounted with MountArchive (see FileSystem.h), FileOpen, ExistFile and MapFile look into them first.
+
+#define ASSET_ARCHIVE_EXTENSION ".apak"
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_ALIGNMENT 16
+
+enum class AssetArchiveCompression : uint32_t
+{
+	NONE,
+	// LZ4 block format, no frame
+	LZ4
+};
+
+struct AssetArchiveHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t pathsSize;
+	// from the start of the file
+	uint64_t entriesOffset;
+	uint64_t pathsOffset;
+};
+
+struct AssetArchiveEntry
+{
+	// HashArchivePath of the path
+	uint64_t pathHash;
+	uint64_t offset;
+	// bytes in the archive and of the file itself, the same for stored entries
+	uint64_t size;
+	uint64_t originalSize;
+	uint32_t compression;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+	uint32_t padding;
+};
+
+// a validated archive, entries and paths point into its data
+struct AssetArchive
+{
+	const uint8_t* pData;
+	uint64_t size;
+	const AssetArchiveHeader* pHeader;
+	const AssetArchiveEntry* pEntries;
+	const char* pPaths;
+};
+
+// 64 bit FNV-1a of a path, backslashes hash as forward slashes
+uint64_t HashArchivePath(const char* a_sPath, size_t a_uLength);
+
+// false for an archive of another version or with an entry out of bounds
+bool ReadAssetArchive(const void* a_pData, uint64_t a_uSize, AssetArchive* a_pArchive);
+// nullptr when the archive has no file at a_sPath
+const AssetArchiveEntry* FindAssetArchiveEntry(const AssetArchive* a_pArchive, const char* a_sPath, size_t a_uLength);
+
+// LZ4 block of a_uSize bytes, 0 when it doesn't fit in a_uCapacity. GetCompressBound bytes always fit
+uint64_t CompressArchiveData(const void* a_pSource, uint64_t a_uSize, void* a_pDestination, uint64_t a_uCapacity);
+uint64_t GetCompressBound(uint64_t a_uSize);
+// false for a block that doesn't decompress to exactly a_uSize bytes
+bool DecompressArchiveData(const void* a_pSource, uint64_t a_uSourceSize, void* a_pDestination, uint64_t a_uSize);
+
+// a file packed by WriteAssetArchive
+struct AssetArchiveFile
+{
+	// relative to the packed directory
+	std::string path;
+	std::vector<uint8_t> data;
+	// false for files that are compressed already or read in place, like cooked models
+	bool compress;
+};
+
+// a compressed file is stored as it is unless compression saves at least 1 / ASSET_ARCHIVE_MIN_SAVING of it
+#define ASSET_ARCHIVE_MIN_SAVING 8
+
+// returns the whole archive
+std::vector<uint8_t> WriteAssetArchive(const std::vector<AssetArchiveFile>& a_Files);
+
+// a file of a mounted archive opened for reading, what FileOpen returns for it
+struct ArchiveFile
+{
+	const uint8_t* pData;
+	uint64_t size;
+	uint64_t position;
+	// decompressed copy of a compressed entry, freed by CloseArchiveFile
+	uint8_t* pDecompressed;
+};
+
+struct MappedFile;
+
+// the FileSystem implementations look a_sPath up in the mounted archives with these, later mounts first.
+// false when none of them has the file
+bool ExistArchiveFile(const char* a_sPath);
+// size of the file itself, compressed entries aren't decompressed for it
+bool GetArchiveFileSize(const char* a_sPath, uint64_t* a_pSize);
+bool OpenArchiveFile(const char* a_sPath, ArchiveFile* a_pFile);
+void CloseArchiveFile(ArchiveFile* a_pFile);
+uint64_t ReadArchiveFile(ArchiveFile* a_pFile, void* a_pBuffer, uint64_t a_uSize);
+// a_iOrigin is SEEK_SET, SEEK_CUR or SEEK_END
+void SeekArchiveFile(ArchiveFile* a_pFile, int64_t a_iOffset, int a_iOrigin);
+// stored entries point into the mapped archive, compressed ones at a decompressed copy. false for empty files too
+bool MapArchiveFile(const char* a_sPath, MappedFile* a_pFile);
+void UnmapArchiveFile(MappedFile* a_pFile);
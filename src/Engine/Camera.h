@@ -1,5 +1,7 @@
 #pragma once
 
+#include "FrustumCull.h"
+
 enum CameraType
 {
 	LookAt,
@@ -126,6 +128,9 @@ public:
 		glm::mat4 view;
 	} matrices;
 
+	// world space planes of perspective * view, kept in sync with the matrices
+	FrustumPlanes frustum;
+
 	struct
 	{
 		bool left = false;
@@ -155,11 +160,13 @@ public:
 		this->znear = znear;
 		this->zfar = zfar;
 		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
+		UpdateFrustum();
 	}
 
 	void UpdateAspectRatio(float aspect)
 	{
 		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
+		UpdateFrustum();
 	}
 
 	void SetPosition(const glm::vec3& position)
@@ -216,6 +223,13 @@ private:
 			matrices.view = transformation_matrix * rotation_matrix;
 		}
 
+		UpdateFrustum();
 		updated = true;
 	}
+
+	void UpdateFrustum()
+	{
+		const glm::mat4 viewProjection = matrices.perspective * matrices.view;
+		ExtractFrustumPlanes(&viewProjection[0][0], &frustum);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "DrawList.h"
+#include "Log.h"
+
+#include <string.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+// non-negative floats compare like their bit patterns
+static inline uint32_t DepthBits(float a_fDepth)
+{
+	if (!(a_fDepth > 0.0f))
+		return 0;
+
+	uint32_t bits;
+	memcpy(&bits, &a_fDepth, sizeof(bits));
+	return bits;
+}
+
+uint64_t MakeDrawSortKey(DrawLayer a_Layer, uint32_t a_uPipeline, uint32_t a_uMaterial, float a_fDepth)
+{
+	const uint64_t layer = (uint64_t)((uint32_t)a_Layer & 0xF) << 60;
+	const uint64_t pipeline = a_uPipeline & 0xFFF;
+	const uint64_t material = a_uMaterial & 0xFFFF;
+	const uint64_t depth = DepthBits(a_fDepth);
+
+	if (a_Layer >= DrawLayer::TRANSLUCENT)
+		return layer | ((~depth & 0xFFFFFFFF) << 28) | (pipeline << 16) | material;
+
+	return layer | (pipeline << 48) | (material << 32) | depth;
+}
+
+void SortDrawPackets(DrawPacket* a_pPackets, DrawPacket* a_pScratch, uint32_t a_uCount)
+{
+	LOG_IF(a_pPackets || !a_uCount, LogSeverity::ERR, "a_pPackets is NULL");
+	LOG_IF(a_pScratch || !a_uCount, LogSeverity::ERR, "a_pScratch is NULL");
+
+	if (a_uCount < 2)
+		return;
+
+	// all histograms in one read of the keys
+	uint32_t histograms[RADIX_PASSES][RADIX_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		const uint64_t key = a_pPackets[i].sortKey;
+		for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+			++histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)];
+	}
+
+	DrawPacket* pSrc = a_pPackets;
+	DrawPacket* pDst = a_pScratch;
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		const uint32_t shift = pass * RADIX_BITS;
+
+		// every key has the same byte, the order would not change
+		if (histogram[(pSrc[0].sortKey >> shift) & (RADIX_BUCKETS - 1)] == a_uCount)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket)
+		{
+			const uint32_t count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += count;
+		}
+
+		for (uint32_t i = 0; i < a_uCount; ++i)
+			pDst[histogram[(pSrc[i].sortKey >> shift) & (RADIX_BUCKETS - 1)]++] = pSrc[i];
+
+		DrawPacket* pTemp = pSrc;
+		pSrc = pDst;
+		pDst = pTemp;
+	}
+
+	if (pSrc != a_pPackets)
+		memcpy(a_pPackets, pSrc, sizeof(DrawPacket) * a_uCount);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// Draw packets ordered by a 64-bit key so consecutive draws share as much state as possible.
+//
+// key layout, most significant first:
+//	front-to-back layers:	layer(4) | pipeline(12) | material(16) | depth(32)
+//	back-to-front layers:	layer(4) | ~depth(32) | pipeline(12) | material(16)
+// depth is the view space distance, pipeline and material ids are truncated to their bits,
+// a collision only costs an extra state change
+
+enum class DrawLayer : uint32_t
+{
+	BACKGROUND = 0,
+	// opaque and alpha tested geometry
+	SOLID,
+	// layers from here on are sorted back-to-front
+	TRANSLUCENT,
+	OVERLAY,
+
+	COUNT
+};
+
+struct DrawPacket
+{
+	uint64_t	sortKey;
+	void*		pItem;
+};
+
+uint64_t MakeDrawSortKey(DrawLayer a_Layer, uint32_t a_uPipeline, uint32_t a_uMaterial, float a_fDepth);
+
+// LSD radix sort on the keys, 8 bits per pass, passes where every key has the same byte are skipped.
+// a_pScratch needs room for a_uCount packets, the result ends up in a_pPackets. Stable.
+void SortDrawPackets(DrawPacket* a_pPackets, DrawPacket* a_pScratch, uint32_t a_uCount);
@@ -0,0 +1,214 @@
+#include "FileIO.h"
+#include "FileSystem.h"
+#include "Log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+struct QueuedRead
+{
+	FileReadRequest*	pRequest;
+	JobCounter*			pCounter;
+};
+
+static std::vector<std::thread>	ioThreads;
+static std::deque<QueuedRead>	readQueues[(size_t)FileReadPriority::COUNT];
+static std::mutex				readQueueMutex;
+static std::condition_variable	readQueueCondition;
+static bool						exitIOThreads = false;
+
+static bool HasQueuedReads()
+{
+	for (const std::deque<QueuedRead>& queue : readQueues)
+	{
+		if (!queue.empty())
+			return true;
+	}
+	return false;
+}
+
+// the oldest read of the highest priority and every other queued read of its file. readQueueMutex has to be held
+static void PopReads(std::vector<QueuedRead>& a_Reads)
+{
+	for (const std::deque<QueuedRead>& queue : readQueues)
+	{
+		if (queue.empty())
+			continue;
+
+		const std::string path = queue.front().pRequest->path;
+		for (std::deque<QueuedRead>& sameFileQueue : readQueues)
+		{
+			for (std::deque<QueuedRead>::iterator itr = sameFileQueue.begin(); itr != sameFileQueue.end();)
+			{
+				if (itr->pRequest->path == path)
+				{
+					a_Reads.push_back(*itr);
+					itr = sameFileQueue.erase(itr);
+				}
+				else
+					++itr;
+			}
+		}
+		return;
+	}
+}
+
+static void FinishRead(const QueuedRead& a_Read, uint64_t a_uBytesRead, bool a_bSuccess)
+{
+	FileReadRequest* pRequest = a_Read.pRequest;
+	pRequest->bytesRead = a_uBytesRead;
+	pRequest->success = a_bSuccess;
+	if (pRequest->pCallback)
+		pRequest->pCallback(pRequest);
+	a_Read.pCounter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+// every read is of the same file
+static void ServeReads(std::vector<QueuedRead>& a_Reads)
+{
+	FileHandle file = FileOpen(a_Reads[0].pRequest->path.c_str(), "rb");
+	if (!file)
+	{
+		for (const QueuedRead& read : a_Reads)
+		{
+			if (read.pRequest->size == FILE_READ_TO_END)
+				read.pRequest->size = 0;
+			FinishRead(read, 0, false);
+		}
+		return;
+	}
+
+	const uint64_t fileSize = FileSize(file);
+	for (const QueuedRead& read : a_Reads)
+	{
+		FileReadRequest* pRequest = read.pRequest;
+		if (pRequest->size == FILE_READ_TO_END)
+			pRequest->size = fileSize > pRequest->offset ? fileSize - pRequest->offset : 0;
+		if (!pRequest->pBuffer)
+			pRequest->pBuffer = malloc(pRequest->size ? (size_t)pRequest->size : 1);
+	}
+	std::stable_sort(a_Reads.begin(), a_Reads.end(), [](const QueuedRead& a_First, const QueuedRead& a_Second) { return a_First.pRequest->offset < a_Second.pRequest->offset; });
+
+	std::vector<char> merged;
+	int64_t position = 0;
+	for (size_t first = 0; first < a_Reads.size();)
+	{
+		const uint64_t begin = a_Reads[first].pRequest->offset;
+		uint64_t end = begin + a_Reads[first].pRequest->size;
+		size_t last = first + 1;
+		for (; last < a_Reads.size(); ++last)
+		{
+			const FileReadRequest* pNext = a_Reads[last].pRequest;
+			const uint64_t nextEnd = std::max(end, pNext->offset + pNext->size);
+			if (pNext->offset > end + FILE_READ_COALESCE_GAP || nextEnd - begin > MAX_FILE_READ_COALESCE_SIZE)
+				break;
+			end = nextEnd;
+		}
+
+		if (position != (int64_t)begin)
+			FileSeek(file, (int64_t)begin, SEEK_SET);
+
+		if (last == first + 1)
+		{
+			char* pBuffer = (char*)a_Reads[first].pRequest->pBuffer;
+			const uint64_t bytesRead = a_Reads[first].pRequest->size ? FileRead(file, &pBuffer, end - begin) : 0;
+			position = (int64_t)(begin + bytesRead);
+			FinishRead(a_Reads[first], bytesRead, bytesRead == a_Reads[first].pRequest->size);
+		}
+		else
+		{
+			merged.resize((size_t)(end - begin));
+			char* pBuffer = merged.data();
+			const uint64_t bytesRead = FileRead(file, &pBuffer, end - begin);
+			position = (int64_t)(begin + bytesRead);
+			for (size_t i = first; i < last; ++i)
+			{
+				FileReadRequest* pRequest = a_Reads[i].pRequest;
+				const uint64_t start = pRequest->offset - begin;
+				const uint64_t available = bytesRead > start ? std::min(bytesRead - start, pRequest->size) : 0;
+				memcpy(pRequest->pBuffer, merged.data() + start, (size_t)available);
+				FinishRead(a_Reads[i], available, available == pRequest->size);
+			}
+		}
+		first = last;
+	}
+	FileClose(file);
+}
+
+static void IOThreadLoop()
+{
+	std::vector<QueuedRead> reads;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(readQueueMutex);
+			readQueueCondition.wait(lock, [] { return exitIOThreads || HasQueuedReads(); });
+			if (exitIOThreads && !HasQueuedReads())
+				return;
+			PopReads(reads);
+		}
+		ServeReads(reads);
+		reads.clear();
+	}
+}
+
+void InitFileIO(uint32_t a_uThreadCount)
+{
+	LOG_IF(ioThreads.empty(), LogSeverity::ERR, "File IO is already initialized");
+
+	exitIOThreads = false;
+	ioThreads.reserve(a_uThreadCount);
+	for (uint32_t i = 0; i < a_uThreadCount; ++i)
+		ioThreads.emplace_back(IOThreadLoop);
+}
+
+void ExitFileIO()
+{
+	{
+		std::lock_guard<std::mutex> lock(readQueueMutex);
+		exitIOThreads = true;
+	}
+	readQueueCondition.notify_all();
+
+	for (std::thread& thread : ioThreads)
+		thread.join();
+	ioThreads.clear();
+}
+
+void ReadFileAsync(FileReadRequest* a_pRequests, uint32_t a_uCount, JobCounter* a_pCounter)
+{
+	LOG_IF(a_pCounter, LogSeverity::ERR, "a_pCounter is NULL");
+
+	if (!a_uCount)
+		return;
+
+	a_pCounter->pending.fetch_add(a_uCount, std::memory_order_relaxed);
+	if (ioThreads.empty())
+	{
+		std::vector<QueuedRead> reads(1);
+		for (uint32_t i = 0; i < a_uCount; ++i)
+		{
+			reads.assign(1, { &a_pRequests[i], a_pCounter });
+			ServeReads(reads);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(readQueueMutex);
+		for (uint32_t i = 0; i < a_uCount; ++i)
+			readQueues[(size_t)a_pRequests[i].priority].push_back({ &a_pRequests[i], a_pCounter });
+	}
+
+	if (a_uCount == 1)
+		readQueueCondition.notify_one();
+	else
+		readQueueCondition.notify_all();
+}
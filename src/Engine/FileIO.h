@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "JobSystem.h"
+
+// Asynchronous file reads on dedicated I/O threads, a job decodes what was read while the next file is read instead
+// of a worker blocking on the disk. A request reads a range of a file into a buffer and finishes a JobCounter, so
+// AreJobsDone polls it and WaitForJobs waits for it like for jobs.
+// Critical reads, the ones a load is waiting for, are served before streaming ones. Requests queued for the same
+// file are read with one open in offset order and ranges close to each other are merged into one read.
+
+#define DEFAULT_FILE_IO_THREADS 2
+// ranges at most this far apart are merged, the bytes between them are read and dropped
+#define FILE_READ_COALESCE_GAP (64 * 1024)
+#define MAX_FILE_READ_COALESCE_SIZE (4 * 1024 * 1024)
+// size of a request that reads from its offset to the end of the file
+#define FILE_READ_TO_END UINT64_MAX
+
+enum class FileReadPriority
+{
+	CRITICAL,
+	STREAMING,
+	COUNT
+};
+
+struct FileReadRequest;
+
+// runs on an I/O thread when the request is done but before its counter is, jobs it starts on the same counter keep
+// the counter pending. that is how a load chains its decode to the read
+typedef void (*FileReadCallback)(FileReadRequest* a_pRequest);
+
+struct FileReadRequest
+{
+	std::string			path;
+	uint64_t			offset;
+	// FILE_READ_TO_END is replaced by the bytes left in the file
+	uint64_t			size;
+	// nullptr has the read allocate size bytes with malloc, the caller frees them even when the read fails
+	void*				pBuffer;
+	FileReadPriority	priority;
+	FileReadCallback	pCallback;
+	void*				pUserData;
+
+	// set before the callback runs
+	uint64_t			bytesRead;
+	bool				success;
+
+	FileReadRequest() :
+		path(), offset(0), size(FILE_READ_TO_END), pBuffer(nullptr), priority(FileReadPriority::CRITICAL), pCallback(nullptr), pUserData(nullptr),
+		bytesRead(0), success(false)
+	{}
+};
+
+// reads queued until ExitFileIO are still served
+void InitFileIO(uint32_t a_uThreadCount = DEFAULT_FILE_IO_THREADS);
+void ExitFileIO();
+
+// queues every request, they have to stay valid until the counter is done. without I/O threads they're read right here
+void ReadFileAsync(FileReadRequest* a_pRequests, uint32_t a_uCount, JobCounter* a_pCounter);
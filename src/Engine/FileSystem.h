@@ -6,11 +6,41 @@ typedef void* FileHandle;
 void InitFileSystem(void* a_PlatformData);
 void CreateDirecroty(const char* a_sDirectoryName);
 bool ExistDirectory(const char* a_sDirectoryPath);
+bool ExistFile(const char* a_sFilePath);
 FileHandle FileOpen(const char* a_sFilename, const char* a_sMode);
 void FileClose(FileHandle a_Handle);
-int FileRead(FileHandle a_Handle, char** a_ppBuffer, uint32_t a_uLength);
-uint32_t FileSize(FileHandle a_Handle);
+// sizes and offsets are 64 bit, FileRead returns the bytes read
+uint64_t FileRead(FileHandle a_Handle, char** a_ppBuffer, uint64_t a_uLength);
+// leaves the position where it is
+uint64_t FileSize(FileHandle a_Handle);
+// size of a file without opening it, false when it doesn't exist
+bool GetFileSize(const char* a_sFilePath, uint64_t* a_pSize);
 void FileWriteLine(FileHandle a_Handle, const char* a_sBuffer);
-long FileTell(FileHandle a_Handle);
-void FileSeek(FileHandle a_Handle, long a_lOffset, int a_iOrigin);
-int IsEndOfFile(FileHandle a_Handle);
\ No newline at end of file
+int64_t FileTell(FileHandle a_Handle);
+void FileSeek(FileHandle a_Handle, int64_t a_iOffset, int a_iOrigin);
+int IsEndOfFile(FileHandle a_Handle);
+
+// files in the app's writable storage (caches), not the packaged resources
+// ReadUserFile allocates the buffer with malloc, the caller frees it
+bool ReadUserFile(const char* a_sFilename, char** a_ppBuffer, uint64_t* a_pSize);
+bool WriteUserFile(const char* a_sFilename, const char* a_pBuffer, uint64_t a_uSize);
+// read only view of a whole file, pages are read on first access instead of copied up front
+struct MappedFile
+{
+	const void*	pData;
+	uint64_t	size;
+	void*		pHandle;
+	// a file of a mounted archive, pData points into the archive or at a decompressed copy
+	bool		archived;
+};
+
+// false for missing and empty files. files of mounted archives aren't copied unless they are compressed
+bool MapFile(const char* a_sFilename, MappedFile* a_pFile);
+bool MapUserFile(const char* a_sFilename, MappedFile* a_pFile);
+void UnmapFile(MappedFile* a_pFile);
+
+// Asset archives built by the AssetPacker tool (see AssetArchive.h). Paths under a_sMountPoint are looked up in the
+// archive before the loose files by ExistFile, FileOpen and MapFile, later mounts first. Mount before any job reads files,
+// an archive stays mapped until it is unmounted and files opened or mapped from it have to be closed before that
+bool MountArchive(const char* a_sArchivePath, const char* a_sMountPoint);
+void UnmountArchive(const char* a_sArchivePath);
@@ -0,0 +1,199 @@
+#include "FrustumCull.h"
+#include "LinearAllocator.h"
+#include "Log.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULL_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FRUSTUM_CULL_NEON
+#include <arm_neon.h>
+#endif
+
+#define CULL_BOUNDS_STREAMS 6
+
+void ExtractFrustumPlanes(const float* a_pViewProjection, FrustumPlanes* a_pFrustum)
+{
+	LOG_IF(a_pViewProjection, LogSeverity::ERR, "a_pViewProjection is NULL");
+	LOG_IF(a_pFrustum, LogSeverity::ERR, "a_pFrustum is NULL");
+
+	float rows[4][4];
+	for (uint32_t row = 0; row < 4; ++row)
+		for (uint32_t column = 0; column < 4; ++column)
+			rows[row][column] = a_pViewProjection[column * 4 + row];
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		a_pFrustum->planes[0][i] = rows[3][i] + rows[0][i];	// left
+		a_pFrustum->planes[1][i] = rows[3][i] - rows[0][i];	// right
+		a_pFrustum->planes[2][i] = rows[3][i] + rows[1][i];	// bottom
+		a_pFrustum->planes[3][i] = rows[3][i] - rows[1][i];	// top
+		a_pFrustum->planes[4][i] = rows[2][i];				// near
+		a_pFrustum->planes[5][i] = rows[3][i] - rows[2][i];	// far
+	}
+
+	for (uint32_t plane = 0; plane < 6; ++plane)
+	{
+		float* p = a_pFrustum->planes[plane];
+		const float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (length > 0.0f)
+		{
+			for (uint32_t i = 0; i < 4; ++i)
+				p[i] /= length;
+		}
+	}
+}
+
+void InitCullBounds(CullBounds* a_pBounds, LinearAllocator* a_pAllocator, uint32_t a_uCapacity)
+{
+	LOG_IF(a_pBounds, LogSeverity::ERR, "a_pBounds is NULL");
+	LOG_IF(a_pAllocator, LogSeverity::ERR, "a_pAllocator is NULL");
+
+	// padded to whole SIMD lanes, every stream stays 16 byte aligned
+	const uint32_t capacity = (a_uCapacity + 3) & ~3u;
+	float* pStreams = (float*)LinearAlloc(a_pAllocator, sizeof(float) * capacity * CULL_BOUNDS_STREAMS, 16);
+	memset(pStreams, 0, sizeof(float) * capacity * CULL_BOUNDS_STREAMS);
+
+	a_pBounds->centerX = pStreams;
+	a_pBounds->centerY = pStreams + capacity;
+	a_pBounds->centerZ = pStreams + capacity * 2;
+	a_pBounds->extentX = pStreams + capacity * 3;
+	a_pBounds->extentY = pStreams + capacity * 4;
+	a_pBounds->extentZ = pStreams + capacity * 5;
+	a_pBounds->count = 0;
+	a_pBounds->capacity = capacity;
+}
+
+uint32_t AddCullBounds(CullBounds* a_pBounds, const float a_Min[3], const float a_Max[3])
+{
+	LOG_IF(a_pBounds->count < a_pBounds->capacity, LogSeverity::ERR, "cull bounds are full, capacity %u", a_pBounds->capacity);
+
+	const uint32_t index = a_pBounds->count++;
+	a_pBounds->centerX[index] = (a_Min[0] + a_Max[0]) * 0.5f;
+	a_pBounds->centerY[index] = (a_Min[1] + a_Max[1]) * 0.5f;
+	a_pBounds->centerZ[index] = (a_Min[2] + a_Max[2]) * 0.5f;
+	a_pBounds->extentX[index] = (a_Max[0] - a_Min[0]) * 0.5f;
+	a_pBounds->extentY[index] = (a_Max[1] - a_Min[1]) * 0.5f;
+	a_pBounds->extentZ[index] = (a_Max[2] - a_Min[2]) * 0.5f;
+	return index;
+}
+
+// a box is outside when its center is further behind a plane than its projected radius
+uint32_t CullBoundsAgainstFrustum(const CullBounds* a_pBounds, const FrustumPlanes& a_Frustum, uint8_t* a_pVisible)
+{
+	LOG_IF(a_pBounds, LogSeverity::ERR, "a_pBounds is NULL");
+	LOG_IF(a_pVisible || !a_pBounds->count, LogSeverity::ERR, "a_pVisible is NULL");
+
+	const uint32_t count = a_pBounds->count;
+	uint32_t visibleCount = 0;
+	uint32_t i = 0;
+
+#if defined(FRUSTUM_CULL_SSE)
+	__m128 planes[6][4];
+	__m128 absNormals[6][3];
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			planes[p][c] = _mm_set1_ps(a_Frustum.planes[p][c]);
+		for (uint32_t c = 0; c < 3; ++c)
+			absNormals[p][c] = _mm_set1_ps(fabsf(a_Frustum.planes[p][c]));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i < count; i += 4)
+	{
+		const __m128 cx = _mm_load_ps(a_pBounds->centerX + i);
+		const __m128 cy = _mm_load_ps(a_pBounds->centerY + i);
+		const __m128 cz = _mm_load_ps(a_pBounds->centerZ + i);
+		const __m128 ex = _mm_load_ps(a_pBounds->extentX + i);
+		const __m128 ey = _mm_load_ps(a_pBounds->extentY + i);
+		const __m128 ez = _mm_load_ps(a_pBounds->extentZ + i);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], cx), planes[p][3]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], cz));
+
+			__m128 radius = _mm_mul_ps(absNormals[p][0], ex);
+			radius = _mm_add_ps(radius, _mm_mul_ps(absNormals[p][1], ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(absNormals[p][2], ez));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		const uint32_t lanes = count - i < 4 ? count - i : 4;
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			a_pVisible[i + lane] = (uint8_t)((mask >> lane) & 1);
+			visibleCount += a_pVisible[i + lane];
+		}
+	}
+#elif defined(FRUSTUM_CULL_NEON)
+	float32x4_t planes[6][4];
+	float32x4_t absNormals[6][3];
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			planes[p][c] = vdupq_n_f32(a_Frustum.planes[p][c]);
+		for (uint32_t c = 0; c < 3; ++c)
+			absNormals[p][c] = vdupq_n_f32(fabsf(a_Frustum.planes[p][c]));
+	}
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+
+	for (; i < count; i += 4)
+	{
+		const float32x4_t cx = vld1q_f32(a_pBounds->centerX + i);
+		const float32x4_t cy = vld1q_f32(a_pBounds->centerY + i);
+		const float32x4_t cz = vld1q_f32(a_pBounds->centerZ + i);
+		const float32x4_t ex = vld1q_f32(a_pBounds->extentX + i);
+		const float32x4_t ey = vld1q_f32(a_pBounds->extentY + i);
+		const float32x4_t ez = vld1q_f32(a_pBounds->extentZ + i);
+
+		uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			float32x4_t distance = vmlaq_f32(planes[p][3], planes[p][0], cx);
+			distance = vmlaq_f32(distance, planes[p][1], cy);
+			distance = vmlaq_f32(distance, planes[p][2], cz);
+
+			float32x4_t radius = vmulq_f32(absNormals[p][0], ex);
+			radius = vmlaq_f32(radius, absNormals[p][1], ey);
+			radius = vmlaq_f32(radius, absNormals[p][2], ez);
+
+			inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(distance, radius), zero));
+		}
+
+		uint32_t mask[4];
+		vst1q_u32(mask, inside);
+		const uint32_t lanes = count - i < 4 ? count - i : 4;
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			a_pVisible[i + lane] = (uint8_t)(mask[lane] & 1);
+			visibleCount += a_pVisible[i + lane];
+		}
+	}
+#endif
+
+	// targets without SIMD, the loops above already covered every box otherwise
+	for (; i < count; ++i)
+	{
+		uint8_t inside = 1;
+		for (uint32_t p = 0; p < 6 && inside; ++p)
+		{
+			const float* plane = a_Frustum.planes[p];
+			const float distance = plane[0] * a_pBounds->centerX[i] + plane[1] * a_pBounds->centerY[i] + plane[2] * a_pBounds->centerZ[i] + plane[3];
+			const float radius = fabsf(plane[0]) * a_pBounds->extentX[i] + fabsf(plane[1]) * a_pBounds->extentY[i] + fabsf(plane[2]) * a_pBounds->extentZ[i];
+			inside = (uint8_t)(distance + radius >= 0.0f);
+		}
+		a_pVisible[i] = inside;
+		visibleCount += inside;
+	}
+
+	return visibleCount;
+}
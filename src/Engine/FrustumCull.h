@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+struct LinearAllocator;
+
+// Batch AABB vs frustum test. Bounds are stored as a structure of arrays so one SIMD instruction
+// works on four boxes, SSE on x86, NEON on ARM and plain floats everywhere else.
+
+// world space planes (a, b, c, d) pointing inwards, a point is inside when a * x + b * y + c * z + d >= 0
+struct FrustumPlanes
+{
+	// left, right, bottom, top, near, far
+	float planes[6][4];
+};
+
+// a_pViewProjection is a column major matrix with zero to one depth, the planes come out normalized
+void ExtractFrustumPlanes(const float* a_pViewProjection, FrustumPlanes* a_pFrustum);
+
+// world space boxes as center and half extents, every array holds capacity floats rounded up to 4
+struct CullBounds
+{
+	float*		centerX;
+	float*		centerY;
+	float*		centerZ;
+	float*		extentX;
+	float*		extentY;
+	float*		extentZ;
+	uint32_t	count;
+	uint32_t	capacity;
+
+	CullBounds() :
+		centerX(nullptr), centerY(nullptr), centerZ(nullptr), extentX(nullptr), extentY(nullptr), extentZ(nullptr), count(0), capacity(0)
+	{}
+};
+
+// arrays are allocated from a_pAllocator, usually the frame allocator
+void InitCullBounds(CullBounds* a_pBounds, LinearAllocator* a_pAllocator, uint32_t a_uCapacity);
+// returns the index of the box
+uint32_t AddCullBounds(CullBounds* a_pBounds, const float a_Min[3], const float a_Max[3]);
+// a_pVisible gets 1 for every box inside or intersecting the frustum and 0 for the rest, returns the visible count
+uint32_t CullBoundsAgainstFrustum(const CullBounds* a_pBounds, const FrustumPlanes& a_Frustum, uint8_t* a_pVisible);
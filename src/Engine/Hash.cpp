@@ -0,0 +1,11 @@
+#include "Hash.h"
+
+#define FNV1A_64_PRIME 1099511628211ULL
+
+uint64_t HashFnv1a64(const void* a_pData, size_t a_uSize, uint64_t a_uHash)
+{
+	const uint8_t* pBytes = (const uint8_t*)a_pData;
+	for (size_t i = 0; i < a_uSize; ++i)
+		a_uHash = (a_uHash ^ pBytes[i]) * FNV1A_64_PRIME;
+	return a_uHash;
+}
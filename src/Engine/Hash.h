@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 64 bit FNV-1a, the key of every cache and lookup that hashes paths or file contents
+
+#define FNV1A_64_OFFSET_BASIS 14695981039346656037ULL
+
+// continues a_uHash over a_uSize bytes, data hashed in pieces gives the hash of the whole
+uint64_t HashFnv1a64(const void* a_pData, size_t a_uSize, uint64_t a_uHash = FNV1A_64_OFFSET_BASIS);
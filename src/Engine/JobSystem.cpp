@@ -0,0 +1,155 @@
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct Job
+{
+	JobFunction	function;
+	void*		pData;
+	uint32_t	index;
+	JobCounter*	pCounter;
+};
+
+static std::vector<std::thread>	workers;
+static std::deque<Job>			jobQueue;
+// long jobs only workers take, once jobQueue is empty
+static std::deque<Job>			backgroundQueue;
+static std::mutex				jobQueueMutex;
+static std::condition_variable	jobQueueCondition;
+static bool						exitWorkers = false;
+
+static bool PopJob(Job& a_Job)
+{
+	std::lock_guard<std::mutex> lock(jobQueueMutex);
+	if (jobQueue.empty())
+		return false;
+
+	a_Job = jobQueue.front();
+	jobQueue.pop_front();
+	return true;
+}
+
+static void RunJob(const Job& a_Job)
+{
+	a_Job.function(a_Job.pData, a_Job.index);
+	a_Job.pCounter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void WorkerLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobQueueMutex);
+			jobQueueCondition.wait(lock, [] { return exitWorkers || !jobQueue.empty() || !backgroundQueue.empty(); });
+			if (exitWorkers && jobQueue.empty() && backgroundQueue.empty())
+				return;
+
+			std::deque<Job>& queue = jobQueue.empty() ? backgroundQueue : jobQueue;
+			job = queue.front();
+			queue.pop_front();
+		}
+		RunJob(job);
+	}
+}
+
+void InitJobSystem(uint32_t a_uWorkerCount)
+{
+	LOG_IF(workers.empty(), LogSeverity::ERR, "Job system is already initialized");
+
+	if (a_uWorkerCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		a_uWorkerCount = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	exitWorkers = false;
+	workers.reserve(a_uWorkerCount);
+	for (uint32_t i = 0; i < a_uWorkerCount; ++i)
+		workers.emplace_back(WorkerLoop);
+}
+
+void ExitJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobQueueMutex);
+		exitWorkers = true;
+	}
+	jobQueueCondition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+uint32_t GetJobWorkerCount()
+{
+	return (uint32_t)workers.size();
+}
+
+void RunJobs(JobFunction a_pFunction, void* a_pData, uint32_t a_uCount, JobCounter* a_pCounter)
+{
+	LOG_IF(a_pFunction, LogSeverity::ERR, "a_pFunction is NULL");
+	LOG_IF(a_pCounter, LogSeverity::ERR, "a_pCounter is NULL");
+
+	if (!a_uCount)
+		return;
+
+	a_pCounter->pending.fetch_add(a_uCount, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(jobQueueMutex);
+		for (uint32_t i = 0; i < a_uCount; ++i)
+			jobQueue.push_back({ a_pFunction, a_pData, i, a_pCounter });
+	}
+
+	if (a_uCount == 1)
+		jobQueueCondition.notify_one();
+	else
+		jobQueueCondition.notify_all();
+}
+
+void RunBackgroundJob(JobFunction a_pFunction, void* a_pData, JobCounter* a_pCounter)
+{
+	LOG_IF(a_pFunction, LogSeverity::ERR, "a_pFunction is NULL");
+	LOG_IF(a_pCounter, LogSeverity::ERR, "a_pCounter is NULL");
+
+	a_pCounter->pending.fetch_add(1, std::memory_order_relaxed);
+	if (workers.empty())
+	{
+		RunJob({ a_pFunction, a_pData, 0, a_pCounter });
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobQueueMutex);
+		backgroundQueue.push_back({ a_pFunction, a_pData, 0, a_pCounter });
+	}
+	jobQueueCondition.notify_one();
+}
+
+bool AreJobsDone(const JobCounter* a_pCounter)
+{
+	return a_pCounter->pending.load(std::memory_order_acquire) == 0;
+}
+
+void WaitForJobs(JobCounter* a_pCounter)
+{
+	LOG_IF(a_pCounter, LogSeverity::ERR, "a_pCounter is NULL");
+
+	while (a_pCounter->pending.load(std::memory_order_acquire) > 0)
+	{
+		// jobs of other batches are fair game too, they would hold up a worker otherwise. background jobs aren't,
+		// a frame waiting on its batch would stall for them
+		Job job;
+		if (PopJob(job))
+			RunJob(job);
+		else
+			std::this_thread::yield();
+	}
+}
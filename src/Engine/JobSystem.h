@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Fixed pool of worker threads for fork/join batches. A batch calls one function for
+// every index in [0, count), the thread waiting on the batch runs jobs as well so the
+// work finishes even with no workers.
+
+typedef void (*JobFunction)(void* a_pData, uint32_t a_uIndex);
+
+struct JobCounter
+{
+	std::atomic<uint32_t> pending;
+
+	JobCounter() :
+		pending(0)
+	{}
+};
+
+// 0 starts one worker less than the hardware threads, the main thread is the last one
+void InitJobSystem(uint32_t a_uWorkerCount = 0);
+void ExitJobSystem();
+uint32_t GetJobWorkerCount();
+
+// queues a_pFunction(a_pData, i) for every i in [0, a_uCount), a_pData has to stay valid until the wait returns
+void RunJobs(JobFunction a_pFunction, void* a_pData, uint32_t a_uCount, JobCounter* a_pCounter);
+// queues a_pFunction(a_pData, 0) for loads and other work that may take longer than a frame. only workers run it, after the
+// batches in the queue, without workers it runs right here
+void RunBackgroundJob(JobFunction a_pFunction, void* a_pData, JobCounter* a_pCounter);
+// true once every job of the counter is done, for polling instead of waiting
+bool AreJobsDone(const JobCounter* a_pCounter);
+// runs queued jobs on the calling thread until every job of the counter is done
+void WaitForJobs(JobCounter* a_pCounter);
@@ -0,0 +1,134 @@
+#include "LinearAllocator.h"
+#include "Log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+
+struct OverflowBlock
+{
+	OverflowBlock* pNext;
+};
+
+static std::mutex frameAllocatorsMutex;
+static std::vector<LinearAllocator*> frameAllocators;
+static thread_local LinearAllocator* pThreadFrameAllocator = nullptr;
+
+static inline size_t AlignUp(size_t a_uValue, size_t a_uAlignment)
+{
+	return (a_uValue + a_uAlignment - 1) & ~(a_uAlignment - 1);
+}
+
+void InitLinearAllocator(LinearAllocator* a_pAllocator, size_t a_uCapacity)
+{
+	LOG_IF(a_pAllocator, LogSeverity::ERR, "a_pAllocator is NULL");
+	LOG_IF(!a_pAllocator->pMemory, LogSeverity::ERR, "allocator is already initialized");
+
+	a_pAllocator->pMemory = (uint8_t*)malloc(a_uCapacity);
+	a_pAllocator->capacity = a_uCapacity;
+	a_pAllocator->offset = 0;
+	a_pAllocator->peak = 0;
+	a_pAllocator->pOverflow = nullptr;
+	a_pAllocator->overflowSize = 0;
+}
+
+static void FreeOverflowBlocks(LinearAllocator* a_pAllocator)
+{
+	OverflowBlock* pBlock = (OverflowBlock*)a_pAllocator->pOverflow;
+	while (pBlock)
+	{
+		OverflowBlock* pNext = pBlock->pNext;
+		free(pBlock);
+		pBlock = pNext;
+	}
+	a_pAllocator->pOverflow = nullptr;
+	a_pAllocator->overflowSize = 0;
+}
+
+void ExitLinearAllocator(LinearAllocator* a_pAllocator)
+{
+	LOG_IF(a_pAllocator, LogSeverity::ERR, "a_pAllocator is NULL");
+
+	FreeOverflowBlocks(a_pAllocator);
+	free(a_pAllocator->pMemory);
+	a_pAllocator->pMemory = nullptr;
+	a_pAllocator->capacity = 0;
+	a_pAllocator->offset = 0;
+}
+
+void* LinearAlloc(LinearAllocator* a_pAllocator, size_t a_uSize, size_t a_uAlignment)
+{
+	LOG_IF(a_pAllocator, LogSeverity::ERR, "a_pAllocator is NULL");
+	LOG_IF((a_uAlignment & (a_uAlignment - 1)) == 0, LogSeverity::ERR, "alignment %zu is not a power of two", a_uAlignment);
+
+	size_t start = AlignUp((size_t)(a_pAllocator->pMemory) + a_pAllocator->offset, a_uAlignment) - (size_t)a_pAllocator->pMemory;
+	if (start + a_uSize <= a_pAllocator->capacity)
+	{
+		a_pAllocator->offset = start + a_uSize;
+		if (a_pAllocator->offset > a_pAllocator->peak)
+			a_pAllocator->peak = a_pAllocator->offset;
+		return a_pAllocator->pMemory + start;
+	}
+
+	// out of space, fall back to the heap for the rest of the frame
+	// the next reset grows the buffer so this does not repeat every frame
+	size_t headerSize = AlignUp(sizeof(OverflowBlock), a_uAlignment);
+	OverflowBlock* pBlock = (OverflowBlock*)malloc(headerSize + a_uSize + a_uAlignment);
+	pBlock->pNext = (OverflowBlock*)a_pAllocator->pOverflow;
+	a_pAllocator->pOverflow = pBlock;
+	a_pAllocator->overflowSize += a_uSize + a_uAlignment;
+
+	return (void*)AlignUp((size_t)pBlock + headerSize, a_uAlignment);
+}
+
+void ResetLinearAllocator(LinearAllocator* a_pAllocator)
+{
+	LOG_IF(a_pAllocator, LogSeverity::ERR, "a_pAllocator is NULL");
+
+	if (a_pAllocator->pOverflow)
+	{
+		size_t newCapacity = a_pAllocator->capacity + a_pAllocator->overflowSize;
+		newCapacity += newCapacity / 2;
+		LOG(LogSeverity::WARNING, "Linear allocator overflowed by %zu bytes, growing to %zu bytes", a_pAllocator->overflowSize, newCapacity);
+
+		FreeOverflowBlocks(a_pAllocator);
+		free(a_pAllocator->pMemory);
+		a_pAllocator->pMemory = (uint8_t*)malloc(newCapacity);
+		a_pAllocator->capacity = newCapacity;
+	}
+
+	a_pAllocator->offset = 0;
+}
+
+LinearAllocator* GetFrameAllocator()
+{
+	if (!pThreadFrameAllocator)
+	{
+		pThreadFrameAllocator = new LinearAllocator();
+		InitLinearAllocator(pThreadFrameAllocator, DEFAULT_FRAME_ALLOCATOR_SIZE);
+
+		std::lock_guard<std::mutex> lock(frameAllocatorsMutex);
+		frameAllocators.push_back(pThreadFrameAllocator);
+	}
+	return pThreadFrameAllocator;
+}
+
+void ResetFrameAllocators()
+{
+	std::lock_guard<std::mutex> lock(frameAllocatorsMutex);
+	for (LinearAllocator* pAllocator : frameAllocators)
+		ResetLinearAllocator(pAllocator);
+}
+
+void ExitFrameAllocators()
+{
+	std::lock_guard<std::mutex> lock(frameAllocatorsMutex);
+	for (LinearAllocator* pAllocator : frameAllocators)
+	{
+		ExitLinearAllocator(pAllocator);
+		delete pAllocator;
+	}
+	frameAllocators.clear();
+	pThreadFrameAllocator = nullptr;
+}
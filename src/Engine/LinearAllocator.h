@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+
+// Bump allocator for transient CPU data. Allocations are never freed individually,
+// the whole allocator is rewound with ResetLinearAllocator.
+struct LinearAllocator
+{
+	uint8_t*	pMemory;
+	size_t		capacity;
+	size_t		offset;
+	size_t		peak;
+	// allocations that did not fit, released on reset
+	void*		pOverflow;
+	size_t		overflowSize;
+
+	LinearAllocator() :
+		pMemory(nullptr), capacity(0), offset(0), peak(0), pOverflow(nullptr), overflowSize(0)
+	{}
+};
+
+#define DEFAULT_FRAME_ALLOCATOR_SIZE (256 * 1024)
+
+void InitLinearAllocator(LinearAllocator* a_pAllocator, size_t a_uCapacity);
+void ExitLinearAllocator(LinearAllocator* a_pAllocator);
+void* LinearAlloc(LinearAllocator* a_pAllocator, size_t a_uSize, size_t a_uAlignment = alignof(max_align_t));
+void ResetLinearAllocator(LinearAllocator* a_pAllocator);
+
+// Per-thread frame allocator, created on first use by the calling thread
+LinearAllocator* GetFrameAllocator();
+// Rewinds the frame allocators of all threads, call once at the end of the frame
+// when no frame allocated memory is referenced anymore
+void ResetFrameAllocators();
+void ExitFrameAllocators();
+
+// STL adaptor over the calling thread's frame allocator, deallocate is a no-op.
+// Containers using it must not outlive the frame they were filled in.
+template <typename T>
+struct FrameAllocator
+{
+	typedef T value_type;
+
+	FrameAllocator() {}
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t a_uCount)
+	{
+		return (T*)LinearAlloc(GetFrameAllocator(), a_uCount * sizeof(T), alignof(T));
+	}
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	struct rebind { typedef FrameAllocator<U> other; };
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) { return false; }
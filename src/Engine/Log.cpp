@@ -6,8 +6,10 @@
 #if defined(_WIN32)
 #include <Windows.h>
 #endif
-#include <string>
+#include <string.h>
+#include <stdarg.h>
 #define BUFFER_SIZE 1024
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #include <thread>
 #include <mutex>
 
@@ -15,9 +17,10 @@ static std::mutex mtx;
 
 static const char* GetFileNameFromPath(const char* path)
 {
-	std::string str = path;
-	size_t pos = str.find_last_of("\\");
-	return path + pos+1;
+	const char* pos = strrchr(path, '\\');
+	if (!pos)
+		pos = strrchr(path, '/');
+	return pos ? pos + 1 : path;
 }
 
 void Log(LogSeverity a_eLogSeverity, const char* a_fileName, int a_lineNumber, const char* message, ...)
@@ -60,14 +63,13 @@ void Log(LogSeverity a_eLogSeverity, const char* a_fileName, int a_lineNumber, c
 
 	// add file name and line number
 	const char* filename = GetFileNameFromPath(a_fileName);
-	std::string str = filename;
-	str += "(" + std::to_string(a_lineNumber) + ") | ";
-	memcpy(buffer+offset, str.c_str(), str.size());
-	offset += (uint32_t)str.size();
+	int written = snprintf(buffer + offset, BUFFER_SIZE - offset, "%s(%d) | ", filename, a_lineNumber);
+	if (written > 0)
+		offset = MIN(offset + (uint32_t)written, (uint32_t)(BUFFER_SIZE - 1));
 
 	va_list args;
 	va_start(args, message);
-	vsnprintf(buffer+offset, BUFFER_SIZE, message, args);
+	vsnprintf(buffer+offset, BUFFER_SIZE - offset, message, args);
 	va_end(args);
 
 	printf("%s\n", buffer);
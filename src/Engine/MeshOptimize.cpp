@@ -0,0 +1,267 @@
+#include "MeshOptimize.h"
+#include "Log.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+uint32_t GenerateVertexRemap(uint32_t* a_pRemap, const void* a_pVertices, uint32_t a_uVertexCount, uint32_t a_uVertexSize)
+{
+	LOG_IF(a_pRemap && a_pVertices, LogSeverity::ERR, "GenerateVertexRemap called without remap or vertices");
+
+	const uint8_t* pVertices = (const uint8_t*)a_pVertices;
+	std::vector<uint32_t> order(a_uVertexCount);
+	for (uint32_t v = 0; v < a_uVertexCount; ++v)
+		order[v] = v;
+	// equal vertices end up next to each other, the lowest index first
+	std::stable_sort(order.begin(), order.end(), [pVertices, a_uVertexSize](uint32_t a, uint32_t b)
+		{ return memcmp(pVertices + (size_t)a * a_uVertexSize, pVertices + (size_t)b * a_uVertexSize, a_uVertexSize) < 0; });
+
+	// every group takes the index of its first vertex, then indices are compacted in vertex order
+	std::vector<uint32_t> first(a_uVertexCount);
+	for (uint32_t i = 0; i < a_uVertexCount; ++i)
+	{
+		const bool equal = i > 0 && memcmp(pVertices + (size_t)order[i] * a_uVertexSize, pVertices + (size_t)order[i - 1] * a_uVertexSize, a_uVertexSize) == 0;
+		first[order[i]] = equal ? first[order[i - 1]] : order[i];
+	}
+
+	uint32_t uniqueCount = 0;
+	for (uint32_t v = 0; v < a_uVertexCount; ++v)
+		a_pRemap[v] = first[v] == v ? uniqueCount++ : a_pRemap[first[v]];
+	return uniqueCount;
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007). fans triangles around one vertex at a time and moves to the
+// neighbour that is still in the cache. a_pClusters gets the first index of every run that had to jump
+// to an unrelated vertex, those runs can be reordered without hurting the cache much
+static void Tipsify(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uVertexCount, std::vector<uint32_t>* a_pClusters)
+{
+	const uint32_t triangleCount = a_uIndexCount / 3;
+
+	std::vector<uint32_t> triangleOffsets(a_uVertexCount + 1, 0);
+	for (uint32_t i = 0; i < a_uIndexCount; ++i)
+		++triangleOffsets[a_pIndices[i] + 1];
+	for (uint32_t v = 0; v < a_uVertexCount; ++v)
+		triangleOffsets[v + 1] += triangleOffsets[v];
+	std::vector<uint32_t> vertexTriangles(a_uIndexCount);
+	{
+		std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (uint32_t i = 0; i < a_uIndexCount; ++i)
+			vertexTriangles[fill[a_pIndices[i]]++] = i / 3;
+	}
+
+	std::vector<uint32_t> liveTriangles(a_uVertexCount);
+	for (uint32_t v = 0; v < a_uVertexCount; ++v)
+		liveTriangles[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+	std::vector<uint32_t> cacheTime(a_uVertexCount, 0);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(a_uIndexCount);
+
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	uint32_t cursor = 0;
+	uint32_t fanning = (uint32_t)-1;
+	while (cursor < a_uVertexCount && liveTriangles[cursor] == 0)
+		++cursor;
+	fanning = cursor < a_uVertexCount ? cursor : (uint32_t)-1;
+	if (a_pClusters && fanning != (uint32_t)-1)
+		a_pClusters->push_back(0);
+
+	while (fanning != (uint32_t)-1)
+	{
+		candidates.clear();
+		for (uint32_t t = triangleOffsets[fanning]; t < triangleOffsets[fanning + 1]; ++t)
+		{
+			const uint32_t triangle = vertexTriangles[t];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const uint32_t vertex = a_pIndices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				--liveTriangles[vertex];
+				if (time - cacheTime[vertex] > VERTEX_CACHE_SIZE)
+					cacheTime[vertex] = time++;
+			}
+		}
+
+		// the candidate that stays cached longest after its remaining triangles are emitted
+		uint32_t next = (uint32_t)-1;
+		int bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+				priority = (int)(time - cacheTime[vertex]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == (uint32_t)-1)
+		{
+			// dead end, recently used vertices first, then the next vertex in input order
+			while (!deadEnds.empty() && next == (uint32_t)-1)
+			{
+				const uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+					next = vertex;
+			}
+			while (next == (uint32_t)-1 && cursor < a_uVertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+					next = cursor;
+				else
+					++cursor;
+			}
+			if (a_pClusters && next != (uint32_t)-1)
+				a_pClusters->push_back((uint32_t)output.size());
+		}
+		fanning = next;
+	}
+
+	memcpy(a_pDestination, output.data(), sizeof(uint32_t) * output.size());
+}
+
+void OptimizeVertexCache(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uVertexCount)
+{
+	LOG_IF(a_uIndexCount % 3 == 0, LogSeverity::ERR, "index count %u is not a triangle list", a_uIndexCount);
+
+	// the destination may alias the source
+	std::vector<uint32_t> source(a_pIndices, a_pIndices + a_uIndexCount);
+	Tipsify(a_pDestination, source.data(), a_uIndexCount, a_uVertexCount, nullptr);
+}
+
+void OptimizeOverdraw(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, const float* a_pPositions, uint32_t a_uVertexCount, uint32_t a_uStride)
+{
+	LOG_IF(a_uIndexCount % 3 == 0, LogSeverity::ERR, "index count %u is not a triangle list", a_uIndexCount);
+
+	std::vector<uint32_t> cacheOrder(a_uIndexCount);
+	std::vector<uint32_t> clusters;
+	{
+		std::vector<uint32_t> source(a_pIndices, a_pIndices + a_uIndexCount);
+		Tipsify(cacheOrder.data(), source.data(), a_uIndexCount, a_uVertexCount, &clusters);
+	}
+	clusters.push_back(a_uIndexCount);
+
+	const uint8_t* pPositions = (const uint8_t*)a_pPositions;
+	auto position = [pPositions, a_uStride](uint32_t a_uVertex) { return (const float*)(pPositions + (size_t)a_uVertex * a_uStride); };
+
+	// area weighted centroid of the mesh and of every cluster, with the cluster's area weighted normal
+	struct Cluster
+	{
+		uint32_t	begin;
+		uint32_t	end;
+		float		centroid[3];
+		float		normal[3];
+		float		sortKey;
+	};
+	std::vector<Cluster> sorted(clusters.size() - 1);
+	float meshCentroid[3] = {};
+	float meshArea = 0.0f;
+	for (uint32_t c = 0; c + 1 < (uint32_t)clusters.size(); ++c)
+	{
+		Cluster& cluster = sorted[c];
+		cluster = { clusters[c], clusters[c + 1], { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f };
+		float clusterArea = 0.0f;
+		for (uint32_t i = cluster.begin; i < cluster.end; i += 3)
+		{
+			const float* p0 = position(cacheOrder[i]);
+			const float* p1 = position(cacheOrder[i + 1]);
+			const float* p2 = position(cacheOrder[i + 2]);
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5f;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				cluster.centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) / 3.0f * area;
+				cluster.normal[axis] += n[axis];
+			}
+			clusterArea += area;
+		}
+		// clusters of degenerate triangles sit at their first vertex
+		const float* pFirst = position(cacheOrder[cluster.begin]);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			meshCentroid[axis] += cluster.centroid[axis];
+			cluster.centroid[axis] = clusterArea > 0.0f ? cluster.centroid[axis] / clusterArea : pFirst[axis];
+		}
+		meshArea += clusterArea;
+	}
+	for (uint32_t axis = 0; axis < 3; ++axis)
+		meshCentroid[axis] = meshArea > 0.0f ? meshCentroid[axis] / meshArea : 0.0f;
+
+	// clusters facing away from the center are more likely to hide the rest, they are drawn first
+	for (Cluster& cluster : sorted)
+	{
+		const float length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+		cluster.sortKey = 0.0f;
+		for (uint32_t axis = 0; axis < 3 && length > 0.0f; ++axis)
+			cluster.sortKey += (cluster.centroid[axis] - meshCentroid[axis]) * cluster.normal[axis] / length;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	uint32_t write = 0;
+	for (const Cluster& cluster : sorted)
+	{
+		for (uint32_t i = cluster.begin; i < cluster.end; ++i)
+			a_pDestination[write++] = cacheOrder[i];
+	}
+}
+
+uint32_t OptimizeVertexFetch(void* a_pDestination, uint32_t* a_pIndices, uint32_t a_uIndexCount, const void* a_pVertices, uint32_t a_uVertexCount, uint32_t a_uVertexSize)
+{
+	LOG_IF(a_pDestination != a_pVertices, LogSeverity::ERR, "OptimizeVertexFetch can not reorder vertices in place");
+
+	std::vector<uint32_t> remap(a_uVertexCount, (uint32_t)-1);
+	uint32_t vertexCount = 0;
+	for (uint32_t i = 0; i < a_uIndexCount; ++i)
+	{
+		uint32_t& newIndex = remap[a_pIndices[i]];
+		if (newIndex == (uint32_t)-1)
+		{
+			newIndex = vertexCount++;
+			memcpy((uint8_t*)a_pDestination + (size_t)newIndex * a_uVertexSize, (const uint8_t*)a_pVertices + (size_t)a_pIndices[i] * a_uVertexSize, a_uVertexSize);
+		}
+		a_pIndices[i] = newIndex;
+	}
+	return vertexCount;
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uVertexCount, uint32_t a_uCacheSize)
+{
+	// FIFO cache, a vertex is a hit while fewer than a_uCacheSize misses happened since it was loaded
+	std::vector<uint32_t> loadedAt(a_uVertexCount, 0);
+	std::vector<uint8_t> used(a_uVertexCount, 0);
+	uint32_t misses = 0;
+	uint32_t usedCount = 0;
+	for (uint32_t i = 0; i < a_uIndexCount; ++i)
+	{
+		const uint32_t vertex = a_pIndices[i];
+		if (!used[vertex])
+		{
+			used[vertex] = 1;
+			++usedCount;
+		}
+		if (loadedAt[vertex] == 0 || misses + 1 - loadedAt[vertex] > a_uCacheSize)
+			loadedAt[vertex] = ++misses;
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = a_uIndexCount ? (float)misses / (float)(a_uIndexCount / 3) : 0.0f;
+	stats.atvr = usedCount ? (float)misses / (float)usedCount : 0.0f;
+	return stats;
+}
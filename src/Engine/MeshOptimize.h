@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Index and vertex reordering for faster drawing: duplicate vertices are merged, triangles are ordered
+// for the post transform vertex cache (Tipsify) and then outside in against overdraw, and vertices are
+// laid out in the order the indices first use them.
+
+// simulated FIFO cache size, close to what current GPUs reuse
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats
+{
+	// transformed vertices per triangle, 0.5 is the best a large mesh can do and 3 the worst
+	float acmr;
+	// transformed vertices per vertex, 1 is ideal
+	float atvr;
+};
+
+// a_pRemap[v] gets the new index of vertex v with equal vertices sharing one, returns the unique vertex count.
+// vertices are a_uVertexSize bytes each and compared bitwise
+uint32_t GenerateVertexRemap(uint32_t* a_pRemap, const void* a_pVertices, uint32_t a_uVertexCount, uint32_t a_uVertexSize);
+// Tipsify, a_pDestination may be a_pIndices
+void OptimizeVertexCache(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uVertexCount);
+// vertex cache order first, then its clusters sorted so triangles facing away from the mesh center come first.
+// positions are three floats every a_uStride bytes, a_pDestination may be a_pIndices
+void OptimizeOverdraw(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, const float* a_pPositions, uint32_t a_uVertexCount, uint32_t a_uStride);
+// copies the used vertices to a_pDestination in first use order and rewrites a_pIndices, returns the vertex count written
+uint32_t OptimizeVertexFetch(void* a_pDestination, uint32_t* a_pIndices, uint32_t a_uIndexCount, const void* a_pVertices, uint32_t a_uVertexCount, uint32_t a_uVertexSize);
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* a_pIndices, uint32_t a_uIndexCount, uint32_t a_uVertexCount, uint32_t a_uCacheSize = VERTEX_CACHE_SIZE);
@@ -0,0 +1,322 @@
+#include "MeshSimplify.h"
+#include "Log.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// every pass collapses a set of independent edges, then the index list is rebuilt
+#define MAX_SIMPLIFY_PASSES 32
+// border planes count this much more than surface planes, outlines of open meshes hold their shape
+#define BORDER_QUADRIC_WEIGHT 10.0
+
+// symmetric 4x4 matrix summing squared distances to triangle planes, weighted by triangle area
+struct Quadric
+{
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+	double weight;
+};
+
+// moves every vertex of one welded position onto a neighbouring welded position
+struct Collapse
+{
+	uint32_t	from;
+	uint32_t	to;
+	// one vertex of the target, its position is where the surface ends up
+	uint32_t	toVertex;
+	double		cost;
+};
+
+static void AddQuadric(Quadric& a_Destination, const Quadric& a_Source)
+{
+	double* pDestination = &a_Destination.xx;
+	const double* pSource = &a_Source.xx;
+	for (uint32_t i = 0; i < sizeof(Quadric) / sizeof(double); ++i)
+		pDestination[i] += pSource[i];
+}
+
+// mean squared distance of the point to the planes
+static double EvaluateQuadric(const Quadric& q, const float* p)
+{
+	const double x = p[0], y = p[1], z = p[2];
+	const double error =
+		q.xx * x * x + 2.0 * q.xy * x * y + 2.0 * q.xz * x * z + 2.0 * q.xw * x +
+		q.yy * y * y + 2.0 * q.yz * y * z + 2.0 * q.yw * y +
+		q.zz * z * z + 2.0 * q.zw * z + q.ww;
+	return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+}
+
+static void TriangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+{
+	const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+// triangles per welded edge, 1 is an open border and more than 2 a non manifold edge
+static void CountEdges(const std::vector<uint32_t>& a_Indices, const std::vector<uint32_t>& a_Weld, std::unordered_map<uint64_t, uint32_t>* a_pEdgeUse)
+{
+	a_pEdgeUse->clear();
+	for (uint32_t i = 0; i < (uint32_t)a_Indices.size(); i += 3)
+	{
+		for (uint32_t e = 0; e < 3; ++e)
+			++(*a_pEdgeUse)[EdgeKey(a_Weld[a_Indices[i + e]], a_Weld[a_Indices[i + (e + 1) % 3]])];
+	}
+}
+
+static Quadric PlaneQuadric(double a, double b, double c, double d, double weight)
+{
+	const Quadric plane = { a * a * weight, a * b * weight, a * c * weight, a * d * weight, b * b * weight, b * c * weight, b * d * weight, c * c * weight, c * d * weight, d * d * weight, weight };
+	return plane;
+}
+
+uint32_t SimplifyMesh(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, const float* a_pPositions, uint32_t a_uVertexCount, uint32_t a_uStride,
+	uint32_t a_uTargetIndexCount, float a_fMaxError, float* a_pResultError)
+{
+	LOG_IF(a_pDestination && a_pIndices && a_pPositions, LogSeverity::ERR, "SimplifyMesh called without destination, indices or positions");
+	LOG_IF(a_uIndexCount % 3 == 0, LogSeverity::ERR, "index count %u is not a triangle list", a_uIndexCount);
+
+	std::vector<float> positions(a_uVertexCount * 3);
+	for (uint32_t v = 0; v < a_uVertexCount; ++v)
+		memcpy(&positions[v * 3], (const uint8_t*)a_pPositions + (size_t)v * a_uStride, sizeof(float) * 3);
+
+	// vertices at the same position share one welded id, seams are welded ids with several vertices.
+	// the vertices of welded id w are weldVertices[weldOffsets[w]] up to weldOffsets[w + 1]
+	std::vector<uint32_t> weld(a_uVertexCount);
+	std::vector<uint32_t> weldVertices(a_uVertexCount);
+	std::vector<uint32_t> weldOffsets;
+	{
+		for (uint32_t v = 0; v < a_uVertexCount; ++v)
+			weldVertices[v] = v;
+		// bitwise compare, equal positions end up next to each other
+		const float* pPositions = positions.data();
+		std::sort(weldVertices.begin(), weldVertices.end(), [pPositions](uint32_t a, uint32_t b) { return memcmp(pPositions + a * 3, pPositions + b * 3, sizeof(float) * 3) < 0; });
+		for (uint32_t i = 0; i < a_uVertexCount; ++i)
+		{
+			if (i == 0 || memcmp(pPositions + weldVertices[i] * 3, pPositions + weldVertices[i - 1] * 3, sizeof(float) * 3) != 0)
+				weldOffsets.push_back(i);
+			weld[weldVertices[i]] = (uint32_t)weldOffsets.size() - 1;
+		}
+		weldOffsets.push_back(a_uVertexCount);
+	}
+	const uint32_t weldCount = (uint32_t)weldOffsets.size() - 1;
+
+	std::vector<uint32_t> indices(a_pIndices, a_pIndices + a_uIndexCount);
+	std::unordered_map<uint64_t, uint32_t> edgeUse;
+	edgeUse.reserve(a_uIndexCount);
+	CountEdges(indices, weld, &edgeUse);
+
+	// positions on non manifold edges never move
+	std::vector<uint8_t> lockedWeld(weldCount, 0);
+	for (const std::pair<const uint64_t, uint32_t>& edge : edgeUse)
+	{
+		if (edge.second > 2)
+			lockedWeld[(uint32_t)(edge.first >> 32)] = lockedWeld[(uint32_t)(edge.first & 0xFFFFFFFF)] = 1;
+	}
+
+	std::vector<Quadric> quadrics(weldCount);
+	memset(quadrics.data(), 0, sizeof(Quadric) * weldCount);
+	for (uint32_t i = 0; i < a_uIndexCount; i += 3)
+	{
+		const float* p0 = &positions[a_pIndices[i] * 3];
+		float n[3];
+		TriangleNormal(p0, &positions[a_pIndices[i + 1] * 3], &positions[a_pIndices[i + 2] * 3], n);
+		const double length = sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+
+		const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+		const Quadric plane = PlaneQuadric(a, b, c, -(a * p0[0] + b * p0[1] + c * p0[2]), length * 0.5);
+		for (uint32_t corner = 0; corner < 3; ++corner)
+			AddQuadric(quadrics[weld[a_pIndices[i + corner]]], plane);
+
+		// a plane through every border edge, perpendicular to the triangle
+		for (uint32_t e = 0; e < 3; ++e)
+		{
+			const uint32_t from = a_pIndices[i + e], to = a_pIndices[i + (e + 1) % 3];
+			if (edgeUse[EdgeKey(weld[from], weld[to])] != 1)
+				continue;
+
+			const double edge[3] = { positions[to * 3] - positions[from * 3], positions[to * 3 + 1] - positions[from * 3 + 1], positions[to * 3 + 2] - positions[from * 3 + 2] };
+			double normal[3] = { edge[1] * c - edge[2] * b, edge[2] * a - edge[0] * c, edge[0] * b - edge[1] * a };
+			const double normalLength = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (normalLength <= 0.0)
+				continue;
+			normal[0] /= normalLength;
+			normal[1] /= normalLength;
+			normal[2] /= normalLength;
+
+			const float* pFrom = &positions[from * 3];
+			const double edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+			const Quadric border = PlaneQuadric(normal[0], normal[1], normal[2], -(normal[0] * pFrom[0] + normal[1] * pFrom[1] + normal[2] * pFrom[2]), edgeLengthSquared * BORDER_QUADRIC_WEIGHT);
+			AddQuadric(quadrics[weld[from]], border);
+			AddQuadric(quadrics[weld[to]], border);
+		}
+	}
+
+	std::vector<uint8_t> borderWeld(weldCount);
+	std::vector<uint32_t> collapseTo(a_uVertexCount);
+	std::vector<uint8_t> touched(weldCount);
+	std::vector<uint32_t> triangleOffsets(a_uVertexCount + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> collapses;
+	// source and target vertex pairs of the collapse being checked
+	std::vector<uint32_t> wedgeTargets;
+	const double maxErrorSquared = (double)a_fMaxError * a_fMaxError;
+	double resultError = 0.0;
+
+	for (uint32_t pass = 0; pass < MAX_SIMPLIFY_PASSES && indices.size() > a_uTargetIndexCount; ++pass)
+	{
+		const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+
+		// triangles around every vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : indices)
+			++triangleOffsets[index + 1];
+		for (uint32_t v = 0; v < a_uVertexCount; ++v)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		vertexTriangles.resize(indices.size());
+		{
+			std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (uint32_t i = 0; i < (uint32_t)indices.size(); ++i)
+				vertexTriangles[fill[indices[i]]++] = i / 3;
+		}
+
+		// border positions may only slide along the border
+		if (pass > 0)
+			CountEdges(indices, weld, &edgeUse);
+		std::fill(borderWeld.begin(), borderWeld.end(), 0);
+		for (const std::pair<const uint64_t, uint32_t>& edge : edgeUse)
+		{
+			if (edge.second == 1)
+				borderWeld[(uint32_t)(edge.first >> 32)] = borderWeld[(uint32_t)(edge.first & 0xFFFFFFFF)] = 1;
+		}
+
+		// moving a position onto its neighbour costs the error of both quadrics at the neighbour
+		collapses.clear();
+		for (uint32_t i = 0; i < (uint32_t)indices.size(); i += 3)
+		{
+			for (uint32_t e = 0; e < 6; ++e)
+			{
+				const uint32_t from = weld[indices[i + e % 3]];
+				const uint32_t toVertex = indices[i + (e < 3 ? (e + 1) % 3 : (e + 2) % 3)];
+				if (lockedWeld[from] || from == weld[toVertex])
+					continue;
+				if (borderWeld[from] && edgeUse[EdgeKey(from, weld[toVertex])] != 1)
+					continue;
+
+				Quadric quadric = quadrics[from];
+				AddQuadric(quadric, quadrics[weld[toVertex]]);
+				const Collapse collapse = { from, weld[toVertex], toVertex, EvaluateQuadric(quadric, &positions[toVertex * 3]) };
+				collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (uint32_t v = 0; v < a_uVertexCount; ++v)
+			collapseTo[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		uint32_t removedTriangles = 0;
+		uint32_t collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxErrorSquared || (triangleCount - removedTriangles) * 3 <= a_uTargetIndexCount)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// each vertex of the source moves to the target vertex it shares a triangle with, so attributes stay
+			// on their side of a seam. a vertex without one would tear the seam open, as would a flipped triangle
+			bool valid = true;
+			uint32_t degenerate = 0;
+			wedgeTargets.clear();
+			for (uint32_t w = weldOffsets[collapse.from]; w < weldOffsets[collapse.from + 1] && valid; ++w)
+			{
+				const uint32_t vertex = weldVertices[w];
+				uint32_t target = (uint32_t)-1;
+				for (uint32_t t = triangleOffsets[vertex]; t < triangleOffsets[vertex + 1] && valid; ++t)
+				{
+					const uint32_t* pTriangle = &indices[vertexTriangles[t] * 3];
+					bool sharesTarget = false;
+					for (uint32_t corner = 0; corner < 3; ++corner)
+					{
+						if (weld[pTriangle[corner]] == collapse.to)
+						{
+							target = pTriangle[corner];
+							sharesTarget = true;
+						}
+					}
+					if (sharesTarget)
+					{
+						++degenerate;
+						continue;
+					}
+
+					const float* corners[3];
+					for (uint32_t corner = 0; corner < 3; ++corner)
+						corners[corner] = &positions[pTriangle[corner] * 3];
+					float before[3], after[3];
+					TriangleNormal(corners[0], corners[1], corners[2], before);
+					for (uint32_t corner = 0; corner < 3; ++corner)
+						corners[corner] = pTriangle[corner] == vertex ? &positions[collapse.toVertex * 3] : corners[corner];
+					TriangleNormal(corners[0], corners[1], corners[2], after);
+					valid = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] > 0.0f;
+				}
+				if (triangleOffsets[vertex] == triangleOffsets[vertex + 1])
+					continue;
+				valid = valid && target != (uint32_t)-1;
+				wedgeTargets.push_back(vertex);
+				wedgeTargets.push_back(target);
+			}
+			if (!valid)
+				continue;
+
+			// every position around the collapse is left alone for the rest of the pass
+			for (uint32_t i = 0; i < (uint32_t)wedgeTargets.size(); i += 2)
+			{
+				const uint32_t vertex = wedgeTargets[i];
+				for (uint32_t t = triangleOffsets[vertex]; t < triangleOffsets[vertex + 1]; ++t)
+				{
+					const uint32_t* pTriangle = &indices[vertexTriangles[t] * 3];
+					touched[weld[pTriangle[0]]] = touched[weld[pTriangle[1]]] = touched[weld[pTriangle[2]]] = 1;
+				}
+				collapseTo[vertex] = wedgeTargets[i + 1];
+			}
+
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			resultError = std::max(resultError, collapse.cost);
+			removedTriangles += degenerate;
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		uint32_t write = 0;
+		for (uint32_t i = 0; i < (uint32_t)indices.size(); i += 3)
+		{
+			const uint32_t a = collapseTo[indices[i]], b = collapseTo[indices[i + 1]], c = collapseTo[indices[i + 2]];
+			if (weld[a] == weld[b] || weld[b] == weld[c] || weld[c] == weld[a])
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	if (a_pResultError)
+		*a_pResultError = (float)sqrt(resultError);
+	memcpy(a_pDestination, indices.data(), sizeof(uint32_t) * indices.size());
+	return (uint32_t)indices.size();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// Quadric error metric edge collapse simplifier. A collapse replaces a vertex with one of its
+// neighbours instead of creating a new one, so the result is an index list into the same vertices.
+// Vertices at the same position (uv and normal seams) move together and each keeps to its side of
+// the seam, vertices on open borders only slide along the border.
+
+// a_pPositions holds a_uVertexCount positions, three floats every a_uStride bytes, indexed by a_pIndices.
+// stops once a_uTargetIndexCount is reached or when the next collapse would move the surface further
+// than a_fMaxError, in the units of the positions. a_pDestination needs room for a_uIndexCount indices.
+// returns the index count written, a_pResultError gets the largest error of the collapses done
+uint32_t SimplifyMesh(uint32_t* a_pDestination, const uint32_t* a_pIndices, uint32_t a_uIndexCount, const float* a_pPositions, uint32_t a_uVertexCount, uint32_t a_uStride,
+	uint32_t a_uTargetIndexCount, float a_fMaxError, float* a_pResultError = nullptr);
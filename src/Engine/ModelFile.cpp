@@ -0,0 +1,181 @@
+#include "ModelFile.h"
+#include "FileSystem.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define MODEL_FILE_ALIGNMENT 16
+
+static const char modelFileMagic[4] = { 'A', 'M', 'D', 'L' };
+
+// the json of a .gltf file, or the json chunk of a .glb
+static void GetGltfJson(const char* a_pData, uint64_t a_uSize, const char** a_ppJson, uint64_t* a_pJsonSize)
+{
+	*a_ppJson = a_pData;
+	*a_pJsonSize = a_uSize;
+	if (a_uSize < 20 || memcmp(a_pData, "glTF", 4) != 0)
+		return;
+
+	uint32_t chunkSize = 0;
+	memcpy(&chunkSize, a_pData + 12, sizeof(chunkSize));
+	*a_ppJson = a_pData + 20;
+	*a_pJsonSize = chunkSize < a_uSize - 20 ? chunkSize : a_uSize - 20;
+}
+
+// every "uri" key of the json, the ones of buffers and images. a string value can't hold the key unescaped.
+// external files add their uri and size, data uris are part of the json already. nothing else is known alike about a
+// loose file, a file of a mounted archive and a packaged asset, the key has to match for all of them
+static uint64_t HashGltfUris(uint64_t a_uHash, const char* a_pJson, uint64_t a_uSize, const std::string& a_sDirectory)
+{
+	static const char uriKey[] = "\"uri\"";
+	const char* pEnd = a_pJson + a_uSize;
+	const char* pKey = a_pJson;
+	while ((pKey = std::search(pKey, pEnd, uriKey, uriKey + sizeof(uriKey) - 1)) != pEnd)
+	{
+		const char* c = pKey + sizeof(uriKey) - 1;
+		pKey = c;
+		while (c < pEnd && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n'))
+			++c;
+		if (c == pEnd || *c != ':')
+			continue;
+		++c;
+		while (c < pEnd && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n'))
+			++c;
+		if (c == pEnd || *c != '"')
+			continue;
+
+		// the loader appends the uri to the directory as it is, only escapes like \/ are undone
+		std::string uri;
+		for (++c; c < pEnd && *c != '"'; ++c)
+		{
+			if (*c == '\\' && c + 1 < pEnd)
+				++c;
+			uri += *c;
+		}
+		if (uri.compare(0, 5, "data:") == 0)
+			continue;
+
+		uint64_t size = 0;
+		GetFileSize((a_sDirectory + uri).c_str(), &size);
+		a_uHash = HashFnv1a64(uri.c_str(), uri.size() + 1, a_uHash);
+		a_uHash = HashFnv1a64(&size, sizeof(size), a_uHash);
+	}
+	return a_uHash;
+}
+
+std::string GetModelFilePath(const std::string& a_sSourcePath)
+{
+	const size_t slash = a_sSourcePath.find_last_of("/\\");
+	const size_t dot = a_sSourcePath.rfind('.');
+	const std::string stem = (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? a_sSourcePath : a_sSourcePath.substr(0, dot);
+	return stem + MODEL_FILE_EXTENSION;
+}
+
+uint64_t ComputeModelFileKey(const char* a_sSourcePath, const void* a_pOptions, uint32_t a_uOptionsSize)
+{
+	LOG_IF(a_sSourcePath, LogSeverity::ERR, "a_sSourcePath is NULL");
+
+	if (!ExistFile(a_sSourcePath))
+		return 0;
+	FileHandle file = FileOpen(a_sSourcePath, "rb");
+	if (!file)
+		return 0;
+
+	uint64_t size = FileSize(file);
+	char* buffer = (char*)malloc(size ? (size_t)size : 1);
+	size = FileRead(file, &buffer, size);
+	FileClose(file);
+
+	const uint32_t version = MODEL_FILE_VERSION;
+	uint64_t hash = HashFnv1a64(&version, sizeof(version));
+	hash = HashFnv1a64(a_pOptions, a_uOptionsSize, hash);
+	hash = HashFnv1a64(buffer, (size_t)size, hash);
+
+	const char* pJson = nullptr;
+	uint64_t jsonSize = 0;
+	GetGltfJson(buffer, size, &pJson, &jsonSize);
+	const std::string sourcePath = a_sSourcePath;
+	hash = HashGltfUris(hash, pJson, jsonSize, sourcePath.substr(0, sourcePath.find_last_of("/\\") + 1));
+	free(buffer);
+
+	// 0 means no key
+	return hash ? hash : 1;
+}
+
+bool ReadModelFile(const void* a_pData, uint64_t a_uSize, uint64_t a_uKey, ModelFile* a_pFile)
+{
+	if (a_uSize < sizeof(ModelFileHeader) || ((uintptr_t)a_pData % MODEL_FILE_ALIGNMENT) != 0)
+		return false;
+
+	const ModelFileHeader* pHeader = (const ModelFileHeader*)a_pData;
+	if (memcmp(pHeader->magic, modelFileMagic, sizeof(modelFileMagic)) != 0 || pHeader->version != MODEL_FILE_VERSION || pHeader->key != a_uKey)
+		return false;
+
+	for (const ModelFileSection& section : pHeader->sections)
+	{
+		const uint64_t sectionSize = (uint64_t)section.count * section.elementSize;
+		if ((section.offset % MODEL_FILE_ALIGNMENT) != 0 || section.offset > a_uSize || sectionSize > a_uSize - section.offset)
+			return false;
+	}
+
+	a_pFile->pData = (const uint8_t*)a_pData;
+	a_pFile->size = a_uSize;
+	a_pFile->pHeader = pHeader;
+	return true;
+}
+
+const void* GetModelFileSection(const ModelFile* a_pFile, ModelFileSectionType a_eType, uint32_t a_uElementSize, uint32_t* a_pCount)
+{
+	const ModelFileSection& section = a_pFile->pHeader->sections[(uint32_t)a_eType];
+	*a_pCount = 0;
+	if (section.count == 0)
+		return nullptr;
+
+	LOG_IF(section.elementSize == a_uElementSize, LogSeverity::WARNING, "Model file section %u has %u byte records, expected %u",
+		(uint32_t)a_eType, section.elementSize, a_uElementSize);
+	if (section.elementSize != a_uElementSize)
+		return nullptr;
+
+	*a_pCount = section.count;
+	return a_pFile->pData + section.offset;
+}
+
+void InitModelFileWriter(ModelFileWriter* a_pWriter, uint64_t a_uKey)
+{
+	static_assert((sizeof(ModelFileHeader) % MODEL_FILE_ALIGNMENT) == 0, "sections have to start aligned");
+
+	a_pWriter->header = {};
+	memcpy(a_pWriter->header.magic, modelFileMagic, sizeof(modelFileMagic));
+	a_pWriter->header.version = MODEL_FILE_VERSION;
+	a_pWriter->header.key = a_uKey;
+	a_pWriter->data.assign(sizeof(ModelFileHeader), 0);
+}
+
+void SetModelFileSection(ModelFileWriter* a_pWriter, ModelFileSectionType a_eType, const void* a_pRecords, uint32_t a_uCount, uint32_t a_uElementSize)
+{
+	std::vector<uint8_t>& data = a_pWriter->data;
+	data.resize((data.size() + MODEL_FILE_ALIGNMENT - 1) & ~(size_t)(MODEL_FILE_ALIGNMENT - 1), 0);
+
+	ModelFileSection& section = a_pWriter->header.sections[(uint32_t)a_eType];
+	section.offset = data.size();
+	section.count = a_uCount;
+	section.elementSize = a_uElementSize;
+	if (a_uCount)
+		data.insert(data.end(), (const uint8_t*)a_pRecords, (const uint8_t*)a_pRecords + (size_t)a_uCount * a_uElementSize);
+}
+
+ModelFileString AddModelFileString(std::vector<char>& a_Strings, const std::string& a_sString)
+{
+	ModelFileString string = { (uint32_t)a_Strings.size(), (uint32_t)a_sString.size() };
+	a_Strings.insert(a_Strings.end(), a_sString.begin(), a_sString.end());
+	return string;
+}
+
+const std::vector<uint8_t>& FinishModelFile(ModelFileWriter* a_pWriter)
+{
+	memcpy(a_pWriter->data.data(), &a_pWriter->header, sizeof(ModelFileHeader));
+	return a_pWriter->data;
+}
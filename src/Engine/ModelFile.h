@@ -0,0 +1,233 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Cooked models, what CreateModelFromFile builds from a glTF file stored so the next load only copies it out.
+// A header with a table of sections follows the magic, every section is a flat array of fixed size records 16 byte
+// aligned in the file. Records refer to each other and to strings by index, the loader maps the file and turns
+// indices into pointers, vertex and index sections go to the staging upload as they are.
+// The layout is little endian, the byte order of every target. A cooked model sits next to its source as
+// <source name without extension>.amodel and carries a key of the source and load options, a stale one is cooked again.
+
+#define MODEL_FILE_EXTENSION ".amodel"
+// bump when a record or the way CreateModelFromFile builds a model changes
+#define MODEL_FILE_VERSION 2
+// MAX_PRIMITIVE_LODS when the file was written
+#define MODEL_FILE_MAX_LODS 4
+
+enum class ModelFileSectionType : uint32_t
+{
+	// Model::PackedVertex, Model::SkinVertex, uint32_t and glm::vec3, as uploaded
+	VERTICES,
+	SKIN_VERTICES,
+	INDICES,
+	POSITIONS,
+	NODES,
+	PRIMITIVES,
+	MATERIALS,
+	TEXTURES,
+	SAMPLERS,
+	SKINS,
+	// uint32_t node indices and glm::mat4, ranges of them per skin
+	JOINTS,
+	INVERSE_BIND_MATRICES,
+	ANIMATIONS,
+	ANIMATION_SAMPLERS,
+	ANIMATION_CHANNELS,
+	// float times, glm::vec4 values and uint16_t packed keys, ranges of them per animation sampler
+	ANIMATION_INPUTS,
+	ANIMATION_OUTPUTS,
+	ANIMATION_PACKED_OUTPUTS,
+	// ModelFileString, the glTF extensions used
+	EXTENSIONS,
+	// chars of every string, not terminated
+	STRINGS,
+	// RGBA8 pixels of images embedded in the glTF file
+	IMAGE_DATA,
+	COUNT
+};
+
+struct ModelFileSection
+{
+	// from the start of the file
+	uint64_t offset;
+	uint32_t count;
+	uint32_t elementSize;
+};
+
+struct ModelFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	ModelFileSection sections[(uint32_t)ModelFileSectionType::COUNT];
+};
+
+struct ModelFileString
+{
+	uint32_t offset;
+	uint32_t length;
+};
+
+// Node, in Model::linearNodes order, a parent comes after its children
+struct ModelFileNode
+{
+	// -1 for root nodes
+	int32_t parent;
+	uint32_t index;
+	int32_t skinIndex;
+	ModelFileString name;
+	float translation[3];
+	float scale[3];
+	float rotation[4];
+	float matrix[16];
+	// -1 for nodes without a mesh
+	int32_t firstPrimitive;
+	uint32_t primitiveCount;
+	uint32_t meshBoundsValid;
+	float meshMin[3];
+	float meshMax[3];
+};
+
+struct ModelFilePrimitive
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+	uint32_t firstVertex;
+	uint32_t material;
+	uint32_t hasIndices;
+	uint32_t boundsValid;
+	float min[3];
+	float max[3];
+	uint32_t lodCount;
+	// PrimitiveLod
+	uint32_t lodFirstIndex[MODEL_FILE_MAX_LODS];
+	uint32_t lodIndexCount[MODEL_FILE_MAX_LODS];
+	float lodError[MODEL_FILE_MAX_LODS];
+};
+
+// texture indices are -1 for no texture
+struct ModelFileMaterial
+{
+	uint32_t alphaMode;
+	float alphaCutoff;
+	float metallicFactor;
+	float roughnessFactor;
+	float baseColorFactor[4];
+	float emissiveFactor[4];
+	float diffuseFactor[4];
+	float specularFactor[3];
+	int32_t baseColorTexture;
+	int32_t metallicRoughnessTexture;
+	int32_t normalTexture;
+	int32_t occlusionTexture;
+	int32_t emissiveTexture;
+	int32_t specularGlossinessTexture;
+	int32_t diffuseTexture;
+	uint8_t texCoordSets[6];
+	uint8_t metallicRoughness;
+	uint8_t specularGlossiness;
+};
+
+// images with a uri load from the file next to the model, embedded ones from IMAGE_DATA
+struct ModelFileTexture
+{
+	// -1 for the default sampler
+	int32_t sampler;
+	ModelFileString uri;
+	uint32_t width;
+	uint32_t height;
+	// bytes in IMAGE_DATA
+	uint64_t pixelOffset;
+	uint64_t pixelSize;
+};
+
+// the VkFilter, VkSamplerAddressMode and VkSamplerMipmapMode values
+struct ModelFileSampler
+{
+	uint32_t minFilter;
+	uint32_t magFilter;
+	uint32_t addressModeU;
+	uint32_t addressModeV;
+	uint32_t addressModeW;
+	uint32_t mipMapMode;
+};
+
+struct ModelFileSkin
+{
+	ModelFileString name;
+	// -1 without one
+	int32_t skeletonRoot;
+	uint32_t firstJoint;
+	uint32_t jointCount;
+	uint32_t firstInverseBindMatrix;
+	uint32_t inverseBindMatrixCount;
+};
+
+struct ModelFileAnimation
+{
+	ModelFileString name;
+	float start;
+	float end;
+	uint32_t firstSampler;
+	uint32_t samplerCount;
+	uint32_t firstChannel;
+	uint32_t channelCount;
+};
+
+struct ModelFileAnimationSampler
+{
+	uint32_t interpolation;
+	uint32_t firstInput;
+	uint32_t inputCount;
+	uint32_t firstOutput;
+	uint32_t outputCount;
+	// AnimationCompression.h, empty for samplers with glm::vec4 values
+	uint32_t firstPackedOutput;
+	uint32_t packedOutputCount;
+	uint32_t packedType;
+	float packedMin[3];
+	float packedExtent[3];
+};
+
+struct ModelFileAnimationChannel
+{
+	uint32_t path;
+	uint32_t node;
+	uint32_t samplerIndex;
+};
+
+// a validated file, the sections point into its data
+struct ModelFile
+{
+	const uint8_t* pData;
+	uint64_t size;
+	const ModelFileHeader* pHeader;
+};
+
+std::string GetModelFilePath(const std::string& a_sSourcePath);
+// hash of the source file, a_pOptions and MODEL_FILE_VERSION, 0 when the source can't be read. buffers and images the
+// source refers to by uri add their uri and size, not their contents
+uint64_t ComputeModelFileKey(const char* a_sSourcePath, const void* a_pOptions, uint32_t a_uOptionsSize);
+
+// false for a file of another version or key, or one with a section out of bounds
+bool ReadModelFile(const void* a_pData, uint64_t a_uSize, uint64_t a_uKey, ModelFile* a_pFile);
+// the records of a section, nullptr when it is empty or its records aren't a_uElementSize bytes
+const void* GetModelFileSection(const ModelFile* a_pFile, ModelFileSectionType a_eType, uint32_t a_uElementSize, uint32_t* a_pCount);
+
+// builds a file in memory, sections can be set in any order
+struct ModelFileWriter
+{
+	ModelFileHeader header;
+	std::vector<uint8_t> data;
+};
+
+void InitModelFileWriter(ModelFileWriter* a_pWriter, uint64_t a_uKey);
+void SetModelFileSection(ModelFileWriter* a_pWriter, ModelFileSectionType a_eType, const void* a_pRecords, uint32_t a_uCount, uint32_t a_uElementSize);
+// appends a_sString to the chars of a STRINGS section
+ModelFileString AddModelFileString(std::vector<char>& a_Strings, const std::string& a_sString);
+// returns the whole file
+const std::vector<uint8_t>& FinishModelFile(ModelFileWriter* a_pWriter);
@@ -11,6 +11,7 @@
 #include "../../include/glm/gtx/string_cast.hpp"
 
 #include "../../include/tinygltf/tiny_gltf.h"
+#include "AnimationCompression.h"
 
 struct Node;
 struct Texture;
@@ -18,8 +19,13 @@ struct Sampler;
 struct Buffer;
 struct DescriptorSet;
 struct Renderer;
+struct ModelUpload;
 
 #define MAX_NUM_JOINTS 128u
+// source mesh plus simplified versions
+#define MAX_PRIMITIVE_LODS 4
+// keys an AnimationCursor moves before a lookup binary searches instead
+#define ANIMATION_CURSOR_STEPS 4
 
 struct BoundingBox
 {
@@ -79,15 +85,30 @@ struct Material
 
 	DescriptorSet* descriptorSet = nullptr;
 	uint32_t indexInDescriptorSet = 0;
+	// slots in the bindless texture array, same order as the material set bindings
+	uint32_t textureIndices[5] = {};
+};
+
+// index range of one detail level in the model index buffer
+struct PrimitiveLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// largest surface deviation from the source mesh, relative to the primitive's bounding box diagonal
+	float error;
 };
 
 struct Primitive {
 	uint32_t firstIndex;
 	uint32_t indexCount;
 	uint32_t vertexCount;
+	// offset of the primitive's vertices in the model vertex buffer
+	uint32_t firstVertex = 0;
 	Material& material;
 	bool hasIndices;
 	BoundingBox bb;
+	// lod 0 is firstIndex and indexCount, later ones index the same vertices with fewer triangles
+	PrimitiveLod lods[MAX_PRIMITIVE_LODS]{};
+	uint32_t lodCount = 1;
 
 	Primitive(uint32_t a_uFirstIndex, uint32_t a_uIndexCount, uint32_t a_uVertexCount, Material& a_Material);
 	void setBoundingBox(glm::vec3 a_vMin, glm::vec3 a_vMax);
@@ -104,13 +125,23 @@ struct Mesh {
 
 	struct UniformBlock {
 		glm::mat4 matrix;
-		glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
+		// inverse transpose of matrix, vertex shaders transform normals without an inverse per vertex
+		glm::mat4 normalMatrix;
 		float jointcount{ 0 };
 	} uniformBlock;
 
+	// skinned meshes only, joint palette of the last Node::update. copied out per entity before the next one is posed
+	struct SkinPalette {
+		glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
+		// inverse transposes of jointMatrix
+		glm::mat4 jointNormalMatrix[MAX_NUM_JOINTS]{};
+	};
+	SkinPalette* pSkinPalette = nullptr;
+
 	Mesh(Renderer* a_pRenderer, glm::mat4 a_mMatrix);
 	~Mesh();
 	void setBoundingBox(glm::vec3 a_vMin, glm::vec3 a_vMax);
+	void createSkinPalette();
 };
 
 struct Skin {
@@ -153,7 +184,12 @@ struct AnimationSampler
 	enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 	InterpolationType interpolation;
 	std::vector<float> inputs;
+	// values of samplers left uncompressed, cubic splines and the ones no channel uses
 	std::vector<glm::vec4> outputsVec4;
+	// ANIMATION_PACKED_KEY_SIZE values per input of compressed samplers, see AnimationCompression.h
+	std::vector<uint16_t> outputsPacked;
+	AnimationTrackType packedType;
+	AnimationTrackRange packedRange;
 };
 
 struct Animation
@@ -179,8 +215,30 @@ struct Model
 		glm::vec4 weight0;
 	};
 
+	// layout of vertices on the GPU, packed from Vertex at load
+	struct PackedVertex
+	{
+		glm::vec3 pos;
+		// octahedral encoded, two snorm16
+		uint32_t normal;
+		// two half floats each
+		uint32_t uv0;
+		uint32_t uv1;
+	};
+
+	// joints and weights of skinned models, only read by the skinning compute pass
+	struct SkinVertex
+	{
+		// four uint8 joint indices
+		uint32_t joints;
+		// four unorm8 weights
+		uint32_t weights;
+	};
+
 	Buffer* vertices = nullptr;
 	Buffer* indices = nullptr;
+	// models with skins, one SkinVertex per vertex
+	Buffer* skinVertices = nullptr;
 
 	glm::mat4 aabb;
 
@@ -194,7 +252,36 @@ struct Model
 	std::vector<Material> materials;
 	std::vector<Animation> animations;
 	std::vector<std::string> extensions;
+	// source vertices while a model is built from glTF, empty once it is loaded
 	std::vector<Model::Vertex> vertexBuffer;
+	// kept on the CPU for colliders and occluder rasterization, in vertex buffer order
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indexBuffer;
+	// what LoadModelFromFile read for the GPU, nullptr once CreateModelResources has created all of it
+	ModelUpload* pUpload = nullptr;
+
+	// set before CreateModelFromFile, lodCount 1 keeps the source meshes only. part of the cooked model key
+	struct LodDesc
+	{
+		uint32_t lodCount = MAX_PRIMITIVE_LODS;
+		// index count of lod i + 1 relative to the source mesh
+		float targetRatios[MAX_PRIMITIVE_LODS - 1] = { 0.5f, 0.15f, 0.01f };
+		// largest error of lod i + 1 relative to the primitive's bounding box diagonal, simplification stops there
+		float maxErrors[MAX_PRIMITIVE_LODS - 1] = { 0.01f, 0.03f, 0.1f };
+		// lod i + 1 is drawn once the bounding sphere covers less than this fraction of the screen height
+		float screenSizes[MAX_PRIMITIVE_LODS - 1] = { 0.3f, 0.12f, 0.04f };
+	} lodDesc;
+
+	// set before CreateModelFromFile, part of the cooked model key. largest error of the animation keys removed on import,
+	// 0 keeps every key. keys are packed either way
+	struct AnimationDesc
+	{
+		// model units
+		float translationTolerance = 0.0005f;
+		// radians
+		float rotationTolerance = 0.001f;
+		float scaleTolerance = 0.0005f;
+	} animationDesc;
 
 	struct Dimensions
 	{
@@ -203,7 +290,20 @@ struct Model
 	} dimensions;
 };
 
+// loads the cooked copy of a glTF file when its key matches, parses the glTF file and cooks it otherwise (see ModelFile.h).
+// textures, samplers and buffers are only described, nothing is submitted to the renderer so it can run on a job.
+// false when the file can't be loaded
+bool LoadModelFromFile(Renderer* a_pRenderer, std::string a_sFilename, Model* a_pModel, float a_fScale = 1.0f);
+// creates what LoadModelFromFile described, on the thread that records frames. every texture and the buffers at the end
+// take one upload from a_pUploadBudget and the call returns when it runs out, nullptr creates everything at once.
+// true once the model can be drawn
+bool CreateModelResources(Model* a_pModel, uint32_t* a_pUploadBudget = nullptr);
+// both of the above
 void CreateModelFromFile(Renderer* a_pRenderer, std::string a_sFilename, Model* a_pModel, float a_fScale = 1.0f);
-void UpdateAnimation(uint32_t index, float time, Model* a_pModel);
-void BlendAnimation(uint32_t a_nSrcIndex, uint32_t a_nDstIndex, float a_fSrcTime, float a_fDstTime, float a_fBlendFactor, Model* a_pModel);
+// keyframe each sampler of an animation was last sampled at, one per playing animation. the next lookup steps from there,
+// a jump further than ANIMATION_CURSOR_STEPS keys falls back to a binary search. nullptr always searches
+typedef std::vector<uint32_t> AnimationCursor;
+void UpdateAnimation(uint32_t index, float time, Model* a_pModel, AnimationCursor* a_pCursor = nullptr);
+void BlendAnimation(uint32_t a_nSrcIndex, uint32_t a_nDstIndex, float a_fSrcTime, float a_fDstTime, float a_fBlendFactor, Model* a_pModel,
+	AnimationCursor* a_pSrcCursor = nullptr, AnimationCursor* a_pDstCursor = nullptr);
 void DestroyModel(Model* a_pModel);
\ No newline at end of file
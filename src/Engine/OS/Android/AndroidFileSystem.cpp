@@ -1,18 +1,34 @@
 #include "../../FileSystem.h"
+#include "../../AssetArchive.h"
 #include "../../Log.h"
 
 #include "android_native_app_glue.h"
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <android/asset_manager.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
 
 typedef void* FileHandle;
 static AAssetManager* assetManager = nullptr;
+static const char* internalDataPath = nullptr;
+
+// a FileHandle, files of mounted archives have no AAsset
+struct File
+{
+	AAsset*		pAsset;
+	ArchiveFile	archiveFile;
+};
 
 void InitFileSystem(void* a_PlatformData)
 {
 	LOG_IF(a_PlatformData, LogSeverity::ERR, "android_app* is NULL");
 	struct android_app* app = (struct android_app*)a_PlatformData;
 	assetManager = app->activity->assetManager;
+	internalDataPath = app->activity->internalDataPath;
 }
 
 FileHandle FileOpen(const char* a_sFilename, const char* a_sMode)
@@ -20,33 +36,94 @@ FileHandle FileOpen(const char* a_sFilename, const char* a_sMode)
 	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
 	LOG_IF(a_sMode, LogSeverity::ERR, "Empty File Mode");
 
-	AAsset* asset = AAssetManager_open(assetManager, a_sFilename, AASSET_MODE_BUFFER);
-	LOG_IF(asset, LogSeverity::ERR, "Could not open file %s", a_sFilename);
-	
-	return asset;
+	File* pFile = new File();
+	pFile->pAsset = nullptr;
+	pFile->archiveFile = {};
+	if (OpenArchiveFile(a_sFilename, &pFile->archiveFile))
+		return (FileHandle)pFile;
+
+	pFile->pAsset = AAssetManager_open(assetManager, a_sFilename, AASSET_MODE_BUFFER);
+	LOG_IF(pFile->pAsset, LogSeverity::ERR, "Could not open file %s", a_sFilename);
+	if (!pFile->pAsset)
+	{
+		delete pFile;
+		return nullptr;
+	}
+	return (FileHandle)pFile;
+}
+
+bool ExistFile(const char* a_sFilePath)
+{
+	LOG_IF(a_sFilePath, LogSeverity::ERR, "Empty File Name");
+
+	if (ExistArchiveFile(a_sFilePath))
+		return true;
+
+	AAsset* asset = AAssetManager_open(assetManager, a_sFilePath, AASSET_MODE_UNKNOWN);
+	if (!asset)
+		return false;
+
+	AAsset_close(asset);
+	return true;
 }
 
 void FileClose(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	AAsset_close((AAsset*)a_Handle);
+	File* pFile = (File*)a_Handle;
+	if (pFile->pAsset)
+		AAsset_close(pFile->pAsset);
+	else
+		CloseArchiveFile(&pFile->archiveFile);
+	delete pFile;
 }
 
-int FileRead(FileHandle a_Handle, char** a_ppBuffer, uint32_t a_uLength)
+uint64_t FileRead(FileHandle a_Handle, char** a_ppBuffer, uint64_t a_uLength)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
 	LOG_IF(*a_ppBuffer, LogSeverity::ERR, "Value at buffer is NULL");
 
-	AAsset* asset = (AAsset*)a_Handle;
-	return AAsset_read(asset, (*a_ppBuffer), a_uLength);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pAsset)
+		return ReadArchiveFile(&pFile->archiveFile, *a_ppBuffer, a_uLength);
+
+	// AAsset_read returns an int, larger reads take several calls
+	uint64_t bytesRead = 0;
+	while (bytesRead < a_uLength)
+	{
+		const uint64_t chunk = std::min<uint64_t>(a_uLength - bytesRead, INT32_MAX);
+		const int read = AAsset_read(pFile->pAsset, (*a_ppBuffer) + bytesRead, (size_t)chunk);
+		if (read <= 0)
+			break;
+		bytesRead += (uint64_t)read;
+	}
+	return bytesRead;
 }
 
-uint32_t FileSize(FileHandle a_Handle)
+uint64_t FileSize(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
 
-	AAsset* asset = (AAsset*)a_Handle;
-	return AAsset_getLength(asset);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pAsset)
+		return pFile->archiveFile.size;
+	return (uint64_t)AAsset_getLength64(pFile->pAsset);
+}
+
+bool GetFileSize(const char* a_sFilePath, uint64_t* a_pSize)
+{
+	LOG_IF(a_sFilePath, LogSeverity::ERR, "Empty File Name");
+
+	if (GetArchiveFileSize(a_sFilePath, a_pSize))
+		return true;
+
+	AAsset* asset = AAssetManager_open(assetManager, a_sFilePath, AASSET_MODE_UNKNOWN);
+	if (!asset)
+		return false;
+
+	*a_pSize = (uint64_t)AAsset_getLength64(asset);
+	AAsset_close(asset);
+	return true;
 }
 
 // YET TO IMPLEMENT
@@ -69,21 +146,165 @@ void FileWriteLine(FileHandle a_Handle, const char* a_sBuffer)
 }
 //
 
-long FileTell(FileHandle a_Handle)
+int64_t FileTell(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	AAsset* asset = (AAsset*)a_Handle;
-	return (AAsset_getLength(asset) - AAsset_getRemainingLength(asset));
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pAsset)
+		return (int64_t)pFile->archiveFile.position;
+	AAsset* asset = pFile->pAsset;
+	return (AAsset_getLength64(asset) - AAsset_getRemainingLength64(asset));
 }
 
-void FileSeek(FileHandle a_Handle, long a_lOffset, int a_iOrigin)
+void FileSeek(FileHandle a_Handle, int64_t a_iOffset, int a_iOrigin)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	AAsset_seek((AAsset*)a_Handle, a_lOffset, a_iOrigin);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pAsset)
+		SeekArchiveFile(&pFile->archiveFile, a_iOffset, a_iOrigin);
+	else
+		AAsset_seek64(pFile->pAsset, a_iOffset, a_iOrigin);
 }
 
 int IsEndOfFile(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	return (AAsset_getRemainingLength((AAsset*)a_Handle) > 0 ? 1 : 0);
-}
\ No newline at end of file
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pAsset)
+		return pFile->archiveFile.position >= pFile->archiveFile.size;
+	return (AAsset_getRemainingLength(pFile->pAsset) > 0 ? 1 : 0);
+}
+
+// user files live in the app's internal storage, assets are read only
+static void GetUserFilePath(const char* a_sFilename, char* a_sPath, size_t a_uPathSize)
+{
+	LOG_IF(internalDataPath, LogSeverity::ERR, "InitFileSystem was not called");
+	snprintf(a_sPath, a_uPathSize, "%s/%s", internalDataPath, a_sFilename);
+}
+
+bool ReadUserFile(const char* a_sFilename, char** a_ppBuffer, uint64_t* a_pSize)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	char path[512];
+	GetUserFilePath(a_sFilename, path, sizeof(path));
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return false;
+
+	// a file larger than size_t is read by nobody on 32 bit devices
+	struct stat status;
+	if (fstat(fileno(pFile), &status) != 0 || (uint64_t)(size_t)status.st_size != (uint64_t)status.st_size)
+	{
+		fclose(pFile);
+		return false;
+	}
+	const uint64_t size = (uint64_t)status.st_size;
+
+	char* pBuffer = (char*)malloc(size ? (size_t)size : 1);
+	bool success = pBuffer && fread(pBuffer, 1, (size_t)size, pFile) == size;
+	fclose(pFile);
+
+	if (!success)
+	{
+		free(pBuffer);
+		return false;
+	}
+	*a_ppBuffer = pBuffer;
+	*a_pSize = size;
+	return true;
+}
+
+bool WriteUserFile(const char* a_sFilename, const char* a_pBuffer, uint64_t a_uSize)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	// write next to the target and swap, the process can be killed at any time
+	char path[512], tempPath[512];
+	GetUserFilePath(a_sFilename, path, sizeof(path));
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+	FILE* pFile = fopen(tempPath, "wb");
+	if (!pFile)
+	{
+		LOG(LogSeverity::WARNING, "Could not open file %s", tempPath);
+		return false;
+	}
+	bool success = fwrite(a_pBuffer, 1, (size_t)a_uSize, pFile) == a_uSize;
+	success = (fclose(pFile) == 0) && success;
+
+	if (success)
+		success = rename(tempPath, path) == 0;
+	if (!success)
+		remove(tempPath);
+	return success;
+}
+
+bool MapFile(const char* a_sFilename, MappedFile* a_pFile)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	if (MapArchiveFile(a_sFilename, a_pFile))
+		return true;
+
+	// uncompressed assets are mapped straight from the apk, compressed ones are inflated into memory
+	AAsset* asset = AAssetManager_open(assetManager, a_sFilename, AASSET_MODE_BUFFER);
+	if (!asset)
+		return false;
+
+	const void* pData = AAsset_getBuffer(asset);
+	const off64_t size = AAsset_getLength64(asset);
+	if (!pData || size <= 0)
+	{
+		AAsset_close(asset);
+		return false;
+	}
+
+	a_pFile->pData = pData;
+	a_pFile->size = (uint64_t)size;
+	a_pFile->pHandle = asset;
+	a_pFile->archived = false;
+	return true;
+}
+
+bool MapUserFile(const char* a_sFilename, MappedFile* a_pFile)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	char path[512];
+	GetUserFilePath(a_sFilename, path, sizeof(path));
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	void* pData = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+		pData = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// the mapping keeps the file open
+	close(file);
+	if (pData == MAP_FAILED)
+		return false;
+
+	a_pFile->pData = pData;
+	a_pFile->size = (uint64_t)status.st_size;
+	a_pFile->pHandle = nullptr;
+	a_pFile->archived = false;
+	return true;
+}
+
+void UnmapFile(MappedFile* a_pFile)
+{
+	LOG_IF(a_pFile->pData, LogSeverity::ERR, "File is not mapped");
+	if (a_pFile->archived)
+	{
+		UnmapArchiveFile(a_pFile);
+		return;
+	}
+	// assets keep their AAsset, user files were mapped with mmap
+	if (a_pFile->pHandle)
+		AAsset_close((AAsset*)a_pFile->pHandle);
+	else
+		munmap((void*)a_pFile->pData, (size_t)a_pFile->size);
+	*a_pFile = {};
+}
@@ -6,8 +6,17 @@
 #include <sys/types.h>  // For stat().
 #include <sys/stat.h>   // For stat().
 #include <stdio.h>
+#include <stdlib.h>
+#include "../../AssetArchive.h"
 #include "../../Log.h"
 
+// a FileHandle, files of mounted archives have no FILE
+struct File
+{
+	FILE*		pFile;
+	ArchiveFile	archiveFile;
+};
+
 void InitFileSystem(void* a_PlatformData)
 {}
 
@@ -21,6 +30,20 @@ bool ExistDirectory(const char* a_sDirectoryPath)
 	return (status.st_mode & S_IFDIR) != 0;
 }
 
+bool ExistFile(const char* a_sFilePath)
+{
+	LOG_IF(a_sFilePath, LogSeverity::ERR, "File name empty!");
+
+	if (ExistArchiveFile(a_sFilePath))
+		return true;
+
+	struct stat status;
+	if (stat(a_sFilePath, &status) != 0)
+		return false;
+
+	return (status.st_mode & S_IFREG) != 0;
+}
+
 void CreateDirecroty(const char* a_sDirectoryName)
 {
 	LOG_IF(a_sDirectoryName, LogSeverity::ERR, "Directory name empty!");
@@ -43,56 +66,211 @@ FileHandle FileOpen(const char* a_sFilename, const char* a_sMode)
 	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
 	LOG_IF(a_sMode, LogSeverity::ERR, "Empty File Mode");
 
-	FILE* pFile = fopen(a_sFilename, a_sMode);
-	LOG_IF(pFile, LogSeverity::WARNING, "Could not open file %s", a_sFilename);
+	File* pFile = new File();
+	pFile->pFile = nullptr;
+	pFile->archiveFile = {};
+	if (a_sMode[0] == 'r' && OpenArchiveFile(a_sFilename, &pFile->archiveFile))
+		return (FileHandle)pFile;
 
+	pFile->pFile = fopen(a_sFilename, a_sMode);
+	LOG_IF(pFile->pFile, LogSeverity::WARNING, "Could not open file %s", a_sFilename);
+	if (!pFile->pFile)
+	{
+		delete pFile;
+		return nullptr;
+	}
 	return (FileHandle)pFile;
 }
 
 void FileClose(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	fclose((FILE*)a_Handle);
+	File* pFile = (File*)a_Handle;
+	if (pFile->pFile)
+		fclose(pFile->pFile);
+	else
+		CloseArchiveFile(&pFile->archiveFile);
+	delete pFile;
 }
 
-int FileRead(FileHandle a_Handle, char** a_ppBuffer, uint32_t a_uLength)
+uint64_t FileRead(FileHandle a_Handle, char** a_ppBuffer, uint64_t a_uLength)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
 	LOG_IF(*a_ppBuffer, LogSeverity::ERR, "Value at buffer is NULL");
-	return (int)fread(*a_ppBuffer, 1, a_uLength, (FILE*)a_Handle);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pFile)
+		return ReadArchiveFile(&pFile->archiveFile, *a_ppBuffer, a_uLength);
+	return (uint64_t)fread(*a_ppBuffer, 1, (size_t)a_uLength, pFile->pFile);
 }
 
-uint32_t FileSize(FileHandle a_Handle)
+uint64_t FileSize(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
 
-	FILE* pFile = (FILE*)a_Handle;
-	fseek(pFile, 0L, SEEK_END);
-	uint32_t size = ftell(pFile);
-	fseek(pFile, 0L, SEEK_SET);
-	return size;
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pFile)
+		return pFile->archiveFile.size;
+
+	// from the file system, seeking to the end and back would throw away the stream's buffer
+	struct _stat64 status;
+	if (_fstat64(_fileno(pFile->pFile), &status) != 0)
+		return 0;
+	return (uint64_t)status.st_size;
+}
+
+bool GetFileSize(const char* a_sFilePath, uint64_t* a_pSize)
+{
+	LOG_IF(a_sFilePath, LogSeverity::ERR, "File name empty!");
+
+	if (GetArchiveFileSize(a_sFilePath, a_pSize))
+		return true;
+
+	struct _stat64 status;
+	if (_stat64(a_sFilePath, &status) != 0 || (status.st_mode & S_IFREG) == 0)
+		return false;
+	*a_pSize = (uint64_t)status.st_size;
+	return true;
 }
 
 void FileWriteLine(FileHandle a_Handle, const char* a_sBuffer)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	fputs(a_sBuffer, (FILE*)a_Handle);
+	File* pFile = (File*)a_Handle;
+	LOG_IF(pFile->pFile, LogSeverity::ERR, "Files of archives are read only");
+	fputs(a_sBuffer, pFile->pFile);
 }
 
-long FileTell(FileHandle a_Handle)
+int64_t FileTell(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	return ftell((FILE*)a_Handle);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pFile)
+		return (int64_t)pFile->archiveFile.position;
+	return _ftelli64(pFile->pFile);
 }
 
-void FileSeek(FileHandle a_Handle, long a_lOffset, int a_iOrigin)
+void FileSeek(FileHandle a_Handle, int64_t a_iOffset, int a_iOrigin)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	fseek((FILE*)a_Handle, a_lOffset, a_iOrigin);
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pFile)
+		SeekArchiveFile(&pFile->archiveFile, a_iOffset, a_iOrigin);
+	else
+		_fseeki64(pFile->pFile, a_iOffset, a_iOrigin);
 }
 
 int IsEndOfFile(FileHandle a_Handle)
 {
 	LOG_IF(a_Handle, LogSeverity::ERR, "File Handle is NULL");
-	return feof((FILE*)a_Handle);
-}
\ No newline at end of file
+	File* pFile = (File*)a_Handle;
+	if (!pFile->pFile)
+		return pFile->archiveFile.position >= pFile->archiveFile.size;
+	return feof(pFile->pFile);
+}
+
+bool ReadUserFile(const char* a_sFilename, char** a_ppBuffer, uint64_t* a_pSize)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	FILE* pFile = fopen(a_sFilename, "rb");
+	if (!pFile)
+		return false;
+
+	struct _stat64 status;
+	if (_fstat64(_fileno(pFile), &status) != 0 || (uint64_t)(size_t)status.st_size != (uint64_t)status.st_size)
+	{
+		fclose(pFile);
+		return false;
+	}
+	const uint64_t size = (uint64_t)status.st_size;
+	char* pBuffer = (char*)malloc(size ? (size_t)size : 1);
+	bool success = pBuffer && fread(pBuffer, 1, (size_t)size, pFile) == size;
+	fclose(pFile);
+
+	if (!success)
+	{
+		free(pBuffer);
+		return false;
+	}
+	*a_ppBuffer = pBuffer;
+	*a_pSize = size;
+	return true;
+}
+
+bool WriteUserFile(const char* a_sFilename, const char* a_pBuffer, uint64_t a_uSize)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	// write next to the target and swap, a crash mid write must not leave a truncated file
+	char tempName[MAX_PATH];
+	snprintf(tempName, sizeof(tempName), "%s.tmp", a_sFilename);
+	FILE* pFile = fopen(tempName, "wb");
+	if (!pFile)
+	{
+		LOG(LogSeverity::WARNING, "Could not open file %s", tempName);
+		return false;
+	}
+	bool success = fwrite(a_pBuffer, 1, (size_t)a_uSize, pFile) == a_uSize;
+	success = (fclose(pFile) == 0) && success;
+
+	if (success)
+		success = MoveFileExA(tempName, a_sFilename, MOVEFILE_REPLACE_EXISTING) != 0;
+	if (!success)
+		remove(tempName);
+	return success;
+}
+
+static bool MapLooseFile(const char* a_sFilename, MappedFile* a_pFile)
+{
+	LOG_IF(a_sFilename, LogSeverity::ERR, "Empty File Name");
+
+	HANDLE file = CreateFileA(a_sFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	// the mapping keeps the file open
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	const void* pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pData)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	a_pFile->pData = pData;
+	a_pFile->size = (uint64_t)size.QuadPart;
+	a_pFile->pHandle = mapping;
+	a_pFile->archived = false;
+	return true;
+}
+
+bool MapFile(const char* a_sFilename, MappedFile* a_pFile)
+{
+	return MapArchiveFile(a_sFilename, a_pFile) || MapLooseFile(a_sFilename, a_pFile);
+}
+
+// user files are never packed
+bool MapUserFile(const char* a_sFilename, MappedFile* a_pFile)
+{
+	return MapLooseFile(a_sFilename, a_pFile);
+}
+
+void UnmapFile(MappedFile* a_pFile)
+{
+	LOG_IF(a_pFile->pData, LogSeverity::ERR, "File is not mapped");
+	if (a_pFile->archived)
+	{
+		UnmapArchiveFile(a_pFile);
+		return;
+	}
+	UnmapViewOfFile(a_pFile->pData);
+	CloseHandle((HANDLE)a_pFile->pHandle);
+	*a_pFile = {};
+}
@@ -0,0 +1,327 @@
+#include "OcclusionCull.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_CULL_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OCCLUSION_CULL_NEON
+#include <arm_neon.h>
+#endif
+
+#define OCCLUSION_TILES_X (OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_SIZE)
+// rows rasterized by one job, whole tile rows so a job also reduces the tiles it drew
+#define OCCLUSION_BAND_HEIGHT 16
+#define OCCLUSION_BAND_COUNT (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_BAND_HEIGHT)
+#define OCCLUSION_TRIANGLE_FLOATS 9
+// clip space w below this is treated as behind the camera
+#define MIN_CLIP_W 1e-4f
+
+// column major, out = a * b
+static void MultiplyMatrices(const float* a, const float* b, float* out)
+{
+	for (uint32_t column = 0; column < 4; ++column)
+	{
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			out[column * 4 + row] =
+				a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+				a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+		}
+	}
+}
+
+static void TransformPoint(const float* m, float x, float y, float z, float out[4])
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+}
+
+void InitOcclusionBuffer(OcclusionBuffer* a_pBuffer)
+{
+	LOG_IF(a_pBuffer, LogSeverity::ERR, "a_pBuffer is NULL");
+
+	a_pBuffer->pDepth = (float*)malloc(sizeof(float) * OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT);
+	a_pBuffer->pTileDepth = (float*)malloc(sizeof(float) * OCCLUSION_TILES_X * OCCLUSION_TILES_Y);
+	a_pBuffer->pTriangles = (float*)malloc(sizeof(float) * OCCLUSION_TRIANGLE_FLOATS * MAX_OCCLUDER_TRIANGLES);
+
+	// nothing drawn yet, every box is visible
+	for (uint32_t i = 0; i < OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT; ++i)
+		a_pBuffer->pDepth[i] = 1.0f;
+	for (uint32_t i = 0; i < OCCLUSION_TILES_X * OCCLUSION_TILES_Y; ++i)
+		a_pBuffer->pTileDepth[i] = 1.0f;
+
+	a_pBuffer->triangleCount = 0;
+	memset(&a_pBuffer->stats, 0, sizeof(OcclusionStats));
+}
+
+void ExitOcclusionBuffer(OcclusionBuffer* a_pBuffer)
+{
+	free(a_pBuffer->pDepth);
+	free(a_pBuffer->pTileDepth);
+	free(a_pBuffer->pTriangles);
+	a_pBuffer->pDepth = nullptr;
+	a_pBuffer->pTileDepth = nullptr;
+	a_pBuffer->pTriangles = nullptr;
+	a_pBuffer->triangleCount = 0;
+}
+
+void BeginOcclusionFrame(OcclusionBuffer* a_pBuffer, const float* a_pViewProjection)
+{
+	LOG_IF(a_pViewProjection, LogSeverity::ERR, "a_pViewProjection is NULL");
+
+	memcpy(a_pBuffer->viewProjection, a_pViewProjection, sizeof(a_pBuffer->viewProjection));
+	a_pBuffer->triangleCount = 0;
+	memset(&a_pBuffer->stats, 0, sizeof(OcclusionStats));
+}
+
+void AddOccluder(OcclusionBuffer* a_pBuffer, const float* a_pWorld, const float* a_pPositions, uint32_t a_uStride, const uint32_t* a_pIndices, uint32_t a_uIndexCount)
+{
+	LOG_IF(a_pPositions && a_pIndices, LogSeverity::ERR, "occluder without positions or indices");
+
+	float transform[16];
+	MultiplyMatrices(a_pBuffer->viewProjection, a_pWorld, transform);
+
+	const uint8_t* pVertices = (const uint8_t*)a_pPositions;
+	for (uint32_t i = 0; i + 2 < a_uIndexCount && a_pBuffer->triangleCount < MAX_OCCLUDER_TRIANGLES; i += 3)
+	{
+		float screen[3][3];
+		bool clipped = false;
+		for (uint32_t v = 0; v < 3 && !clipped; ++v)
+		{
+			const float* pPosition = (const float*)(pVertices + (size_t)a_pIndices[i + v] * a_uStride);
+			float clip[4];
+			TransformPoint(transform, pPosition[0], pPosition[1], pPosition[2], clip);
+			// in front of the near plane only, a closer depth than the real one would hide visible boxes
+			clipped = clip[3] < MIN_CLIP_W || clip[2] < 0.0f;
+			if (clipped)
+				break;
+
+			const float invW = 1.0f / clip[3];
+			screen[v][0] = (clip[0] * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+			screen[v][1] = (clip[1] * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+			screen[v][2] = clip[2] * invW;
+		}
+		if (clipped)
+			continue;
+
+		const float minX = fminf(screen[0][0], fminf(screen[1][0], screen[2][0]));
+		const float maxX = fmaxf(screen[0][0], fmaxf(screen[1][0], screen[2][0]));
+		const float minY = fminf(screen[0][1], fminf(screen[1][1], screen[2][1]));
+		const float maxY = fmaxf(screen[0][1], fmaxf(screen[1][1], screen[2][1]));
+		const float minZ = fminf(screen[0][2], fminf(screen[1][2], screen[2][2]));
+		if (maxX < 0.0f || minX > OCCLUSION_BUFFER_WIDTH || maxY < 0.0f || minY > OCCLUSION_BUFFER_HEIGHT || minZ > 1.0f)
+			continue;
+
+		// both faces occlude, triangles are stored counter clockwise
+		const float area = (screen[1][0] - screen[0][0]) * (screen[2][1] - screen[0][1]) - (screen[2][0] - screen[0][0]) * (screen[1][1] - screen[0][1]);
+		if (fabsf(area) < FLT_EPSILON)
+			continue;
+
+		float* pTriangle = a_pBuffer->pTriangles + a_pBuffer->triangleCount++ * OCCLUSION_TRIANGLE_FLOATS;
+		memcpy(pTriangle, screen[0], sizeof(float) * 3);
+		memcpy(pTriangle + 3, screen[area > 0.0f ? 1 : 2], sizeof(float) * 3);
+		memcpy(pTriangle + 6, screen[area > 0.0f ? 2 : 1], sizeof(float) * 3);
+	}
+}
+
+// clears and draws the rows of one band, then updates its tiles. pixels are sampled at their centers
+static void RasterizeBand(void* a_pData, uint32_t a_uBand)
+{
+	OcclusionBuffer* pBuffer = (OcclusionBuffer*)a_pData;
+	const int bandTop = (int)(a_uBand * OCCLUSION_BAND_HEIGHT);
+	const int bandBottom = bandTop + OCCLUSION_BAND_HEIGHT - 1;
+
+	float* pBand = pBuffer->pDepth + bandTop * OCCLUSION_BUFFER_WIDTH;
+	for (uint32_t i = 0; i < OCCLUSION_BAND_HEIGHT * OCCLUSION_BUFFER_WIDTH; ++i)
+		pBand[i] = 1.0f;
+
+	for (uint32_t t = 0; t < pBuffer->triangleCount; ++t)
+	{
+		const float* pTriangle = pBuffer->pTriangles + t * OCCLUSION_TRIANGLE_FLOATS;
+		const float x0 = pTriangle[0], y0 = pTriangle[1], z0 = pTriangle[2];
+		const float x1 = pTriangle[3], y1 = pTriangle[4], z1 = pTriangle[5];
+		const float x2 = pTriangle[6], y2 = pTriangle[7], z2 = pTriangle[8];
+
+		int minY = (int)floorf(fminf(y0, fminf(y1, y2)));
+		int maxY = (int)ceilf(fmaxf(y0, fmaxf(y1, y2)));
+		minY = minY < bandTop ? bandTop : minY;
+		maxY = maxY > bandBottom ? bandBottom : maxY;
+		if (minY > maxY)
+			continue;
+
+		int minX = (int)floorf(fminf(x0, fminf(x1, x2)));
+		int maxX = (int)ceilf(fmaxf(x0, fmaxf(x1, x2)));
+		// starts on a whole SIMD lane, the width is a multiple of 4 so the last lane stays inside the row
+		minX = (minX < 0 ? 0 : minX) & ~3;
+		maxX = maxX > OCCLUSION_BUFFER_WIDTH - 1 ? OCCLUSION_BUFFER_WIDTH - 1 : maxX;
+		if (minX > maxX)
+			continue;
+
+		// edge functions a * x + b * y + c, each one is the weight of the vertex opposite the edge
+		const float a0 = y1 - y2, b0 = x2 - x1, c0 = x1 * y2 - x2 * y1;
+		const float a1 = y2 - y0, b1 = x0 - x2, c1 = x2 * y0 - x0 * y2;
+		const float a2 = y0 - y1, b2 = x1 - x0, c2 = x0 * y1 - x1 * y0;
+		const float invArea = 1.0f / ((x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0));
+		const float dz1 = (z1 - z0) * invArea;
+		const float dz2 = (z2 - z0) * invArea;
+
+#if defined(OCCLUSION_CULL_SSE)
+		const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2);
+		const __m128 vz0 = _mm_set1_ps(z0), vdz1 = _mm_set1_ps(dz1), vdz2 = _mm_set1_ps(dz2);
+#elif defined(OCCLUSION_CULL_NEON)
+		const float offsetValues[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+		const float32x4_t offsets = vld1q_f32(offsetValues);
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		const float32x4_t va0 = vdupq_n_f32(a0), va1 = vdupq_n_f32(a1), va2 = vdupq_n_f32(a2);
+		const float32x4_t vz0 = vdupq_n_f32(z0), vdz1 = vdupq_n_f32(dz1), vdz2 = vdupq_n_f32(dz2);
+#endif
+
+		for (int y = minY; y <= maxY; ++y)
+		{
+			const float py = (float)y + 0.5f;
+			const float row0 = b0 * py + c0, row1 = b1 * py + c1, row2 = b2 * py + c2;
+			float* pRow = pBuffer->pDepth + y * OCCLUSION_BUFFER_WIDTH;
+
+#if defined(OCCLUSION_CULL_SSE)
+			const __m128 vr0 = _mm_set1_ps(row0), vr1 = _mm_set1_ps(row1), vr2 = _mm_set1_ps(row2);
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, px), vr0);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, px), vr1);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, px), vr2);
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (!_mm_movemask_ps(inside))
+					continue;
+
+				const __m128 z = _mm_add_ps(vz0, _mm_add_ps(_mm_mul_ps(vdz1, e1), _mm_mul_ps(vdz2, e2)));
+				const __m128 depth = _mm_loadu_ps(pRow + x);
+				const __m128 closer = _mm_min_ps(depth, z);
+				_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, depth)));
+			}
+#elif defined(OCCLUSION_CULL_NEON)
+			const float32x4_t vr0 = vdupq_n_f32(row0), vr1 = vdupq_n_f32(row1), vr2 = vdupq_n_f32(row2);
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const float32x4_t px = vaddq_f32(vdupq_n_f32((float)x), offsets);
+				const float32x4_t e0 = vmlaq_f32(vr0, va0, px);
+				const float32x4_t e1 = vmlaq_f32(vr1, va1, px);
+				const float32x4_t e2 = vmlaq_f32(vr2, va2, px);
+				const uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+
+				const float32x4_t z = vmlaq_f32(vmlaq_f32(vz0, vdz1, e1), vdz2, e2);
+				const float32x4_t depth = vld1q_f32(pRow + x);
+				vst1q_f32(pRow + x, vbslq_f32(inside, vminq_f32(depth, z), depth));
+			}
+#else
+			for (int x = minX; x <= maxX; ++x)
+			{
+				const float px = (float)x + 0.5f;
+				const float e0 = a0 * px + row0, e1 = a1 * px + row1, e2 = a2 * px + row2;
+				if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+					continue;
+
+				const float z = z0 + dz1 * e1 + dz2 * e2;
+				if (z < pRow[x])
+					pRow[x] = z;
+			}
+#endif
+		}
+	}
+
+	for (int tileY = bandTop / OCCLUSION_TILE_SIZE; tileY <= bandBottom / OCCLUSION_TILE_SIZE; ++tileY)
+	{
+		for (int tileX = 0; tileX < OCCLUSION_TILES_X; ++tileX)
+		{
+			float farthest = 0.0f;
+			for (int y = tileY * OCCLUSION_TILE_SIZE; y < (tileY + 1) * OCCLUSION_TILE_SIZE; ++y)
+			{
+				const float* pRow = pBuffer->pDepth + y * OCCLUSION_BUFFER_WIDTH + tileX * OCCLUSION_TILE_SIZE;
+				for (int x = 0; x < OCCLUSION_TILE_SIZE; ++x)
+					farthest = fmaxf(farthest, pRow[x]);
+			}
+			pBuffer->pTileDepth[tileY * OCCLUSION_TILES_X + tileX] = farthest;
+		}
+	}
+}
+
+void RasterizeOccluders(OcclusionBuffer* a_pBuffer)
+{
+	a_pBuffer->stats.occluderTriangles = a_pBuffer->triangleCount;
+
+	JobCounter counter;
+	RunJobs(RasterizeBand, a_pBuffer, OCCLUSION_BAND_COUNT, &counter);
+	WaitForJobs(&counter);
+}
+
+// conservative, the box is reduced to its screen rectangle at the depth of its nearest corner
+bool IsBoxVisible(OcclusionBuffer* a_pBuffer, const float a_Min[3], const float a_Max[3])
+{
+	++a_pBuffer->stats.tested;
+
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		float clip[4];
+		TransformPoint(a_pBuffer->viewProjection,
+			(corner & 1) ? a_Max[0] : a_Min[0], (corner & 2) ? a_Max[1] : a_Min[1], (corner & 4) ? a_Max[2] : a_Min[2], clip);
+		// the box reaches behind the near plane, the camera may be inside it
+		if (clip[3] < MIN_CLIP_W || clip[2] < 0.0f)
+			return true;
+
+		const float invW = 1.0f / clip[3];
+		const float x = (clip[0] * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+		const float y = (clip[1] * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+		minX = fminf(minX, x);
+		maxX = fmaxf(maxX, x);
+		minY = fminf(minY, y);
+		maxY = fmaxf(maxY, y);
+		minZ = fminf(minZ, clip[2] * invW);
+	}
+
+	// off screen boxes are left to the frustum test
+	const int x0 = minX < 0.0f ? 0 : (int)floorf(minX);
+	const int y0 = minY < 0.0f ? 0 : (int)floorf(minY);
+	const int x1 = maxX > OCCLUSION_BUFFER_WIDTH - 1 ? OCCLUSION_BUFFER_WIDTH - 1 : (int)ceilf(maxX);
+	const int y1 = maxY > OCCLUSION_BUFFER_HEIGHT - 1 ? OCCLUSION_BUFFER_HEIGHT - 1 : (int)ceilf(maxY);
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	for (int tileY = y0 / OCCLUSION_TILE_SIZE; tileY <= y1 / OCCLUSION_TILE_SIZE; ++tileY)
+	{
+		for (int tileX = x0 / OCCLUSION_TILE_SIZE; tileX <= x1 / OCCLUSION_TILE_SIZE; ++tileX)
+		{
+			// every pixel of the tile is in front of the box
+			if (a_pBuffer->pTileDepth[tileY * OCCLUSION_TILES_X + tileX] < minZ)
+				continue;
+
+			const int tileLeft = tileX * OCCLUSION_TILE_SIZE, tileTop = tileY * OCCLUSION_TILE_SIZE;
+			const int left = x0 > tileLeft ? x0 : tileLeft;
+			const int right = x1 < tileLeft + OCCLUSION_TILE_SIZE - 1 ? x1 : tileLeft + OCCLUSION_TILE_SIZE - 1;
+			const int top = y0 > tileTop ? y0 : tileTop;
+			const int bottom = y1 < tileTop + OCCLUSION_TILE_SIZE - 1 ? y1 : tileTop + OCCLUSION_TILE_SIZE - 1;
+			for (int y = top; y <= bottom; ++y)
+			{
+				const float* pRow = a_pBuffer->pDepth + y * OCCLUSION_BUFFER_WIDTH;
+				for (int x = left; x <= right; ++x)
+				{
+					if (pRow[x] >= minZ)
+						return true;
+				}
+			}
+		}
+	}
+
+	++a_pBuffer->stats.culled;
+	return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Software occlusion culling. A few large occluder meshes are rasterized on the CPU into a small
+// depth buffer, then boxes are tested against it before anything is queued for drawing. Rows are
+// split into bands rasterized on the job system, four pixels at a time with SSE or NEON.
+
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+// every tile keeps the farthest depth of its pixels, most boxes are rejected without touching pixels
+#define OCCLUSION_TILE_SIZE 8
+// occluder triangles past this are dropped for the frame
+#define MAX_OCCLUDER_TRIANGLES 16384
+
+struct OcclusionStats
+{
+	uint32_t	occluderTriangles;
+	uint32_t	tested;
+	uint32_t	culled;
+};
+
+struct OcclusionBuffer
+{
+	// nearest occluder depth per pixel, 1 is the far plane
+	float*			pDepth;
+	// farthest pixel depth per tile
+	float*			pTileDepth;
+	// screen space x, y and depth of the three vertices of every triangle
+	float*			pTriangles;
+	uint32_t		triangleCount;
+	float			viewProjection[16];
+	OcclusionStats	stats;
+
+	OcclusionBuffer() :
+		pDepth(nullptr), pTileDepth(nullptr), pTriangles(nullptr), triangleCount(0), viewProjection(), stats()
+	{}
+};
+
+void InitOcclusionBuffer(OcclusionBuffer* a_pBuffer);
+void ExitOcclusionBuffer(OcclusionBuffer* a_pBuffer);
+
+// drops last frame's occluders and resets the stats, a_pViewProjection is column major with zero to one depth
+void BeginOcclusionFrame(OcclusionBuffer* a_pBuffer, const float* a_pViewProjection);
+// a_pWorld places the mesh, positions are three floats every a_uStride bytes and indices are absolute.
+// triangles crossing the near plane are skipped, an occluder only has to hide things, not be complete
+void AddOccluder(OcclusionBuffer* a_pBuffer, const float* a_pWorld, const float* a_pPositions, uint32_t a_uStride, const uint32_t* a_pIndices, uint32_t a_uIndexCount);
+// clears the depth buffer and draws every occluder added since BeginOcclusionFrame
+void RasterizeOccluders(OcclusionBuffer* a_pBuffer);
+// false when the world space box is behind the occluders everywhere it covers
+bool IsBoxVisible(OcclusionBuffer* a_pBuffer, const float a_Min[3], const float a_Max[3]);
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Renderer.h"
+
+// Frame render graph. Passes declare the targets they write and the textures they read,
+// CompileRenderGraph culls passes whose results are never used, derives the layout
+// transitions between passes (one batched vkCmdPipelineBarrier per pass) and places
+// transient targets with disjoint lifetimes in the same memory.
+//
+// The graph is rebuilt every frame:
+//	ResetRenderGraph -> Import/CreateRenderGraphTarget, AddRenderGraphPass, Write/Read... ->
+//	CompileRenderGraph -> ExecuteRenderGraph
+// Transient targets are created on the first compile and kept while the graph keeps the same shape.
+
+#define RG_INVALID_ID uint32_t(-1)
+#define RG_MAX_PASS_READS 8
+#define RG_MAX_TARGETS 32
+
+// records the draws of a pass, attachments are already bound and the viewport covers them.
+// for passes added with a_bSecondaryCommandBuffers the callback may only execute secondary command buffers
+typedef void (*RenderGraphExecuteFn)(CommandBuffer* a_pCommandBuffer, void* a_pUserData);
+
+struct RenderGraphTargetDesc
+{
+	uint32_t				width;
+	uint32_t				height;
+	VkFormat				format;
+	VkSampleCountFlagBits	sampleCount;
+
+	RenderGraphTargetDesc() :
+		width(0), height(0), format(VK_FORMAT_UNDEFINED), sampleCount(VK_SAMPLE_COUNT_1_BIT)
+	{}
+
+	RenderGraphTargetDesc(uint32_t a_uWidth, uint32_t a_uHeight, VkFormat a_Format, VkSampleCountFlagBits a_SampleCount = VK_SAMPLE_COUNT_1_BIT) :
+		width(a_uWidth), height(a_uHeight), format(a_Format), sampleCount(a_SampleCount)
+	{}
+};
+
+struct RenderGraphTarget
+{
+	const char*				name;
+	RenderGraphTargetDesc	desc;
+	// imported targets are owned by the caller and outlive the frame, they are the graph outputs
+	bool					imported;
+	VkImageLayout			initialLayout;
+	VkImageLayout			finalLayout;
+	RenderTarget*			pRenderTarget;
+	// filled by CompileRenderGraph
+	VkImageUsageFlags		usage;
+	uint32_t				firstPass;
+	uint32_t				lastPass;
+	uint32_t				memoryBlock;
+
+	RenderGraphTarget() :
+		name(nullptr), desc(), imported(false), initialLayout(VK_IMAGE_LAYOUT_UNDEFINED), finalLayout(VK_IMAGE_LAYOUT_UNDEFINED), pRenderTarget(nullptr),
+		usage(0), firstPass(RG_INVALID_ID), lastPass(RG_INVALID_ID), memoryBlock(RG_INVALID_ID)
+	{}
+};
+
+struct RenderGraphPass
+{
+	const char*				name;
+	RenderGraphExecuteFn	execute;
+	void*					pUserData;
+	uint32_t				colorCount;
+	uint32_t				colors[MAX_RENDER_TARGET_ATTACHMENTS];
+	uint32_t				depth;
+	LoadActionsDesc			loadActions;
+	uint32_t				readCount;
+	uint32_t				reads[RG_MAX_PASS_READS];
+	bool					secondaryCommandBuffers;
+	// filled by CompileRenderGraph
+	bool					culled;
+	uint32_t				firstBarrier;
+	uint32_t				barrierCount;
+	VkPipelineStageFlags	srcStages;
+	VkPipelineStageFlags	dstStages;
+
+	RenderGraphPass() :
+		name(nullptr), execute(nullptr), pUserData(nullptr), colorCount(0), colors(), depth(RG_INVALID_ID), loadActions(), readCount(0), reads(), secondaryCommandBuffers(false),
+		culled(false), firstBarrier(0), barrierCount(0), srcStages(0), dstStages(0)
+	{}
+};
+
+// transient targets whose lifetimes do not overlap share one block
+struct RenderGraphMemoryBlock
+{
+	VkDeviceMemory				memory;
+	VkDeviceSize				size;
+	std::vector<RenderTarget*>	renderTargets;
+	bool						depth;
+	uint32_t					lastPass;
+	// last access to the memory, the next occupant waits on it, carried over to the next frame
+	VkPipelineStageFlags		stages;
+	VkAccessFlags				access;
+
+	RenderGraphMemoryBlock() :
+		memory(VK_NULL_HANDLE), size(0), renderTargets(), depth(false), lastPass(0), stages(0), access(0)
+	{}
+};
+
+struct RenderGraphStats
+{
+	uint32_t		passCount;
+	uint32_t		culledPassCount;
+	uint32_t		barrierBatchCount;		// vkCmdPipelineBarrier calls per execute
+	uint32_t		imageBarrierCount;
+	uint32_t		transientTargetCount;
+	uint32_t		memoryBlockCount;
+	VkDeviceSize	transientMemorySize;	// bytes, after aliasing
+
+	RenderGraphStats() :
+		passCount(0), culledPassCount(0), barrierBatchCount(0), imageBarrierCount(0), transientTargetCount(0), memoryBlockCount(0), transientMemorySize(0)
+	{}
+};
+
+struct RenderGraph
+{
+	Renderer*							pRenderer;
+	std::vector<RenderGraphTarget>		targets;
+	std::vector<RenderGraphPass>		passes;
+	std::vector<VkImageMemoryBarrier>	barriers;
+	// transitions of imported targets to their final layout, after the last pass
+	uint32_t							finalBarrierCount;
+	VkPipelineStageFlags				finalSrcStages;
+	VkPipelineStageFlags				finalDstStages;
+	std::vector<RenderGraphMemoryBlock>	memoryBlocks;
+	uint32_t							transientHash;
+	RenderGraphStats					stats;
+
+	RenderGraph() :
+		pRenderer(nullptr), targets(), passes(), barriers(), finalBarrierCount(0), finalSrcStages(0), finalDstStages(0), memoryBlocks(), transientHash(0), stats()
+	{}
+};
+
+void CreateRenderGraph(Renderer* a_pRenderer, RenderGraph** a_ppRenderGraph);
+// frees the transient targets, the device has to be idle
+void DestroyRenderGraph(Renderer* a_pRenderer, RenderGraph** a_ppRenderGraph);
+void ResetRenderGraph(RenderGraph* a_pRenderGraph);
+
+uint32_t ImportRenderGraphTarget(RenderGraph* a_pRenderGraph, const char* a_sName, RenderTarget* a_pRenderTarget, VkImageLayout a_InitialLayout, VkImageLayout a_FinalLayout);
+uint32_t CreateRenderGraphTarget(RenderGraph* a_pRenderGraph, const char* a_sName, const RenderGraphTargetDesc& a_Desc);
+
+uint32_t AddRenderGraphPass(RenderGraph* a_pRenderGraph, const char* a_sName, RenderGraphExecuteFn a_Execute, void* a_pUserData, bool a_bSecondaryCommandBuffers = false);
+void WriteRenderGraphColor(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget, VkAttachmentLoadOp a_LoadOp, const VkClearValue& a_ClearValue);
+void WriteRenderGraphDepth(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget, VkAttachmentLoadOp a_LoadOp, const VkClearValue& a_ClearValue);
+// sampled in the fragment shader
+void ReadRenderGraphTexture(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget);
+
+void CompileRenderGraph(RenderGraph* a_pRenderGraph);
+void ExecuteRenderGraph(RenderGraph* a_pRenderGraph, CommandBuffer* a_pCommandBuffer);
+
+// physical target after CompileRenderGraph, nullptr for a transient no live pass uses
+RenderTarget* GetRenderGraphTarget(RenderGraph* a_pRenderGraph, uint32_t a_uTarget);
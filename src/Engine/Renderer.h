@@ -32,11 +32,13 @@ struct TextureDesc
 	uint64_t				rawDataSize;
 	bool					mipMaps;
 	uint32_t				mipLevels;
+	// a block compressed file found for filePath is loaded with its smallest levels only, see TextureStreaming.h
+	bool					streamed;
 
 	TextureDesc() :
 		width(0), height(0), format(VK_FORMAT_UNDEFINED), tiling(VK_IMAGE_TILING_OPTIMAL), usage(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT),
 		properties(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), aspectBits(VK_IMAGE_ASPECT_COLOR_BIT), sampleCount(VK_SAMPLE_COUNT_1_BIT),
-		initialLayout(VK_IMAGE_LAYOUT_UNDEFINED), filePath(), rawData(nullptr), rawDataSize(0), mipMaps(false), mipLevels(-1)
+		initialLayout(VK_IMAGE_LAYOUT_UNDEFINED), filePath(), rawData(nullptr), rawDataSize(0), mipMaps(false), mipLevels(-1), streamed(false)
 	{}
 };
 
@@ -123,9 +125,12 @@ struct LoadActionsDesc
 	VkClearValue					clearDepth;
 	VkAttachmentLoadOp				loadDepthAction;
 	VkAttachmentLoadOp				loadStencilAction;
+	// DONT_CARE lets tilers skip writing depth back when nothing reads it later
+	VkAttachmentStoreOp				storeDepthAction;
 
 	LoadActionsDesc() :
-		clearColors(), loadColorActions(), clearDepth(), loadDepthAction(VK_ATTACHMENT_LOAD_OP_DONT_CARE), loadStencilAction(VK_ATTACHMENT_LOAD_OP_DONT_CARE)
+		clearColors(), loadColorActions(), clearDepth(), loadDepthAction(VK_ATTACHMENT_LOAD_OP_DONT_CARE), loadStencilAction(VK_ATTACHMENT_LOAD_OP_DONT_CARE),
+		storeDepthAction(VK_ATTACHMENT_STORE_OP_STORE)
 	{}
 };
 
@@ -151,15 +156,70 @@ struct RenderPass
 	{}
 };
 
+#define MAX_BOUND_DESCRIPTOR_SETS 4
+#define MAX_BOUND_VERTEX_BUFFERS 8
+#define MAX_PUSH_CONSTANT_SIZE 128
+
+// last state set on a command buffer, binds of the same state are skipped
+struct BoundState
+{
+	VkPipeline			pipeline;
+	// sets and push constants are only compared while the same layout is used
+	VkPipelineLayout	pipelineLayout;
+	VkDescriptorSet		descriptorSets[MAX_BOUND_DESCRIPTOR_SETS];
+	uint32_t			dynamicOffsets[MAX_BOUND_DESCRIPTOR_SETS];
+	uint32_t			vertexBufferCount;
+	VkBuffer			vertexBuffers[MAX_BOUND_VERTEX_BUFFERS];
+	VkBuffer			indexBuffer;
+	VkIndexType			indexType;
+	uint32_t			pushConstantOffset;
+	uint32_t			pushConstantSize;
+	uint8_t				pushConstants[MAX_PUSH_CONSTANT_SIZE];
+	bool				viewportSet;
+	VkViewport			viewport;
+
+	BoundState() :
+		pipeline(VK_NULL_HANDLE), pipelineLayout(VK_NULL_HANDLE), descriptorSets(), dynamicOffsets(), vertexBufferCount(0), vertexBuffers(),
+		indexBuffer(VK_NULL_HANDLE), indexType(VK_INDEX_TYPE_UINT32), pushConstantOffset(0), pushConstantSize(0), pushConstants(), viewportSet(false), viewport()
+	{}
+};
+
+// counted since the command buffer began recording
+struct CommandBufferStats
+{
+	uint32_t	drawCount;
+	uint32_t	stateChangeCount;
+	uint32_t	skippedStateChangeCount;
+
+	CommandBufferStats() :
+		drawCount(0), stateChangeCount(0), skippedStateChangeCount(0)
+	{}
+};
+
 struct Renderer;
+struct TextureStreamer;
 struct CommandBuffer
 {
-	Renderer*		pRenderer;
-	VkCommandBuffer commandBuffer;
-	VkRenderPass	activeRenderPass;
+	Renderer*			pRenderer;
+	VkCommandBuffer		commandBuffer;
+	VkRenderPass		activeRenderPass;
+	// inherited by secondary command buffers recorded inside the active render pass
+	VkFramebuffer		activeFramebuffer;
+	BoundState			boundState;
+	CommandBufferStats	stats;
 
 	CommandBuffer() :
-		pRenderer(nullptr), commandBuffer(VK_NULL_HANDLE), activeRenderPass(VK_NULL_HANDLE)
+		pRenderer(nullptr), commandBuffer(VK_NULL_HANDLE), activeRenderPass(VK_NULL_HANDLE), activeFramebuffer(VK_NULL_HANDLE), boundState(), stats()
+	{}
+};
+
+// a pool is only used by one thread at a time, recording threads get one each
+struct CommandPool
+{
+	VkCommandPool	commandPool;
+
+	CommandPool() :
+		commandPool(VK_NULL_HANDLE)
 	{}
 };
 
@@ -177,9 +237,12 @@ struct DescriptorInfo
 	uint32_t						set;
 	VkDescriptorSetLayoutBinding	binding;
 	std::string						name;
+	// descriptor indexing flags, a VARIABLE_DESCRIPTOR_COUNT binding has to be the last binding of its set
+	// and is written with UpdateDescriptorSetArray instead of UpdateDescriptorSet
+	VkDescriptorBindingFlagsEXT		bindingFlags;
 
-	DescriptorInfo(uint32_t a_uSet, VkDescriptorSetLayoutBinding a_binding, std::string a_sName) :
-		set(a_uSet), binding(a_binding), name(a_sName)
+	DescriptorInfo(uint32_t a_uSet, VkDescriptorSetLayoutBinding a_binding, std::string a_sName, VkDescriptorBindingFlagsEXT a_BindingFlags = 0) :
+		set(a_uSet), binding(a_binding), name(a_sName), bindingFlags(a_BindingFlags)
 	{}
 };
 
@@ -265,13 +328,13 @@ struct DescriptorSet
 
 struct DescriptorUpdateInfo
 {
-	std::string				name;
+	const char*				name;
 	VkDescriptorImageInfo	mImageInfo;
 	VkDescriptorBufferInfo	mBufferInfo;
 	VkBufferView			mBufferView;
 
 	DescriptorUpdateInfo() :
-		name(), mImageInfo(), mBufferInfo(), mBufferView()
+		name(nullptr), mImageInfo(), mBufferInfo(), mBufferView()
 	{}
 };
 
@@ -334,11 +397,14 @@ struct PipelineDesc
 
 struct Pipeline
 {
-	PipelineDesc	desc;
-	VkPipeline		pipeline;
+	PipelineDesc		desc;
+	VkPipeline			pipeline;
+	// unique per created pipeline, for draw sort keys
+	uint32_t			id;
+	VkPipelineBindPoint	bindPoint;
 
 	Pipeline() :
-		desc(), pipeline(VK_NULL_HANDLE)
+		desc(), pipeline(VK_NULL_HANDLE), id(0), bindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS)
 	{}
 };
 
@@ -353,6 +419,18 @@ struct DefaultResources
 	{}
 };
 
+struct RendererStats
+{
+	uint32_t	pipelineCount;				// pipelines created since InitRenderer
+	float		pipelineCreationTime;		// total milliseconds spent creating them
+	float		lastPipelineCreationTime;	// milliseconds, most recent pipeline
+	uint64_t	pipelineCacheLoadedSize;	// bytes of valid cache data found at startup, 0 on a cold start
+
+	RendererStats() :
+		pipelineCount(0), pipelineCreationTime(0.0f), lastPipelineCreationTime(0.0f), pipelineCacheLoadedSize(0)
+	{}
+};
+
 struct Renderer
 {
 	Window window;
@@ -371,6 +449,15 @@ struct Renderer
 	VkQueue				presentQueue;
 	//
 
+	// descriptor indexing (bindless) support, maxBindlessTextures is 0 when unavailable
+	bool				bindlessSupported;
+	uint32_t			maxBindlessTextures;
+	// indirect draws with a non zero firstInstance, what GPU culled instanced draws need
+	bool				indirectFirstInstanceSupported;
+	// more than one command per indirect draw, and the draw count read from a buffer (VK_KHR_draw_indirect_count)
+	bool				multiDrawIndirectSupported;
+	bool				drawIndirectCountSupported;
+
 	// swapchain
 	VkSwapchainKHR swapChain;
 	RenderTarget** swapchainRenderTargets;
@@ -379,6 +466,9 @@ struct Renderer
 
 	VkCommandPool		commandPool;
 	VkDescriptorPool	descriptorPool;
+	// persisted across runs, see PIPELINE_CACHE_FILE
+	VkPipelineCache		pipelineCache;
+	bool				pipelineCacheDirty;
 
 	DefaultResources	defaultResources;
 
@@ -390,9 +480,14 @@ struct Renderer
 	uint32_t					currentFrame;
 	uint32_t					imageIndex;
 
+	RendererStats				stats;
+
+	// set by the app, textures with desc.streamed load whole without one
+	TextureStreamer*			pTextureStreamer;
+
 	Renderer() :
-		instance(), debugMessenger(), surface(), physicalDevice(), device(), graphicsQueue(), presentQueue(), swapChain(), swapchainRenderTargets(), swapchainRenderTargetCount(0),
-		commandPool(), descriptorPool(), maxInFlightFrames(2), currentFrame(0), imageIndex(0)
+		instance(), debugMessenger(), surface(), physicalDevice(), device(), graphicsQueue(), presentQueue(), bindlessSupported(false), maxBindlessTextures(0), indirectFirstInstanceSupported(false), multiDrawIndirectSupported(false), drawIndirectCountSupported(false), swapChain(), swapchainRenderTargets(), swapchainRenderTargetCount(0),
+		commandPool(), descriptorPool(), pipelineCache(), pipelineCacheDirty(false), maxInFlightFrames(2), currentFrame(0), imageIndex(0), stats(), pTextureStreamer(nullptr)
 	{}
 };
 
@@ -401,10 +496,25 @@ void ExitRenderer(Renderer** a_ppRenderer);
 void CreateSwapchain(Renderer** a_ppRenderer);
 void DestroySwapchain(Renderer** a_ppRenderer);
 void WaitDeviceIdle(Renderer* a_pRenderer);
+// waits for the fences of every frame in flight, nothing submitted by them runs afterwards
+void WaitForInFlightFrames(Renderer* a_pRenderer);
 
+// textures with a filePath load the first block compressed copy FindCompressedTexture finds and decode the source otherwise,
+// streamed ones start with only their smallest levels when the renderer has a pTextureStreamer
 void CreateTexture(Renderer* a_pRenderer, Texture** a_ppTexture);
 void DestroyTexture(Renderer* a_pRenderer, Texture** a_ppTexture);
+// decodes the source image of a texture without a block compressed copy into desc.rawData so CreateTexture only uploads it.
+// reads nothing of the renderer but its format support and can run on any thread, FreeTextureData releases the pixels.
+// a_pFileData is the source file when it was read already, see FileIO.h
+void LoadTextureData(Renderer* a_pRenderer, Texture* a_pTexture, const void* a_pFileData = nullptr, uint64_t a_uFileSize = 0);
+void FreeTextureData(Texture* a_pTexture);
+// bytes of device memory the image of a texture takes, 0 before CreateTexture
+uint64_t GetTextureMemorySize(Renderer* a_pRenderer, const Texture* a_pTexture);
 void TransitionImageLayout(CommandBuffer* a_pCommandBuffer, Texture* a_pTexture, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t a_uBaseMipLevel = 0);
+// a_uFeatures with optimal tiling, block compressed formats depend on the device
+bool IsFormatSupported(Renderer* a_pRenderer, VkFormat a_eFormat, VkFormatFeatureFlags a_uFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+// path of the TextureCompressor output for a_sSourcePath in the preferred format the device can sample, empty when there is none
+std::string FindCompressedTexture(Renderer* a_pRenderer, const std::string& a_sSourcePath);
 
 void CreateSampler(Renderer* a_pRenderer, Sampler** a_ppSampler);
 void DestroySampler(Renderer* a_pRenderer, Sampler** a_ppSampler);
@@ -421,15 +531,26 @@ void DestroyResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppR
 void CreateDescriptorSet(Renderer* a_pRenderer, DescriptorSet** a_ppDescriptorSet);
 void DestroyDescriptorSet(Renderer* a_pRenderer, DescriptorSet** a_ppDescriptorSet);
 void UpdateDescriptorSet(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a_pDescriptorSet, uint32_t a_uCount, const DescriptorUpdateInfo* a_pDescriptorUpdateInfos);
+void UpdateDescriptorSetArray(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a_pDescriptorSet, const char* a_sName, uint32_t a_uFirstElement, uint32_t a_uCount, const VkDescriptorImageInfo* a_pImageInfos);
 
 void CreateGraphicsPipeline(Renderer* a_ppRenderer, Pipeline** a_ppPipeline);
 void DestroyGraphicsPipeline(Renderer* a_ppRenderer, Pipeline** a_ppPipeline);
+// desc.shaders[0] is the compute shader, only the shader and the resource descriptor of the desc are used
+void CreateComputePipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline);
+void DestroyComputePipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline);
 
 void CreateRenderTarget(Renderer* a_pRenderer, RenderTarget** a_ppRenderTarget);
 void DestroyRenderTarget(Renderer* a_pRenderer, RenderTarget** a_ppRenderTarget);
-void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTargetCount, RenderTarget** a_ppRenderTargets, LoadActionsDesc* a_pLoadActions = nullptr, RenderTarget* a_pDepthTarget = nullptr);
-
-void CreateShaderModule(Renderer* a_pRenderer, const char* a_sPath, ShaderModule** a_ppShaderModule);
+// binds all targets to one allocation at offset 0, only one of them may hold live contents at a time.
+// targets are left in VK_IMAGE_LAYOUT_UNDEFINED, a_pSize receives the allocation size
+void CreateAliasedRenderTargets(Renderer* a_pRenderer, uint32_t a_uCount, RenderTarget** a_ppRenderTargets, VkDeviceMemory* a_pMemory, VkDeviceSize* a_pSize = nullptr);
+void DestroyAliasedRenderTargets(Renderer* a_pRenderer, uint32_t a_uCount, RenderTarget** a_ppRenderTargets, VkDeviceMemory* a_pMemory);
+// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass can only be filled with ExecuteCommandBuffers
+void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTargetCount, RenderTarget** a_ppRenderTargets, LoadActionsDesc* a_pLoadActions = nullptr, RenderTarget* a_pDepthTarget = nullptr,
+	VkSubpassContents a_SubpassContents = VK_SUBPASS_CONTENTS_INLINE);
+
+// a_sDefines picks a variant of the shader, see ComputeShaderCacheKey
+void CreateShaderModule(Renderer* a_pRenderer, const char* a_sPath, ShaderModule** a_ppShaderModule, const char* a_sDefines = "");
 void DestroyShaderModule(Renderer* a_pRenderer, ShaderModule** a_ppShaderModule);
 
 uint32_t GetNextSwapchainImage(Renderer* a_pRenderer);
@@ -438,14 +559,36 @@ void CreateCommandBuffers(Renderer* a_pRenderer, uint32_t a_uiCount, CommandBuff
 void DestroyCommandBuffers(Renderer* a_pRenderer, uint32_t a_uiCount, CommandBuffer** a_ppCommandBuffers);
 void BeginCommandBuffer(CommandBuffer* a_pCommandBuffer);
 void EndCommandBuffer(CommandBuffer* a_pCommandBuffer);
+
+void CreateCommandPool(Renderer* a_pRenderer, CommandPool** a_ppCommandPool);
+void DestroyCommandPool(Renderer* a_pRenderer, CommandPool** a_ppCommandPool);
+// recycles every command buffer of the pool, none of them may still be in flight
+void ResetCommandPool(Renderer* a_pRenderer, CommandPool* a_pCommandPool);
+void CreateSecondaryCommandBuffers(Renderer* a_pRenderer, CommandPool* a_pCommandPool, uint32_t a_uCount, CommandBuffer** a_ppCommandBuffers);
+void DestroySecondaryCommandBuffers(Renderer* a_pRenderer, CommandPool* a_pCommandPool, uint32_t a_uCount, CommandBuffer** a_ppCommandBuffers);
+// continues the render pass active on a_pPrimary, dynamic state (viewport, scissors) is not inherited
+void BeginSecondaryCommandBuffer(CommandBuffer* a_pCommandBuffer, CommandBuffer* a_pPrimary);
+void ExecuteCommandBuffers(CommandBuffer* a_pPrimary, uint32_t a_uCount, CommandBuffer** a_ppSecondaries);
 void SetViewport(CommandBuffer* a_pCommandBuffer, float a_fX, float a_fY, float a_fWidth, float a_fHeight, float a_fMinDepth, float a_fMaxDepth);
 void SetScissors(CommandBuffer* a_pCommandBuffer, uint32_t a_uX, uint32_t a_uY, uint32_t a_uWidth, uint32_t a_uHeight);
 void BindPipeline(CommandBuffer* a_pCommandBuffer, Pipeline* a_pPipeline);
-void BindDescriptorSet(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndex, DescriptorSet* a_pDescriptorSet, ResourceDescriptor* a_pResourceDescriptor = NULL, uint32_t a_uDynamicOffsetCount = 0, const uint32_t* a_uOffsets = NULL);
+// compute binds are not tracked in the bound state
+void BindDescriptorSet(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndex, DescriptorSet* a_pDescriptorSet, ResourceDescriptor* a_pResourceDescriptor = NULL, uint32_t a_uDynamicOffsetCount = 0, const uint32_t* a_uOffsets = NULL,
+	VkPipelineBindPoint a_BindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 void BindVertexBuffers(CommandBuffer* a_pCommandBuffer, uint32_t a_uCount, Buffer** a_ppBuffers);
 void BindIndexBuffer(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, VkIndexType a_IndexType);
 void BindPushConstants(CommandBuffer* a_pCommandBuffer, ResourceDescriptor* a_pResourceDescriptor, const char* name, const void* pConstants);
-void Draw(CommandBuffer* a_pCommandBuffer, uint32_t a_uVertexCount, uint32_t a_uFirstVertex);
-void DrawIndexed(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndicesCount, uint32_t a_uFirstIndex, uint32_t a_uFirstVertex);
+void Draw(CommandBuffer* a_pCommandBuffer, uint32_t a_uVertexCount, uint32_t a_uFirstVertex, uint32_t a_uInstanceCount = 1, uint32_t a_uFirstInstance = 0);
+// instance rate vertex attributes are fetched from a_uFirstInstance on
+void DrawIndexed(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndicesCount, uint32_t a_uFirstIndex, uint32_t a_uFirstVertex, uint32_t a_uInstanceCount = 1, uint32_t a_uFirstInstance = 0);
+// a_uDrawCount VkDrawIndexedIndirectCommands read from a_pBuffer at a_uOffset, more than one needs multiDrawIndirect
+void DrawIndexedIndirect(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, uint64_t a_uOffset, uint32_t a_uDrawCount = 1, uint32_t a_uStride = sizeof(VkDrawIndexedIndirectCommand));
+// as many commands as the uint32 at a_uCountOffset in a_pCountBuffer says, at most a_uMaxDrawCount. needs drawIndirectCountSupported
+void DrawIndexedIndirectCount(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, uint64_t a_uOffset, Buffer* a_pCountBuffer, uint64_t a_uCountOffset, uint32_t a_uMaxDrawCount,
+	uint32_t a_uStride = sizeof(VkDrawIndexedIndirectCommand));
+// outside of a render pass
+void Dispatch(CommandBuffer* a_pCommandBuffer, uint32_t a_uGroupCountX, uint32_t a_uGroupCountY = 1, uint32_t a_uGroupCountZ = 1);
+// makes the writes of the source stages to the whole buffer visible to the destination stages, outside of a render pass
+void BufferBarrier(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, VkPipelineStageFlags a_SrcStages, VkAccessFlags a_SrcAccess, VkPipelineStageFlags a_DstStages, VkAccessFlags a_DstAccess);
 void Submit(CommandBuffer* a_pCommandBuffer);
 void Present(CommandBuffer* a_pCommandBuffer);
\ No newline at end of file
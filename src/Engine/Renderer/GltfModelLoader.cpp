@@ -8,19 +8,42 @@
 #include "../ModelLoader.h"
 #include "../Renderer.h"
 #include "../Log.h"
+#include "../LinearAllocator.h"
+#include "../MeshSimplify.h"
+#include "../MeshOptimize.h"
+#include "../ModelFile.h"
+#include "../AnimationCompression.h"
+#include "../FileSystem.h"
+#include "../JobSystem.h"
+#include "../../../include/glm/gtc/packing.hpp"
 #include <set>
+#include <algorithm>
+#include <unordered_map>
+
+struct GltfMeshLoader;
 
 void LoadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model,
-	std::vector<uint32_t>& indexBuffer, std::vector<Model::Vertex>& vertexBuffer, float globalscale, Model* a_pModel);
+	GltfMeshLoader& meshLoader, float globalscale, Model* a_pModel);
+void LoadPrimitive(void* meshLoader, uint32_t primitiveIndex);
 void LoadSkins(tinygltf::Model& gltfModel, Model* a_pModel);
-void LoadTextures(Renderer* pRenderer, tinygltf::Model& gltfModel, Model* a_pModel);
-void LoadTextureSamplers(Renderer* a_pRenderer, tinygltf::Model& gltfModel, Model* a_pModel);
+void LoadTextures(tinygltf::Model& gltfModel, const std::string& baseDirectory, Model* a_pModel);
+void AddModelTexture(Sampler* pSampler, const std::string& filePath, const void* pPixels, uint64_t size, uint32_t width, uint32_t height, Model* a_pModel);
+void LoadTextureSamplers(tinygltf::Model& gltfModel, Model* a_pModel);
 void LoadMaterials(tinygltf::Model& gltfModel, Model* a_pModel);
 void LoadAnimations(tinygltf::Model& gltfModel, Model* a_pModel);
+void CompressAnimations(Model* a_pModel);
 void DrawNode(Node* node, CommandBuffer* commandBuffer);
 void Draw(CommandBuffer* commandBuffer, Model* a_pModel);
 void CalculateBoundingBox(Node* node, Node* parent, Model* a_pModel);
 void GetSceneDimensions(Model* a_pModel);
+void OptimizeMeshes(Model* a_pModel);
+void GenerateLods(Model* a_pModel);
+void PackVertices(const Model* a_pModel, bool skinned, std::vector<Model::PackedVertex>& packedVertices, std::vector<Model::SkinVertex>& skinVertices);
+void CreateModelBuffers(Model* a_pModel, const Model::PackedVertex* vertices, uint32_t vertexCount, const Model::SkinVertex* skinVertices);
+void PoseNodes(Model* a_pModel);
+bool LoadCookedModel(Renderer* pRenderer, const std::string& sourcePath, uint64_t key, Model* a_pModel);
+void CookModel(const tinygltf::Model& gltfModel, const std::string& sourcePath, uint64_t key, const std::vector<Model::PackedVertex>& packedVertices,
+	const std::vector<Model::SkinVertex>& skinVertices, const Model* a_pModel);
 Node* FindNode(Node* parent, uint32_t index);
 Node* NodeFromIndex(uint32_t index, Model* a_pModel);
 
@@ -67,6 +90,7 @@ Primitive::Primitive(uint32_t a_uFirstIndex, uint32_t a_uIndexCount, uint32_t a_
 	: firstIndex(a_uFirstIndex), indexCount(a_uIndexCount), vertexCount(a_uVertexCount), material(a_Material)
 {
 	hasIndices = indexCount > 0;
+	lods[0] = { firstIndex, indexCount, 0.0f };
 };
 
 void Primitive::setBoundingBox(glm::vec3 a_vMin, glm::vec3 a_vMax)
@@ -81,6 +105,7 @@ Mesh::Mesh(Renderer* a_pRenderer, glm::mat4 a_mMatrix)
 {
 	this->pRenderer = a_pRenderer;
 	this->uniformBlock.matrix = a_mMatrix;
+	this->uniformBlock.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(a_mMatrix))));
 	
 	uniformBuffer = new Buffer();
 	uniformBuffer->desc = {
@@ -89,12 +114,13 @@ Mesh::Mesh(Renderer* a_pRenderer, glm::mat4 a_mMatrix)
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		(void*)(&uniformBlock)
 	};
-	CreateBuffer(this->pRenderer, &uniformBuffer);
+	// created by PoseNodes with the model's other buffers
 };
 
 Mesh::~Mesh()
 {
 	DestroyBuffer(pRenderer, &uniformBuffer);
+	delete pSkinPalette;
 	for (Primitive* p : primitives)
 		delete p;
 }
@@ -106,6 +132,11 @@ void Mesh::setBoundingBox(glm::vec3 a_vMin, glm::vec3 a_vMax)
 	bb.valid = true;
 }
 
+void Mesh::createSkinPalette()
+{
+	pSkinPalette = new SkinPalette();
+}
+
 // Node
 glm::mat4 Node::localMatrix()
 {
@@ -128,9 +159,10 @@ void Node::update()
 	if (mesh)
 	{
 		glm::mat4 m = getMatrix();
-		if (skin)
+		mesh->uniformBlock.matrix = m;
+		mesh->uniformBlock.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(m))));
+		if (skin && mesh->pSkinPalette)
 		{
-			mesh->uniformBlock.matrix = m;
 			// Update join matrices
 			glm::mat4 inverseTransform = glm::inverse(m);
 			size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
@@ -139,13 +171,14 @@ void Node::update()
 				Node* jointNode = skin->joints[i];
 				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
 				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
+				mesh->pSkinPalette->jointMatrix[i] = jointMat;
+				mesh->pSkinPalette->jointNormalMatrix[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(jointMat))));
 			}
 			mesh->uniformBlock.jointcount = (float)numJoints;
 			UpdateBuffer(mesh->pRenderer, mesh->uniformBuffer, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
 		}
 		else
-			UpdateBuffer(mesh->pRenderer, mesh->uniformBuffer, &m, sizeof(glm::mat4));
+			UpdateBuffer(mesh->pRenderer, mesh->uniformBuffer, &mesh->uniformBlock, sizeof(glm::mat4) * 2);
 	}
 
 	for (Node* child : children)
@@ -162,91 +195,298 @@ Node::~Node()
 
 // Model
 
+// what LoadModelFromFile leaves to CreateModelResources, the texture descs and the vertex pointers refer to it
+struct ModelUpload
+{
+	// packed on a glTF load, a cooked one points into its file
+	std::vector<Model::PackedVertex>		packedVertices;
+	std::vector<Model::SkinVertex>			skinVertices;
+	const Model::PackedVertex*				pVertices;
+	uint32_t								vertexCount;
+	// nullptr for models without skins
+	const Model::SkinVertex*				pSkinVertices;
+	// RGBA8 images decoded from the glTF file, one per image textures use
+	std::vector<std::vector<unsigned char>>	images;
+	MappedFile								file;
+	// Model::textures before this one exist
+	uint32_t								createdTextures;
+	bool									createdSamplers;
+
+	ModelUpload() :
+		packedVertices(), skinVertices(), pVertices(nullptr), vertexCount(0), pSkinVertices(nullptr), images(), file(), createdTextures(0),
+		createdSamplers(false)
+	{}
+};
+
+static void ReleaseModelUpload(Model* a_pModel)
+{
+	if (a_pModel->pUpload && a_pModel->pUpload->file.pData) {
+		UnmapFile(&a_pModel->pUpload->file);
+	}
+	delete a_pModel->pUpload;
+	a_pModel->pUpload = nullptr;
+}
+
+// encoded bytes of an image, decoded on the job system once the whole file is parsed
+struct PendingGltfImage
+{
+	int							imageIndex;
+	int							requiredWidth;
+	int							requiredHeight;
+	std::vector<unsigned char>	bytes;
+	std::string					error;
+	bool						decoded;
+};
+
+struct GltfImageLoader
+{
+	Renderer*						pRenderer;
+	std::string						baseDirectory;
+	tinygltf::Model*				pGltfModel;
+	std::vector<PendingGltfImage>	pendingImages;
+};
+
+// external images with a block compressed copy the device can sample aren't decoded, LoadTextures creates them from the file.
+// the rest are only copied here, tinygltf parses serially and DecodeGltfImages decodes them all at once
+static bool LoadGltfImage(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int requiredWidth, int requiredHeight,
+	const unsigned char* bytes, int size, void* userData)
+{
+	GltfImageLoader* pLoader = (GltfImageLoader*)userData;
+	if (!image->uri.empty() && !FindCompressedTexture(pLoader->pRenderer, pLoader->baseDirectory + image->uri).empty()) {
+		return true;
+	}
+	pLoader->pendingImages.push_back({ imageIndex, requiredWidth, requiredHeight, std::vector<unsigned char>(bytes, bytes + size), std::string(), false });
+	return true;
+}
+
+static void DecodeGltfImage(void* a_pData, uint32_t a_uIndex)
+{
+	GltfImageLoader* pLoader = (GltfImageLoader*)a_pData;
+	PendingGltfImage& pending = pLoader->pendingImages[a_uIndex];
+	std::string warning;
+	pending.decoded = tinygltf::LoadImageData(&pLoader->pGltfModel->images[pending.imageIndex], pending.imageIndex, &pending.error, &warning,
+		pending.requiredWidth, pending.requiredHeight, pending.bytes.data(), (int)pending.bytes.size(), nullptr);
+	std::vector<unsigned char>().swap(pending.bytes);
+}
+
+// one job per image, false like a failed parse when one of them can't be decoded
+static bool DecodeGltfImages(GltfImageLoader* a_pLoader, tinygltf::Model* a_pGltfModel, std::string* a_pError)
+{
+	a_pLoader->pGltfModel = a_pGltfModel;
+	JobCounter counter;
+	RunJobs(DecodeGltfImage, a_pLoader, (uint32_t)a_pLoader->pendingImages.size(), &counter);
+	WaitForJobs(&counter);
+
+	bool decoded = true;
+	for (const PendingGltfImage& pending : a_pLoader->pendingImages) {
+		if (!pending.decoded) {
+			*a_pError += pending.error;
+			decoded = false;
+		}
+	}
+	return decoded;
+}
+
+// gltf files and their buffers are read through the FileSystem so they can come from mounted archives
+static bool GltfFileExists(const std::string& a_sPath, void*)
+{
+	return ExistFile(a_sPath.c_str());
+}
+
+static std::string ExpandGltfFilePath(const std::string& a_sPath, void*)
+{
+	return a_sPath;
+}
+
+static bool ReadGltfFile(std::vector<unsigned char>* a_pData, std::string* a_pError, const std::string& a_sPath, void*)
+{
+	MappedFile file = {};
+	if (!MapFile(a_sPath.c_str(), &file)) {
+		if (a_pError) {
+			*a_pError += "File open error : " + a_sPath + "\n";
+		}
+		return false;
+	}
+
+	const unsigned char* pData = (const unsigned char*)file.pData;
+	a_pData->assign(pData, pData + file.size);
+	UnmapFile(&file);
+	return true;
+}
+
+// vertex and index ranges LoadNode gives each primitive, filled by LoadPrimitive jobs
+struct GltfPrimitiveLoad
+{
+	const tinygltf::Primitive*	pPrimitive;
+	uint32_t					firstVertex;
+	uint32_t					firstIndex;
+};
+
+struct GltfMeshLoader
+{
+	const tinygltf::Model*			pGltfModel;
+	Model*							pModel;
+	std::vector<GltfPrimitiveLoad>	primitives;
+	uint32_t						vertexCount;
+	uint32_t						indexCount;
+};
+
 void CreateModelFromFile(Renderer* a_pRenderer, std::string a_sFilename, Model* a_pModel, float a_fScale)
 {
+	if (LoadModelFromFile(a_pRenderer, a_sFilename, a_pModel, a_fScale)) {
+		CreateModelResources(a_pModel);
+	}
+}
+
+bool LoadModelFromFile(Renderer* a_pRenderer, std::string a_sFilename, Model* a_pModel, float a_fScale)
+{
+	a_pModel->pRenderer = a_pRenderer;
+	a_pModel->pUpload = new ModelUpload();
+
+	// a cooked model is only loaded when it was built from this source with these options
+	const struct {
+		Model::LodDesc lodDesc;
+		Model::AnimationDesc animationDesc;
+		float scale;
+	} cookOptions = { a_pModel->lodDesc, a_pModel->animationDesc, a_fScale };
+	const uint64_t cookKey = ComputeModelFileKey(a_sFilename.c_str(), &cookOptions, sizeof(cookOptions));
+	if (cookKey && LoadCookedModel(a_pRenderer, a_sFilename, cookKey, a_pModel)) {
+		return true;
+	}
+
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
 	std::string error;
 	std::string warning;
 
-	a_pModel->pRenderer = a_pRenderer;
-
 	bool binary = false;
 	size_t extpos = a_sFilename.rfind('.', a_sFilename.length());
 	if (extpos != std::string::npos) {
 		binary = (a_sFilename.substr(extpos + 1, a_sFilename.length() - extpos) == "glb");
 	}
 
-	bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, a_sFilename.c_str()) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, a_sFilename.c_str());
+	GltfImageLoader imageLoader = { a_pRenderer, a_sFilename.substr(0, a_sFilename.find_last_of("/\\") + 1), nullptr, {} };
+	gltfContext.SetImageLoader(LoadGltfImage, &imageLoader);
+	gltfContext.SetFsCallbacks({ GltfFileExists, ExpandGltfFilePath, ReadGltfFile, tinygltf::WriteWholeFile, nullptr });
 
-	std::vector<uint32_t> indexBuffer;
+	bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, a_sFilename.c_str()) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, a_sFilename.c_str());
+	fileLoaded = fileLoaded && DecodeGltfImages(&imageLoader, &gltfModel, &error);
 
 	if (fileLoaded) {
-		LoadTextureSamplers(a_pRenderer, gltfModel, a_pModel);
-		LoadTextures(a_pModel->pRenderer, gltfModel, a_pModel);
+		LoadTextureSamplers(gltfModel, a_pModel);
+		LoadTextures(gltfModel, imageLoader.baseDirectory, a_pModel);
 		LoadMaterials(gltfModel, a_pModel);
 		// TODO: scene handling with no default scene
 		const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+		GltfMeshLoader meshLoader = { &gltfModel, a_pModel, {}, 0, 0 };
 		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			LoadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, a_pModel->vertexBuffer, a_fScale, a_pModel);
+			const tinygltf::Node& node = gltfModel.nodes[scene.nodes[i]];
+			LoadNode(nullptr, node, scene.nodes[i], gltfModel, meshLoader, a_fScale, a_pModel);
 		}
+		// every primitive has its range now, they are read in parallel
+		a_pModel->vertexBuffer.resize(meshLoader.vertexCount);
+		a_pModel->indexBuffer.resize(meshLoader.indexCount);
+		JobCounter primitiveCounter;
+		RunJobs(LoadPrimitive, &meshLoader, (uint32_t)meshLoader.primitives.size(), &primitiveCounter);
+		WaitForJobs(&primitiveCounter);
 		if (gltfModel.animations.size() > 0) {
 			LoadAnimations(gltfModel, a_pModel);
+			CompressAnimations(a_pModel);
 		}
 		LoadSkins(gltfModel, a_pModel);
-
-		for (Node* node : a_pModel->linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = a_pModel->skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
-		}
+		OptimizeMeshes(a_pModel);
+		GenerateLods(a_pModel);
 	}
 	else {
 		LOG(LogSeverity::ERR, "Could not load gltf file: %s", error.c_str());
-		return;
+		return false;
 	}
 
 	a_pModel->extensions = gltfModel.extensionsUsed;
 
-	a_pModel->vertices = new Buffer();
-	a_pModel->indices = new Buffer();
+	// the meshes PoseNodes gives a skin buffer
+	bool skinned = false;
+	for (Node* node : a_pModel->linearNodes) {
+		skinned = skinned || (node->mesh && node->skinIndex > -1);
+	}
 
-	size_t vertexBufferSize = a_pModel->vertexBuffer.size() * sizeof(Model::Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
+	ModelUpload* pUpload = a_pModel->pUpload;
+	std::vector<Model::PackedVertex>& packedVertices = pUpload->packedVertices;
+	std::vector<Model::SkinVertex>& skinVertices = pUpload->skinVertices;
+	PackVertices(a_pModel, skinned, packedVertices, skinVertices);
 
-	assert(vertexBufferSize > 0);
+	a_pModel->positions.resize(a_pModel->vertexBuffer.size());
+	for (size_t v = 0; v < a_pModel->vertexBuffer.size(); ++v) {
+		a_pModel->positions[v] = a_pModel->vertexBuffer[v].pos;
+	}
 
-	// Vertex data
-	a_pModel->vertices->desc.bufferUsageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	a_pModel->vertices->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	a_pModel->vertices->desc.bufferSize = vertexBufferSize;
-	a_pModel->vertices->desc.pData = a_pModel->vertexBuffer.data();
-	CreateBuffer(a_pModel->pRenderer, &a_pModel->vertices);
+	LOG(LogSeverity::INFO, "Vertex data: %u -> %u bytes", (uint32_t)(a_pModel->vertexBuffer.size() * sizeof(Model::Vertex)),
+		(uint32_t)(packedVertices.size() * sizeof(Model::PackedVertex) + skinVertices.size() * sizeof(Model::SkinVertex)));
+	std::vector<Model::Vertex>().swap(a_pModel->vertexBuffer);
 
-	// Index data
-	if (indexBufferSize > 0) {
-		a_pModel->indices->desc.bufferUsageFlags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-		a_pModel->indices->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		a_pModel->indices->desc.bufferSize = indexBufferSize;
-		a_pModel->indices->desc.pData = indexBuffer.data();
-		CreateBuffer(a_pModel->pRenderer, &a_pModel->indices);
+	if (cookKey) {
+		CookModel(gltfModel, a_sFilename, cookKey, packedVertices, skinVertices, a_pModel);
 	}
 
+	pUpload->pVertices = packedVertices.data();
+	pUpload->vertexCount = (uint32_t)packedVertices.size();
+	pUpload->pSkinVertices = skinned ? skinVertices.data() : nullptr;
 	GetSceneDimensions(a_pModel);
+	return true;
+}
+
+bool CreateModelResources(Model* a_pModel, uint32_t* a_pUploadBudget)
+{
+	ModelUpload* pUpload = a_pModel->pUpload;
+	if (!pUpload) {
+		return true;
+	}
+
+	if (!pUpload->createdSamplers) {
+		for (Sampler*& pSampler : a_pModel->samplers) {
+			CreateSampler(a_pModel->pRenderer, &pSampler);
+		}
+		pUpload->createdSamplers = true;
+	}
+
+	// every texture waits for the queue, large models spread them over a few calls
+	for (; pUpload->createdTextures < (uint32_t)a_pModel->textures.size(); ++pUpload->createdTextures) {
+		if (a_pUploadBudget && *a_pUploadBudget == 0) {
+			return false;
+		}
+		Texture*& pTexture = a_pModel->textures[pUpload->createdTextures]->texture;
+		CreateTexture(a_pModel->pRenderer, &pTexture);
+		pTexture->desc.rawData = nullptr;
+		if (a_pUploadBudget) {
+			--*a_pUploadBudget;
+		}
+	}
+
+	if (a_pUploadBudget) {
+		if (*a_pUploadBudget == 0) {
+			return false;
+		}
+		--*a_pUploadBudget;
+	}
+	PoseNodes(a_pModel);
+	CreateModelBuffers(a_pModel, pUpload->pVertices, pUpload->vertexCount, pUpload->pSkinVertices);
+	ReleaseModelUpload(a_pModel);
+	return true;
 }
 
 void DestroyModel(Model* a_pModel)
 {
-	if (a_pModel->vertices->buffer != VK_NULL_HANDLE) {
+	// a model that was never created only holds descriptions, destroying their null handles does nothing
+	ReleaseModelUpload(a_pModel);
+	if (a_pModel->vertices && a_pModel->vertices->buffer != VK_NULL_HANDLE) {
 		DestroyBuffer(a_pModel->pRenderer, &a_pModel->vertices);
 	}
-	if (a_pModel->indices->buffer != VK_NULL_HANDLE) {
+	if (a_pModel->skinVertices) {
+		DestroyBuffer(a_pModel->pRenderer, &a_pModel->skinVertices);
+		delete a_pModel->skinVertices;
+		a_pModel->skinVertices = nullptr;
+	}
+	if (a_pModel->indices && a_pModel->indices->buffer != VK_NULL_HANDLE) {
 		DestroyBuffer(a_pModel->pRenderer, &a_pModel->indices);
 		a_pModel->indices->buffer = VK_NULL_HANDLE;
 	}
@@ -282,7 +522,7 @@ void DestroyModel(Model* a_pModel)
 };
 
 void LoadNode(Node* a_Parent, const tinygltf::Node& a_Node, uint32_t a_uNodeIndex, const tinygltf::Model& a_Model,
-					 std::vector<uint32_t>& a_IndexBuffer, std::vector<Model::Vertex>& a_VertexBuffer, float a_fGlobalscale, Model* a_pModel)
+					 GltfMeshLoader& a_MeshLoader, float a_fGlobalscale, Model* a_pModel)
 {
 	Node* newNode = new Node{};
 	newNode->index = a_uNodeIndex;
@@ -313,167 +553,32 @@ void LoadNode(Node* a_Parent, const tinygltf::Node& a_Node, uint32_t a_uNodeInde
 	// Node with children
 	if (a_Node.children.size() > 0) {
 		for (size_t i = 0; i < a_Node.children.size(); i++) {
-			LoadNode(newNode, a_Model.nodes[a_Node.children[i]], a_Node.children[i], a_Model, a_IndexBuffer, a_VertexBuffer, a_fGlobalscale, a_pModel);
+			LoadNode(newNode, a_Model.nodes[a_Node.children[i]], a_Node.children[i], a_Model, a_MeshLoader, a_fGlobalscale, a_pModel);
 		}
 	}
 
-	// Node contains mesh data
+	// Node contains mesh data, only the ranges of its primitives are reserved here and LoadPrimitive reads them
 	if (a_Node.mesh > -1) {
-		const tinygltf::Mesh mesh = a_Model.meshes[a_Node.mesh];
+		const tinygltf::Mesh& mesh = a_Model.meshes[a_Node.mesh];
 		Mesh* newMesh = new Mesh(a_pModel->pRenderer, newNode->matrix);
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive& primitive = mesh.primitives[j];
-			uint32_t indexStart = static_cast<uint32_t>(a_IndexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(a_VertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			bool hasIndices = primitive.indices > -1;
-			// Vertices
-			{
-				const float* bufferPos = nullptr;
-				const float* bufferNormals = nullptr;
-				const float* bufferTexCoordSet0 = nullptr;
-				const float* bufferTexCoordSet1 = nullptr;
-				const void* bufferJoints = nullptr;
-				const float* bufferWeights = nullptr;
-
-				int posByteStride;
-				int normByteStride;
-				int uv0ByteStride;
-				int uv1ByteStride;
-				int jointByteStride;
-				int weightByteStride;
-
-				int jointComponentType;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor& posAccessor = a_Model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView& posView = a_Model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float*>(&(a_Model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-				posByteStride = posAccessor.ByteStride(posView) ? (posAccessor.ByteStride(posView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC3);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor& normAccessor = a_Model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView& normView = a_Model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float*>(&(a_Model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-					normByteStride = normAccessor.ByteStride(normView) ? (normAccessor.ByteStride(normView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC3);
-				}
-
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& uvAccessor = a_Model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView& uvView = a_Model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoordSet0 = reinterpret_cast<const float*>(&(a_Model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-					uv0ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC2);
-				}
-				if (primitive.attributes.find("TEXCOORD_1") != primitive.attributes.end()) {
-					const tinygltf::Accessor& uvAccessor = a_Model.accessors[primitive.attributes.find("TEXCOORD_1")->second];
-					const tinygltf::BufferView& uvView = a_Model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoordSet1 = reinterpret_cast<const float*>(&(a_Model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-					uv1ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC2);
-				}
-
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& jointAccessor = a_Model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView& jointView = a_Model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = &(a_Model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]);
-					jointComponentType = jointAccessor.componentType;
-					jointByteStride = jointAccessor.ByteStride(jointView) ? (jointAccessor.ByteStride(jointView) / tinygltf::GetComponentSizeInBytes(jointComponentType)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC4);
-				}
-
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor& weightAccessor = a_Model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView& weightView = a_Model.bufferViews[weightAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float*>(&(a_Model.buffers[weightView.buffer].data[weightAccessor.byteOffset + weightView.byteOffset]));
-					weightByteStride = weightAccessor.ByteStride(weightView) ? (weightAccessor.ByteStride(weightView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC4);
-				}
-
-				hasSkin = (bufferJoints && bufferWeights);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Model::Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * posByteStride]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normByteStride]) : glm::vec3(0.0f)));
-					vert.uv0 = bufferTexCoordSet0 ? glm::make_vec2(&bufferTexCoordSet0[v * uv0ByteStride]) : glm::vec3(0.0f);
-					vert.uv1 = bufferTexCoordSet1 ? glm::make_vec2(&bufferTexCoordSet1[v * uv1ByteStride]) : glm::vec3(0.0f);
-
-					if (hasSkin)
-					{
-						switch (jointComponentType) {
-						case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-							const uint16_t* buf = static_cast<const uint16_t*>(bufferJoints);
-							vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-							break;
-						}
-						case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-							const uint8_t* buf = static_cast<const uint8_t*>(bufferJoints);
-							vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-							break;
-						}
-						default:
-							// Not supported by spec
-							LOG(LogSeverity::ERR, "Joint component type %d not supported!", jointComponentType);
-							break;
-						}
-					}
-					else {
-						vert.joint0 = glm::vec4(0.0f);
-					}
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride]) : glm::vec4(0.0f);
-					// Fix for all zero weights
-					if (glm::length(vert.weight0) == 0.0f) {
-						vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
-					}
-					a_VertexBuffer.push_back(vert);
-				}
-			}
-			// Indices
-			if (hasIndices)
-			{
-				const tinygltf::Accessor& accessor = a_Model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-				const tinygltf::BufferView& bufferView = a_Model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer& buffer = a_Model.buffers[bufferView.buffer];
-
-				indexCount = static_cast<uint32_t>(accessor.count);
-				const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+
+			const tinygltf::Accessor& posAccessor = a_Model.accessors[primitive.attributes.find("POSITION")->second];
+			const uint32_t vertexCount = static_cast<uint32_t>(posAccessor.count);
+			const uint32_t indexCount = primitive.indices > -1 ? static_cast<uint32_t>(a_Model.accessors[primitive.indices].count) : 0;
+			const glm::vec3 posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+			const glm::vec3 posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+			const uint32_t indexStart = a_MeshLoader.indexCount;
+			const uint32_t vertexStart = a_MeshLoader.vertexCount;
+			a_MeshLoader.primitives.push_back({ &primitive, vertexStart, indexStart });
+			a_MeshLoader.indexCount += indexCount;
+			a_MeshLoader.vertexCount += vertexCount;
 
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					const uint32_t* buf = static_cast<const uint32_t*>(dataPtr);
-					for (size_t index = 0; index < accessor.count; index++) {
-						a_IndexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
-					for (size_t index = 0; index < accessor.count; index++) {
-						a_IndexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
-					for (size_t index = 0; index < accessor.count; index++) {
-						a_IndexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				default:
-					LOG(LogSeverity::ERR, "Index component type %d not supported!", accessor.componentType);
-					return;
-				}
-			}
 			Primitive* newPrimitive = new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? a_pModel->materials[primitive.material] : a_pModel->materials.back());
+			newPrimitive->firstVertex = vertexStart;
 			newPrimitive->setBoundingBox(posMin, posMax);
 			newMesh->primitives.push_back(newPrimitive);
 		}
@@ -497,6 +602,154 @@ void LoadNode(Node* a_Parent, const tinygltf::Node& a_Node, uint32_t a_uNodeInde
 	a_pModel->linearNodes.push_back(newNode);
 }
 
+// reads one primitive into the range LoadNode reserved for it, primitives don't share anything while they are read
+void LoadPrimitive(void* a_pMeshLoader, uint32_t a_uPrimitiveIndex)
+{
+	const GltfMeshLoader* pLoader = (const GltfMeshLoader*)a_pMeshLoader;
+	const GltfPrimitiveLoad& load = pLoader->primitives[a_uPrimitiveIndex];
+	const tinygltf::Model& model = *pLoader->pGltfModel;
+	const tinygltf::Primitive& primitive = *load.pPrimitive;
+	Model::Vertex* pVertices = pLoader->pModel->vertexBuffer.data() + load.firstVertex;
+	uint32_t* pIndices = pLoader->pModel->indexBuffer.data() + load.firstIndex;
+	bool hasSkin = false;
+
+	// Vertices
+	{
+		const float* bufferPos = nullptr;
+		const float* bufferNormals = nullptr;
+		const float* bufferTexCoordSet0 = nullptr;
+		const float* bufferTexCoordSet1 = nullptr;
+		const void* bufferJoints = nullptr;
+		const float* bufferWeights = nullptr;
+
+		int posByteStride;
+		int normByteStride;
+		int uv0ByteStride;
+		int uv1ByteStride;
+		int jointByteStride;
+		int weightByteStride;
+
+		int jointComponentType;
+
+		const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+		const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
+		bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+		posByteStride = posAccessor.ByteStride(posView) ? (posAccessor.ByteStride(posView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC3);
+
+		if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
+			const tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
+			const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
+			bufferNormals = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+			normByteStride = normAccessor.ByteStride(normView) ? (normAccessor.ByteStride(normView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC3);
+		}
+
+		if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
+			const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferTexCoordSet0 = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+			uv0ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC2);
+		}
+		if (primitive.attributes.find("TEXCOORD_1") != primitive.attributes.end()) {
+			const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_1")->second];
+			const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferTexCoordSet1 = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+			uv1ByteStride = uvAccessor.ByteStride(uvView) ? (uvAccessor.ByteStride(uvView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC2);
+		}
+
+		// Skinning
+		// Joints
+		if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+			const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
+			bufferJoints = &(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]);
+			jointComponentType = jointAccessor.componentType;
+			jointByteStride = jointAccessor.ByteStride(jointView) ? (jointAccessor.ByteStride(jointView) / tinygltf::GetComponentSizeInBytes(jointComponentType)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC4);
+		}
+
+		if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor& weightAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+			const tinygltf::BufferView& weightView = model.bufferViews[weightAccessor.bufferView];
+			bufferWeights = reinterpret_cast<const float*>(&(model.buffers[weightView.buffer].data[weightAccessor.byteOffset + weightView.byteOffset]));
+			weightByteStride = weightAccessor.ByteStride(weightView) ? (weightAccessor.ByteStride(weightView) / sizeof(float)) : tinygltf::GetTypeSizeInBytes(TINYGLTF_TYPE_VEC4);
+		}
+
+		hasSkin = (bufferJoints && bufferWeights);
+
+		for (size_t v = 0; v < posAccessor.count; v++) {
+			Model::Vertex vert{};
+			vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * posByteStride]), 1.0f);
+			vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normByteStride]) : glm::vec3(0.0f)));
+			vert.uv0 = bufferTexCoordSet0 ? glm::make_vec2(&bufferTexCoordSet0[v * uv0ByteStride]) : glm::vec3(0.0f);
+			vert.uv1 = bufferTexCoordSet1 ? glm::make_vec2(&bufferTexCoordSet1[v * uv1ByteStride]) : glm::vec3(0.0f);
+
+			if (hasSkin)
+			{
+				switch (jointComponentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+					const uint16_t* buf = static_cast<const uint16_t*>(bufferJoints);
+					vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
+					break;
+				}
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+					const uint8_t* buf = static_cast<const uint8_t*>(bufferJoints);
+					vert.joint0 = glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
+					break;
+				}
+				default:
+					// Not supported by spec
+					LOG(LogSeverity::ERR, "Joint component type %d not supported!", jointComponentType);
+					break;
+				}
+			}
+			else {
+				vert.joint0 = glm::vec4(0.0f);
+			}
+			vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride]) : glm::vec4(0.0f);
+			// Fix for all zero weights
+			if (glm::length(vert.weight0) == 0.0f) {
+				vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+			}
+			pVertices[v] = vert;
+		}
+	}
+	// Indices
+	if (primitive.indices > -1)
+	{
+		const tinygltf::Accessor& accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
+		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+
+		const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+
+		switch (accessor.componentType) {
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+			const uint32_t* buf = static_cast<const uint32_t*>(dataPtr);
+			for (size_t index = 0; index < accessor.count; index++) {
+				pIndices[index] = buf[index] + load.firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+			const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
+			for (size_t index = 0; index < accessor.count; index++) {
+				pIndices[index] = buf[index] + load.firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+			const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
+			for (size_t index = 0; index < accessor.count; index++) {
+				pIndices[index] = buf[index] + load.firstVertex;
+			}
+			break;
+		}
+		default:
+			LOG(LogSeverity::ERR, "Index component type %d not supported!", accessor.componentType);
+			return;
+		}
+	}
+}
+
 void LoadSkins(tinygltf::Model& a_GltfModel, Model* a_pModel)
 {
 	for (tinygltf::Skin& source : a_GltfModel.skins) {
@@ -529,70 +782,745 @@ void LoadSkins(tinygltf::Model& a_GltfModel, Model* a_pModel)
 	}
 }
 
-void LoadTextures(Renderer* a_pRenderer, tinygltf::Model& a_GltfModel, Model* a_pModel)
+// Most devices don't support RGB only on Vulkan so convert if necessary
+// TODO: Check actual format support and transform only if required
+static void AppendRgbaPixels(const tinygltf::Image& a_Image, std::vector<unsigned char>& a_Pixels)
 {
-	a_pModel->pRenderer = a_pRenderer;
+	if (a_Image.component != 3) {
+		a_Pixels.insert(a_Pixels.end(), a_Image.image.begin(), a_Image.image.end());
+		return;
+	}
+	const size_t offset = a_Pixels.size();
+	a_Pixels.resize(offset + (size_t)a_Image.width * a_Image.height * 4);
+	unsigned char* rgba = &a_Pixels[offset];
+	const unsigned char* rgb = a_Image.image.data();
+	for (int32_t i = 0; i < a_Image.width * a_Image.height; ++i) {
+		for (int32_t j = 0; j < 3; ++j) {
+			rgba[j] = rgb[j];
+		}
+		rgba[3] = 255;
+		rgba += 4;
+		rgb += 3;
+	}
+}
+
+// a_pSampler nullptr for the default sampler, a_sFilePath set for textures created from their file instead of a_pPixels.
+// a_pPixels have to stay valid until CreateModelResources
+void AddModelTexture(Sampler* a_pSampler, const std::string& a_sFilePath, const void* a_pPixels, uint64_t a_uSize, uint32_t a_uWidth, uint32_t a_uHeight,
+	Model* a_pModel)
+{
+	Sampler* pTextureSampler = a_pSampler;
+	if (!pTextureSampler) {
+		// No sampler specified, use a default one
+		pTextureSampler = new Sampler();
+		pTextureSampler->desc.magFilter = VK_FILTER_LINEAR;
+		pTextureSampler->desc.minFilter = VK_FILTER_LINEAR;
+		pTextureSampler->desc.mipMapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		pTextureSampler->desc.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		pTextureSampler->desc.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		pTextureSampler->desc.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	}
+
+	Texture* pTexture = new Texture();
+	pTexture->desc.filePath = a_sFilePath;
+	pTexture->desc.rawData = (void*)a_pPixels;
+	pTexture->desc.rawDataSize = a_uSize;
+	pTexture->desc.width = a_uWidth;
+	pTexture->desc.height = a_uHeight;
+	pTexture->desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+	pTexture->desc.tiling = VK_IMAGE_TILING_OPTIMAL;
+	pTexture->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	pTexture->desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	pTexture->desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	pTexture->desc.aspectBits = VK_IMAGE_ASPECT_COLOR_BIT;
+	pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	pTexture->desc.mipMaps = true;
+	// larger levels are read once the app asks for them, see TextureStreaming.h
+	pTexture->desc.streamed = true;
+
+	TextureSampler* pModelTexture = new TextureSampler();
+	pModelTexture->texture = pTexture;
+	pModelTexture->sampler = pTextureSampler;
+	a_pModel->textures.push_back(pModelTexture);
+}
+
+void LoadTextures(tinygltf::Model& a_GltfModel, const std::string& a_sBaseDirectory, Model* a_pModel)
+{
+	// decoded pixels move to the upload once, textures sharing an image share them
+	std::vector<std::vector<unsigned char>>& images = a_pModel->pUpload->images;
+	std::vector<int32_t> uploadImages(a_GltfModel.images.size(), -1);
+	images.reserve(a_GltfModel.images.size());
 
 	for (tinygltf::Texture& tex : a_GltfModel.textures) {
-		tinygltf::Image image = a_GltfModel.images[tex.source];
-		Sampler* pTextureSampler = nullptr;
-		if (tex.sampler == -1) {
-			// No sampler specified, use a default one
-			pTextureSampler = new Sampler();
-			pTextureSampler->desc.magFilter = VK_FILTER_LINEAR;
-			pTextureSampler->desc.minFilter = VK_FILTER_LINEAR;
-			pTextureSampler->desc.mipMapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-			pTextureSampler->desc.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			pTextureSampler->desc.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			pTextureSampler->desc.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		tinygltf::Image& image = a_GltfModel.images[tex.source];
+
+		const unsigned char* buffer = nullptr;
+		VkDeviceSize bufferSize = 0;
+		std::string filePath;
+		if (image.image.empty() && !image.uri.empty()) {
+			// skipped by LoadGltfImage, CreateTexture loads the compressed copy
+			filePath = a_sBaseDirectory + image.uri;
 		}
 		else {
-			pTextureSampler = a_pModel->samplers[tex.sampler];
+			if (uploadImages[tex.source] < 0) {
+				uploadImages[tex.source] = (int32_t)images.size();
+				images.emplace_back();
+				if (image.component == 3) {
+					AppendRgbaPixels(image, images.back());
+				}
+				else {
+					images.back().swap(image.image);
+				}
+			}
+			buffer = images[uploadImages[tex.source]].data();
+			bufferSize = images[uploadImages[tex.source]].size();
 		}
 
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (image.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = image.width * image.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &image.image[0];
-			for (int32_t i = 0; i < image.width * image.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
+		AddModelTexture(tex.sampler == -1 ? nullptr : a_pModel->samplers[tex.sampler], filePath, buffer, bufferSize,
+			(uint32_t)image.width, (uint32_t)image.height, a_pModel);
+	}
+}
+
+void CreateModelBuffers(Model* a_pModel, const Model::PackedVertex* a_pVertices, uint32_t a_uVertexCount, const Model::SkinVertex* a_pSkinVertices)
+{
+	a_pModel->vertices = new Buffer();
+	a_pModel->indices = new Buffer();
+
+	const bool skinned = a_pSkinVertices != nullptr;
+	size_t vertexBufferSize = a_uVertexCount * sizeof(Model::PackedVertex);
+	size_t indexBufferSize = a_pModel->indexBuffer.size() * sizeof(uint32_t);
+
+	assert(vertexBufferSize > 0);
+
+	// Vertex data, skinned models read it in the skinning compute pass
+	a_pModel->vertices->desc.bufferUsageFlags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (skinned ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+	a_pModel->vertices->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	a_pModel->vertices->desc.bufferSize = vertexBufferSize;
+	a_pModel->vertices->desc.pData = (void*)a_pVertices;
+	CreateBuffer(a_pModel->pRenderer, &a_pModel->vertices);
+	a_pModel->vertices->desc.pData = nullptr;
+
+	// the skinning pass poses every entity into a buffer of the renderer, the model only keeps the weights
+	if (skinned) {
+		a_pModel->skinVertices = new Buffer();
+		a_pModel->skinVertices->desc.bufferUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		a_pModel->skinVertices->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		a_pModel->skinVertices->desc.bufferSize = a_uVertexCount * sizeof(Model::SkinVertex);
+		a_pModel->skinVertices->desc.pData = (void*)a_pSkinVertices;
+		CreateBuffer(a_pModel->pRenderer, &a_pModel->skinVertices);
+		a_pModel->skinVertices->desc.pData = nullptr;
+	}
+
+	// Index data
+	if (indexBufferSize > 0) {
+		a_pModel->indices->desc.bufferUsageFlags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		a_pModel->indices->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		a_pModel->indices->desc.bufferSize = indexBufferSize;
+		a_pModel->indices->desc.pData = a_pModel->indexBuffer.data();
+		CreateBuffer(a_pModel->pRenderer, &a_pModel->indices);
+	}
+}
+
+// creates the mesh buffers, assigns skins and uploads the initial pose of every mesh
+void PoseNodes(Model* a_pModel)
+{
+	for (Node* node : a_pModel->linearNodes) {
+		if (node->mesh) {
+			CreateBuffer(a_pModel->pRenderer, &node->mesh->uniformBuffer);
+		}
+		// Assign skins
+		if (node->skinIndex > -1) {
+			node->skin = a_pModel->skins[node->skinIndex];
+			if (node->mesh) {
+				node->mesh->createSkinPalette();
+			}
+		}
+		// Initial pose
+		if (node->mesh) {
+			node->update();
+		}
+	}
+}
+
+// Cooked model
+
+static_assert(MAX_PRIMITIVE_LODS == MODEL_FILE_MAX_LODS, "ModelFilePrimitive holds every lod");
+
+#if defined(__ANDROID_API__)
+// assets are read only, models cooked at runtime go to internal storage under a flat name
+static std::string GetCookedModelUserFileName(const std::string& a_sSourcePath)
+{
+	std::string name = GetModelFilePath(a_sSourcePath);
+	std::replace(name.begin(), name.end(), '/', '_');
+	std::replace(name.begin(), name.end(), '\\', '_');
+	return name;
+}
+#endif
+
+static bool InRange(uint64_t a_uFirst, uint64_t a_uCount, uint64_t a_uTotal)
+{
+	return a_uFirst <= a_uTotal && a_uCount <= a_uTotal - a_uFirst;
+}
+
+static bool IsValidString(ModelFileString a_String, uint32_t a_uStringCount)
+{
+	return InRange(a_String.offset, a_String.length, a_uStringCount);
+}
+
+static bool IsValidIndex(int32_t a_iIndex, uint32_t a_uCount)
+{
+	return a_iIndex == -1 || (a_iIndex >= 0 && (uint32_t)a_iIndex < a_uCount);
+}
+
+static std::string GetCookedString(const char* a_pStrings, ModelFileString a_String)
+{
+	return a_String.length ? std::string(a_pStrings + a_String.offset, a_String.length) : std::string();
+}
+
+static TextureSampler* GetCookedTexture(int32_t a_iIndex, Model* a_pModel)
+{
+	return a_iIndex < 0 ? nullptr : a_pModel->textures[a_iIndex];
+}
+
+// sections of a mapped cooked model, every index in them checked before anything is created
+struct CookedModel
+{
+	const Model::PackedVertex*			pVertices;
+	const Model::SkinVertex*			pSkinVertices;
+	const uint32_t*						pIndices;
+	const glm::vec3*					pPositions;
+	const ModelFileNode*				pNodes;
+	const ModelFilePrimitive*			pPrimitives;
+	const ModelFileMaterial*			pMaterials;
+	const ModelFileTexture*				pTextures;
+	const ModelFileSampler*				pSamplers;
+	const ModelFileSkin*				pSkins;
+	const uint32_t*						pJoints;
+	const glm::mat4*					pInverseBindMatrices;
+	const ModelFileAnimation*			pAnimations;
+	const ModelFileAnimationSampler*	pAnimationSamplers;
+	const ModelFileAnimationChannel*	pAnimationChannels;
+	const float*						pAnimationInputs;
+	const glm::vec4*					pAnimationOutputs;
+	const uint16_t*						pAnimationPackedOutputs;
+	const ModelFileString*				pExtensions;
+	const char*							pStrings;
+	const uint8_t*						pImageData;
+
+	uint32_t vertexCount, skinVertexCount, indexCount, positionCount, nodeCount, primitiveCount, materialCount, textureCount, samplerCount, skinCount,
+		jointCount, inverseBindMatrixCount, animationCount, animationSamplerCount, animationChannelCount, animationInputCount, animationOutputCount,
+		animationPackedOutputCount, extensionCount, stringCount, imageDataSize;
+};
+
+static bool GetCookedModelSections(const ModelFile* a_pFile, CookedModel* a_pModel)
+{
+	CookedModel& m = *a_pModel;
+	m.pVertices = (const Model::PackedVertex*)GetModelFileSection(a_pFile, ModelFileSectionType::VERTICES, sizeof(Model::PackedVertex), &m.vertexCount);
+	m.pSkinVertices = (const Model::SkinVertex*)GetModelFileSection(a_pFile, ModelFileSectionType::SKIN_VERTICES, sizeof(Model::SkinVertex), &m.skinVertexCount);
+	m.pIndices = (const uint32_t*)GetModelFileSection(a_pFile, ModelFileSectionType::INDICES, sizeof(uint32_t), &m.indexCount);
+	m.pPositions = (const glm::vec3*)GetModelFileSection(a_pFile, ModelFileSectionType::POSITIONS, sizeof(glm::vec3), &m.positionCount);
+	m.pNodes = (const ModelFileNode*)GetModelFileSection(a_pFile, ModelFileSectionType::NODES, sizeof(ModelFileNode), &m.nodeCount);
+	m.pPrimitives = (const ModelFilePrimitive*)GetModelFileSection(a_pFile, ModelFileSectionType::PRIMITIVES, sizeof(ModelFilePrimitive), &m.primitiveCount);
+	m.pMaterials = (const ModelFileMaterial*)GetModelFileSection(a_pFile, ModelFileSectionType::MATERIALS, sizeof(ModelFileMaterial), &m.materialCount);
+	m.pTextures = (const ModelFileTexture*)GetModelFileSection(a_pFile, ModelFileSectionType::TEXTURES, sizeof(ModelFileTexture), &m.textureCount);
+	m.pSamplers = (const ModelFileSampler*)GetModelFileSection(a_pFile, ModelFileSectionType::SAMPLERS, sizeof(ModelFileSampler), &m.samplerCount);
+	m.pSkins = (const ModelFileSkin*)GetModelFileSection(a_pFile, ModelFileSectionType::SKINS, sizeof(ModelFileSkin), &m.skinCount);
+	m.pJoints = (const uint32_t*)GetModelFileSection(a_pFile, ModelFileSectionType::JOINTS, sizeof(uint32_t), &m.jointCount);
+	m.pInverseBindMatrices = (const glm::mat4*)GetModelFileSection(a_pFile, ModelFileSectionType::INVERSE_BIND_MATRICES, sizeof(glm::mat4), &m.inverseBindMatrixCount);
+	m.pAnimations = (const ModelFileAnimation*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATIONS, sizeof(ModelFileAnimation), &m.animationCount);
+	m.pAnimationSamplers = (const ModelFileAnimationSampler*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATION_SAMPLERS, sizeof(ModelFileAnimationSampler), &m.animationSamplerCount);
+	m.pAnimationChannels = (const ModelFileAnimationChannel*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATION_CHANNELS, sizeof(ModelFileAnimationChannel), &m.animationChannelCount);
+	m.pAnimationInputs = (const float*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATION_INPUTS, sizeof(float), &m.animationInputCount);
+	m.pAnimationOutputs = (const glm::vec4*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATION_OUTPUTS, sizeof(glm::vec4), &m.animationOutputCount);
+	m.pAnimationPackedOutputs = (const uint16_t*)GetModelFileSection(a_pFile, ModelFileSectionType::ANIMATION_PACKED_OUTPUTS, sizeof(uint16_t), &m.animationPackedOutputCount);
+	m.pExtensions = (const ModelFileString*)GetModelFileSection(a_pFile, ModelFileSectionType::EXTENSIONS, sizeof(ModelFileString), &m.extensionCount);
+	m.pStrings = (const char*)GetModelFileSection(a_pFile, ModelFileSectionType::STRINGS, sizeof(char), &m.stringCount);
+	m.pImageData = (const uint8_t*)GetModelFileSection(a_pFile, ModelFileSectionType::IMAGE_DATA, sizeof(uint8_t), &m.imageDataSize);
+
+	// a model always has vertices and the default material, skin vertices and positions match the vertices one to one
+	if (!m.vertexCount || !m.materialCount || m.positionCount != m.vertexCount || (m.skinVertexCount && m.skinVertexCount != m.vertexCount)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < m.primitiveCount; ++i) {
+		const ModelFilePrimitive& primitive = m.pPrimitives[i];
+		if (primitive.material >= m.materialCount || !InRange(primitive.firstVertex, primitive.vertexCount, m.vertexCount) ||
+			!InRange(primitive.firstIndex, primitive.indexCount, m.indexCount) || !primitive.lodCount || primitive.lodCount > MAX_PRIMITIVE_LODS) {
+			return false;
+		}
+		for (uint32_t lod = 0; lod < primitive.lodCount; ++lod) {
+			if (!InRange(primitive.lodFirstIndex[lod], primitive.lodIndexCount[lod], m.indexCount)) {
+				return false;
+			}
+		}
+	}
+	// parents come after their children
+	for (uint32_t i = 0; i < m.nodeCount; ++i) {
+		const ModelFileNode& node = m.pNodes[i];
+		if ((node.parent != -1 && (node.parent < 0 || (uint32_t)node.parent <= i || (uint32_t)node.parent >= m.nodeCount)) ||
+			!IsValidIndex(node.skinIndex, m.skinCount) || !IsValidString(node.name, m.stringCount) ||
+			(node.firstPrimitive != -1 && (node.firstPrimitive < 0 || !InRange((uint32_t)node.firstPrimitive, node.primitiveCount, m.primitiveCount)))) {
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m.materialCount; ++i) {
+		const ModelFileMaterial& material = m.pMaterials[i];
+		const int32_t textures[] = { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture,
+			material.emissiveTexture, material.specularGlossinessTexture, material.diffuseTexture };
+		for (int32_t texture : textures) {
+			if (!IsValidIndex(texture, m.textureCount)) {
+				return false;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < m.textureCount; ++i) {
+		const ModelFileTexture& texture = m.pTextures[i];
+		if (!IsValidIndex(texture.sampler, m.samplerCount) || !IsValidString(texture.uri, m.stringCount) || !InRange(texture.pixelOffset, texture.pixelSize, m.imageDataSize)) {
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m.skinCount; ++i) {
+		const ModelFileSkin& skin = m.pSkins[i];
+		if (!IsValidString(skin.name, m.stringCount) || !IsValidIndex(skin.skeletonRoot, m.nodeCount) || !InRange(skin.firstJoint, skin.jointCount, m.jointCount) ||
+			!InRange(skin.firstInverseBindMatrix, skin.inverseBindMatrixCount, m.inverseBindMatrixCount)) {
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m.jointCount; ++i) {
+		if (m.pJoints[i] >= m.nodeCount) {
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m.animationCount; ++i) {
+		const ModelFileAnimation& animation = m.pAnimations[i];
+		if (!IsValidString(animation.name, m.stringCount) || !InRange(animation.firstSampler, animation.samplerCount, m.animationSamplerCount) ||
+			!InRange(animation.firstChannel, animation.channelCount, m.animationChannelCount)) {
+			return false;
+		}
+		for (uint32_t c = 0; c < animation.channelCount; ++c) {
+			const ModelFileAnimationChannel& channel = m.pAnimationChannels[animation.firstChannel + c];
+			if (channel.node >= m.nodeCount || channel.samplerIndex >= animation.samplerCount || channel.path > AnimationChannel::PathType::SCALE) {
+				return false;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < m.animationSamplerCount; ++i) {
+		const ModelFileAnimationSampler& sampler = m.pAnimationSamplers[i];
+		if (!InRange(sampler.firstInput, sampler.inputCount, m.animationInputCount) || !InRange(sampler.firstOutput, sampler.outputCount, m.animationOutputCount) ||
+			!InRange(sampler.firstPackedOutput, sampler.packedOutputCount, m.animationPackedOutputCount) ||
+			sampler.interpolation > AnimationSampler::InterpolationType::CUBICSPLINE || sampler.packedType > (uint32_t)AnimationTrackType::ROTATION) {
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m.extensionCount; ++i) {
+		if (!IsValidString(m.pExtensions[i], m.stringCount)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// builds the model from the file CookModel wrote for a_uKey, false when there is none or it is malformed and nothing was created then.
+// records become the usual model objects, the file stays mapped until CreateModelResources uploads vertices and images from it
+bool LoadCookedModel(Renderer* a_pRenderer, const std::string& a_sSourcePath, uint64_t a_uKey, Model* a_pModel)
+{
+	MappedFile mappedFile = {};
+	ModelFile file = {};
+	bool loaded = MapFile(GetModelFilePath(a_sSourcePath).c_str(), &mappedFile);
+	bool valid = loaded && ReadModelFile(mappedFile.pData, mappedFile.size, a_uKey, &file);
+#if defined(__ANDROID_API__)
+	// a model cooked on windows is packaged with the assets, stale or missing ones are cooked into internal storage
+	if (!valid) {
+		if (loaded) {
+			UnmapFile(&mappedFile);
+		}
+		loaded = MapUserFile(GetCookedModelUserFileName(a_sSourcePath).c_str(), &mappedFile);
+		valid = loaded && ReadModelFile(mappedFile.pData, mappedFile.size, a_uKey, &file);
+	}
+#endif
+	CookedModel cooked = {};
+	valid = valid && GetCookedModelSections(&file, &cooked);
+	if (!valid) {
+		if (loaded) {
+			UnmapFile(&mappedFile);
+		}
+		LOG(LogSeverity::INFO, "Cooked model miss for %s, loading the glTF file", a_sSourcePath.c_str());
+		return false;
+	}
+
+	a_pModel->pRenderer = a_pRenderer;
+
+	for (uint32_t i = 0; i < cooked.samplerCount; ++i) {
+		const ModelFileSampler& record = cooked.pSamplers[i];
+		Sampler* pSampler = new Sampler();
+		pSampler->desc.minFilter = (VkFilter)record.minFilter;
+		pSampler->desc.magFilter = (VkFilter)record.magFilter;
+		pSampler->desc.addressModeU = (VkSamplerAddressMode)record.addressModeU;
+		pSampler->desc.addressModeV = (VkSamplerAddressMode)record.addressModeV;
+		pSampler->desc.addressModeW = (VkSamplerAddressMode)record.addressModeW;
+		pSampler->desc.mipMapMode = (VkSamplerMipmapMode)record.mipMapMode;
+
+		a_pModel->samplers.push_back(pSampler);
+	}
+
+	const std::string baseDirectory = a_sSourcePath.substr(0, a_sSourcePath.find_last_of("/\\") + 1);
+	for (uint32_t i = 0; i < cooked.textureCount; ++i) {
+		const ModelFileTexture& record = cooked.pTextures[i];
+		const bool external = record.uri.length > 0;
+		AddModelTexture(record.sampler < 0 ? nullptr : a_pModel->samplers[record.sampler],
+			external ? baseDirectory + GetCookedString(cooked.pStrings, record.uri) : std::string(),
+			external ? nullptr : cooked.pImageData + record.pixelOffset, external ? 0 : record.pixelSize, record.width, record.height, a_pModel);
+	}
+
+	// complete before primitives keep references to its materials
+	a_pModel->materials.resize(cooked.materialCount);
+	for (uint32_t i = 0; i < cooked.materialCount; ++i) {
+		const ModelFileMaterial& record = cooked.pMaterials[i];
+		Material& material = a_pModel->materials[i];
+		material.alphaMode = (Material::AlphaMode)record.alphaMode;
+		material.alphaCutoff = record.alphaCutoff;
+		material.metallicFactor = record.metallicFactor;
+		material.roughnessFactor = record.roughnessFactor;
+		material.baseColorFactor = glm::make_vec4(record.baseColorFactor);
+		material.emissiveFactor = glm::make_vec4(record.emissiveFactor);
+		material.baseColorTexture = GetCookedTexture(record.baseColorTexture, a_pModel);
+		material.metallicRoughnessTexture = GetCookedTexture(record.metallicRoughnessTexture, a_pModel);
+		material.normalTexture = GetCookedTexture(record.normalTexture, a_pModel);
+		material.occlusionTexture = GetCookedTexture(record.occlusionTexture, a_pModel);
+		material.emissiveTexture = GetCookedTexture(record.emissiveTexture, a_pModel);
+		material.texCoordSets.baseColor = record.texCoordSets[0];
+		material.texCoordSets.metallicRoughness = record.texCoordSets[1];
+		material.texCoordSets.specularGlossiness = record.texCoordSets[2];
+		material.texCoordSets.normal = record.texCoordSets[3];
+		material.texCoordSets.occlusion = record.texCoordSets[4];
+		material.texCoordSets.emissive = record.texCoordSets[5];
+		material.extension.specularGlossinessTexture = GetCookedTexture(record.specularGlossinessTexture, a_pModel);
+		material.extension.diffuseTexture = GetCookedTexture(record.diffuseTexture, a_pModel);
+		material.extension.diffuseFactor = glm::make_vec4(record.diffuseFactor);
+		material.extension.specularFactor = glm::make_vec3(record.specularFactor);
+		material.pbrWorkflows.metallicRoughness = record.metallicRoughness != 0;
+		material.pbrWorkflows.specularGlossiness = record.specularGlossiness != 0;
+	}
+
+	// in linearNodes order, children are linked to their parent in the order LoadNode finished them
+	a_pModel->linearNodes.resize(cooked.nodeCount);
+	for (uint32_t i = 0; i < cooked.nodeCount; ++i) {
+		a_pModel->linearNodes[i] = new Node{};
+	}
+	for (uint32_t i = 0; i < cooked.nodeCount; ++i) {
+		const ModelFileNode& record = cooked.pNodes[i];
+		Node* node = a_pModel->linearNodes[i];
+		node->index = record.index;
+		node->name = GetCookedString(cooked.pStrings, record.name);
+		node->skinIndex = record.skinIndex;
+		node->translation = glm::make_vec3(record.translation);
+		node->scale = glm::make_vec3(record.scale);
+		node->rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+		node->matrix = glm::make_mat4x4(record.matrix);
+
+		if (record.firstPrimitive > -1) {
+			Mesh* mesh = new Mesh(a_pRenderer, node->matrix);
+			for (uint32_t p = 0; p < record.primitiveCount; ++p) {
+				const ModelFilePrimitive& source = cooked.pPrimitives[record.firstPrimitive + p];
+				Primitive* primitive = new Primitive(source.firstIndex, source.indexCount, source.vertexCount, a_pModel->materials[source.material]);
+				primitive->firstVertex = source.firstVertex;
+				primitive->hasIndices = source.hasIndices != 0;
+				if (source.boundsValid) {
+					primitive->setBoundingBox(glm::make_vec3(source.min), glm::make_vec3(source.max));
 				}
-				rgba += 4;
-				rgb += 3;
+				primitive->lodCount = source.lodCount;
+				for (uint32_t lod = 0; lod < source.lodCount; ++lod) {
+					primitive->lods[lod] = { source.lodFirstIndex[lod], source.lodIndexCount[lod], source.lodError[lod] };
+				}
+				mesh->primitives.push_back(primitive);
 			}
-			deleteBuffer = true;
+			mesh->bb.min = glm::make_vec3(record.meshMin);
+			mesh->bb.max = glm::make_vec3(record.meshMax);
+			mesh->bb.valid = record.meshBoundsValid != 0;
+			node->mesh = mesh;
+		}
+
+		if (record.parent > -1) {
+			node->parent = a_pModel->linearNodes[record.parent];
+			node->parent->children.push_back(node);
 		}
 		else {
-			buffer = &image.image[0];
-			bufferSize = image.image.size();
-		}
-
-		Texture* pTexture = new Texture();
-		pTexture->desc.rawData = buffer;
-		pTexture->desc.rawDataSize = bufferSize;
-		pTexture->desc.width = image.width;
-		pTexture->desc.height = image.height;
-		pTexture->desc.format = VK_FORMAT_R8G8B8A8_UNORM;
-		pTexture->desc.tiling = VK_IMAGE_TILING_OPTIMAL;
-		pTexture->desc.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-		pTexture->desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		pTexture->desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		pTexture->desc.aspectBits = VK_IMAGE_ASPECT_COLOR_BIT;
-		pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		pTexture->desc.mipMaps = true;
-		CreateTexture(a_pRenderer, &pTexture);
-		
-		TextureSampler* pModelTexture = new TextureSampler();
-		pModelTexture->texture = pTexture;
-		pModelTexture->sampler = pTextureSampler;
-		a_pModel->textures.push_back(pModelTexture);
+			a_pModel->nodes.push_back(node);
+		}
+	}
+
+	for (uint32_t i = 0; i < cooked.skinCount; ++i) {
+		const ModelFileSkin& record = cooked.pSkins[i];
+		Skin* skin = new Skin{};
+		skin->name = GetCookedString(cooked.pStrings, record.name);
+		skin->skeletonRoot = record.skeletonRoot > -1 ? a_pModel->linearNodes[record.skeletonRoot] : nullptr;
+		for (uint32_t j = 0; j < record.jointCount; ++j) {
+			skin->joints.push_back(a_pModel->linearNodes[cooked.pJoints[record.firstJoint + j]]);
+		}
+		skin->inverseBindMatrices.assign(cooked.pInverseBindMatrices + record.firstInverseBindMatrix,
+			cooked.pInverseBindMatrices + record.firstInverseBindMatrix + record.inverseBindMatrixCount);
+		a_pModel->skins.push_back(skin);
+	}
+
+	for (uint32_t i = 0; i < cooked.animationCount; ++i) {
+		const ModelFileAnimation& record = cooked.pAnimations[i];
+		Animation animation{};
+		animation.name = GetCookedString(cooked.pStrings, record.name);
+		animation.start = record.start;
+		animation.end = record.end;
+		for (uint32_t s = 0; s < record.samplerCount; ++s) {
+			const ModelFileAnimationSampler& source = cooked.pAnimationSamplers[record.firstSampler + s];
+			AnimationSampler sampler{};
+			sampler.interpolation = (AnimationSampler::InterpolationType)source.interpolation;
+			sampler.inputs.assign(cooked.pAnimationInputs + source.firstInput, cooked.pAnimationInputs + source.firstInput + source.inputCount);
+			sampler.outputsVec4.assign(cooked.pAnimationOutputs + source.firstOutput, cooked.pAnimationOutputs + source.firstOutput + source.outputCount);
+			sampler.outputsPacked.assign(cooked.pAnimationPackedOutputs + source.firstPackedOutput,
+				cooked.pAnimationPackedOutputs + source.firstPackedOutput + source.packedOutputCount);
+			sampler.packedType = (AnimationTrackType)source.packedType;
+			memcpy(sampler.packedRange.min, source.packedMin, sizeof(source.packedMin));
+			memcpy(sampler.packedRange.extent, source.packedExtent, sizeof(source.packedExtent));
+			animation.samplers.push_back(sampler);
+		}
+		for (uint32_t c = 0; c < record.channelCount; ++c) {
+			const ModelFileAnimationChannel& source = cooked.pAnimationChannels[record.firstChannel + c];
+			AnimationChannel channel{};
+			channel.path = (AnimationChannel::PathType)source.path;
+			channel.node = a_pModel->linearNodes[source.node];
+			channel.samplerIndex = source.samplerIndex;
+			animation.channels.push_back(channel);
+		}
+		a_pModel->animations.push_back(animation);
+	}
+
+	for (uint32_t i = 0; i < cooked.extensionCount; ++i) {
+		a_pModel->extensions.push_back(GetCookedString(cooked.pStrings, cooked.pExtensions[i]));
+	}
+
+	a_pModel->positions.assign(cooked.pPositions, cooked.pPositions + cooked.positionCount);
+	a_pModel->indexBuffer.assign(cooked.pIndices, cooked.pIndices + cooked.indexCount);
+	GetSceneDimensions(a_pModel);
+
+	ModelUpload* pUpload = a_pModel->pUpload;
+	pUpload->file = mappedFile;
+	pUpload->pVertices = cooked.pVertices;
+	pUpload->vertexCount = cooked.vertexCount;
+	pUpload->pSkinVertices = cooked.pSkinVertices;
+	return true;
+}
+
+// writes what CreateModelFromFile built from the glTF file, pointers between model objects become record indices
+void CookModel(const tinygltf::Model& a_GltfModel, const std::string& a_sSourcePath, uint64_t a_uKey, const std::vector<Model::PackedVertex>& a_PackedVertices,
+	const std::vector<Model::SkinVertex>& a_SkinVertices, const Model* a_pModel)
+{
+	std::vector<char> strings;
+
+	std::unordered_map<const Node*, uint32_t> nodeIndices;
+	for (size_t i = 0; i < a_pModel->linearNodes.size(); ++i) {
+		nodeIndices[a_pModel->linearNodes[i]] = (uint32_t)i;
+	}
+	std::unordered_map<const TextureSampler*, int32_t> textureIndices;
+	textureIndices[nullptr] = -1;
+	for (size_t i = 0; i < a_pModel->textures.size(); ++i) {
+		textureIndices[a_pModel->textures[i]] = (int32_t)i;
+	}
+
+	std::vector<ModelFileNode> nodes(a_pModel->linearNodes.size());
+	std::vector<ModelFilePrimitive> primitives;
+	for (size_t i = 0; i < a_pModel->linearNodes.size(); ++i) {
+		const Node* node = a_pModel->linearNodes[i];
+		ModelFileNode& record = nodes[i];
+		record.parent = node->parent ? (int32_t)nodeIndices[node->parent] : -1;
+		record.index = node->index;
+		record.skinIndex = node->skinIndex;
+		record.name = AddModelFileString(strings, node->name);
+		memcpy(record.translation, glm::value_ptr(node->translation), sizeof(record.translation));
+		memcpy(record.scale, glm::value_ptr(node->scale), sizeof(record.scale));
+		const float rotation[4] = { node->rotation.x, node->rotation.y, node->rotation.z, node->rotation.w };
+		memcpy(record.rotation, rotation, sizeof(record.rotation));
+		memcpy(record.matrix, glm::value_ptr(node->matrix), sizeof(record.matrix));
+		record.firstPrimitive = -1;
+		if (!node->mesh) {
+			continue;
+		}
+
+		record.firstPrimitive = (int32_t)primitives.size();
+		record.primitiveCount = (uint32_t)node->mesh->primitives.size();
+		record.meshBoundsValid = node->mesh->bb.valid;
+		memcpy(record.meshMin, glm::value_ptr(node->mesh->bb.min), sizeof(record.meshMin));
+		memcpy(record.meshMax, glm::value_ptr(node->mesh->bb.max), sizeof(record.meshMax));
+		for (const Primitive* primitive : node->mesh->primitives) {
+			ModelFilePrimitive source = {};
+			source.firstIndex = primitive->firstIndex;
+			source.indexCount = primitive->indexCount;
+			source.vertexCount = primitive->vertexCount;
+			source.firstVertex = primitive->firstVertex;
+			source.material = (uint32_t)(&primitive->material - a_pModel->materials.data());
+			source.hasIndices = primitive->hasIndices;
+			source.boundsValid = primitive->bb.valid;
+			memcpy(source.min, glm::value_ptr(primitive->bb.min), sizeof(source.min));
+			memcpy(source.max, glm::value_ptr(primitive->bb.max), sizeof(source.max));
+			source.lodCount = primitive->lodCount;
+			for (uint32_t lod = 0; lod < primitive->lodCount; ++lod) {
+				source.lodFirstIndex[lod] = primitive->lods[lod].firstIndex;
+				source.lodIndexCount[lod] = primitive->lods[lod].indexCount;
+				source.lodError[lod] = primitive->lods[lod].error;
+			}
+			primitives.push_back(source);
+		}
+	}
+
+	std::vector<ModelFileMaterial> materials(a_pModel->materials.size());
+	for (size_t i = 0; i < a_pModel->materials.size(); ++i) {
+		const Material& material = a_pModel->materials[i];
+		ModelFileMaterial& record = materials[i];
+		record.alphaMode = (uint32_t)material.alphaMode;
+		record.alphaCutoff = material.alphaCutoff;
+		record.metallicFactor = material.metallicFactor;
+		record.roughnessFactor = material.roughnessFactor;
+		memcpy(record.baseColorFactor, glm::value_ptr(material.baseColorFactor), sizeof(record.baseColorFactor));
+		memcpy(record.emissiveFactor, glm::value_ptr(material.emissiveFactor), sizeof(record.emissiveFactor));
+		memcpy(record.diffuseFactor, glm::value_ptr(material.extension.diffuseFactor), sizeof(record.diffuseFactor));
+		memcpy(record.specularFactor, glm::value_ptr(material.extension.specularFactor), sizeof(record.specularFactor));
+		record.baseColorTexture = textureIndices[material.baseColorTexture];
+		record.metallicRoughnessTexture = textureIndices[material.metallicRoughnessTexture];
+		record.normalTexture = textureIndices[material.normalTexture];
+		record.occlusionTexture = textureIndices[material.occlusionTexture];
+		record.emissiveTexture = textureIndices[material.emissiveTexture];
+		record.specularGlossinessTexture = textureIndices[material.extension.specularGlossinessTexture];
+		record.diffuseTexture = textureIndices[material.extension.diffuseTexture];
+		record.texCoordSets[0] = material.texCoordSets.baseColor;
+		record.texCoordSets[1] = material.texCoordSets.metallicRoughness;
+		record.texCoordSets[2] = material.texCoordSets.specularGlossiness;
+		record.texCoordSets[3] = material.texCoordSets.normal;
+		record.texCoordSets[4] = material.texCoordSets.occlusion;
+		record.texCoordSets[5] = material.texCoordSets.emissive;
+		record.metallicRoughness = material.pbrWorkflows.metallicRoughness;
+		record.specularGlossiness = material.pbrWorkflows.specularGlossiness;
+	}
+
+	std::vector<ModelFileSampler> samplers(a_pModel->samplers.size());
+	for (size_t i = 0; i < a_pModel->samplers.size(); ++i) {
+		const Sampler* pSampler = a_pModel->samplers[i];
+		samplers[i] = { (uint32_t)pSampler->desc.minFilter, (uint32_t)pSampler->desc.magFilter, (uint32_t)pSampler->desc.addressModeU,
+			(uint32_t)pSampler->desc.addressModeV, (uint32_t)pSampler->desc.addressModeW, (uint32_t)pSampler->desc.mipMapMode };
+	}
+
+	// images LoadGltfImage left to their compressed copy keep their uri, decoded ones are stored as they will be uploaded
+	std::vector<ModelFileTexture> textures(a_pModel->textures.size());
+	std::vector<uint8_t> imageData;
+	for (size_t i = 0; i < a_pModel->textures.size(); ++i) {
+		const tinygltf::Image& image = a_GltfModel.images[a_GltfModel.textures[i].source];
+		const TextureDesc& textureDesc = a_pModel->textures[i]->texture->desc;
+		const std::vector<Sampler*>::const_iterator sampler = std::find(a_pModel->samplers.begin(), a_pModel->samplers.end(), a_pModel->textures[i]->sampler);
+		ModelFileTexture& record = textures[i];
+		record.sampler = sampler == a_pModel->samplers.end() ? -1 : (int32_t)(sampler - a_pModel->samplers.begin());
+		record.width = (uint32_t)image.width;
+		record.height = (uint32_t)image.height;
+		if (!textureDesc.filePath.empty()) {
+			record.uri = AddModelFileString(strings, image.uri);
+		}
+		else {
+			const uint8_t* pPixels = (const uint8_t*)textureDesc.rawData;
+			record.pixelOffset = imageData.size();
+			imageData.insert(imageData.end(), pPixels, pPixels + textureDesc.rawDataSize);
+			record.pixelSize = textureDesc.rawDataSize;
+		}
+	}
+
+	std::vector<ModelFileSkin> skins;
+	std::vector<uint32_t> joints;
+	std::vector<glm::mat4> inverseBindMatrices;
+	for (const Skin* skin : a_pModel->skins) {
+		ModelFileSkin record = {};
+		record.name = AddModelFileString(strings, skin->name);
+		record.skeletonRoot = skin->skeletonRoot ? (int32_t)nodeIndices[skin->skeletonRoot] : -1;
+		record.firstJoint = (uint32_t)joints.size();
+		record.jointCount = (uint32_t)skin->joints.size();
+		for (const Node* joint : skin->joints) {
+			joints.push_back(nodeIndices[joint]);
+		}
+		record.firstInverseBindMatrix = (uint32_t)inverseBindMatrices.size();
+		record.inverseBindMatrixCount = (uint32_t)skin->inverseBindMatrices.size();
+		inverseBindMatrices.insert(inverseBindMatrices.end(), skin->inverseBindMatrices.begin(), skin->inverseBindMatrices.end());
+		skins.push_back(record);
+	}
+
+	std::vector<ModelFileAnimation> animations;
+	std::vector<ModelFileAnimationSampler> animationSamplers;
+	std::vector<ModelFileAnimationChannel> animationChannels;
+	std::vector<float> animationInputs;
+	std::vector<glm::vec4> animationOutputs;
+	std::vector<uint16_t> animationPackedOutputs;
+	for (const Animation& animation : a_pModel->animations) {
+		ModelFileAnimation record = {};
+		record.name = AddModelFileString(strings, animation.name);
+		record.start = animation.start;
+		record.end = animation.end;
+		record.firstSampler = (uint32_t)animationSamplers.size();
+		record.samplerCount = (uint32_t)animation.samplers.size();
+		for (const AnimationSampler& sampler : animation.samplers) {
+			ModelFileAnimationSampler samplerRecord = {};
+			samplerRecord.interpolation = (uint32_t)sampler.interpolation;
+			samplerRecord.firstInput = (uint32_t)animationInputs.size();
+			samplerRecord.inputCount = (uint32_t)sampler.inputs.size();
+			samplerRecord.firstOutput = (uint32_t)animationOutputs.size();
+			samplerRecord.outputCount = (uint32_t)sampler.outputsVec4.size();
+			samplerRecord.firstPackedOutput = (uint32_t)animationPackedOutputs.size();
+			samplerRecord.packedOutputCount = (uint32_t)sampler.outputsPacked.size();
+			samplerRecord.packedType = (uint32_t)sampler.packedType;
+			memcpy(samplerRecord.packedMin, sampler.packedRange.min, sizeof(samplerRecord.packedMin));
+			memcpy(samplerRecord.packedExtent, sampler.packedRange.extent, sizeof(samplerRecord.packedExtent));
+			animationSamplers.push_back(samplerRecord);
+			animationInputs.insert(animationInputs.end(), sampler.inputs.begin(), sampler.inputs.end());
+			animationOutputs.insert(animationOutputs.end(), sampler.outputsVec4.begin(), sampler.outputsVec4.end());
+			animationPackedOutputs.insert(animationPackedOutputs.end(), sampler.outputsPacked.begin(), sampler.outputsPacked.end());
+		}
+		record.firstChannel = (uint32_t)animationChannels.size();
+		record.channelCount = (uint32_t)animation.channels.size();
+		for (const AnimationChannel& channel : animation.channels) {
+			animationChannels.push_back({ (uint32_t)channel.path, nodeIndices[channel.node], channel.samplerIndex });
+		}
+		animations.push_back(record);
+	}
+
+	std::vector<ModelFileString> extensions;
+	for (const std::string& extension : a_pModel->extensions) {
+		extensions.push_back(AddModelFileString(strings, extension));
+	}
+
+	ModelFileWriter writer;
+	InitModelFileWriter(&writer, a_uKey);
+	SetModelFileSection(&writer, ModelFileSectionType::VERTICES, a_PackedVertices.data(), (uint32_t)a_PackedVertices.size(), sizeof(Model::PackedVertex));
+	SetModelFileSection(&writer, ModelFileSectionType::SKIN_VERTICES, a_SkinVertices.data(), (uint32_t)a_SkinVertices.size(), sizeof(Model::SkinVertex));
+	SetModelFileSection(&writer, ModelFileSectionType::INDICES, a_pModel->indexBuffer.data(), (uint32_t)a_pModel->indexBuffer.size(), sizeof(uint32_t));
+	SetModelFileSection(&writer, ModelFileSectionType::POSITIONS, a_pModel->positions.data(), (uint32_t)a_pModel->positions.size(), sizeof(glm::vec3));
+	SetModelFileSection(&writer, ModelFileSectionType::NODES, nodes.data(), (uint32_t)nodes.size(), sizeof(ModelFileNode));
+	SetModelFileSection(&writer, ModelFileSectionType::PRIMITIVES, primitives.data(), (uint32_t)primitives.size(), sizeof(ModelFilePrimitive));
+	SetModelFileSection(&writer, ModelFileSectionType::MATERIALS, materials.data(), (uint32_t)materials.size(), sizeof(ModelFileMaterial));
+	SetModelFileSection(&writer, ModelFileSectionType::TEXTURES, textures.data(), (uint32_t)textures.size(), sizeof(ModelFileTexture));
+	SetModelFileSection(&writer, ModelFileSectionType::SAMPLERS, samplers.data(), (uint32_t)samplers.size(), sizeof(ModelFileSampler));
+	SetModelFileSection(&writer, ModelFileSectionType::SKINS, skins.data(), (uint32_t)skins.size(), sizeof(ModelFileSkin));
+	SetModelFileSection(&writer, ModelFileSectionType::JOINTS, joints.data(), (uint32_t)joints.size(), sizeof(uint32_t));
+	SetModelFileSection(&writer, ModelFileSectionType::INVERSE_BIND_MATRICES, inverseBindMatrices.data(), (uint32_t)inverseBindMatrices.size(), sizeof(glm::mat4));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATIONS, animations.data(), (uint32_t)animations.size(), sizeof(ModelFileAnimation));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATION_SAMPLERS, animationSamplers.data(), (uint32_t)animationSamplers.size(), sizeof(ModelFileAnimationSampler));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATION_CHANNELS, animationChannels.data(), (uint32_t)animationChannels.size(), sizeof(ModelFileAnimationChannel));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATION_INPUTS, animationInputs.data(), (uint32_t)animationInputs.size(), sizeof(float));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATION_OUTPUTS, animationOutputs.data(), (uint32_t)animationOutputs.size(), sizeof(glm::vec4));
+	SetModelFileSection(&writer, ModelFileSectionType::ANIMATION_PACKED_OUTPUTS, animationPackedOutputs.data(), (uint32_t)animationPackedOutputs.size(), sizeof(uint16_t));
+	SetModelFileSection(&writer, ModelFileSectionType::EXTENSIONS, extensions.data(), (uint32_t)extensions.size(), sizeof(ModelFileString));
+	SetModelFileSection(&writer, ModelFileSectionType::STRINGS, strings.data(), (uint32_t)strings.size(), sizeof(char));
+	SetModelFileSection(&writer, ModelFileSectionType::IMAGE_DATA, imageData.data(), (uint32_t)imageData.size(), sizeof(uint8_t));
+	const std::vector<uint8_t>& data = FinishModelFile(&writer);
+
+#if defined(__ANDROID_API__)
+	const std::string cookedPath = GetCookedModelUserFileName(a_sSourcePath);
+#else
+	// the resource tree is writable on windows, the cooked model is packaged for android from there
+	const std::string cookedPath = GetModelFilePath(a_sSourcePath);
+#endif
+	if (!WriteUserFile(cookedPath.c_str(), (const char*)data.data(), data.size())) {
+		LOG(LogSeverity::WARNING, "Could not write cooked model %s", cookedPath.c_str());
 	}
 }
 
@@ -628,7 +1556,7 @@ static VkFilter getVkFilterMode(int32_t a_iFilterMode)
 	return VK_FILTER_NEAREST;
 }
 
-void LoadTextureSamplers(Renderer* a_pRenderer, tinygltf::Model& a_GltfModel, Model* a_pModel)
+void LoadTextureSamplers(tinygltf::Model& a_GltfModel, Model* a_pModel)
 {
 	for (tinygltf::Sampler smpl : a_GltfModel.samplers)
 	{
@@ -639,7 +1567,6 @@ void LoadTextureSamplers(Renderer* a_pRenderer, tinygltf::Model& a_GltfModel, Mo
 		pSampler->desc.addressModeV = getVkWrapMode(smpl.wrapT);
 		pSampler->desc.addressModeW = pSampler->desc.addressModeV;
 		pSampler->desc.mipMapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		CreateSampler(a_pRenderer, &pSampler);
 
 		a_pModel->samplers.push_back(pSampler);
 	}
@@ -845,6 +1772,47 @@ void LoadAnimations(tinygltf::Model& a_GltfModel, Model* a_pModel)
 	}
 }
 
+// packs the samplers channels use and removes keys within the model's animationDesc tolerances, cubic splines are left
+// as they are. logs the size before and after and the largest error of each path
+void CompressAnimations(Model* a_pModel)
+{
+	const float tolerances[] = { a_pModel->animationDesc.translationTolerance, a_pModel->animationDesc.rotationTolerance, a_pModel->animationDesc.scaleTolerance };
+	float errors[] = { 0.0f, 0.0f, 0.0f };
+	uint64_t sourceBytes = 0, compressedBytes = 0;
+	uint32_t sourceKeys = 0, compressedKeys = 0;
+	std::vector<float> times;
+	std::vector<uint16_t> keys;
+	for (Animation& animation : a_pModel->animations) {
+		for (const AnimationChannel& channel : animation.channels) {
+			AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+			const uint32_t keyCount = (uint32_t)sampler.inputs.size();
+			if (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE || sampler.outputsVec4.empty() || sampler.outputsVec4.size() < keyCount) {
+				continue;
+			}
+
+			const AnimationTrackType type = channel.path == AnimationChannel::PathType::ROTATION ? AnimationTrackType::ROTATION : AnimationTrackType::VECTOR;
+			times.resize(keyCount);
+			keys.resize((size_t)keyCount * ANIMATION_PACKED_KEY_SIZE);
+			float error = 0.0f;
+			const uint32_t keptCount = CompressAnimationTrack(times.data(), keys.data(), &sampler.packedRange, sampler.inputs.data(), &sampler.outputsVec4[0].x, keyCount,
+				type, tolerances[channel.path], sampler.interpolation == AnimationSampler::InterpolationType::LINEAR, &error);
+			errors[channel.path] = std::max(errors[channel.path], error);
+			sourceBytes += keyCount * (sizeof(float) + sizeof(glm::vec4));
+			compressedBytes += keptCount * (sizeof(float) + ANIMATION_PACKED_KEY_SIZE * sizeof(uint16_t));
+			sourceKeys += keyCount;
+			compressedKeys += keptCount;
+
+			sampler.inputs.assign(times.begin(), times.begin() + keptCount);
+			sampler.outputsPacked.assign(keys.begin(), keys.begin() + (size_t)keptCount * ANIMATION_PACKED_KEY_SIZE);
+			sampler.packedType = type;
+			std::vector<glm::vec4>().swap(sampler.outputsVec4);
+		}
+	}
+	LOG(LogSeverity::INFO, "Animation data: %u -> %u bytes, %u -> %u keys, largest error %f translation, %f degrees rotation, %f scale",
+		(uint32_t)sourceBytes, (uint32_t)compressedBytes, sourceKeys, compressedKeys, errors[AnimationChannel::PathType::TRANSLATION],
+		glm::degrees(errors[AnimationChannel::PathType::ROTATION]), errors[AnimationChannel::PathType::SCALE]);
+}
+
 void DrawNode(Node* a_Node, CommandBuffer* a_pCommandBuffer)
 {
 	if (a_Node->mesh) {
@@ -915,37 +1883,354 @@ void GetSceneDimensions(Model* a_pModel)
 	a_pModel->aabb[3][2] = a_pModel->dimensions.min[2];
 }
 
+static void GetModelPrimitives(Model* a_pModel, std::vector<Primitive*>& a_Primitives)
+{
+	for (Node* node : a_pModel->linearNodes) {
+		if (node->mesh) {
+			a_Primitives.insert(a_Primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+}
+
+// vertices of one primitive after OptimizePrimitive, OptimizeMeshes joins them in primitive order
+struct OptimizedPrimitive
+{
+	std::vector<Model::Vertex>	vertices;
+	VertexCacheStats			before;
+	VertexCacheStats			after;
+	bool						optimized;
+};
+
+struct MeshOptimizeJobs
+{
+	Model*							pModel;
+	std::vector<Primitive*>			primitives;
+	std::vector<OptimizedPrimitive>	results;
+};
+
+// rewrites the primitive's indices in place relative to its new vertices, primitives only touch their own ranges
+static void OptimizePrimitive(void* a_pData, uint32_t a_uIndex)
+{
+	MeshOptimizeJobs* pJobs = (MeshOptimizeJobs*)a_pData;
+	const Primitive* primitive = pJobs->primitives[a_uIndex];
+	OptimizedPrimitive& result = pJobs->results[a_uIndex];
+	const Model::Vertex* pSource = pJobs->pModel->vertexBuffer.data() + primitive->firstVertex;
+
+	// non indexed draws keep their vertices as they are
+	result.optimized = primitive->hasIndices && primitive->indexCount % 3 == 0;
+	if (!result.optimized) {
+		result.vertices.assign(pSource, pSource + primitive->vertexCount);
+		return;
+	}
+
+	uint32_t* indices = pJobs->pModel->indexBuffer.data() + primitive->firstIndex;
+	for (uint32_t i = 0; i < primitive->indexCount; ++i) {
+		indices[i] -= primitive->firstVertex;
+	}
+	result.before = AnalyzeVertexCache(indices, primitive->indexCount, primitive->vertexCount);
+
+	std::vector<uint32_t> remap(primitive->vertexCount);
+	const uint32_t uniqueCount = GenerateVertexRemap(remap.data(), pSource, primitive->vertexCount, sizeof(Model::Vertex));
+	std::vector<Model::Vertex> unique(uniqueCount);
+	for (uint32_t v = 0; v < primitive->vertexCount; ++v) {
+		unique[remap[v]] = pSource[v];
+	}
+	for (uint32_t i = 0; i < primitive->indexCount; ++i) {
+		indices[i] = remap[indices[i]];
+	}
+
+	OptimizeOverdraw(indices, indices, primitive->indexCount, &unique[0].pos.x, uniqueCount, sizeof(Model::Vertex));
+	result.vertices.resize(uniqueCount);
+	const uint32_t vertexCount = OptimizeVertexFetch(result.vertices.data(), indices, primitive->indexCount, unique.data(), uniqueCount, sizeof(Model::Vertex));
+	result.vertices.resize(vertexCount);
+	result.after = AnalyzeVertexCache(indices, primitive->indexCount, vertexCount);
+}
+
+// rebuilds the model vertex buffer primitive by primitive, duplicates merged and vertices in first use order.
+// primitives are optimized in parallel and joined in their order afterwards
+void OptimizeMeshes(Model* a_pModel)
+{
+	MeshOptimizeJobs jobs;
+	jobs.pModel = a_pModel;
+	GetModelPrimitives(a_pModel, jobs.primitives);
+	jobs.results.resize(jobs.primitives.size());
+
+	JobCounter counter;
+	RunJobs(OptimizePrimitive, &jobs, (uint32_t)jobs.primitives.size(), &counter);
+	WaitForJobs(&counter);
+
+	std::vector<Model::Vertex> vertices;
+	vertices.reserve(a_pModel->vertexBuffer.size());
+
+	// totals over every primitive, vertex cache stats are weighted by triangles and vertices
+	float missesBefore = 0.0f, missesAfter = 0.0f;
+	uint32_t triangleCount = 0, vertexCountBefore = 0, vertexCountAfter = 0;
+
+	for (size_t p = 0; p < jobs.primitives.size(); ++p) {
+		Primitive* primitive = jobs.primitives[p];
+		OptimizedPrimitive& result = jobs.results[p];
+		const uint32_t firstVertex = (uint32_t)vertices.size();
+		const uint32_t vertexCount = (uint32_t)result.vertices.size();
+		vertices.insert(vertices.end(), result.vertices.begin(), result.vertices.end());
+		std::vector<Model::Vertex>().swap(result.vertices);
+		primitive->firstVertex = firstVertex;
+		if (!result.optimized) {
+			continue;
+		}
+
+		for (uint32_t i = 0; i < primitive->indexCount; ++i) {
+			a_pModel->indexBuffer[primitive->firstIndex + i] += firstVertex;
+		}
+
+		triangleCount += primitive->indexCount / 3;
+		missesBefore += result.before.acmr * (primitive->indexCount / 3);
+		missesAfter += result.after.acmr * (primitive->indexCount / 3);
+		vertexCountBefore += primitive->vertexCount;
+		vertexCountAfter += vertexCount;
+
+		primitive->vertexCount = vertexCount;
+	}
+
+	a_pModel->vertexBuffer.swap(vertices);
+
+	if (triangleCount) {
+		LOG(LogSeverity::INFO, "Mesh optimization: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", vertexCountBefore, vertexCountAfter,
+			missesBefore / triangleCount, missesAfter / triangleCount, missesBefore / vertexCountBefore, missesAfter / vertexCountAfter);
+	}
+}
+
+// a lod has to drop at least this share of its source's indices, the rest of the chain stops otherwise
+#define MIN_LOD_REDUCTION 0.85f
+
+struct LodJobs
+{
+	Model*								pModel;
+	uint32_t							lodCount;
+	std::vector<Primitive*>				primitives;
+	// indices of lod 1 and later per primitive, lods[i].firstIndex is relative to them until GenerateLods appends them
+	std::vector<std::vector<uint32_t>>	lodIndices;
+};
+
+// every lod is simplified from the previous one
+static void GeneratePrimitiveLods(void* a_pData, uint32_t a_uIndex)
+{
+	LodJobs* pJobs = (LodJobs*)a_pData;
+	const Model::LodDesc& desc = pJobs->pModel->lodDesc;
+	Primitive* primitive = pJobs->primitives[a_uIndex];
+	std::vector<uint32_t>& lodIndices = pJobs->lodIndices[a_uIndex];
+	if (!primitive->hasIndices || primitive->indexCount % 3 != 0 || !primitive->bb.valid) {
+		return;
+	}
+
+	// indices relative to the primitive's first vertex, the simplifier only sees its vertices
+	std::vector<uint32_t> source(primitive->indexCount);
+	for (uint32_t i = 0; i < primitive->indexCount; ++i) {
+		source[i] = pJobs->pModel->indexBuffer[primitive->firstIndex + i] - primitive->firstVertex;
+	}
+	std::vector<uint32_t> simplified(primitive->indexCount);
+	const float diagonal = glm::length(primitive->bb.max - primitive->bb.min);
+
+	for (uint32_t lod = 1; lod < pJobs->lodCount; ++lod) {
+		const uint32_t targetIndexCount = (uint32_t)(primitive->indexCount * desc.targetRatios[lod - 1]) / 3 * 3;
+		float error = 0.0f;
+		const uint32_t indexCount = SimplifyMesh(simplified.data(), source.data(), (uint32_t)source.size(), &pJobs->pModel->vertexBuffer[primitive->firstVertex].pos.x,
+			primitive->vertexCount, sizeof(Model::Vertex), targetIndexCount, desc.maxErrors[lod - 1] * diagonal, &error);
+		if (indexCount == 0 || indexCount > source.size() * MIN_LOD_REDUCTION) {
+			break;
+		}
+
+		OptimizeVertexCache(simplified.data(), simplified.data(), indexCount, primitive->vertexCount);
+		primitive->lods[lod] = { (uint32_t)lodIndices.size(), indexCount, diagonal > 0.0f ? error / diagonal : 0.0f };
+		for (uint32_t i = 0; i < indexCount; ++i) {
+			lodIndices.push_back(simplified[i] + primitive->firstVertex);
+		}
+		primitive->lodCount = lod + 1;
+		source.assign(simplified.begin(), simplified.begin() + indexCount);
+	}
+}
+
+// primitives are simplified in parallel, their lods are appended to the model index buffer in primitive order
+void GenerateLods(Model* a_pModel)
+{
+	LodJobs jobs;
+	jobs.pModel = a_pModel;
+	jobs.lodCount = std::min(a_pModel->lodDesc.lodCount, (uint32_t)MAX_PRIMITIVE_LODS);
+	GetModelPrimitives(a_pModel, jobs.primitives);
+	jobs.lodIndices.resize(jobs.primitives.size());
+
+	JobCounter counter;
+	RunJobs(GeneratePrimitiveLods, &jobs, (uint32_t)jobs.primitives.size(), &counter);
+	WaitForJobs(&counter);
+
+	uint32_t triangleCounts[MAX_PRIMITIVE_LODS] = {};
+	for (size_t p = 0; p < jobs.primitives.size(); ++p) {
+		Primitive* primitive = jobs.primitives[p];
+		const uint32_t firstIndex = (uint32_t)a_pModel->indexBuffer.size();
+		a_pModel->indexBuffer.insert(a_pModel->indexBuffer.end(), jobs.lodIndices[p].begin(), jobs.lodIndices[p].end());
+		for (uint32_t lod = 1; lod < primitive->lodCount; ++lod) {
+			primitive->lods[lod].firstIndex += firstIndex;
+		}
+
+		triangleCounts[0] += primitive->indexCount / 3;
+		if (!primitive->hasIndices || primitive->indexCount % 3 != 0 || !primitive->bb.valid) {
+			continue;
+		}
+		// primitives that stopped early draw their last lod in the coarser ones
+		for (uint32_t lod = 1; lod < jobs.lodCount; ++lod) {
+			triangleCounts[lod] += primitive->lods[std::min(lod, primitive->lodCount - 1)].indexCount / 3;
+		}
+	}
+
+	LOG(LogSeverity::INFO, "LOD triangles %u / %u / %u / %u", triangleCounts[0], triangleCounts[1], triangleCounts[2], triangleCounts[3]);
+}
+
+// unit vector to the octahedron folded onto the z = 1 square, in [-1, 1]
+static glm::vec2 OctahedralEncode(glm::vec3 a_vNormal)
+{
+	const float sum = std::abs(a_vNormal.x) + std::abs(a_vNormal.y) + std::abs(a_vNormal.z);
+	if (sum == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	a_vNormal /= sum;
+	if (a_vNormal.z >= 0.0f) {
+		return glm::vec2(a_vNormal);
+	}
+	return glm::vec2((1.0f - std::abs(a_vNormal.y)) * (a_vNormal.x >= 0.0f ? 1.0f : -1.0f),
+		(1.0f - std::abs(a_vNormal.x)) * (a_vNormal.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// quantizes the CPU vertices to the GPU layouts, skin vertices are only written for models with skins
+void PackVertices(const Model* a_pModel, bool a_bSkinned, std::vector<Model::PackedVertex>& a_PackedVertices, std::vector<Model::SkinVertex>& a_SkinVertices)
+{
+	const size_t vertexCount = a_pModel->vertexBuffer.size();
+	a_PackedVertices.resize(vertexCount);
+	a_SkinVertices.resize(a_bSkinned ? vertexCount : 0);
+
+	for (size_t v = 0; v < vertexCount; ++v) {
+		const Model::Vertex& vertex = a_pModel->vertexBuffer[v];
+		Model::PackedVertex& packed = a_PackedVertices[v];
+		packed.pos = vertex.pos;
+		packed.normal = glm::packSnorm2x16(OctahedralEncode(vertex.normal));
+		packed.uv0 = glm::packHalf2x16(vertex.uv0);
+		packed.uv1 = glm::packHalf2x16(vertex.uv1);
+
+		if (!a_bSkinned) {
+			continue;
+		}
+
+		// weights rounded to 1/255 steps, what rounding loses or adds goes to the largest one so they still sum to 1
+		const float weightSum = vertex.weight0.x + vertex.weight0.y + vertex.weight0.z + vertex.weight0.w;
+		int32_t weights[4];
+		int32_t total = 0;
+		uint32_t largest = 0;
+		for (uint32_t i = 0; i < 4; ++i) {
+			weights[i] = weightSum > 0.0f ? (int32_t)(vertex.weight0[i] / weightSum * 255.0f + 0.5f) : (i == 0 ? 255 : 0);
+			total += weights[i];
+			largest = weights[i] > weights[largest] ? i : largest;
+		}
+		weights[largest] += 255 - total;
+
+		Model::SkinVertex& skin = a_SkinVertices[v];
+		skin.joints = 0;
+		skin.weights = 0;
+		for (uint32_t i = 0; i < 4; ++i) {
+			const uint32_t joint = std::min((uint32_t)vertex.joint0[i], MAX_NUM_JOINTS - 1);
+			skin.joints |= joint << (i * 8);
+			skin.weights |= (uint32_t)weights[i] << (i * 8);
+		}
+	}
+}
+
+static size_t GetAnimationKeyCount(const AnimationSampler& a_Sampler)
+{
+	return a_Sampler.outputsPacked.empty() ? a_Sampler.outputsVec4.size() : a_Sampler.outputsPacked.size() / ANIMATION_PACKED_KEY_SIZE;
+}
+
+// keys of compressed samplers are unpacked
+static glm::vec4 GetAnimationKey(const AnimationSampler& a_Sampler, size_t a_uIndex)
+{
+	if (a_Sampler.outputsPacked.empty()) {
+		return a_Sampler.outputsVec4[a_uIndex];
+	}
+	glm::vec4 key(0.0f);
+	UnpackAnimationKey(&key.x, &a_Sampler.outputsPacked[a_uIndex * ANIMATION_PACKED_KEY_SIZE], a_Sampler.packedType, a_Sampler.packedRange);
+	return key;
+}
+
 void GetUpdatedSRT(const AnimationChannel& channel, const AnimationSampler& sampler, const size_t i, const float u, glm::vec3& s, glm::quat& r, glm::vec3& t)
 {
+	const glm::vec4 first = GetAnimationKey(sampler, i);
+	const glm::vec4 second = GetAnimationKey(sampler, i + 1);
 	switch (channel.path) {
 	case AnimationChannel::PathType::TRANSLATION: {
-		glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+		glm::vec4 trans = glm::mix(first, second, u);
 		t = glm::vec3(trans);
 		break;
 	}
 	case AnimationChannel::PathType::SCALE: {
-		glm::vec4 scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+		glm::vec4 scale = glm::mix(first, second, u);
 		s = glm::vec3(scale);
 		break;
 	}
 	case AnimationChannel::PathType::ROTATION: {
 		glm::quat q1;
-		q1.x = sampler.outputsVec4[i].x;
-		q1.y = sampler.outputsVec4[i].y;
-		q1.z = sampler.outputsVec4[i].z;
-		q1.w = sampler.outputsVec4[i].w;
+		q1.x = first.x;
+		q1.y = first.y;
+		q1.z = first.z;
+		q1.w = first.w;
 		glm::quat q2;
-		q2.x = sampler.outputsVec4[i + 1].x;
-		q2.y = sampler.outputsVec4[i + 1].y;
-		q2.z = sampler.outputsVec4[i + 1].z;
-		q2.w = sampler.outputsVec4[i + 1].w;
+		q2.x = second.x;
+		q2.y = second.y;
+		q2.z = second.z;
+		q2.w = second.w;
 		r = glm::normalize(glm::slerp(q1, q2, u));
 		break;
 	}
 	}
 }
 
-void UpdateAnimation(uint32_t a_uIndex, float a_fTime, Model* a_pModel)
+// segment [i, i + 1] of the sampler's inputs a_fTime falls in, the last one that starts at or before it. a_pKey is where
+// the previous lookup ended, playback moves a key or two per frame from there. without it the inputs are binary searched.
+// false outside of the inputs
+static bool FindKeyframe(const AnimationSampler& a_Sampler, float a_fTime, uint32_t* a_pKey, size_t& a_rIndex, float& a_rU)
+{
+	const std::vector<float>& inputs = a_Sampler.inputs;
+	if (inputs.size() < 2 || inputs.size() > GetAnimationKeyCount(a_Sampler) || !(a_fTime >= inputs.front() && a_fTime <= inputs.back())) {
+		return false;
+	}
+
+	const size_t last = inputs.size() - 2;
+	size_t i = a_pKey ? std::min<size_t>(*a_pKey, last) : 0;
+	uint32_t steps = a_pKey ? 0 : ANIMATION_CURSOR_STEPS;
+	for (; steps < ANIMATION_CURSOR_STEPS && i < last && inputs[i + 1] <= a_fTime; ++steps) {
+		++i;
+	}
+	for (; steps < ANIMATION_CURSOR_STEPS && inputs[i] > a_fTime; ++steps) {
+		--i;
+	}
+	if (inputs[i] > a_fTime || (i < last && inputs[i + 1] <= a_fTime)) {
+		i = std::min<size_t>(std::upper_bound(inputs.begin(), inputs.end(), a_fTime) - inputs.begin() - 1, last);
+	}
+	// the end of an animation with its last key repeated is the end of the segment before
+	while (i > 0 && inputs[i] == inputs[i + 1]) {
+		--i;
+	}
+	if (a_pKey) {
+		*a_pKey = (uint32_t)i;
+	}
+
+	// keys at the same time give NaN and are skipped
+	a_rU = std::max(0.0f, a_fTime - inputs[i]) / (inputs[i + 1] - inputs[i]);
+	a_rIndex = i;
+	return a_rU <= 1.0f;
+}
+
+static uint32_t* GetCursorKey(AnimationCursor* a_pCursor, uint32_t a_uSamplerIndex)
+{
+	return a_pCursor ? &(*a_pCursor)[a_uSamplerIndex] : nullptr;
+}
+
+void UpdateAnimation(uint32_t a_uIndex, float a_fTime, Model* a_pModel, AnimationCursor* a_pCursor)
 {
 	if (a_pModel->animations.empty()) {
 		LOG(LogSeverity::INFO, ".glTF does not contain animation.");
@@ -956,22 +2241,18 @@ void UpdateAnimation(uint32_t a_uIndex, float a_fTime, Model* a_pModel)
 		return;
 	}
 	Animation& animation = a_pModel->animations[a_uIndex];
+	if (a_pCursor) {
+		a_pCursor->resize(animation.samplers.size(), 0);
+	}
 
 	bool updated = false;
-	for (AnimationChannel channel : animation.channels) {
-		AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-			continue;
-		}
-
-		for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((a_fTime >= sampler.inputs[i]) && (a_fTime <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, a_fTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					GetUpdatedSRT(channel, sampler, i, u, channel.node->scale, channel.node->rotation, channel.node->translation);
-					updated = true;
-				}
-			}
+	for (const AnimationChannel& channel : animation.channels) {
+		const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+		size_t i = 0;
+		float u = 0.0f;
+		if (FindKeyframe(sampler, a_fTime, GetCursorKey(a_pCursor, channel.samplerIndex), i, u)) {
+			GetUpdatedSRT(channel, sampler, i, u, channel.node->scale, channel.node->rotation, channel.node->translation);
+			updated = true;
 		}
 	}
 	if (updated) {
@@ -1007,7 +2288,8 @@ void ChannelBlendSRT(const AnimationChannel& channel,
 	}
 }
 
-void BlendAnimation(uint32_t a_nSrcIndex, uint32_t a_nDstIndex, float a_fSrcTime, float a_fDstTime, float a_fBlendFactor, Model* a_pModel)
+void BlendAnimation(uint32_t a_nSrcIndex, uint32_t a_nDstIndex, float a_fSrcTime, float a_fDstTime, float a_fBlendFactor, Model* a_pModel,
+	AnimationCursor* a_pSrcCursor, AnimationCursor* a_pDstCursor)
 {
 	if (a_pModel->animations.empty()) {
 		LOG(LogSeverity::INFO, ".glTF does not contain animation.");
@@ -1027,77 +2309,75 @@ void BlendAnimation(uint32_t a_nSrcIndex, uint32_t a_nDstIndex, float a_fSrcTime
 		glm::vec3 s, t;
 		glm::quat r;
 	};
-	std::unordered_map<uint32_t, AnimationBlendData> blendData;
-	std::set<uint32_t> dstAffectedIndices;
+	typedef std::unordered_map<uint32_t, AnimationBlendData, std::hash<uint32_t>, std::equal_to<uint32_t>,
+		FrameAllocator<std::pair<const uint32_t, AnimationBlendData>>> BlendDataMap;
+	BlendDataMap blendData;
+	std::set<uint32_t, std::less<uint32_t>, FrameAllocator<uint32_t>> dstAffectedIndices;
 
 	Animation& dstAnimation = a_pModel->animations[a_nDstIndex];
-	for (const AnimationChannel& channel : dstAnimation.channels) {
-		const AnimationSampler& sampler = dstAnimation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-			continue;
-		}
-		for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((a_fDstTime >= sampler.inputs[i]) && (a_fDstTime <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, a_fDstTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					dstAffectedIndices.insert(channel.node->index);
-				}
-			}
+	Animation& srcAnimation = a_pModel->animations[a_nSrcIndex];
+	if (a_pDstCursor) {
+		a_pDstCursor->resize(dstAnimation.samplers.size(), 0);
+	}
+	if (a_pSrcCursor) {
+		a_pSrcCursor->resize(srcAnimation.samplers.size(), 0);
+	}
+
+	// the lookups of every destination channel, the second pass over them reuses these
+	struct DstKeyframe
+	{
+		size_t i;
+		float u;
+		bool found;
+	};
+	std::vector<DstKeyframe, FrameAllocator<DstKeyframe>> dstKeyframes(dstAnimation.channels.size());
+	for (size_t c = 0; c < dstAnimation.channels.size(); ++c) {
+		const AnimationChannel& channel = dstAnimation.channels[c];
+		DstKeyframe& keyframe = dstKeyframes[c];
+		keyframe.found = FindKeyframe(dstAnimation.samplers[channel.samplerIndex], a_fDstTime, GetCursorKey(a_pDstCursor, channel.samplerIndex), keyframe.i, keyframe.u);
+		if (keyframe.found) {
+			dstAffectedIndices.insert(channel.node->index);
 		}
 	}
 
-	Animation& srcAnimation = a_pModel->animations[a_nSrcIndex];
 	bool updated = false;
-	for (AnimationChannel channel : srcAnimation.channels) {
+	for (const AnimationChannel& channel : srcAnimation.channels) {
 		const AnimationSampler& sampler = srcAnimation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-			continue;
-		}
-
-		for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((a_fSrcTime >= sampler.inputs[i]) && (a_fSrcTime <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, a_fSrcTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					glm::vec3 s, t;
-					glm::quat r;
-					GetUpdatedSRT(channel, sampler, i, u, s, r, t);
-
-					if (dstAffectedIndices.find(channel.node->index) != dstAffectedIndices.end())
-						blendData.insert({ channel.node->index, {channel.node->scale, channel.node->translation, channel.node->rotation} });
-					else
-						ChannelBlendSRT(channel, s, r, t, a_fBlendFactor, channel.node->scale, channel.node->rotation, channel.node->translation);
-					updated = true;
-				}
-			}
+		size_t i = 0;
+		float u = 0.0f;
+		if (FindKeyframe(sampler, a_fSrcTime, GetCursorKey(a_pSrcCursor, channel.samplerIndex), i, u)) {
+			glm::vec3 s, t;
+			glm::quat r;
+			GetUpdatedSRT(channel, sampler, i, u, s, r, t);
+
+			if (dstAffectedIndices.find(channel.node->index) != dstAffectedIndices.end())
+				blendData.insert({ channel.node->index, {channel.node->scale, channel.node->translation, channel.node->rotation} });
+			else
+				ChannelBlendSRT(channel, s, r, t, a_fBlendFactor, channel.node->scale, channel.node->rotation, channel.node->translation);
+			updated = true;
 		}
 	}
 
-	for (const AnimationChannel& channel : dstAnimation.channels) {
-		const AnimationSampler& sampler = dstAnimation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+	for (size_t c = 0; c < dstAnimation.channels.size(); ++c) {
+		const AnimationChannel& channel = dstAnimation.channels[c];
+		const DstKeyframe& keyframe = dstKeyframes[c];
+		if (!keyframe.found) {
 			continue;
 		}
 
-		for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((a_fDstTime >= sampler.inputs[i]) && (a_fDstTime <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, a_fDstTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					glm::vec3 s, t;
-					glm::quat r;
-					GetUpdatedSRT(channel, sampler, i, u, s, r, t);
-					std::unordered_map<uint32_t, AnimationBlendData>::const_iterator itr = blendData.find(channel.node->index);
-					if (itr != blendData.end())
-					{
-						ChannelBlendSRT(channel, itr->second.s, itr->second.r, itr->second.t, a_fBlendFactor, s, r, t);
-						blendData.erase(itr);
-					}
-					else
-						ChannelBlendSRT(channel, channel.node->scale, channel.node->rotation, channel.node->translation, a_fBlendFactor, s, r, t);
-					
-					updated = true;
-				}
-			}
+		glm::vec3 s, t;
+		glm::quat r;
+		GetUpdatedSRT(channel, dstAnimation.samplers[channel.samplerIndex], keyframe.i, keyframe.u, s, r, t);
+		BlendDataMap::const_iterator itr = blendData.find(channel.node->index);
+		if (itr != blendData.end())
+		{
+			ChannelBlendSRT(channel, itr->second.s, itr->second.r, itr->second.t, a_fBlendFactor, s, r, t);
+			blendData.erase(itr);
 		}
+		else
+			ChannelBlendSRT(channel, channel.node->scale, channel.node->rotation, channel.node->translation, a_fBlendFactor, s, r, t);
+
+		updated = true;
 	}
 
 	if (updated) {
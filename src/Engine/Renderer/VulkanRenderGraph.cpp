@@ -0,0 +1,546 @@
+#include "../RenderGraph.h"
+#include "../Log.h"
+
+#define RG_WRITE_ACCESS (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | \
+	VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+bool hasStencilComponent(VkFormat format);
+
+struct TargetState
+{
+	VkImageLayout			layout;
+	VkPipelineStageFlags	stages;
+	VkAccessFlags			access;
+};
+
+static bool IsDepthFormat(VkFormat a_Format)
+{
+	return a_Format == VK_FORMAT_D16_UNORM || a_Format == VK_FORMAT_X8_D24_UNORM_PACK32 || a_Format == VK_FORMAT_D32_SFLOAT ||
+		a_Format == VK_FORMAT_D16_UNORM_S8_UINT || a_Format == VK_FORMAT_D24_UNORM_S8_UINT || a_Format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// stages and accesses that produced (a_bDestination false) or will consume an image in this layout
+static TargetState GetLayoutState(VkImageLayout a_Layout, bool a_bDestination)
+{
+	switch (a_Layout)
+	{
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+		return { a_Layout, 0, 0 };
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		// the acquire semaphore is waited on at color attachment output, the barrier has to chain with it
+		return { a_Layout, a_bDestination ? (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : (VkPipelineStageFlags)VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 };
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		return { a_Layout, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		return { a_Layout, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		return { a_Layout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		return { a_Layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		return { a_Layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+	default:
+		return { a_Layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT };
+	}
+}
+
+static inline uint32_t hashValues(const uint32_t* a_pValues, uint32_t a_uCount, uint32_t a_uPrev)
+{
+	uint32_t result = a_uPrev;
+	while (a_uCount--)
+		result = (result * 16777619U) ^ *a_pValues++;
+	return result;
+}
+
+static void ReleaseTransientTargets(RenderGraph* a_pRenderGraph)
+{
+	Renderer* pRenderer = a_pRenderGraph->pRenderer;
+	for (RenderGraphMemoryBlock& block : a_pRenderGraph->memoryBlocks)
+	{
+		DestroyAliasedRenderTargets(pRenderer, (uint32_t)block.renderTargets.size(), block.renderTargets.data(), &block.memory);
+		for (RenderTarget* pRenderTarget : block.renderTargets)
+		{
+			delete pRenderTarget->pTexture;
+			delete pRenderTarget;
+		}
+	}
+	a_pRenderGraph->memoryBlocks.clear();
+	a_pRenderGraph->transientHash = 0;
+}
+
+void CreateRenderGraph(Renderer* a_pRenderer, RenderGraph** a_ppRenderGraph)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppRenderGraph, LogSeverity::ERR, "Value at a_ppRenderGraph is NULL");
+
+	RenderGraph* pRenderGraph = *a_ppRenderGraph;
+	pRenderGraph->pRenderer = a_pRenderer;
+	pRenderGraph->targets.reserve(16);
+	pRenderGraph->passes.reserve(16);
+	pRenderGraph->barriers.reserve(32);
+}
+
+void DestroyRenderGraph(Renderer* a_pRenderer, RenderGraph** a_ppRenderGraph)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppRenderGraph, LogSeverity::ERR, "Value at a_ppRenderGraph is NULL");
+
+	RenderGraph* pRenderGraph = *a_ppRenderGraph;
+	ReleaseTransientTargets(pRenderGraph);
+	ResetRenderGraph(pRenderGraph);
+	pRenderGraph->stats = RenderGraphStats();
+}
+
+void ResetRenderGraph(RenderGraph* a_pRenderGraph)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+
+	// keeps the capacity, a steady frame does not allocate
+	a_pRenderGraph->targets.clear();
+	a_pRenderGraph->passes.clear();
+	a_pRenderGraph->barriers.clear();
+	a_pRenderGraph->finalBarrierCount = 0;
+	a_pRenderGraph->finalSrcStages = 0;
+	a_pRenderGraph->finalDstStages = 0;
+}
+
+uint32_t ImportRenderGraphTarget(RenderGraph* a_pRenderGraph, const char* a_sName, RenderTarget* a_pRenderTarget, VkImageLayout a_InitialLayout, VkImageLayout a_FinalLayout)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_pRenderTarget && a_pRenderTarget->pTexture, LogSeverity::ERR, "Imported render target %s has no texture", a_sName);
+
+	RenderGraphTarget target;
+	target.name = a_sName;
+	target.desc = RenderGraphTargetDesc(a_pRenderTarget->pTexture->desc.width, a_pRenderTarget->pTexture->desc.height,
+		a_pRenderTarget->pTexture->desc.format, a_pRenderTarget->pTexture->desc.sampleCount);
+	target.imported = true;
+	target.initialLayout = a_InitialLayout;
+	target.finalLayout = a_FinalLayout;
+	target.pRenderTarget = a_pRenderTarget;
+	a_pRenderGraph->targets.push_back(target);
+	return (uint32_t)a_pRenderGraph->targets.size() - 1;
+}
+
+uint32_t CreateRenderGraphTarget(RenderGraph* a_pRenderGraph, const char* a_sName, const RenderGraphTargetDesc& a_Desc)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_Desc.width && a_Desc.height && a_Desc.format != VK_FORMAT_UNDEFINED, LogSeverity::ERR, "Render graph target %s has no size or format", a_sName);
+
+	RenderGraphTarget target;
+	target.name = a_sName;
+	target.desc = a_Desc;
+	a_pRenderGraph->targets.push_back(target);
+	return (uint32_t)a_pRenderGraph->targets.size() - 1;
+}
+
+uint32_t AddRenderGraphPass(RenderGraph* a_pRenderGraph, const char* a_sName, RenderGraphExecuteFn a_Execute, void* a_pUserData, bool a_bSecondaryCommandBuffers)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+
+	RenderGraphPass pass;
+	pass.name = a_sName;
+	pass.execute = a_Execute;
+	pass.pUserData = a_pUserData;
+	pass.secondaryCommandBuffers = a_bSecondaryCommandBuffers;
+	a_pRenderGraph->passes.push_back(pass);
+	return (uint32_t)a_pRenderGraph->passes.size() - 1;
+}
+
+void WriteRenderGraphColor(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget, VkAttachmentLoadOp a_LoadOp, const VkClearValue& a_ClearValue)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_uPass < a_pRenderGraph->passes.size() && a_uTarget < a_pRenderGraph->targets.size(), LogSeverity::ERR, "Invalid render graph pass or target");
+
+	RenderGraphPass& pass = a_pRenderGraph->passes[a_uPass];
+	LOG_IF(pass.colorCount < MAX_RENDER_TARGET_ATTACHMENTS, LogSeverity::ERR, "Too many color targets in pass %s", pass.name);
+
+	pass.loadActions.clearColors[pass.colorCount] = a_ClearValue;
+	pass.loadActions.loadColorActions[pass.colorCount] = a_LoadOp;
+	pass.colors[pass.colorCount++] = a_uTarget;
+}
+
+void WriteRenderGraphDepth(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget, VkAttachmentLoadOp a_LoadOp, const VkClearValue& a_ClearValue)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_uPass < a_pRenderGraph->passes.size() && a_uTarget < a_pRenderGraph->targets.size(), LogSeverity::ERR, "Invalid render graph pass or target");
+
+	RenderGraphPass& pass = a_pRenderGraph->passes[a_uPass];
+	pass.loadActions.clearDepth = a_ClearValue;
+	pass.loadActions.loadDepthAction = a_LoadOp;
+	pass.depth = a_uTarget;
+}
+
+void ReadRenderGraphTexture(RenderGraph* a_pRenderGraph, uint32_t a_uPass, uint32_t a_uTarget)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_uPass < a_pRenderGraph->passes.size() && a_uTarget < a_pRenderGraph->targets.size(), LogSeverity::ERR, "Invalid render graph pass or target");
+
+	RenderGraphPass& pass = a_pRenderGraph->passes[a_uPass];
+	LOG_IF(pass.readCount < RG_MAX_PASS_READS, LogSeverity::ERR, "Too many reads in pass %s", pass.name);
+	pass.reads[pass.readCount++] = a_uTarget;
+}
+
+// walks the passes backwards from the imported targets, a pass lives when something downstream uses what it writes
+static void CullPasses(RenderGraph* a_pRenderGraph, bool* a_pNeeded)
+{
+	std::vector<RenderGraphTarget>& targets = a_pRenderGraph->targets;
+	for (uint32_t i = 0; i < (uint32_t)targets.size(); ++i)
+		a_pNeeded[i] = targets[i].imported;
+
+	for (uint32_t p = (uint32_t)a_pRenderGraph->passes.size(); p-- > 0;)
+	{
+		RenderGraphPass& pass = a_pRenderGraph->passes[p];
+		bool alive = (pass.depth != RG_INVALID_ID) && a_pNeeded[pass.depth];
+		for (uint32_t i = 0; i < pass.colorCount; ++i)
+			alive |= a_pNeeded[pass.colors[i]];
+
+		pass.culled = !alive;
+		if (!alive)
+			continue;
+
+		// a cleared target does not depend on earlier writers, a loaded one does
+		for (uint32_t i = 0; i < pass.colorCount; ++i)
+			a_pNeeded[pass.colors[i]] = (pass.loadActions.loadColorActions[i] == VK_ATTACHMENT_LOAD_OP_LOAD);
+		if (pass.depth != RG_INVALID_ID)
+			a_pNeeded[pass.depth] = (pass.loadActions.loadDepthAction == VK_ATTACHMENT_LOAD_OP_LOAD);
+		for (uint32_t i = 0; i < pass.readCount; ++i)
+			a_pNeeded[pass.reads[i]] = true;
+	}
+}
+
+static void UseTarget(RenderGraph* a_pRenderGraph, uint32_t a_uTarget, uint32_t a_uPass, VkImageUsageFlags a_Usage)
+{
+	RenderGraphTarget& target = a_pRenderGraph->targets[a_uTarget];
+	if (target.firstPass == RG_INVALID_ID)
+		target.firstPass = a_uPass;
+	target.lastPass = a_uPass;
+	target.usage |= a_Usage;
+}
+
+// greedy interval packing, a target reuses the first block of its kind whose occupants are all done
+static void AssignMemoryBlocks(RenderGraph* a_pRenderGraph, uint32_t* a_pBlockLastPass, bool* a_pBlockDepth, uint32_t& a_uBlockCount)
+{
+	std::vector<RenderGraphTarget>& targets = a_pRenderGraph->targets;
+	a_uBlockCount = 0;
+
+	for (uint32_t p = 0; p < (uint32_t)a_pRenderGraph->passes.size(); ++p)
+	{
+		for (RenderGraphTarget& target : targets)
+		{
+			if (target.imported || target.firstPass != p)
+				continue;
+
+			bool depth = IsDepthFormat(target.desc.format);
+			uint32_t block = 0;
+			for (; block < a_uBlockCount; ++block)
+			{
+				if (a_pBlockDepth[block] == depth && a_pBlockLastPass[block] < target.firstPass)
+					break;
+			}
+			if (block == a_uBlockCount)
+			{
+				a_pBlockDepth[a_uBlockCount++] = depth;
+			}
+			a_pBlockLastPass[block] = target.lastPass;
+			target.memoryBlock = block;
+		}
+	}
+}
+
+static void CreateTransientTargets(RenderGraph* a_pRenderGraph, uint32_t a_uBlockCount, const bool* a_pBlockDepth)
+{
+	Renderer* pRenderer = a_pRenderGraph->pRenderer;
+	a_pRenderGraph->memoryBlocks.resize(a_uBlockCount);
+	for (uint32_t i = 0; i < a_uBlockCount; ++i)
+		a_pRenderGraph->memoryBlocks[i].depth = a_pBlockDepth[i];
+
+	for (RenderGraphTarget& target : a_pRenderGraph->targets)
+	{
+		if (target.imported || target.memoryBlock == RG_INVALID_ID)
+			continue;
+
+		RenderTarget* pRenderTarget = new RenderTarget();
+		pRenderTarget->pTexture = new Texture();
+		TextureDesc& desc = pRenderTarget->pTexture->desc;
+		desc.width = target.desc.width;
+		desc.height = target.desc.height;
+		desc.format = target.desc.format;
+		desc.sampleCount = target.desc.sampleCount;
+		desc.tiling = VK_IMAGE_TILING_OPTIMAL;
+		desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		desc.usage = target.usage;
+		desc.aspectBits = IsDepthFormat(target.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		a_pRenderGraph->memoryBlocks[target.memoryBlock].renderTargets.push_back(pRenderTarget);
+	}
+
+	a_pRenderGraph->stats.transientMemorySize = 0;
+	for (RenderGraphMemoryBlock& block : a_pRenderGraph->memoryBlocks)
+	{
+		CreateAliasedRenderTargets(pRenderer, (uint32_t)block.renderTargets.size(), block.renderTargets.data(), &block.memory, &block.size);
+		a_pRenderGraph->stats.transientMemorySize += block.size;
+	}
+}
+
+// moves a target into the state a pass needs, the barrier is added to the pass batch.
+// read after read in the same layout needs nothing, the readers are remembered for the next writer
+static void RequireState(RenderGraph* a_pRenderGraph, uint32_t a_uTarget, TargetState& a_Current, const TargetState& a_Wanted, bool a_bDiscard,
+	VkPipelineStageFlags& a_SrcStages, VkPipelineStageFlags& a_DstStages)
+{
+	bool currentWrites = (a_Current.access & RG_WRITE_ACCESS) != 0;
+	bool wantedWrites = (a_Wanted.access & RG_WRITE_ACCESS) != 0;
+	if (a_Current.layout == a_Wanted.layout && !currentWrites && !wantedWrites)
+	{
+		a_Current.stages |= a_Wanted.stages;
+		a_Current.access |= a_Wanted.access;
+		return;
+	}
+
+	RenderGraphTarget& target = a_pRenderGraph->targets[a_uTarget];
+	Texture* pTexture = target.pRenderTarget->pTexture;
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	// previous contents are not needed, UNDEFINED lets the driver skip preserving them
+	barrier.oldLayout = a_bDiscard ? VK_IMAGE_LAYOUT_UNDEFINED : a_Current.layout;
+	barrier.newLayout = a_Wanted.layout;
+	barrier.srcAccessMask = a_Current.access & RG_WRITE_ACCESS;
+	barrier.dstAccessMask = a_Wanted.access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pTexture->image;
+	barrier.subresourceRange.aspectMask = pTexture->desc.aspectBits;
+	if (pTexture->desc.aspectBits == VK_IMAGE_ASPECT_DEPTH_BIT && hasStencilComponent(pTexture->desc.format))
+		barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = pTexture->desc.mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	a_pRenderGraph->barriers.push_back(barrier);
+
+	a_SrcStages |= a_Current.stages ? a_Current.stages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	a_DstStages |= a_Wanted.stages;
+	a_Current = a_Wanted;
+}
+
+void CompileRenderGraph(RenderGraph* a_pRenderGraph)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+
+	std::vector<RenderGraphTarget>& targets = a_pRenderGraph->targets;
+	std::vector<RenderGraphPass>& passes = a_pRenderGraph->passes;
+	uint32_t targetCount = (uint32_t)targets.size();
+	uint32_t passCount = (uint32_t)passes.size();
+
+	LOG_IF(targetCount <= RG_MAX_TARGETS, LogSeverity::ERR, "Render graph has more than %d targets", RG_MAX_TARGETS);
+
+	bool needed[RG_MAX_TARGETS];
+	CullPasses(a_pRenderGraph, needed);
+
+	// lifetimes and usage over the live passes
+	for (uint32_t p = 0; p < passCount; ++p)
+	{
+		RenderGraphPass& pass = passes[p];
+		if (pass.culled)
+			continue;
+
+		for (uint32_t i = 0; i < pass.colorCount; ++i)
+			UseTarget(a_pRenderGraph, pass.colors[i], p, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+		if (pass.depth != RG_INVALID_ID)
+			UseTarget(a_pRenderGraph, pass.depth, p, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		for (uint32_t i = 0; i < pass.readCount; ++i)
+			UseTarget(a_pRenderGraph, pass.reads[i], p, VK_IMAGE_USAGE_SAMPLED_BIT);
+	}
+
+	uint32_t blockLastPass[RG_MAX_TARGETS];
+	bool blockDepth[RG_MAX_TARGETS];
+	uint32_t blockCount = 0;
+	AssignMemoryBlocks(a_pRenderGraph, blockLastPass, blockDepth, blockCount);
+
+	// the transient targets are kept until the graph changes shape, a resize goes through DestroyRenderGraph
+	uint32_t transientHash = 2166136261U;
+	uint32_t transientCount = 0;
+	for (const RenderGraphTarget& target : targets)
+	{
+		if (target.imported)
+			continue;
+
+		uint32_t values[6] = { target.memoryBlock, target.desc.width, target.desc.height, (uint32_t)target.desc.format, (uint32_t)target.desc.sampleCount, target.usage };
+		transientHash = hashValues(values, sizeof(values) / sizeof(values[0]), transientHash);
+		transientCount += (target.memoryBlock != RG_INVALID_ID) ? 1 : 0;
+	}
+
+	if (transientHash != a_pRenderGraph->transientHash)
+	{
+		if (!a_pRenderGraph->memoryBlocks.empty())
+		{
+			LOG(LogSeverity::WARNING, "Render graph transient targets changed, recreating them");
+			WaitDeviceIdle(a_pRenderGraph->pRenderer);
+			ReleaseTransientTargets(a_pRenderGraph);
+		}
+		CreateTransientTargets(a_pRenderGraph, blockCount, blockDepth);
+		a_pRenderGraph->transientHash = transientHash;
+	}
+
+	// transients get their physical target in declaration order, the same order they were created in
+	uint32_t blockNext[RG_MAX_TARGETS] = {};
+	for (RenderGraphTarget& target : targets)
+	{
+		if (!target.imported && target.memoryBlock != RG_INVALID_ID)
+			target.pRenderTarget = a_pRenderGraph->memoryBlocks[target.memoryBlock].renderTargets[blockNext[target.memoryBlock]++];
+	}
+
+	// barriers, all transitions a pass needs go into one batch
+	TargetState states[RG_MAX_TARGETS];
+	for (uint32_t i = 0; i < targetCount; ++i)
+		states[i] = GetLayoutState(targets[i].imported ? targets[i].initialLayout : VK_IMAGE_LAYOUT_UNDEFINED, false);
+
+	a_pRenderGraph->barriers.clear();
+	uint32_t batchCount = 0, culledCount = 0;
+	for (uint32_t p = 0; p < passCount; ++p)
+	{
+		RenderGraphPass& pass = passes[p];
+		if (pass.culled)
+		{
+			++culledCount;
+			continue;
+		}
+
+		pass.firstBarrier = (uint32_t)a_pRenderGraph->barriers.size();
+		pass.srcStages = 0;
+		pass.dstStages = 0;
+
+		uint32_t used[MAX_RENDER_TARGET_ATTACHMENTS + 1 + RG_MAX_PASS_READS];
+		TargetState wanted[MAX_RENDER_TARGET_ATTACHMENTS + 1 + RG_MAX_PASS_READS];
+		bool discard[MAX_RENDER_TARGET_ATTACHMENTS + 1 + RG_MAX_PASS_READS];
+		uint32_t usedCount = 0;
+		for (uint32_t i = 0; i < pass.colorCount; ++i)
+		{
+			used[usedCount] = pass.colors[i];
+			wanted[usedCount] = GetLayoutState(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+			discard[usedCount++] = pass.loadActions.loadColorActions[i] != VK_ATTACHMENT_LOAD_OP_LOAD;
+		}
+		if (pass.depth != RG_INVALID_ID)
+		{
+			used[usedCount] = pass.depth;
+			wanted[usedCount] = GetLayoutState(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true);
+			discard[usedCount++] = pass.loadActions.loadDepthAction != VK_ATTACHMENT_LOAD_OP_LOAD;
+
+			// depth nobody reads or loads later is not written back to memory
+			bool depthUsedLater = targets[pass.depth].imported || targets[pass.depth].lastPass != p;
+			pass.loadActions.storeDepthAction = depthUsedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		}
+		for (uint32_t i = 0; i < pass.readCount; ++i)
+		{
+			used[usedCount] = pass.reads[i];
+			wanted[usedCount] = GetLayoutState(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true);
+			discard[usedCount++] = false;
+		}
+
+		for (uint32_t i = 0; i < usedCount; ++i)
+		{
+			RenderGraphTarget& target = targets[used[i]];
+			bool firstUse = !target.imported && target.firstPass == p;
+			if (firstUse)
+			{
+				// the previous occupant of the memory has to be done with it
+				RenderGraphMemoryBlock& block = a_pRenderGraph->memoryBlocks[target.memoryBlock];
+				states[used[i]].stages = block.stages;
+				states[used[i]].access = block.access;
+			}
+			LOG_IF(!firstUse || discard[i], LogSeverity::WARNING, "Pass %s reads transient target %s before anything writes it", pass.name, target.name);
+
+			RequireState(a_pRenderGraph, used[i], states[used[i]], wanted[i], discard[i] || firstUse, pass.srcStages, pass.dstStages);
+
+			if (!target.imported)
+			{
+				RenderGraphMemoryBlock& block = a_pRenderGraph->memoryBlocks[target.memoryBlock];
+				block.stages = states[used[i]].stages;
+				block.access = states[used[i]].access;
+			}
+		}
+
+		pass.barrierCount = (uint32_t)a_pRenderGraph->barriers.size() - pass.firstBarrier;
+		batchCount += pass.barrierCount ? 1 : 0;
+	}
+
+	// imported targets leave the graph in the layout the caller expects
+	uint32_t firstFinalBarrier = (uint32_t)a_pRenderGraph->barriers.size();
+	a_pRenderGraph->finalSrcStages = 0;
+	a_pRenderGraph->finalDstStages = 0;
+	for (uint32_t i = 0; i < targetCount; ++i)
+	{
+		if (targets[i].imported && states[i].layout != targets[i].finalLayout)
+			RequireState(a_pRenderGraph, i, states[i], GetLayoutState(targets[i].finalLayout, true), false, a_pRenderGraph->finalSrcStages, a_pRenderGraph->finalDstStages);
+	}
+	a_pRenderGraph->finalBarrierCount = (uint32_t)a_pRenderGraph->barriers.size() - firstFinalBarrier;
+	batchCount += a_pRenderGraph->finalBarrierCount ? 1 : 0;
+
+	RenderGraphStats& stats = a_pRenderGraph->stats;
+	stats.passCount = passCount;
+	stats.culledPassCount = culledCount;
+	stats.barrierBatchCount = batchCount;
+	stats.imageBarrierCount = (uint32_t)a_pRenderGraph->barriers.size();
+	stats.transientTargetCount = transientCount;
+	stats.memoryBlockCount = (uint32_t)a_pRenderGraph->memoryBlocks.size();
+}
+
+static void EmitBarriers(CommandBuffer* a_pCommandBuffer, const VkImageMemoryBarrier* a_pBarriers, uint32_t a_uCount, VkPipelineStageFlags a_SrcStages, VkPipelineStageFlags a_DstStages)
+{
+	if (!a_uCount)
+		return;
+
+	vkCmdPipelineBarrier(a_pCommandBuffer->commandBuffer, a_SrcStages, a_DstStages, 0, 0, nullptr, 0, nullptr, a_uCount, a_pBarriers);
+}
+
+void ExecuteRenderGraph(RenderGraph* a_pRenderGraph, CommandBuffer* a_pCommandBuffer)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+
+	const VkImageMemoryBarrier* pBarriers = a_pRenderGraph->barriers.data();
+	for (RenderGraphPass& pass : a_pRenderGraph->passes)
+	{
+		if (pass.culled)
+			continue;
+
+		EmitBarriers(a_pCommandBuffer, pBarriers + pass.firstBarrier, pass.barrierCount, pass.srcStages, pass.dstStages);
+
+		RenderTarget* colors[MAX_RENDER_TARGET_ATTACHMENTS] = {};
+		for (uint32_t i = 0; i < pass.colorCount; ++i)
+			colors[i] = a_pRenderGraph->targets[pass.colors[i]].pRenderTarget;
+		RenderTarget* pDepth = (pass.depth != RG_INVALID_ID) ? a_pRenderGraph->targets[pass.depth].pRenderTarget : nullptr;
+
+		if (pass.colorCount || pDepth)
+		{
+			Texture* pExtent = pass.colorCount ? colors[0]->pTexture : pDepth->pTexture;
+			if (pass.secondaryCommandBuffers)
+			{
+				// only vkCmdExecuteCommands is allowed in the pass, the secondaries set their own viewport
+				BindRenderTargets(a_pCommandBuffer, pass.colorCount, colors, &pass.loadActions, pDepth, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			}
+			else
+			{
+				BindRenderTargets(a_pCommandBuffer, pass.colorCount, colors, &pass.loadActions, pDepth);
+				SetViewport(a_pCommandBuffer, 0.0f, 0.0f, (float)pExtent->desc.width, (float)pExtent->desc.height, 0.0f, 1.0f);
+				SetScissors(a_pCommandBuffer, 0, 0, pExtent->desc.width, pExtent->desc.height);
+			}
+		}
+
+		if (pass.execute)
+			pass.execute(a_pCommandBuffer, pass.pUserData);
+
+		if (pass.colorCount || pDepth)
+			BindRenderTargets(a_pCommandBuffer, 0, nullptr);
+	}
+
+	uint32_t firstFinalBarrier = (uint32_t)a_pRenderGraph->barriers.size() - a_pRenderGraph->finalBarrierCount;
+	EmitBarriers(a_pCommandBuffer, pBarriers + firstFinalBarrier, a_pRenderGraph->finalBarrierCount, a_pRenderGraph->finalSrcStages, a_pRenderGraph->finalDstStages);
+}
+
+RenderTarget* GetRenderGraphTarget(RenderGraph* a_pRenderGraph, uint32_t a_uTarget)
+{
+	LOG_IF(a_pRenderGraph, LogSeverity::ERR, "a_pRenderGraph is NULL");
+	LOG_IF(a_uTarget < a_pRenderGraph->targets.size(), LogSeverity::ERR, "Invalid render graph target");
+	return a_pRenderGraph->targets[a_uTarget].pRenderTarget;
+}
@@ -2,6 +2,9 @@
 #include "../App.h"
 #include "../Log.h"
 #include "../FileSystem.h"
+#include "../ShaderCache.h"
+#include "../TextureFile.h"
+#include "../TextureStreaming.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../../../include/stb_image.h"
 
@@ -9,25 +12,34 @@
 #include <unordered_set>
 #include <string>
 #include <algorithm>
+#include <chrono>
 
-#if defined(_WIN32)
-#include <direct.h>
-#define GetCurrentDir _getcwd
-#endif
 #if defined(__ANDROID_API__)
 #include <shaderc/shaderc.hpp>
 #include <dlfcn.h>
 #endif
+#if defined(_WIN32) && defined(USE_SHADERC)
+#include <shaderc/shaderc.hpp>
+#endif
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define MAX_BINDLESS_TEXTURES 4096u
+#define MAX_DESCRIPTORS_PER_SET 16
+#define MAX_SECONDARY_COMMAND_BUFFERS 64
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+// frames between saves of a changed pipeline cache, android may kill the app before ExitRenderer
+#define PIPELINE_CACHE_SAVE_INTERVAL 300
 
 void CreateInstance(Renderer** a_pRenderer);
 void DestroyInstance(Renderer** a_pRenderer);
 void PickPhysicalDevice(Renderer** a_pRenderer);
 void CreateLogicalDevice(Renderer** a_ppRenderer);
 
-void CreateCommandPool(Renderer** a_ppRenderer);
+void CreateGraphicsCommandPool(Renderer** a_ppRenderer);
 void CreateDescriptorPool(Renderer** a_ppRenderer);
+void CreatePipelineCache(Renderer** a_ppRenderer);
+void DestroyPipelineCache(Renderer** a_ppRenderer);
+void SavePipelineCache(Renderer* a_pRenderer);
 void CreateSyncObjects(Renderer** a_ppRenderer);
 
 void InitializeDefaultResources(Renderer* a_pRenderer);
@@ -39,9 +51,20 @@ void EndSingleTimeCommands(Renderer* a_pRenderer, CommandBuffer* a_pCommandBuffe
 VkImageView CreateImageView(Renderer* pRenderer, Texture* a_pTexture);
 void CreateBufferUtil(Renderer* a_pRenderer, Buffer** a_ppBuffer);
 
+// FNV-1a over a null terminated name, avoids building std::string temporaries for lookups
+static inline uint32_t hashName(const char* a_sName)
+{
+	uint32_t result = 2166136261U;
+	while (*a_sName)
+		result = (result ^ (uint8_t)(*a_sName++)) * 16777619U;
+	return result;
+}
+
 static std::unordered_map<uint32_t, VkRenderPass>	renderPasses;
 static std::unordered_map<uint32_t, VkFramebuffer>	frameBuffers;
 static uint32_t RT_IDs = 0;
+static uint32_t pipelineIDs = 0;
+static uint32_t framesSincePipelineCacheSave = 0;
 
 void InitRenderer(Renderer** a_ppRenderer)
 {
@@ -50,8 +73,9 @@ void InitRenderer(Renderer** a_ppRenderer)
 	CreateInstance(a_ppRenderer);
 	PickPhysicalDevice(a_ppRenderer);
 	CreateLogicalDevice(a_ppRenderer);
-	CreateCommandPool(a_ppRenderer);
+	CreateGraphicsCommandPool(a_ppRenderer);
 	CreateDescriptorPool(a_ppRenderer);
+	CreatePipelineCache(a_ppRenderer);
 	CreateSyncObjects(a_ppRenderer);
 	InitializeDefaultResources(*a_ppRenderer);
 }
@@ -89,6 +113,7 @@ void ExitRenderer(Renderer** a_ppRenderer)
 	free(pRenderer->imageAvailableSemaphores);
 	free(pRenderer->inFlightFences);
 
+	DestroyPipelineCache(a_ppRenderer);
 	vkDestroyDescriptorPool(pRenderer->device, pRenderer->descriptorPool, nullptr);
 	vkDestroyCommandPool(pRenderer->device, pRenderer->commandPool, nullptr);
 	pRenderer->commandPool = VK_NULL_HANDLE;
@@ -379,6 +404,25 @@ const char* deviceExtensions[] = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// device level, loaded when VK_KHR_draw_indirect_count is enabled
+static PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
+bool IsDeviceExtensionSupported(const VkPhysicalDevice& device, const char* a_sExtensionName)
+{
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const VkExtensionProperties& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, a_sExtensionName) == 0)
+			return true;
+	}
+	return false;
+}
+
 int rateDeviceSuitability(const VkPhysicalDevice& device, const VkSurfaceKHR& surface)
 {
 	VkPhysicalDeviceProperties deviceProperties;
@@ -534,25 +578,81 @@ void CreateLogicalDevice(Renderer** a_ppRenderer)
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 	// features
+	VkPhysicalDeviceFeatures supportedFeatures = {};
+	vkGetPhysicalDeviceFeatures(pRenderer->physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 	deviceFeatures.fillModeNonSolid = VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	// block compressed textures, see FindCompressedTexture
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+	deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+	pRenderer->indirectFirstInstanceSupported = (supportedFeatures.drawIndirectFirstInstance == VK_TRUE);
+	pRenderer->multiDrawIndirectSupported = (supportedFeatures.multiDrawIndirect == VK_TRUE);
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
+	std::vector<const char*> enabledExtensions(deviceExtensions, deviceExtensions + sizeof(deviceExtensions) / sizeof(const char*));
+
 	// additional extension features
-	/*VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexFeature = {};
-	indexFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
-	indexFeature.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
-	indexFeature.runtimeDescriptorArray = VK_TRUE;
-	indexFeature.pNext = nullptr;*/
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexFeature = {};
+	supportedIndexFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	pRenderer->bindlessSupported = false;
+	pRenderer->maxBindlessTextures = 0;
+	if (IsDeviceExtensionSupported(pRenderer->physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supportedIndexFeature;
+		vkGetPhysicalDeviceFeatures2(pRenderer->physicalDevice, &features2);
+
+		// only what a variable sized, partially bound texture array updated during the frame needs
+		pRenderer->bindlessSupported = supportedIndexFeature.runtimeDescriptorArray && supportedIndexFeature.descriptorBindingPartiallyBound &&
+			supportedIndexFeature.descriptorBindingVariableDescriptorCount && supportedIndexFeature.descriptorBindingSampledImageUpdateAfterBind &&
+			supportedIndexFeature.descriptorBindingUpdateUnusedWhilePending;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexFeature = {};
+	indexFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (pRenderer->bindlessSupported)
+	{
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexProperties = {};
+		indexProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &indexProperties;
+		vkGetPhysicalDeviceProperties2(pRenderer->physicalDevice, &properties2);
 
-	//createInfo.pNext = &indexFeature;
+		uint32_t maxTextures = MIN(indexProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexProperties.maxPerStageDescriptorUpdateAfterBindSamplers);
+		maxTextures = MIN(maxTextures, indexProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+		maxTextures = MIN(maxTextures, indexProperties.maxDescriptorSetUpdateAfterBindSamplers);
+		pRenderer->maxBindlessTextures = MIN(maxTextures, MAX_BINDLESS_TEXTURES);
+
+		indexFeature.shaderSampledImageArrayNonUniformIndexing = supportedIndexFeature.shaderSampledImageArrayNonUniformIndexing;
+		indexFeature.runtimeDescriptorArray = VK_TRUE;
+		indexFeature.descriptorBindingPartiallyBound = VK_TRUE;
+		indexFeature.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexFeature.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexFeature.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+		createInfo.pNext = &indexFeature;
+		enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		LOG(LogSeverity::INFO, "Descriptor indexing enabled, %u bindless textures", pRenderer->maxBindlessTextures);
+	}
+
+	// culled draws are compacted on the GPU, the draw count is read back by the draw
+	pRenderer->drawIndirectCountSupported = IsDeviceExtensionSupported(pRenderer->physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (pRenderer->drawIndirectCountSupported)
+		enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 
 	// extensions
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(sizeof(deviceExtensions) / sizeof(const char*));
-	createInfo.ppEnabledExtensionNames = deviceExtensions;
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	// validation layers
 	createInfo.enabledLayerCount = static_cast<uint32_t>(pRenderer->validationLayers.size());
 	createInfo.ppEnabledLayerNames = pRenderer->validationLayers.data();
@@ -560,6 +660,12 @@ void CreateLogicalDevice(Renderer** a_ppRenderer)
 	LOG_IF( (vkCreateDevice(pRenderer->physicalDevice, &createInfo, nullptr, &pRenderer->device) == VK_SUCCESS), LogSeverity::ERR, "failed to create logical device!" );
 	vkGetDeviceQueue(pRenderer->device, familyIndices.graphicsFamily, 0, &pRenderer->graphicsQueue);
 	vkGetDeviceQueue(pRenderer->device, familyIndices.presentFamily, 0, &pRenderer->presentQueue);
+
+	if (pRenderer->drawIndirectCountSupported)
+	{
+		vkCmdDrawIndexedIndirectCountKHR = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(pRenderer->device, "vkCmdDrawIndexedIndirectCountKHR");
+		pRenderer->drawIndirectCountSupported = (vkCmdDrawIndexedIndirectCountKHR != nullptr);
+	}
 }
 
 #pragma endregion
@@ -732,6 +838,12 @@ void WaitDeviceIdle(Renderer* a_pRenderer)
 	vkDeviceWaitIdle(a_pRenderer->device);
 }
 
+void WaitForInFlightFrames(Renderer* a_pRenderer)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	vkWaitForFences(a_pRenderer->device, a_pRenderer->maxInFlightFrames, a_pRenderer->inFlightFences, VK_TRUE, UINT64_MAX);
+}
+
 void CreateSyncObjects(Renderer** a_ppRenderer)
 {
 	LOG_IF(*a_ppRenderer, LogSeverity::ERR, "Value at a_ppRenderer is NULL");
@@ -889,14 +1001,13 @@ VkImageView CreateImageView(Renderer* a_pRenderer, Texture* a_pTexture)
 	return imageView;
 }
 
-void CreateTextureUtil(Renderer* a_pRenderer, Texture** a_ppTexture)
+VkImage CreateImageUtil(Renderer* a_pRenderer, Texture* a_pTexture)
 {
 	LOG_IF(a_pRenderer, LogSeverity::ERR, "Value at a_pRenderer is NULL");
-	LOG_IF(a_ppTexture, LogSeverity::ERR, "Value at a_ppTexture is NULL");
+	LOG_IF(a_pTexture, LogSeverity::ERR, "a_pTexture is NULL");
 
-	Texture* pTexture = *a_ppTexture;
+	Texture* pTexture = a_pTexture;
 	VkImage image = {};
-	VkDeviceMemory imageMemory = {};
 
 	uint32_t mipLevels = (pTexture->desc.mipLevels == -1) ? 1 : pTexture->desc.mipLevels;
 	if (pTexture->desc.mipMaps && pTexture->desc.mipLevels == -1)
@@ -923,6 +1034,17 @@ void CreateTextureUtil(Renderer* a_pRenderer, Texture** a_ppTexture)
 	imageInfo.flags = 0; // Optional
 
 	LOG_IF((vkCreateImage(a_pRenderer->device, &imageInfo, nullptr, &image) == VK_SUCCESS), LogSeverity::ERR, "failed to create image!");
+	return image;
+}
+
+void CreateTextureUtil(Renderer* a_pRenderer, Texture** a_ppTexture)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "Value at a_pRenderer is NULL");
+	LOG_IF(a_ppTexture, LogSeverity::ERR, "Value at a_ppTexture is NULL");
+
+	Texture* pTexture = *a_ppTexture;
+	VkImage image = CreateImageUtil(a_pRenderer, pTexture);
+	VkDeviceMemory imageMemory = {};
 
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(a_pRenderer->device, image, &memRequirements);
@@ -940,6 +1062,117 @@ void CreateTextureUtil(Renderer* a_pRenderer, Texture** a_ppTexture)
 	pTexture->imageView = CreateImageView(a_pRenderer, pTexture);
 }
 
+bool IsFormatSupported(Renderer* a_pRenderer, VkFormat a_eFormat, VkFormatFeatureFlags a_uFeatures)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+
+	VkFormatProperties properties = {};
+	vkGetPhysicalDeviceFormatProperties(a_pRenderer->physicalDevice, a_eFormat, &properties);
+	return (properties.optimalTilingFeatures & a_uFeatures) == a_uFeatures;
+}
+
+std::string FindCompressedTexture(Renderer* a_pRenderer, const std::string& a_sSourcePath)
+{
+	for (TextureFileFormat format : textureFileFormats)
+	{
+		if (!IsFormatSupported(a_pRenderer, (VkFormat)format))
+			continue;
+
+		const std::string path = GetTextureFilePath(a_sSourcePath, format);
+		if (ExistFile(path.c_str()))
+			return path;
+	}
+	return std::string();
+}
+
+// uploads every level of a TextureFile as it is, the file decides the format, size and mip levels.
+// false leaves the texture untouched so the caller can decode the source image instead
+static bool CreateCompressedTexture(Renderer* a_pRenderer, Texture** a_ppTexture, const std::string& a_sPath)
+{
+	Texture* pTexture = *a_ppTexture;
+
+	FileHandle file = FileOpen(a_sPath.c_str(), "rb");
+	if (!file)
+		return false;
+	uint64_t fileSize = FileSize(file);
+	char* buffer = (char*)malloc(sizeof(char) * (size_t)fileSize);
+	fileSize = FileRead(file, &buffer, fileSize);
+	FileClose(file);
+
+	TextureFile textureFile;
+	if (!ReadTextureFile(buffer, fileSize, fileSize, &textureFile))
+	{
+		LOG(LogSeverity::WARNING, "%s is not a valid texture file, decoding the source image", a_sPath.c_str());
+		free(buffer);
+		return false;
+	}
+
+	// levels packed back to back, the file stores them smallest first with padding
+	VkDeviceSize imageSize = 0;
+	for (uint32_t i = 0; i < textureFile.levelCount; ++i)
+		imageSize += textureFile.levels[i].size;
+
+	Buffer* pStagingBuffer = new Buffer();
+	pStagingBuffer->desc.bufferSize = imageSize;
+	pStagingBuffer->desc.bufferUsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	pStagingBuffer->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	CreateBufferUtil(a_pRenderer, &pStagingBuffer);
+
+	VkBufferImageCopy regions[MAX_TEXTURE_FILE_LEVELS] = {};
+	char* data;
+	vkMapMemory(a_pRenderer->device, pStagingBuffer->bufferMemory, 0, imageSize, 0, (void**)&data);
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < textureFile.levelCount; ++i)
+	{
+		memcpy(data + offset, buffer + textureFile.levels[i].offset, static_cast<size_t>(textureFile.levels[i].size));
+
+		regions[i].bufferOffset = offset;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.baseArrayLayer = 0;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageExtent = {
+			textureFile.width >> i ? textureFile.width >> i : 1,
+			textureFile.height >> i ? textureFile.height >> i : 1,
+			1
+		};
+		offset += textureFile.levels[i].size;
+	}
+	vkUnmapMemory(a_pRenderer->device, pStagingBuffer->bufferMemory);
+	free(buffer);
+
+	pTexture->desc.format = (VkFormat)textureFile.format;
+	pTexture->desc.width = textureFile.width;
+	pTexture->desc.height = textureFile.height;
+	pTexture->desc.mipLevels = textureFile.levelCount;
+	CreateTextureUtil(a_pRenderer, a_ppTexture);
+
+	{
+		CommandBuffer cmdBfr;
+		BeginSingleTimeCommands(a_pRenderer, &cmdBfr);
+		TransitionImageLayout(&cmdBfr, pTexture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		vkCmdCopyBufferToImage(cmdBfr.commandBuffer, pStagingBuffer->buffer, pTexture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, textureFile.levelCount, regions);
+		TransitionImageLayout(&cmdBfr, pTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pTexture->desc.initialLayout);
+		EndSingleTimeCommands(a_pRenderer, &cmdBfr);
+	}
+
+	DestroyBuffer(a_pRenderer, &pStagingBuffer);
+	delete pStagingBuffer;
+	return true;
+}
+
+// through MapFile so images of mounted archives decode in place
+static stbi_uc* LoadImageFile(const char* a_sPath, int* a_pWidth, int* a_pHeight, int* a_pChannels)
+{
+	MappedFile file = {};
+	if (!MapFile(a_sPath, &file))
+		return nullptr;
+
+	stbi_uc* pixels = stbi_load_from_memory((const stbi_uc*)file.pData, (int)file.size, a_pWidth, a_pHeight, a_pChannels, STBI_rgb_alpha);
+	UnmapFile(&file);
+	return pixels;
+}
+
 void CreateTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 {
 	LOG_IF(a_pRenderer, LogSeverity::ERR, "Value at a_pRenderer is NULL");
@@ -960,17 +1193,23 @@ void CreateTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 	}
 	else
 	{
+		// a block compressed copy carries its own mip chain, the source image is the fallback
+		if (!pTexture->desc.filePath.empty() && !pTexture->desc.rawData)
+		{
+			const std::string compressedPath = FindCompressedTexture(a_pRenderer, pTexture->desc.filePath);
+			if (!compressedPath.empty() && pTexture->desc.streamed && a_pRenderer->pTextureStreamer &&
+				CreateStreamedTexture(a_pRenderer->pTextureStreamer, a_ppTexture, compressedPath.c_str()))
+				return;
+			if (!compressedPath.empty() && CreateCompressedTexture(a_pRenderer, a_ppTexture, compressedPath))
+				return;
+		}
+
 		int texWidth = 0, texHeight = 0, texChannels = 0;
 		unsigned char* pixels = nullptr;
 		VkDeviceSize imageSize;
 
-		if (!pTexture->desc.filePath.empty())
-		{
-			pixels = stbi_load(pTexture->desc.filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-			LOG_IF(pixels, LogSeverity::ERR, "failed to load texture image!");
-			imageSize = texWidth * texHeight * 4;
-		}
-		else if ((pTexture->desc.rawDataSize > 0) && (pTexture->desc.rawData != nullptr))
+		// pixels LoadTextureData decoded ahead win over the file
+		if ((pTexture->desc.rawDataSize > 0) && (pTexture->desc.rawData != nullptr))
 		{
 			pixels = (unsigned char*)pTexture->desc.rawData;
 			imageSize = pTexture->desc.rawDataSize;
@@ -978,6 +1217,12 @@ void CreateTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 			texHeight = pTexture->desc.height;
 			texChannels = 4;
 		}
+		else if (!pTexture->desc.filePath.empty())
+		{
+			pixels = LoadImageFile(pTexture->desc.filePath.c_str(), &texWidth, &texHeight, &texChannels);
+			LOG_IF(pixels, LogSeverity::ERR, "failed to load texture image!");
+			imageSize = texWidth * texHeight * 4;
+		}
 
 		Buffer* pStagingBuffer = new Buffer();
 		pStagingBuffer->desc.bufferSize = imageSize;
@@ -990,7 +1235,7 @@ void CreateTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 		memcpy(data, pixels, static_cast<size_t>(imageSize));
 		vkUnmapMemory(a_pRenderer->device, pStagingBuffer->bufferMemory);
 
-		if (!pTexture->desc.filePath.empty())
+		if (pixels != pTexture->desc.rawData)
 			stbi_image_free(pixels);
 
 		pTexture->desc.width = texWidth;
@@ -1069,6 +1314,8 @@ void DestroyTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 {
 	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
 	LOG_IF(*a_ppTexture, LogSeverity::ERR, "Value at a_ppTexture is NULL");
+	if (a_pRenderer->pTextureStreamer)
+		ReleaseStreamedTexture(a_pRenderer->pTextureStreamer, *a_ppTexture);
 	vkDestroyImageView(a_pRenderer->device, (*a_ppTexture)->imageView, nullptr);
 	vkDestroyImage(a_pRenderer->device, (*a_ppTexture)->image, nullptr);
 	vkFreeMemory(a_pRenderer->device, (*a_ppTexture)->imageMemory, nullptr);
@@ -1077,6 +1324,46 @@ void DestroyTexture(Renderer* a_pRenderer, Texture** a_ppTexture)
 	(*a_ppTexture)->imageMemory = VK_NULL_HANDLE;
 }
 
+void LoadTextureData(Renderer* a_pRenderer, Texture* a_pTexture, const void* a_pFileData, uint64_t a_uFileSize)
+{
+	LOG_IF(a_pTexture, LogSeverity::ERR, "a_pTexture is NULL");
+	TextureDesc& desc = a_pTexture->desc;
+	if (desc.filePath.empty() || desc.rawData || !FindCompressedTexture(a_pRenderer, desc.filePath).empty())
+		return;
+
+	int texWidth = 0, texHeight = 0, texChannels = 0;
+	stbi_uc* pixels = a_pFileData ?
+		stbi_load_from_memory((const stbi_uc*)a_pFileData, (int)a_uFileSize, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha) :
+		LoadImageFile(desc.filePath.c_str(), &texWidth, &texHeight, &texChannels);
+	// CreateTexture reports a file that can't be decoded
+	if (!pixels)
+		return;
+
+	desc.rawData = pixels;
+	desc.rawDataSize = (uint64_t)texWidth * texHeight * 4;
+	desc.width = texWidth;
+	desc.height = texHeight;
+}
+
+void FreeTextureData(Texture* a_pTexture)
+{
+	LOG_IF(a_pTexture, LogSeverity::ERR, "a_pTexture is NULL");
+	stbi_image_free(a_pTexture->desc.rawData);
+	a_pTexture->desc.rawData = nullptr;
+	a_pTexture->desc.rawDataSize = 0;
+}
+
+uint64_t GetTextureMemorySize(Renderer* a_pRenderer, const Texture* a_pTexture)
+{
+	LOG_IF(a_pTexture, LogSeverity::ERR, "a_pTexture is NULL");
+	if (a_pTexture->image == VK_NULL_HANDLE)
+		return 0;
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(a_pRenderer->device, a_pTexture->image, &memRequirements);
+	return memRequirements.size;
+}
+
 void CreateSampler(Renderer* a_pRenderer, Sampler** a_ppSampler)
 {
 	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
@@ -1297,6 +1584,12 @@ void CreateBuffer(Renderer* a_pRenderer, Buffer** a_ppBuffer)
 
 	Buffer* pBuffer = *a_ppBuffer;
 
+	// only written by the device
+	if ((pBuffer->desc.memoryPropertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !pBuffer->desc.pData &&
+		!(pBuffer->desc.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+	{
+		CreateBufferUtil(a_pRenderer, a_ppBuffer);
+	}
 	if ((pBuffer->desc.memoryPropertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && pBuffer->desc.pData)
 	{
 		VkBufferUsageFlags usageFlags = pBuffer->desc.bufferUsageFlags;
@@ -1410,7 +1703,7 @@ void CreateRenderPass(Renderer* a_pRenderer, LoadActionsDesc* pLoadActions, Rend
 		attachments[colorAttachmentsCount].format = pRenderPass->desc.depthStencilFormat;
 		attachments[colorAttachmentsCount].samples = pRenderPass->desc.sampleCount;
 		attachments[colorAttachmentsCount].loadOp = pLoadActions ? pLoadActions->loadDepthAction : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[colorAttachmentsCount].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[colorAttachmentsCount].storeOp = pLoadActions ? pLoadActions->storeDepthAction : VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[colorAttachmentsCount].stencilLoadOp = pLoadActions ? pLoadActions->loadStencilAction : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachments[colorAttachmentsCount].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		attachments[colorAttachmentsCount].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -1463,7 +1756,7 @@ void CreateDescriptorPool(Renderer** a_ppRenderer)
 	VkDescriptorPoolSize descriptorPoolSizes[] =
 	{
 		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1024 },
-		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8192 },
 		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8192 },
 		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1024 },
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1024 },
@@ -1480,6 +1773,9 @@ void CreateDescriptorPool(Renderer** a_ppRenderer)
 	poolInfo.poolSizeCount = sizeof(descriptorPoolSizes) / sizeof(descriptorPoolSizes[0]);
 	poolInfo.pPoolSizes = descriptorPoolSizes;
 	poolInfo.maxSets = 8192;
+	// sets with update after bind layouts (bindless textures) have to come from such a pool
+	if (pRenderer->bindlessSupported)
+		poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
 	LOG_IF( (vkCreateDescriptorPool(pRenderer->device, &poolInfo, nullptr, &pRenderer->descriptorPool) == VK_SUCCESS),
 		LogSeverity::ERR, "Failed to create descriptor pool" );
 }
@@ -1507,7 +1803,7 @@ void CreateResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppRe
 
 	for (uint32_t i = 0; i < descriptorCount; ++i)
 	{
-		pResourceDescriptor->nameToDescriptorInfoIndexMap.insert({ (uint32_t)std::hash<std::string>{}(sortedDescriptors[i].name) , descriptorCounts[sortedDescriptors[i].set]++ });
+		pResourceDescriptor->nameToDescriptorInfoIndexMap.insert({ hashName(sortedDescriptors[i].name.c_str()) , descriptorCounts[sortedDescriptors[i].set]++ });
 	}
 
 	VkDescriptorSetLayoutBinding* layoutBindings[(uint32_t)DescriptorUpdateFrequency::COUNT] = {};
@@ -1535,7 +1831,7 @@ void CreateResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppRe
 	for (uint32_t i = 0; i < descriptorCount; ++i)
 	{
 		uint32_t set = sortedDescriptors[i].set;
-		uint32_t index = pResourceDescriptor->nameToDescriptorInfoIndexMap[(uint32_t)std::hash<std::string>{}(sortedDescriptors[i].name)];
+		uint32_t index = pResourceDescriptor->nameToDescriptorInfoIndexMap[hashName(sortedDescriptors[i].name.c_str())];
 		
 		memcpy(&(pResourceDescriptor->descriptorInfos[set][index]), (&sortedDescriptors[i]), sizeof(DescriptorInfo));		// store descriptor info in a list of it's set index
 		layoutBindings[set][index] = sortedDescriptors[i].binding;
@@ -1559,6 +1855,27 @@ void CreateResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppRe
 			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 			layoutInfo.bindingCount = descriptorCounts[i];
 			layoutInfo.pBindings = binding;
+
+			// descriptor indexing flags
+			VkDescriptorBindingFlagsEXT bindingFlags[MAX_DESCRIPTORS_PER_SET] = {};
+			VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+			bool hasBindingFlags = false;
+			LOG_IF(descriptorCounts[i] <= MAX_DESCRIPTORS_PER_SET, LogSeverity::ERR, "Too many descriptors in set %d", i);
+			for (uint32_t j = 0; j < descriptorCounts[i]; ++j)
+			{
+				bindingFlags[j] = pResourceDescriptor->descriptorInfos[i][j].bindingFlags;
+				hasBindingFlags |= (bindingFlags[j] != 0);
+				if (bindingFlags[j] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+					layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			}
+			if (hasBindingFlags)
+			{
+				LOG_IF(a_pRenderer->bindlessSupported, LogSeverity::ERR, "Descriptor binding flags used without descriptor indexing support");
+				bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+				bindingFlagsInfo.bindingCount = descriptorCounts[i];
+				bindingFlagsInfo.pBindingFlags = bindingFlags;
+				layoutInfo.pNext = &bindingFlagsInfo;
+			}
 			LOG_IF((vkCreateDescriptorSetLayout(a_pRenderer->device, &layoutInfo, nullptr, &pResourceDescriptor->descriptorSetLayouts[i]) == VK_SUCCESS),
 				LogSeverity::ERR, "failed to create descriptor set layout!");
 			++layoutsCount;
@@ -1569,7 +1886,7 @@ void CreateResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppRe
 	for (uint32_t i = 0; i < pResourceDescriptor->desc.pushConstantCount; ++i)
 	{
 		pushConstantRanges[i] = pResourceDescriptor->desc.pushConstants[i].pushConstant;
-		pResourceDescriptor->nameToPushConstantIndexMap.insert({ (uint32_t)std::hash<std::string>{}(pResourceDescriptor->desc.pushConstants[i].name), i });
+		pResourceDescriptor->nameToPushConstantIndexMap.insert({ hashName(pResourceDescriptor->desc.pushConstants[i].name.c_str()), i });
 	}
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
@@ -1588,20 +1905,30 @@ void CreateResourceDescriptor(Renderer* a_pRenderer, ResourceDescriptor** a_ppRe
 		if (descriptorCounts[i] <= 0)
 			continue;
 
-		std::vector<VkDescriptorUpdateTemplateEntry> descriptorUpdateTemplateEntries(descriptorCounts[i]);
+		std::vector<VkDescriptorUpdateTemplateEntry> descriptorUpdateTemplateEntries;
+		descriptorUpdateTemplateEntries.reserve(descriptorCounts[i]);
 
 		uint32_t offset = 0;
 		for (uint32_t j = 0; j < descriptorCounts[i]; ++j)
 		{
-			descriptorUpdateTemplateEntries[j].descriptorCount = binding[j].descriptorCount;
-			descriptorUpdateTemplateEntries[j].descriptorType = binding[j].descriptorType;
-			descriptorUpdateTemplateEntries[j].dstArrayElement = 0;
-			descriptorUpdateTemplateEntries[j].dstBinding = binding[j].binding;
-			descriptorUpdateTemplateEntries[j].offset = offset;
-			descriptorUpdateTemplateEntries[j].stride = sizeof(DescriptorUpdateData);
+			// variable sized arrays are written element wise with UpdateDescriptorSetArray
+			if (!(pResourceDescriptor->descriptorInfos[i][j].bindingFlags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT))
+			{
+				VkDescriptorUpdateTemplateEntry entry = {};
+				entry.descriptorCount = binding[j].descriptorCount;
+				entry.descriptorType = binding[j].descriptorType;
+				entry.dstArrayElement = 0;
+				entry.dstBinding = binding[j].binding;
+				entry.offset = offset;
+				entry.stride = sizeof(DescriptorUpdateData);
+				descriptorUpdateTemplateEntries.push_back(entry);
+			}
 			offset += sizeof(DescriptorUpdateData);
 		}
 
+		if (descriptorUpdateTemplateEntries.empty())
+			continue;
+
 		VkDescriptorUpdateTemplateCreateInfo createInfo = {
 			VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,  // sType
 			NULL,                                                      // pNext
@@ -1673,6 +2000,20 @@ void CreateDescriptorSet(Renderer* a_pRenderer, DescriptorSet** a_ppDescriptorSe
 	allocInfo.pSetLayouts = layouts.data();
 	allocInfo.pNext = nullptr;
 
+	// variable sized array is always the last binding of the set, allocate it at its full size
+	std::vector<uint32_t> variableCounts;
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo = {};
+	const uint32_t setDescriptorCount = pResDesc->descriptorCounts[updateFrequency];
+	const DescriptorInfo* pLastDescriptorInfo = (setDescriptorCount > 0) ? &pResDesc->descriptorInfos[updateFrequency][setDescriptorCount - 1] : nullptr;
+	if (pLastDescriptorInfo && (pLastDescriptorInfo->bindingFlags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT))
+	{
+		variableCounts.resize(pDescriptorSet->desc.descriptorSetCount, pLastDescriptorInfo->binding.descriptorCount);
+		variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+		variableCountInfo.descriptorSetCount = pDescriptorSet->desc.descriptorSetCount;
+		variableCountInfo.pDescriptorCounts = variableCounts.data();
+		allocInfo.pNext = &variableCountInfo;
+	}
+
 	{
 		MALLOC_ZERO(VkDescriptorSet, ptr, sizeof(VkDescriptorSet) * pDescriptorSet->desc.descriptorSetCount);
 		pDescriptorSet->descriptorSets = ptr;
@@ -1737,7 +2078,7 @@ void UpdateDescriptorSet(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a
 	for (uint32_t i = 0; i < a_uCount; ++i)
 	{
 		const DescriptorUpdateInfo& pInfo = a_pDescriptorUpdateInfos[i];
-		uint32_t nameHash = (uint32_t)std::hash<std::string>{}(pInfo.name);
+		uint32_t nameHash = hashName(pInfo.name);
 		uint32_t descIndex = (uint32_t)-1;
 
 		std::unordered_map<uint32_t, uint32_t>::const_iterator itr = pResourceDescriptor->nameToDescriptorInfoIndexMap.find(nameHash);
@@ -1747,7 +2088,7 @@ void UpdateDescriptorSet(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a
 		}
 		else
 		{
-			LOG(LogSeverity::ERR, "Descriptor of name %s not found!", pInfo.name.c_str());
+			LOG(LogSeverity::ERR, "Descriptor of name %s not found!", pInfo.name);
 			return;
 		}
 
@@ -1760,6 +2101,8 @@ void UpdateDescriptorSet(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a
 		{
 		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
 		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
 			pData->mBufferInfo = a_pDescriptorUpdateInfos[i].mBufferInfo;
 			break;
 		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
@@ -1771,11 +2114,57 @@ void UpdateDescriptorSet(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a
 		}
 	}
 
+	LOG_IF(pResourceDescriptor->descriptorUpdateTemplates[updateFrequency] != VK_NULL_HANDLE, LogSeverity::ERR,
+		"Set %u has no update template, use UpdateDescriptorSetArray", updateFrequency);
 	vkUpdateDescriptorSetWithTemplate(a_pRenderer->device, a_pDescriptorSet->descriptorSets[index],
 		a_pDescriptorSet->desc.pResourceDescriptor->descriptorUpdateTemplates[updateFrequency], pUpdateData);
 }
 
-void BindDescriptorSet(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndex, DescriptorSet* a_pDescriptorSet, ResourceDescriptor* a_pResourceDescriptor, uint32_t a_uDynamicOffsetCount, const uint32_t* a_uOffsets)
+void UpdateDescriptorSetArray(Renderer* a_pRenderer, uint32_t index, DescriptorSet* a_pDescriptorSet, const char* a_sName, uint32_t a_uFirstElement, uint32_t a_uCount, const VkDescriptorImageInfo* a_pImageInfos)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_pDescriptorSet, LogSeverity::ERR, "a_pDescriptorSet is NULL");
+	LOG_IF(a_pImageInfos, LogSeverity::ERR, "a_pImageInfos is NULL");
+
+	ResourceDescriptor* pResourceDescriptor = a_pDescriptorSet->desc.pResourceDescriptor;
+	uint32_t updateFrequency = (uint32_t)a_pDescriptorSet->desc.updateFrequency;
+
+	std::unordered_map<uint32_t, uint32_t>::const_iterator itr = pResourceDescriptor->nameToDescriptorInfoIndexMap.find(hashName(a_sName));
+	if (itr == pResourceDescriptor->nameToDescriptorInfoIndexMap.end())
+	{
+		LOG(LogSeverity::ERR, "Descriptor of name %s not found!", a_sName);
+		return;
+	}
+
+	const DescriptorInfo& descInfo = pResourceDescriptor->descriptorInfos[updateFrequency][itr->second];
+	LOG_IF(a_uFirstElement + a_uCount <= descInfo.binding.descriptorCount, LogSeverity::ERR, "Descriptor array %s overflow", a_sName);
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = a_pDescriptorSet->descriptorSets[index];
+	write.dstBinding = descInfo.binding.binding;
+	write.dstArrayElement = a_uFirstElement;
+	write.descriptorCount = a_uCount;
+	write.descriptorType = descInfo.binding.descriptorType;
+	write.pImageInfo = a_pImageInfos;
+	vkUpdateDescriptorSets(a_pRenderer->device, 1, &write, 0, nullptr);
+}
+
+// sets and push constants bound with another layout may have been disturbed, forget them when the layout changes
+static void UseBoundPipelineLayout(CommandBuffer* a_pCommandBuffer, VkPipelineLayout a_PipelineLayout)
+{
+	BoundState& bound = a_pCommandBuffer->boundState;
+	if (bound.pipelineLayout == a_PipelineLayout)
+		return;
+
+	bound.pipelineLayout = a_PipelineLayout;
+	memset(bound.descriptorSets, 0, sizeof(bound.descriptorSets));
+	memset(bound.dynamicOffsets, 0, sizeof(bound.dynamicOffsets));
+	bound.pushConstantSize = 0;
+}
+
+void BindDescriptorSet(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndex, DescriptorSet* a_pDescriptorSet, ResourceDescriptor* a_pResourceDescriptor, uint32_t a_uDynamicOffsetCount, const uint32_t* a_uOffsets,
+	VkPipelineBindPoint a_BindPoint)
 {
 	LOG_IF(a_pDescriptorSet, LogSeverity::ERR, "a_pDescriptorSet is NULL");
 	if(a_uDynamicOffsetCount > 0)
@@ -1791,8 +2180,133 @@ void BindDescriptorSet(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndex, Descr
 		pResourceDescriptor = a_pResourceDescriptor;
 	}
 
+	VkDescriptorSet descriptorSet = a_pDescriptorSet->descriptorSets[a_uIndex];
+	if (a_BindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS)
+	{
+		a_pCommandBuffer->stats.stateChangeCount++;
+		vkCmdBindDescriptorSets(a_pCommandBuffer->commandBuffer, a_BindPoint, pResourceDescriptor->pipelineLayout, updateFrequency, 1,
+			&descriptorSet, a_uDynamicOffsetCount, (a_uDynamicOffsetCount > 0) ? a_uOffsets : NULL);
+		return;
+	}
+
+	// only sets with at most one dynamic offset are tracked
+	BoundState& bound = a_pCommandBuffer->boundState;
+	const uint32_t dynamicOffset = (a_uDynamicOffsetCount > 0) ? a_uOffsets[0] : 0;
+	const bool tracked = (updateFrequency < MAX_BOUND_DESCRIPTOR_SETS && a_uDynamicOffsetCount <= 1);
+	UseBoundPipelineLayout(a_pCommandBuffer, pResourceDescriptor->pipelineLayout);
+	if (tracked && bound.descriptorSets[updateFrequency] == descriptorSet && bound.dynamicOffsets[updateFrequency] == dynamicOffset)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
+	}
+	if (updateFrequency < MAX_BOUND_DESCRIPTOR_SETS)
+	{
+		bound.descriptorSets[updateFrequency] = tracked ? descriptorSet : VK_NULL_HANDLE;
+		bound.dynamicOffsets[updateFrequency] = dynamicOffset;
+	}
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdBindDescriptorSets(a_pCommandBuffer->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pResourceDescriptor->pipelineLayout, updateFrequency, 1,
-		&a_pDescriptorSet->descriptorSets[a_uIndex], a_uDynamicOffsetCount, (a_uDynamicOffsetCount > 0) ? a_uOffsets : NULL);
+		&descriptorSet, a_uDynamicOffsetCount, (a_uDynamicOffsetCount > 0) ? a_uOffsets : NULL);
+}
+
+#pragma endregion
+
+#pragma region PIPELINE_CACHE
+
+// checks the VkPipelineCache header of data saved by a previous run, a cache from
+// another gpu or driver is useless and may be rejected by the driver
+bool IsPipelineCacheCompatible(Renderer* a_pRenderer, const char* a_pData, uint64_t a_uSize)
+{
+	const uint32_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+	if (a_uSize < headerSize)
+		return false;
+
+	uint32_t header[4];
+	memcpy(header, a_pData, sizeof(header));
+	const uint32_t headerLength = header[0];
+	const uint32_t headerVersion = header[1];
+	const uint32_t vendorID = header[2];
+	const uint32_t deviceID = header[3];
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(a_pRenderer->physicalDevice, &deviceProperties);
+
+	return headerLength >= headerSize && headerLength <= a_uSize &&
+		headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		vendorID == deviceProperties.vendorID &&
+		deviceID == deviceProperties.deviceID &&
+		memcmp(a_pData + 4 * sizeof(uint32_t), deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void CreatePipelineCache(Renderer** a_ppRenderer)
+{
+	LOG_IF(*a_ppRenderer, LogSeverity::ERR, "Value at a_ppRenderer is NULL");
+	Renderer* pRenderer = *a_ppRenderer;
+
+	char* pData = nullptr;
+	uint64_t size = 0;
+	if (ReadUserFile(PIPELINE_CACHE_FILE, &pData, &size) && !IsPipelineCacheCompatible(pRenderer, pData, size))
+	{
+		LOG(LogSeverity::WARNING, "Discarding pipeline cache of %llu bytes, created by a different device or driver", (unsigned long long)size);
+		free(pData);
+		pData = nullptr;
+		size = 0;
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = (size_t)size;
+	cacheInfo.pInitialData = pData;
+	VkResult result = vkCreatePipelineCache(pRenderer->device, &cacheInfo, nullptr, &pRenderer->pipelineCache);
+	if (result != VK_SUCCESS && pData)
+	{
+		// the driver refused the data, start cold
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		size = 0;
+		result = vkCreatePipelineCache(pRenderer->device, &cacheInfo, nullptr, &pRenderer->pipelineCache);
+	}
+	LOG_IF(result == VK_SUCCESS, LogSeverity::ERR, "Failed to create pipeline cache");
+	free(pData);
+
+	pRenderer->stats.pipelineCacheLoadedSize = size;
+	pRenderer->pipelineCacheDirty = false;
+	framesSincePipelineCacheSave = 0;
+	LOG(LogSeverity::INFO, "Pipeline cache created with %llu bytes of initial data", (unsigned long long)size);
+}
+
+void SavePipelineCache(Renderer* a_pRenderer)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	if (a_pRenderer->pipelineCache == VK_NULL_HANDLE)
+		return;
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(a_pRenderer->device, a_pRenderer->pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return;
+
+	char* pData = (char*)malloc(size);
+	if (vkGetPipelineCacheData(a_pRenderer->device, a_pRenderer->pipelineCache, &size, pData) == VK_SUCCESS)
+	{
+		if (WriteUserFile(PIPELINE_CACHE_FILE, pData, size))
+			a_pRenderer->pipelineCacheDirty = false;
+		else
+			LOG(LogSeverity::WARNING, "Failed to save pipeline cache");
+	}
+	free(pData);
+	framesSincePipelineCacheSave = 0;
+}
+
+void DestroyPipelineCache(Renderer** a_ppRenderer)
+{
+	LOG_IF(*a_ppRenderer, LogSeverity::ERR, "Value at a_ppRenderer is NULL");
+	Renderer* pRenderer = *a_ppRenderer;
+
+	if (pRenderer->pipelineCacheDirty)
+		SavePipelineCache(pRenderer);
+	vkDestroyPipelineCache(pRenderer->device, pRenderer->pipelineCache, nullptr);
+	pRenderer->pipelineCache = VK_NULL_HANDLE;
 }
 
 #pragma endregion
@@ -1993,8 +2507,17 @@ void CreateGraphicsPipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline)
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	LOG_IF( (vkCreateGraphicsPipelines(a_pRenderer->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &(pPipeline->pipeline)) == VK_SUCCESS),
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	LOG_IF( (vkCreateGraphicsPipelines(a_pRenderer->device, a_pRenderer->pipelineCache, 1, &pipelineInfo, nullptr, &(pPipeline->pipeline)) == VK_SUCCESS),
 		LogSeverity::ERR, "Failed to create graphics pipeline!" );
+	pPipeline->id = ++pipelineIDs;
+	float creationTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	a_pRenderer->stats.pipelineCount++;
+	a_pRenderer->stats.pipelineCreationTime += creationTime;
+	a_pRenderer->stats.lastPipelineCreationTime = creationTime;
+	a_pRenderer->pipelineCacheDirty = true;
+	LOG(LogSeverity::INFO, "Graphics pipeline created in %.2f ms", creationTime);
 
 	DestroyRenderPass(a_pRenderer, &pRenderPass);
 	delete pRenderPass;
@@ -2008,6 +2531,49 @@ void DestroyGraphicsPipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline)
 	(*a_ppPipeline)->pipeline = VK_NULL_HANDLE;
 }
 
+void CreateComputePipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppPipeline, LogSeverity::ERR, "Value at a_ppPipeline is NULL");
+	LOG_IF((*a_ppPipeline)->desc.pResourceDescriptor, LogSeverity::ERR, "Value at a_ppPipeline is NULL");
+	LOG_IF((*a_ppPipeline)->desc.pResourceDescriptor->pipelineLayout, LogSeverity::ERR, "pipelineLayout is NULL");
+	LOG_IF((*a_ppPipeline)->desc.shaderCount == 1 && (*a_ppPipeline)->desc.shaders[0]->stage == VK_SHADER_STAGE_COMPUTE_BIT,
+		LogSeverity::ERR, "A compute pipeline takes exactly one compute shader");
+
+	Pipeline* pPipeline = *a_ppPipeline;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = pPipeline->desc.shaders[0]->shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pPipeline->desc.pResourceDescriptor->pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	LOG_IF((vkCreateComputePipelines(a_pRenderer->device, a_pRenderer->pipelineCache, 1, &pipelineInfo, nullptr, &(pPipeline->pipeline)) == VK_SUCCESS),
+		LogSeverity::ERR, "Failed to create compute pipeline!");
+	pPipeline->id = ++pipelineIDs;
+	pPipeline->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+	float creationTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	a_pRenderer->stats.pipelineCount++;
+	a_pRenderer->stats.pipelineCreationTime += creationTime;
+	a_pRenderer->stats.lastPipelineCreationTime = creationTime;
+	a_pRenderer->pipelineCacheDirty = true;
+	LOG(LogSeverity::INFO, "Compute pipeline created in %.2f ms", creationTime);
+}
+
+void DestroyComputePipeline(Renderer* a_pRenderer, Pipeline** a_ppPipeline)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppPipeline, LogSeverity::ERR, "Value at a_ppPipeline is NULL");
+	vkDestroyPipeline(a_pRenderer->device, (*a_ppPipeline)->pipeline, nullptr);
+	(*a_ppPipeline)->pipeline = VK_NULL_HANDLE;
+}
+
 #pragma region RenderTarget
 
 void CreateRenderTarget(Renderer* a_pRenderer, RenderTarget** a_ppRenderTarget)
@@ -2032,6 +2598,65 @@ void DestroyRenderTarget(Renderer* a_pRenderer, RenderTarget** a_ppRenderTarget)
 	DestroyTexture(a_pRenderer, &pRenderTarget->pTexture);
 }
 
+void CreateAliasedRenderTargets(Renderer* a_pRenderer, uint32_t a_uCount, RenderTarget** a_ppRenderTargets, VkDeviceMemory* a_pMemory, VkDeviceSize* a_pSize)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_ppRenderTargets, LogSeverity::ERR, "a_ppRenderTargets is NULL");
+	LOG_IF(a_pMemory, LogSeverity::ERR, "a_pMemory is NULL");
+
+	// the allocation has to satisfy every image, offset 0 satisfies any alignment
+	VkDeviceSize size = 0;
+	uint32_t memoryTypeBits = ~0u;
+	VkMemoryPropertyFlags properties = 0;
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		RenderTarget* pRenderTarget = a_ppRenderTargets[i];
+		LOG_IF(pRenderTarget->pTexture, LogSeverity::ERR, "pTexture is NULL");
+		LOG_IF((pRenderTarget->id == INVALID_RT_ID), LogSeverity::ERR, "RenderTarger is already initialized");
+
+		pRenderTarget->id = RT_IDs++;
+		pRenderTarget->pTexture->desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		pRenderTarget->pTexture->image = CreateImageUtil(a_pRenderer, pRenderTarget->pTexture);
+		pRenderTarget->pTexture->imageMemory = VK_NULL_HANDLE;
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(a_pRenderer->device, pRenderTarget->pTexture->image, &memRequirements);
+		size = MAX(size, memRequirements.size);
+		memoryTypeBits &= memRequirements.memoryTypeBits;
+		properties |= pRenderTarget->pTexture->desc.properties;
+	}
+	LOG_IF(memoryTypeBits != 0, LogSeverity::ERR, "Aliased render targets have no memory type in common!");
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = findMemoryType(a_pRenderer, memoryTypeBits, properties);
+	LOG_IF((vkAllocateMemory(a_pRenderer->device, &allocInfo, nullptr, a_pMemory) == VK_SUCCESS), LogSeverity::ERR, "failed to allocate aliased render target memory!");
+
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		Texture* pTexture = a_ppRenderTargets[i]->pTexture;
+		vkBindImageMemory(a_pRenderer->device, pTexture->image, *a_pMemory, 0);
+		pTexture->imageView = CreateImageView(a_pRenderer, pTexture);
+	}
+
+	if (a_pSize)
+		*a_pSize = size;
+}
+
+void DestroyAliasedRenderTargets(Renderer* a_pRenderer, uint32_t a_uCount, RenderTarget** a_ppRenderTargets, VkDeviceMemory* a_pMemory)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_pMemory, LogSeverity::ERR, "a_pMemory is NULL");
+
+	// the textures do not own memory, DestroyTexture skips the free
+	for (uint32_t i = 0; i < a_uCount; ++i)
+		DestroyRenderTarget(a_pRenderer, &a_ppRenderTargets[i]);
+
+	vkFreeMemory(a_pRenderer->device, *a_pMemory, nullptr);
+	*a_pMemory = VK_NULL_HANDLE;
+}
+
 static inline uint32_t hash(const uint32_t* mem, uint32_t size, uint32_t prev = 2166136261U)
 {
 	uint32_t result = prev;
@@ -2040,7 +2665,8 @@ static inline uint32_t hash(const uint32_t* mem, uint32_t size, uint32_t prev =
 	return (uint32_t)result;
 }
 
-void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTargetCount, RenderTarget** a_ppRenderTargets, LoadActionsDesc* a_pLoadActions, RenderTarget* a_pDepthTarget)
+void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTargetCount, RenderTarget** a_ppRenderTargets, LoadActionsDesc* a_pLoadActions, RenderTarget* a_pDepthTarget,
+	VkSubpassContents a_SubpassContents)
 {
 	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "Value at a_ppCommandBuffer is NULL");
 	LOG_IF(a_pCommandBuffer->pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
@@ -2052,6 +2678,7 @@ void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTarget
 	{
 		vkCmdEndRenderPass(a_pCommandBuffer->commandBuffer);
 		a_pCommandBuffer->activeRenderPass = VK_NULL_HANDLE;
+		a_pCommandBuffer->activeFramebuffer = VK_NULL_HANDLE;
 	}
 
 	if (!a_uRenderTargetCount && !a_pDepthTarget)
@@ -2082,11 +2709,12 @@ void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTarget
 
 	if (a_pDepthTarget)
 	{
-		uint32_t renderPassHashValues[4] = {
+		uint32_t renderPassHashValues[5] = {
 			(uint32_t)a_pDepthTarget->pTexture->desc.format,
 			(uint32_t)a_pDepthTarget->pTexture->desc.sampleCount,
 			(a_pLoadActions) ? (uint32_t)a_pLoadActions->loadDepthAction : 0,
-			(a_pLoadActions) ? (uint32_t)a_pLoadActions->loadStencilAction : 0
+			(a_pLoadActions) ? (uint32_t)a_pLoadActions->loadStencilAction : 0,
+			(a_pLoadActions) ? (uint32_t)a_pLoadActions->storeDepthAction : 0
 		};
 
 		uint32_t frameBufferHashValues[3] = {
@@ -2166,6 +2794,7 @@ void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTarget
 	}
 
 	a_pCommandBuffer->activeRenderPass = renderpass;
+	a_pCommandBuffer->activeFramebuffer = framebuffer;
 
 	VkExtent2D extent = { 0, 0};
 	if (a_uRenderTargetCount)
@@ -2204,113 +2833,151 @@ void BindRenderTargets(CommandBuffer* a_pCommandBuffer, uint32_t a_uRenderTarget
 	renderPassInfo.clearValueCount = clearValueCount;
 	renderPassInfo.pClearValues = clearValues;
 
-	vkCmdBeginRenderPass(a_pCommandBuffer->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(a_pCommandBuffer->commandBuffer, &renderPassInfo, a_SubpassContents);
 }
 
 #pragma endregion
 
-void CreateShaderModule(Renderer* a_pRenderer, const char* a_sPath, ShaderModule** a_ppShaderModule)
+#if defined(__ANDROID_API__) || defined(USE_SHADERC)
+// in process compile, the only option on android. on windows define USE_SHADERC and link
+// shaderc_shared.lib from the Vulkan SDK to skip spawning glslangValidator during development
+bool CompileShaderWithShaderc(const char* a_sPath, VkShaderStageFlagBits a_eStage, const char* a_sDefines, std::vector<char>& a_Code)
+{
+	FileHandle file = FileOpen(a_sPath, "rb");
+	if (!file)
+		return false;
+	uint64_t fileSize = FileSize(file);
+	char* buffer = (char*)malloc(sizeof(char) * (size_t)fileSize);
+	fileSize = FileRead(file, &buffer, fileSize);
+	FileClose(file);
+
+	shaderc_shader_kind kind = {};
+	switch (a_eStage)
+	{
+	case VK_SHADER_STAGE_VERTEX_BIT:	kind = shaderc_glsl_vertex_shader;		break;
+	case VK_SHADER_STAGE_FRAGMENT_BIT:	kind = shaderc_glsl_fragment_shader;	break;
+	default: 
+		LOG(LogSeverity::ERR, "Shader Type not supported yet!");
+		break;
+	}
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	// must match SHADER_OPTIONS, it is part of the cache key
+#if defined(__ANDROID_API__)
+	options.AddMacroDefinition("TARGET_ANDROID", "1");
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+#else
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+#endif
+	for (const char* define = a_sDefines; *define; )
+	{
+		const char* end = strchr(define, ' ');
+		if (!end)
+			end = define + strlen(define);
+		const std::string token(define, end);
+		size_t equals = token.find('=');
+		if (!token.empty())
+			options.AddMacroDefinition(token.substr(0, equals), (equals == std::string::npos) ? std::string() : token.substr(equals + 1));
+		define = *end ? end + 1 : end;
+	}
+	shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(buffer, (size_t)fileSize, kind, a_sPath, "main", options);
+	free(buffer);
+	LOG_IF((module.GetCompilationStatus() == shaderc_compilation_status_success), LogSeverity::ERR, "SpvCompilation Error: %s", module.GetErrorMessage().c_str());
+	if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+		return false;
+
+	size_t byteCodeSize = (module.cend() - module.cbegin()) * sizeof(uint32_t);
+	const char* _code = reinterpret_cast<const char*>(module.cbegin());
+	a_Code.assign(_code, _code + byteCodeSize);
+	return true;
+}
+#endif
+
+bool LoadSpirV(const char* a_sPath, bool a_bUserFile, std::vector<char>& a_Code)
+{
+	if (a_bUserFile)
+	{
+		char* buffer = nullptr;
+		uint64_t fileSize = 0;
+		if (!ReadUserFile(a_sPath, &buffer, &fileSize))
+			return false;
+		a_Code.assign(buffer, buffer + fileSize);
+		free(buffer);
+	}
+	else
+	{
+		if (!ExistFile(a_sPath))
+			return false;
+		FileHandle file = FileOpen(a_sPath, "rb");
+		uint64_t fileSize = FileSize(file);
+		a_Code.resize((size_t)fileSize);
+		char* buffer = a_Code.data();
+		a_Code.resize((size_t)FileRead(file, &buffer, fileSize));
+		FileClose(file);
+	}
+	// a spir-v module is a whole number of words
+	return a_Code.size() >= sizeof(uint32_t) && (a_Code.size() % sizeof(uint32_t)) == 0;
+}
+
+void CreateShaderModule(Renderer* a_pRenderer, const char* a_sPath, ShaderModule** a_ppShaderModule, const char* a_sDefines)
 {
 	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
 	LOG_IF(*a_ppShaderModule, LogSeverity::ERR, "Value at a_ppShaderModule is NULL");
 	LOG_IF(a_sPath, LogSeverity::ERR, "a_sPath is NULL");
+	LOG_IF(a_sDefines, LogSeverity::ERR, "a_sDefines is NULL");
 
 	ShaderModule* pShaderModule = *a_ppShaderModule;
-	char* buffer = nullptr;
 
-#if defined(_WIN32)
-	// convert to spirv
 	std::string path = std::string(a_sPath);
-	std::replace(path.begin(), path.end(), '/', '\\');
-
-	size_t index = path.find_last_of("\\");
-	std::string filePath = path.substr(0, index);
+	size_t index = path.find_last_of("/\\");
+	std::string filePath = (index == std::string::npos) ? std::string() : path.substr(0, index + 1);
 	std::string shaderNameWithExt = path.substr(index + 1);
 
-	std::string vulkan_env = "VULKAN_SDK";
-	char* vulkan_env_str_buffer;
-	size_t bufferCount;
-	_dupenv_s(&vulkan_env_str_buffer, &bufferCount, vulkan_env.c_str());
-
-	char cdbuffer[256];
-	GetCurrentDir(cdbuffer, 256);
-
-	std::string glslangValidator = vulkan_env_str_buffer;
-	glslangValidator += "\\Bin\\glslangValidator.exe";
-	std::string inputFilePath = cdbuffer + std::string("\\") + filePath + std::string("\\") + shaderNameWithExt;
-	std::string outputFilePath = cdbuffer + std::string("\\") + filePath + "\\SpirV\\";
-
-	if(!ExistDirectory(outputFilePath.c_str()))
-		CreateDirecroty(outputFilePath.c_str());
-
-	std::string cmd = glslangValidator + " -V " + inputFilePath + " -o " + outputFilePath + shaderNameWithExt + ".spv";
-	
-	STARTUPINFOA        startupInfo;
-	PROCESS_INFORMATION processInfo;
-	memset(&startupInfo, 0, sizeof startupInfo);
-	memset(&processInfo, 0, sizeof processInfo);
-	startupInfo.cb = sizeof(STARTUPINFO);
-	startupInfo.dwFlags |= STARTF_USESTDHANDLES;
-	startupInfo.hStdOutput = NULL;
-	startupInfo.hStdError = NULL;
-
-	{
-		//if (system(cmd.c_str()) != 0)
-		//	return;
-		if (!CreateProcessA(NULL, (LPSTR)cmd.c_str(), NULL, NULL, NULL, NULL, NULL, NULL, &startupInfo, &processInfo))
-			return;
-		WaitForSingleObject(processInfo.hProcess, INFINITE);
-		DWORD exitCode;
-		GetExitCodeProcess(processInfo.hProcess, &exitCode);
-
-		CloseHandle(processInfo.hProcess);
-		CloseHandle(processInfo.hThread);
-	}
-	
-	
-	// create shader module
-	FileHandle file = FileOpen((outputFilePath + shaderNameWithExt + ".spv").c_str(), "rb");
-	uint32_t fileSize = FileSize(file);
-	buffer = (char*)malloc(sizeof(char) * fileSize);
-	FileRead(file, &buffer, fileSize);
-	FileClose(file);
+	// binaries precompiled by the ShaderCompiler tool ship with the resources
+	const uint64_t key = ComputeShaderCacheKey(a_sPath, SHADER_OPTIONS, a_sDefines);
+	const std::string spirvName = GetShaderCacheFileName(shaderNameWithExt.c_str(), key);
+	const std::string precompiledPath = filePath + SHADER_CACHE_DIRECTORY + "/" + spirvName;
 
-	std::vector<char> code(buffer, buffer+fileSize);
-#endif
+	std::vector<char> code;
+	bool loaded = key && LoadSpirV(precompiledPath.c_str(), false, code);
 
 #if defined(__ANDROID_API__)
-	// Like -DMY_DEFINE=1
-	//options.AddMacroDefinition("MY_DEFINE", "1");
-	FileHandle file = FileOpen(a_sPath, "r");
-	uint32_t fileSize = FileSize(file);
-	buffer = (char*)malloc(sizeof(char) * fileSize);
-	FileRead(file, &buffer, fileSize);
-	FileClose(file);
-
-	shaderc_shader_kind kind = {};
-	switch (pShaderModule->stage)
-	{
-	case VK_SHADER_STAGE_VERTEX_BIT:	kind = shaderc_glsl_vertex_shader;		break;
-	case VK_SHADER_STAGE_FRAGMENT_BIT:	kind = shaderc_glsl_fragment_shader;	break;
-	default: 
-		LOG(LogSeverity::ERR, "Shader Type not supported yet!");
-		break;
+	// assets are read only, runtime compiled shaders are cached in internal storage
+	if (!loaded && key)
+		loaded = LoadSpirV(spirvName.c_str(), true, code);
+	if (!loaded)
+	{
+		LOG(LogSeverity::INFO, "Shader cache miss for %s, compiling", a_sPath);
+		loaded = CompileShaderWithShaderc(a_sPath, pShaderModule->stage, a_sDefines, code);
+		if (loaded && key)
+			WriteUserFile(spirvName.c_str(), code.data(), code.size());
+	}
+#else
+	// the resource tree is writable on windows, misses are compiled straight into the cache directory
+	if (!loaded)
+	{
+		LOG(LogSeverity::INFO, "Shader cache miss for %s, compiling", a_sPath);
+		std::string outputDirectory = filePath + SHADER_CACHE_DIRECTORY;
+		if (!ExistDirectory(outputDirectory.c_str()))
+			CreateDirecroty(outputDirectory.c_str());
+
+#if defined(USE_SHADERC)
+		loaded = CompileShaderWithShaderc(a_sPath, pShaderModule->stage, a_sDefines, code);
+		if (loaded && key)
+			WriteUserFile(precompiledPath.c_str(), code.data(), code.size());
+#else
+		std::string outputPath = key ? precompiledPath : outputDirectory + "/" + shaderNameWithExt + ".spv";
+		loaded = CompileShaderWithGlslang(a_sPath, outputPath.c_str(), SHADER_OPTIONS, a_sDefines) && LoadSpirV(outputPath.c_str(), false, code);
+#endif
 	}
+#endif
 
-	std::vector<char> code;
+	if (!loaded)
 	{
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions options;
-		options.AddMacroDefinition("TARGET_ANDROID", "1");
-		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
-		shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(buffer, fileSize, kind, "shaderc_error", "main", options);
-		LOG_IF((module.GetCompilationStatus() == shaderc_compilation_status_success), LogSeverity::ERR, "SpvCompilation Error: %s", module.GetErrorMessage().c_str());
-
-		uint32_t byteCodeSize = (module.cend() - module.cbegin()) * sizeof(uint32_t);
-		const char* _code = reinterpret_cast<const char*>(module.cbegin());
-		code = std::vector<char>(_code, _code + byteCodeSize);
+		LOG(LogSeverity::ERR, "Failed to load shader %s", a_sPath);
+		return;
 	}
-#endif
 
 	VkShaderModuleCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -2319,8 +2986,6 @@ void CreateShaderModule(Renderer* a_pRenderer, const char* a_sPath, ShaderModule
 
 	LOG_IF( (vkCreateShaderModule(a_pRenderer->device, &createInfo, nullptr, &pShaderModule->shaderModule) == VK_SUCCESS),
 		LogSeverity::ERR, "failed to create shader module!" );
-
-	free(buffer);
 }
 
 void DestroyShaderModule(Renderer* a_pRenderer, ShaderModule** a_ppShaderModule)
@@ -2359,7 +3024,7 @@ uint32_t GetNextSwapchainImage(Renderer* a_pRenderer)
 
 #pragma region Commands
 
-void CreateCommandPool(Renderer** a_ppRenderer)
+void CreateGraphicsCommandPool(Renderer** a_ppRenderer)
 {
 	LOG_IF(*a_ppRenderer, LogSeverity::ERR, "Value at a_ppRenderer is NULL");
 	Renderer* pRenderer = *a_ppRenderer;
@@ -2415,6 +3080,8 @@ void BeginCommandBuffer(CommandBuffer* a_pCommandBuffer)
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 	beginInfo.pInheritanceInfo = nullptr;
 	LOG_IF(vkBeginCommandBuffer(a_pCommandBuffer->commandBuffer , &beginInfo) == VK_SUCCESS, LogSeverity::ERR, "Couldn't begin command buffer recording");
+	a_pCommandBuffer->boundState = BoundState();
+	a_pCommandBuffer->stats = CommandBufferStats();
 }
 
 void EndCommandBuffer(CommandBuffer* a_pCommandBuffer)
@@ -2429,6 +3096,115 @@ void EndCommandBuffer(CommandBuffer* a_pCommandBuffer)
 
 	LOG_IF(vkEndCommandBuffer(a_pCommandBuffer->commandBuffer) == VK_SUCCESS, LogSeverity::ERR, "Couldn't end command buffer recording");
 	a_pCommandBuffer->activeRenderPass = VK_NULL_HANDLE;
+	a_pCommandBuffer->activeFramebuffer = VK_NULL_HANDLE;
+}
+
+void CreateCommandPool(Renderer* a_pRenderer, CommandPool** a_ppCommandPool)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppCommandPool, LogSeverity::ERR, "Value at a_ppCommandPool is NULL");
+
+	// buffers are recycled all at once with ResetCommandPool, not one by one
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = familyIndices.graphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	LOG_IF((vkCreateCommandPool(a_pRenderer->device, &poolInfo, nullptr, &(*a_ppCommandPool)->commandPool) == VK_SUCCESS), LogSeverity::ERR, "failed to create command pool!");
+}
+
+void DestroyCommandPool(Renderer* a_pRenderer, CommandPool** a_ppCommandPool)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(*a_ppCommandPool, LogSeverity::ERR, "Value at a_ppCommandPool is NULL");
+
+	vkDestroyCommandPool(a_pRenderer->device, (*a_ppCommandPool)->commandPool, nullptr);
+	(*a_ppCommandPool)->commandPool = VK_NULL_HANDLE;
+}
+
+void ResetCommandPool(Renderer* a_pRenderer, CommandPool* a_pCommandPool)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_pCommandPool, LogSeverity::ERR, "a_pCommandPool is NULL");
+
+	vkResetCommandPool(a_pRenderer->device, a_pCommandPool->commandPool, 0);
+}
+
+void CreateSecondaryCommandBuffers(Renderer* a_pRenderer, CommandPool* a_pCommandPool, uint32_t a_uCount, CommandBuffer** a_ppCommandBuffers)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_pCommandPool, LogSeverity::ERR, "a_pCommandPool is NULL");
+	LOG_IF(a_uCount <= MAX_SECONDARY_COMMAND_BUFFERS, LogSeverity::ERR, "Can't allocate more than %d secondary command buffers at once", MAX_SECONDARY_COMMAND_BUFFERS);
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = a_pCommandPool->commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocInfo.commandBufferCount = a_uCount;
+
+	VkCommandBuffer cmdBuffers[MAX_SECONDARY_COMMAND_BUFFERS];
+	LOG_IF((vkAllocateCommandBuffers(a_pRenderer->device, &allocInfo, cmdBuffers) == VK_SUCCESS), LogSeverity::ERR, "failed to allocate secondary command buffers!");
+
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		a_ppCommandBuffers[i]->commandBuffer = cmdBuffers[i];
+		a_ppCommandBuffers[i]->pRenderer = a_pRenderer;
+	}
+}
+
+void DestroySecondaryCommandBuffers(Renderer* a_pRenderer, CommandPool* a_pCommandPool, uint32_t a_uCount, CommandBuffer** a_ppCommandBuffers)
+{
+	LOG_IF(a_pRenderer, LogSeverity::ERR, "a_pRenderer is NULL");
+	LOG_IF(a_pCommandPool, LogSeverity::ERR, "a_pCommandPool is NULL");
+
+	VkCommandBuffer cmdBuffers[MAX_SECONDARY_COMMAND_BUFFERS];
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		cmdBuffers[i] = a_ppCommandBuffers[i]->commandBuffer;
+		a_ppCommandBuffers[i]->commandBuffer = VK_NULL_HANDLE;
+	}
+
+	vkFreeCommandBuffers(a_pRenderer->device, a_pCommandPool->commandPool, a_uCount, cmdBuffers);
+}
+
+void BeginSecondaryCommandBuffer(CommandBuffer* a_pCommandBuffer, CommandBuffer* a_pPrimary)
+{
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+	LOG_IF(a_pPrimary, LogSeverity::ERR, "a_pPrimary is NULL");
+	LOG_IF(a_pPrimary->activeRenderPass != VK_NULL_HANDLE, LogSeverity::ERR, "Secondary command buffers are only recorded inside a render pass");
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = a_pPrimary->activeRenderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = a_pPrimary->activeFramebuffer;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	LOG_IF(vkBeginCommandBuffer(a_pCommandBuffer->commandBuffer, &beginInfo) == VK_SUCCESS, LogSeverity::ERR, "Couldn't begin secondary command buffer recording");
+	a_pCommandBuffer->boundState = BoundState();
+	a_pCommandBuffer->stats = CommandBufferStats();
+}
+
+void ExecuteCommandBuffers(CommandBuffer* a_pPrimary, uint32_t a_uCount, CommandBuffer** a_ppSecondaries)
+{
+	LOG_IF(a_pPrimary, LogSeverity::ERR, "a_pPrimary is NULL");
+	LOG_IF(a_uCount <= MAX_SECONDARY_COMMAND_BUFFERS, LogSeverity::ERR, "Can't execute more than %d secondary command buffers at once", MAX_SECONDARY_COMMAND_BUFFERS);
+
+	VkCommandBuffer cmdBuffers[MAX_SECONDARY_COMMAND_BUFFERS];
+	for (uint32_t i = 0; i < a_uCount; ++i)
+		cmdBuffers[i] = a_ppSecondaries[i]->commandBuffer;
+
+	vkCmdExecuteCommands(a_pPrimary->commandBuffer, a_uCount, cmdBuffers);
+	// the state set by the secondaries is undefined in the primary afterwards
+	a_pPrimary->boundState = BoundState();
+	for (uint32_t i = 0; i < a_uCount; ++i)
+	{
+		a_pPrimary->stats.drawCount += a_ppSecondaries[i]->stats.drawCount;
+		a_pPrimary->stats.stateChangeCount += a_ppSecondaries[i]->stats.stateChangeCount;
+		a_pPrimary->stats.skippedStateChangeCount += a_ppSecondaries[i]->stats.skippedStateChangeCount;
+	}
 }
 
 void SetViewport(CommandBuffer* a_pCommandBuffer, float a_fX, float a_fY, float a_fWidth, float a_fHeight, float a_fMinDepth, float a_fMaxDepth)
@@ -2443,6 +3219,17 @@ void SetViewport(CommandBuffer* a_pCommandBuffer, float a_fX, float a_fY, float
 	viewport.height = a_fHeight;
 	viewport.minDepth = a_fMinDepth;
 	viewport.maxDepth = a_fMaxDepth;
+
+	BoundState& bound = a_pCommandBuffer->boundState;
+	if (bound.viewportSet && memcmp(&bound.viewport, &viewport, sizeof(VkViewport)) == 0)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
+	}
+	bound.viewportSet = true;
+	bound.viewport = viewport;
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdSetViewport(a_pCommandBuffer->commandBuffer, 0, 1, &viewport);
 }
 
@@ -2465,6 +3252,23 @@ void BindPipeline(CommandBuffer* a_pCommandBuffer, Pipeline* a_pPipeline)
 	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
 	LOG_IF(a_pPipeline, LogSeverity::ERR, "a_pPipeline is NULL");
 
+	// compute has its own binding slot, only graphics pipelines are tracked
+	if (a_pPipeline->bindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS)
+	{
+		a_pCommandBuffer->stats.stateChangeCount++;
+		vkCmdBindPipeline(a_pCommandBuffer->commandBuffer, a_pPipeline->bindPoint, a_pPipeline->pipeline);
+		return;
+	}
+
+	BoundState& bound = a_pCommandBuffer->boundState;
+	if (bound.pipeline == a_pPipeline->pipeline)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
+	}
+	bound.pipeline = a_pPipeline->pipeline;
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdBindPipeline(a_pCommandBuffer->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, a_pPipeline->pipeline);
 }
 
@@ -2473,13 +3277,27 @@ void BindVertexBuffers(CommandBuffer* a_pCommandBuffer, uint32_t a_uCount, Buffe
 	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
 	LOG_IF(a_ppBuffers, LogSeverity::ERR, "Value at a_ppBuffers is NULL");
 
-	VkBuffer buffers[64];
-	VkDeviceSize offsets[64];
+	LOG_IF(a_uCount <= MAX_BOUND_VERTEX_BUFFERS, LogSeverity::ERR, "Can't bind more than %d vertex buffers", MAX_BOUND_VERTEX_BUFFERS);
+
+	VkBuffer buffers[MAX_BOUND_VERTEX_BUFFERS];
+	VkDeviceSize offsets[MAX_BOUND_VERTEX_BUFFERS];
+	bool sameBuffers = (a_pCommandBuffer->boundState.vertexBufferCount == a_uCount);
 	for (uint32_t i = 0; i < a_uCount; ++i)
 	{
 		buffers[i] = a_ppBuffers[i]->buffer;
 		offsets[i] = 0;
+		sameBuffers = sameBuffers && (a_pCommandBuffer->boundState.vertexBuffers[i] == buffers[i]);
+	}
+
+	if (sameBuffers)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
 	}
+	a_pCommandBuffer->boundState.vertexBufferCount = a_uCount;
+	memcpy(a_pCommandBuffer->boundState.vertexBuffers, buffers, sizeof(VkBuffer) * a_uCount);
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdBindVertexBuffers(a_pCommandBuffer->commandBuffer, 0, a_uCount, buffers, offsets);
 }
 
@@ -2488,6 +3306,16 @@ void BindIndexBuffer(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, VkIndex
 	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
 	LOG_IF(a_pBuffer, LogSeverity::ERR, "a_pBuffer is NULL");
 
+	BoundState& bound = a_pCommandBuffer->boundState;
+	if (bound.indexBuffer == a_pBuffer->buffer && bound.indexType == a_IndexType)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
+	}
+	bound.indexBuffer = a_pBuffer->buffer;
+	bound.indexType = a_IndexType;
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdBindIndexBuffer(a_pCommandBuffer->commandBuffer, a_pBuffer->buffer, 0, a_IndexType);
 }
 
@@ -2497,28 +3325,96 @@ void BindPushConstants(CommandBuffer* a_pCommandBuffer, ResourceDescriptor* a_pR
 	LOG_IF(a_pResourceDescriptor, LogSeverity::ERR, "pResourceDescriptor is NULL");
 	LOG_IF(pConstants, LogSeverity::ERR, "pConstants is NULL");
 
-	std::unordered_map<uint32_t, uint32_t>::const_iterator itr = a_pResourceDescriptor->nameToPushConstantIndexMap.find((uint32_t)std::hash<std::string>{}(name));
+	std::unordered_map<uint32_t, uint32_t>::const_iterator itr = a_pResourceDescriptor->nameToPushConstantIndexMap.find(hashName(name));
 	LOG_IF(itr != a_pResourceDescriptor->nameToPushConstantIndexMap.end(), LogSeverity::ERR, "Push constant named \"%s\" not added to the resource descriptor", name);
 	
 	VkPushConstantRange pushConstant = a_pResourceDescriptor->desc.pushConstants[itr->second].pushConstant;
+	LOG_IF(pushConstant.size <= MAX_PUSH_CONSTANT_SIZE, LogSeverity::ERR, "Push constant \"%s\" is larger than %d bytes", name, MAX_PUSH_CONSTANT_SIZE);
+
+	BoundState& bound = a_pCommandBuffer->boundState;
+	UseBoundPipelineLayout(a_pCommandBuffer, a_pResourceDescriptor->pipelineLayout);
+	if (bound.pushConstantSize == pushConstant.size && bound.pushConstantOffset == pushConstant.offset &&
+		memcmp(bound.pushConstants, pConstants, pushConstant.size) == 0)
+	{
+		a_pCommandBuffer->stats.skippedStateChangeCount++;
+		return;
+	}
+	bound.pushConstantOffset = pushConstant.offset;
+	bound.pushConstantSize = pushConstant.size;
+	memcpy(bound.pushConstants, pConstants, pushConstant.size);
+	a_pCommandBuffer->stats.stateChangeCount++;
+
 	vkCmdPushConstants(a_pCommandBuffer->commandBuffer, a_pResourceDescriptor->pipelineLayout,
 		pushConstant.stageFlags, pushConstant.offset, pushConstant.size, pConstants);
 }
 
-void Draw(CommandBuffer* a_pCommandBuffer, uint32_t a_uVertexCount, uint32_t a_uFirstVertex)
+void Draw(CommandBuffer* a_pCommandBuffer, uint32_t a_uVertexCount, uint32_t a_uFirstVertex, uint32_t a_uInstanceCount, uint32_t a_uFirstInstance)
 {
 	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
 	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
 	
-	vkCmdDraw(a_pCommandBuffer->commandBuffer, a_uVertexCount, 1, a_uFirstVertex, 0);
+	vkCmdDraw(a_pCommandBuffer->commandBuffer, a_uVertexCount, a_uInstanceCount, a_uFirstVertex, a_uFirstInstance);
+	a_pCommandBuffer->stats.drawCount++;
 }
 
-void DrawIndexed(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndicesCount, uint32_t a_uFirstIndex, uint32_t a_uFirstVertex)
+void DrawIndexed(CommandBuffer* a_pCommandBuffer, uint32_t a_uIndicesCount, uint32_t a_uFirstIndex, uint32_t a_uFirstVertex, uint32_t a_uInstanceCount, uint32_t a_uFirstInstance)
 {
 	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
 	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
 
-	vkCmdDrawIndexed(a_pCommandBuffer->commandBuffer, a_uIndicesCount, 1, a_uFirstIndex, a_uFirstVertex, 0);
+	vkCmdDrawIndexed(a_pCommandBuffer->commandBuffer, a_uIndicesCount, a_uInstanceCount, a_uFirstIndex, a_uFirstVertex, a_uFirstInstance);
+	a_pCommandBuffer->stats.drawCount++;
+}
+
+void DrawIndexedIndirect(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, uint64_t a_uOffset, uint32_t a_uDrawCount, uint32_t a_uStride)
+{
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
+	LOG_IF(a_pBuffer, LogSeverity::ERR, "a_pBuffer is NULL");
+	LOG_IF(a_pBuffer->desc.bufferUsageFlags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, LogSeverity::ERR, "Buffer was not created with VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT");
+
+	vkCmdDrawIndexedIndirect(a_pCommandBuffer->commandBuffer, a_pBuffer->buffer, a_uOffset, a_uDrawCount, a_uStride);
+	a_pCommandBuffer->stats.drawCount += a_uDrawCount;
+}
+
+void DrawIndexedIndirectCount(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, uint64_t a_uOffset, Buffer* a_pCountBuffer, uint64_t a_uCountOffset, uint32_t a_uMaxDrawCount, uint32_t a_uStride)
+{
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
+	LOG_IF(a_pBuffer && a_pCountBuffer, LogSeverity::ERR, "a_pBuffer or a_pCountBuffer is NULL");
+	LOG_IF((a_pBuffer->desc.bufferUsageFlags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) && (a_pCountBuffer->desc.bufferUsageFlags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT),
+		LogSeverity::ERR, "Buffer was not created with VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT");
+	LOG_IF(vkCmdDrawIndexedIndirectCountKHR, LogSeverity::ERR, "VK_KHR_draw_indirect_count is not enabled");
+
+	vkCmdDrawIndexedIndirectCountKHR(a_pCommandBuffer->commandBuffer, a_pBuffer->buffer, a_uOffset, a_pCountBuffer->buffer, a_uCountOffset, a_uMaxDrawCount, a_uStride);
+	// the count is only known on the GPU, one recorded draw
+	a_pCommandBuffer->stats.drawCount++;
+}
+
+void Dispatch(CommandBuffer* a_pCommandBuffer, uint32_t a_uGroupCountX, uint32_t a_uGroupCountY, uint32_t a_uGroupCountZ)
+{
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+	LOG_IF(a_pCommandBuffer->commandBuffer != VK_NULL_HANDLE, LogSeverity::ERR, "command buffer is VK_NULL_HANDLE");
+	LOG_IF(a_pCommandBuffer->activeRenderPass == VK_NULL_HANDLE, LogSeverity::ERR, "Dispatch inside a render pass");
+
+	vkCmdDispatch(a_pCommandBuffer->commandBuffer, a_uGroupCountX, a_uGroupCountY, a_uGroupCountZ);
+}
+
+void BufferBarrier(CommandBuffer* a_pCommandBuffer, Buffer* a_pBuffer, VkPipelineStageFlags a_SrcStages, VkAccessFlags a_SrcAccess, VkPipelineStageFlags a_DstStages, VkAccessFlags a_DstAccess)
+{
+	LOG_IF(a_pCommandBuffer, LogSeverity::ERR, "a_pCommandBuffer is NULL");
+	LOG_IF(a_pBuffer, LogSeverity::ERR, "a_pBuffer is NULL");
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = a_SrcAccess;
+	barrier.dstAccessMask = a_DstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = a_pBuffer->buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(a_pCommandBuffer->commandBuffer, a_SrcStages, a_DstStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 }
 
 void Submit(CommandBuffer* a_pCommandBuffer)
@@ -2584,6 +3480,9 @@ void Present(CommandBuffer* a_pCommandBuffer)
 	}
 
 	pRenderer->currentFrame = (pRenderer->currentFrame + 1) % pRenderer->maxInFlightFrames;
+
+	if (pRenderer->pipelineCacheDirty && ++framesSincePipelineCacheSave >= PIPELINE_CACHE_SAVE_INTERVAL)
+		SavePipelineCache(pRenderer);
 }
 
 #pragma endregion
@@ -0,0 +1,461 @@
+#include "../TextureStreaming.h"
+#include "../TextureFile.h"
+#include "../Renderer.h"
+#include "../JobSystem.h"
+#include "../FileSystem.h"
+#include "../FileIO.h"
+#include "../Log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+// debug builds report the stats every this many updates
+#define TEXTURE_STREAMING_REPORT_UPDATES 60
+
+void BeginSingleTimeCommands(Renderer* a_pRenderer, CommandBuffer* a_pCommandBuffer);
+void EndSingleTimeCommands(Renderer* a_pRenderer, CommandBuffer* a_pCommandBuffer);
+void CreateTextureUtil(Renderer* a_pRenderer, Texture** a_ppTexture);
+void CreateBufferUtil(Renderer* a_pRenderer, Buffer** a_ppBuffer);
+
+struct StreamedTexture
+{
+	Texture*	pTexture;
+	std::string	path;
+	TextureFile	file;
+	// the image holds levels [residentLevel, file.levelCount) of the file
+	uint32_t	residentLevel;
+	// residentLevel right after creation, evicted textures go back to it
+	uint32_t	minLevel;
+	// largest level asked for in lastRequestFrame
+	uint32_t	requestedLevel;
+	uint64_t	lastRequestFrame;
+
+	// levels [loadLevel, residentLevel) read into pLoadData by one streaming read each, largest first
+	bool							loading;
+	uint32_t						loadLevel;
+	char*							pLoadData;
+	std::vector<FileReadRequest>	loadReads;
+	JobCounter						loadCounter;
+
+	StreamedTexture() :
+		pTexture(nullptr), path(), file(), residentLevel(0), minLevel(0), requestedLevel(0), lastRequestFrame(0),
+		loading(false), loadLevel(0), pLoadData(nullptr), loadReads(), loadCounter()
+	{}
+};
+
+static uint32_t GetLevelExtent(uint32_t a_uSize, uint32_t a_uLevel)
+{
+	return (a_uSize >> a_uLevel) ? (a_uSize >> a_uLevel) : 1;
+}
+
+// bytes of levels [a_uFirst, a_uLast)
+static uint64_t GetLevelBytes(const StreamedTexture* a_pStreamed, uint32_t a_uFirst, uint32_t a_uLast)
+{
+	uint64_t size = 0;
+	for (uint32_t i = a_uFirst; i < a_uLast; ++i)
+		size += a_pStreamed->file.levels[i].size;
+	return size;
+}
+
+// reads levels [a_uFirst, a_uLast) back to back into a_pData
+static bool ReadLevels(FileHandle a_File, const StreamedTexture* a_pStreamed, uint32_t a_uFirst, uint32_t a_uLast, char* a_pData)
+{
+	for (uint32_t i = a_uFirst; i < a_uLast; ++i)
+	{
+		const TextureFileLevel& level = a_pStreamed->file.levels[i];
+		FileSeek(a_File, (int64_t)level.offset, SEEK_SET);
+		if (FileRead(a_File, &a_pData, level.size) != level.size)
+			return false;
+		a_pData += level.size;
+	}
+	return true;
+}
+
+// staging buffer with levels [a_uFirst, a_uLast) from a_pData, a_pRegions copy them to the image's levels from 0 on
+static Buffer* CreateLevelUpload(Renderer* a_pRenderer, const StreamedTexture* a_pStreamed, uint32_t a_uFirst, uint32_t a_uLast, const char* a_pData, VkBufferImageCopy* a_pRegions)
+{
+	const VkDeviceSize uploadSize = GetLevelBytes(a_pStreamed, a_uFirst, a_uLast);
+	Buffer* pStagingBuffer = new Buffer();
+	pStagingBuffer->desc.bufferSize = uploadSize;
+	pStagingBuffer->desc.bufferUsageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	pStagingBuffer->desc.memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	CreateBufferUtil(a_pRenderer, &pStagingBuffer);
+
+	void* data;
+	vkMapMemory(a_pRenderer->device, pStagingBuffer->bufferMemory, 0, uploadSize, 0, &data);
+	memcpy(data, a_pData, static_cast<size_t>(uploadSize));
+	vkUnmapMemory(a_pRenderer->device, pStagingBuffer->bufferMemory);
+
+	const TextureFile& file = a_pStreamed->file;
+	VkDeviceSize offset = 0;
+	for (uint32_t i = a_uFirst; i < a_uLast; ++i)
+	{
+		VkBufferImageCopy& region = a_pRegions[i - a_uFirst];
+		region = {};
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = i - a_uFirst;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { GetLevelExtent(file.width, i), GetLevelExtent(file.height, i), 1 };
+		offset += file.levels[i].size;
+	}
+	return pStagingBuffer;
+}
+
+// queues the reads of levels [loadLevel, residentLevel), the I/O threads merge the ones next to each other in the file
+static void LoadLevels(StreamedTexture* a_pStreamed)
+{
+	std::vector<FileReadRequest>& reads = a_pStreamed->loadReads;
+	reads.assign(a_pStreamed->residentLevel - a_pStreamed->loadLevel, FileReadRequest());
+	char* pData = a_pStreamed->pLoadData;
+	for (uint32_t i = a_pStreamed->loadLevel; i < a_pStreamed->residentLevel; ++i)
+	{
+		const TextureFileLevel& level = a_pStreamed->file.levels[i];
+		FileReadRequest& read = reads[i - a_pStreamed->loadLevel];
+		read.path = a_pStreamed->path;
+		read.offset = level.offset;
+		read.size = level.size;
+		read.pBuffer = pData;
+		read.priority = FileReadPriority::STREAMING;
+		pData += level.size;
+	}
+	ReadFileAsync(reads.data(), (uint32_t)reads.size(), &a_pStreamed->loadCounter);
+}
+
+static bool AreLevelsLoaded(const StreamedTexture* a_pStreamed)
+{
+	for (const FileReadRequest& read : a_pStreamed->loadReads)
+	{
+		if (!read.success)
+			return false;
+	}
+	return true;
+}
+
+// moves the texture to an image with levels [a_uLevel, file.levelCount). levels it already has are copied from the old
+// image, larger ones come from a_pData in ReadLevels order. the copies are recorded into a_pCommandBuffer
+static void ResizeStreamedTexture(TextureStreamer* a_pStreamer, StreamedTexture* a_pStreamed, uint32_t a_uLevel, const char* a_pData, CommandBuffer* a_pCommandBuffer,
+	std::vector<TextureResidencyChange>& a_Changes)
+{
+	Renderer* pRenderer = a_pStreamer->pRenderer;
+	Texture* pTexture = a_pStreamed->pTexture;
+	const TextureFile& file = a_pStreamed->file;
+
+	Texture* pResized = new Texture();
+	pResized->desc = pTexture->desc;
+	pResized->desc.width = GetLevelExtent(file.width, a_uLevel);
+	pResized->desc.height = GetLevelExtent(file.height, a_uLevel);
+	pResized->desc.mipLevels = file.levelCount - a_uLevel;
+	CreateTextureUtil(pRenderer, &pResized);
+
+	Buffer* pStagingBuffer = nullptr;
+	VkBufferImageCopy uploads[MAX_TEXTURE_FILE_LEVELS];
+	const uint32_t uploadCount = a_uLevel < a_pStreamed->residentLevel ? a_pStreamed->residentLevel - a_uLevel : 0;
+	if (uploadCount)
+		pStagingBuffer = CreateLevelUpload(pRenderer, a_pStreamed, a_uLevel, a_pStreamed->residentLevel, a_pData, uploads);
+
+	// levels both images have, whole levels so the ones smaller than a block can be copied too
+	const uint32_t firstCopied = std::max(a_uLevel, a_pStreamed->residentLevel);
+	VkImageCopy copies[MAX_TEXTURE_FILE_LEVELS] = {};
+	for (uint32_t i = firstCopied; i < file.levelCount; ++i)
+	{
+		VkImageCopy& copy = copies[i - firstCopied];
+		copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.srcSubresource.mipLevel = i - a_pStreamed->residentLevel;
+		copy.srcSubresource.layerCount = 1;
+		copy.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.dstSubresource.mipLevel = i - a_uLevel;
+		copy.dstSubresource.layerCount = 1;
+		copy.extent = { GetLevelExtent(file.width, i), GetLevelExtent(file.height, i), 1 };
+	}
+
+	// the old image waits for the fragment shaders of the frames before, it stays in the transfer layout as nothing
+	// samples it after this frame
+	TransitionImageLayout(a_pCommandBuffer, pResized, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	TransitionImageLayout(a_pCommandBuffer, pTexture, pTexture->desc.initialLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	vkCmdCopyImage(a_pCommandBuffer->commandBuffer, pTexture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pResized->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		file.levelCount - firstCopied, copies);
+	if (uploadCount)
+		vkCmdCopyBufferToImage(a_pCommandBuffer->commandBuffer, pStagingBuffer->buffer, pResized->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uploadCount, uploads);
+	TransitionImageLayout(a_pCommandBuffer, pResized, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pResized->desc.initialLayout);
+
+	a_Changes.push_back({ pTexture, pTexture->imageView });
+
+	// swapped so the streamed Texture keeps its address, the old image goes with pResized
+	std::swap(*pTexture, *pResized);
+	a_pStreamer->retired.push_back({ pResized, pStagingBuffer, a_pStreamer->frame });
+
+	const uint32_t oldLevel = a_pStreamed->residentLevel;
+	a_pStreamed->residentLevel = a_uLevel;
+	if (a_uLevel < oldLevel)
+		a_pStreamer->stats.loadedLevels += oldLevel - a_uLevel;
+	else
+		a_pStreamer->stats.evictedLevels += a_uLevel - oldLevel;
+}
+
+static void DestroyRetiredImage(Renderer* a_pRenderer, RetiredStreamedImage& a_Retired)
+{
+	DestroyTexture(a_pRenderer, &a_Retired.pTexture);
+	delete a_Retired.pTexture;
+	if (a_Retired.pStagingBuffer)
+	{
+		DestroyBuffer(a_pRenderer, &a_Retired.pStagingBuffer);
+		delete a_Retired.pStagingBuffer;
+	}
+}
+
+void InitTextureStreamer(TextureStreamer* a_pStreamer, Renderer* a_pRenderer, uint64_t a_uBudget)
+{
+	a_pStreamer->pRenderer = a_pRenderer;
+	a_pStreamer->budget = a_uBudget;
+	a_pStreamer->frame = 0;
+	a_pStreamer->stats = TextureStreamingStats();
+}
+
+void ExitTextureStreamer(TextureStreamer* a_pStreamer)
+{
+	for (std::pair<Texture* const, StreamedTexture*>& texture : a_pStreamer->textures)
+	{
+		WaitForJobs(&texture.second->loadCounter);
+		free(texture.second->pLoadData);
+		delete texture.second;
+	}
+	a_pStreamer->textures.clear();
+	for (RetiredStreamedImage& retired : a_pStreamer->retired)
+		DestroyRetiredImage(a_pStreamer->pRenderer, retired);
+	a_pStreamer->retired.clear();
+	a_pStreamer->pRenderer = nullptr;
+}
+
+bool CreateStreamedTexture(TextureStreamer* a_pStreamer, Texture** a_ppTexture, const char* a_sPath)
+{
+	LOG_IF(a_pStreamer->pRenderer, LogSeverity::ERR, "Texture streamer is not initialized");
+
+	FileHandle file = FileOpen(a_sPath, "rb");
+	if (!file)
+		return false;
+
+	const uint64_t fileSize = FileSize(file);
+	char header[MAX_TEXTURE_FILE_HEADER_SIZE];
+	char* pHeader = header;
+	const uint64_t headerSize = fileSize < MAX_TEXTURE_FILE_HEADER_SIZE ? fileSize : MAX_TEXTURE_FILE_HEADER_SIZE;
+	FileRead(file, &pHeader, headerSize);
+
+	StreamedTexture* pStreamed = new StreamedTexture();
+	if (!ReadTextureFile(header, headerSize, fileSize, &pStreamed->file))
+	{
+		LOG(LogSeverity::WARNING, "%s is not a valid texture file, decoding the source image", a_sPath);
+		FileClose(file);
+		delete pStreamed;
+		return false;
+	}
+
+	const TextureFile& textureFile = pStreamed->file;
+	uint32_t level = 0;
+	while (level + 1 < textureFile.levelCount &&
+		std::max(GetLevelExtent(textureFile.width, level), GetLevelExtent(textureFile.height, level)) > TEXTURE_STREAMING_MIN_SIZE)
+		++level;
+
+	// the smallest levels are at the start of the file, right after the header
+	char* pData = (char*)malloc(static_cast<size_t>(GetLevelBytes(pStreamed, level, textureFile.levelCount)));
+	const bool loaded = ReadLevels(file, pStreamed, level, textureFile.levelCount, pData);
+	FileClose(file);
+	if (!loaded)
+	{
+		LOG(LogSeverity::WARNING, "%s is truncated, decoding the source image", a_sPath);
+		free(pData);
+		delete pStreamed;
+		return false;
+	}
+
+	Texture* pTexture = *a_ppTexture;
+	pTexture->desc.format = (VkFormat)textureFile.format;
+	pTexture->desc.width = GetLevelExtent(textureFile.width, level);
+	pTexture->desc.height = GetLevelExtent(textureFile.height, level);
+	pTexture->desc.mipLevels = textureFile.levelCount - level;
+	CreateTextureUtil(a_pStreamer->pRenderer, a_ppTexture);
+
+	{
+		Renderer* pRenderer = a_pStreamer->pRenderer;
+		VkBufferImageCopy regions[MAX_TEXTURE_FILE_LEVELS];
+		Buffer* pStagingBuffer = CreateLevelUpload(pRenderer, pStreamed, level, textureFile.levelCount, pData, regions);
+
+		CommandBuffer cmdBfr;
+		BeginSingleTimeCommands(pRenderer, &cmdBfr);
+		TransitionImageLayout(&cmdBfr, pTexture, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		vkCmdCopyBufferToImage(cmdBfr.commandBuffer, pStagingBuffer->buffer, pTexture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, textureFile.levelCount - level, regions);
+		TransitionImageLayout(&cmdBfr, pTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, pTexture->desc.initialLayout);
+		EndSingleTimeCommands(pRenderer, &cmdBfr);
+
+		DestroyBuffer(pRenderer, &pStagingBuffer);
+		delete pStagingBuffer;
+	}
+	free(pData);
+
+	pStreamed->pTexture = pTexture;
+	pStreamed->path = a_sPath;
+	pStreamed->residentLevel = level;
+	pStreamed->minLevel = level;
+	pStreamed->requestedLevel = level;
+	pStreamed->lastRequestFrame = a_pStreamer->frame;
+	a_pStreamer->textures.insert({ pTexture, pStreamed });
+	return true;
+}
+
+void ReleaseStreamedTexture(TextureStreamer* a_pStreamer, Texture* a_pTexture)
+{
+	std::unordered_map<Texture*, StreamedTexture*>::iterator itr = a_pStreamer->textures.find(a_pTexture);
+	if (itr == a_pStreamer->textures.end())
+		return;
+
+	WaitForJobs(&itr->second->loadCounter);
+	free(itr->second->pLoadData);
+	delete itr->second;
+	a_pStreamer->textures.erase(itr);
+}
+
+void RequestTextureSize(TextureStreamer* a_pStreamer, Texture* a_pTexture, uint32_t a_uTexels)
+{
+	std::unordered_map<Texture*, StreamedTexture*>::const_iterator itr = a_pStreamer->textures.find(a_pTexture);
+	if (itr == a_pStreamer->textures.end())
+		return;
+
+	// the smallest level still at least a_uTexels across
+	StreamedTexture* pStreamed = itr->second;
+	const TextureFile& file = pStreamed->file;
+	uint32_t level = 0;
+	while (level + 1 < file.levelCount && std::max(GetLevelExtent(file.width, level + 1), GetLevelExtent(file.height, level + 1)) >= a_uTexels)
+		++level;
+	level = std::min(level, pStreamed->minLevel);
+
+	if (pStreamed->lastRequestFrame != a_pStreamer->frame)
+		pStreamed->requestedLevel = level;
+	else
+		pStreamed->requestedLevel = std::min(pStreamed->requestedLevel, level);
+	pStreamed->lastRequestFrame = a_pStreamer->frame;
+}
+
+void UpdateTextureStreaming(TextureStreamer* a_pStreamer, CommandBuffer* a_pCommandBuffer, std::vector<TextureResidencyChange>& a_Changes)
+{
+	a_Changes.clear();
+	TextureStreamingStats& stats = a_pStreamer->stats;
+	const uint64_t frame = a_pStreamer->frame;
+	uint32_t updates = 0;
+
+	// the fence of this frame has been waited on, the frames up to the one maxInFlightFrames ago are done
+	const uint32_t inFlightFrames = a_pStreamer->pRenderer->maxInFlightFrames;
+	std::vector<RetiredStreamedImage>& retired = a_pStreamer->retired;
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); ++i)
+	{
+		if (retired[i].frame + inFlightFrames <= frame)
+			DestroyRetiredImage(a_pStreamer->pRenderer, retired[i]);
+		else
+			retired[kept++] = retired[i];
+	}
+	retired.resize(kept);
+
+	// finished reads become resident
+	for (std::pair<Texture* const, StreamedTexture*>& texture : a_pStreamer->textures)
+	{
+		StreamedTexture* pStreamed = texture.second;
+		if (!pStreamed->loading || pStreamed->loadCounter.pending.load() != 0 || updates >= MAX_TEXTURE_STREAMING_UPDATES)
+			continue;
+
+		pStreamed->loading = false;
+		if (!AreLevelsLoaded(pStreamed))
+		{
+			LOG(LogSeverity::WARNING, "Failed to stream levels of %s", pStreamed->path.c_str());
+		}
+		else
+		{
+			ResizeStreamedTexture(a_pStreamer, pStreamed, pStreamed->loadLevel, pStreamed->pLoadData, a_pCommandBuffer, a_Changes);
+			++updates;
+		}
+		free(pStreamed->pLoadData);
+		pStreamed->pLoadData = nullptr;
+		pStreamed->loadReads.clear();
+	}
+
+	// resident and pending loads count against the budget, a load is never started when it doesn't fit
+	uint64_t usedBytes = 0;
+	uint32_t pendingLoads = 0;
+	std::vector<StreamedTexture*> wanted, evictable;
+	stats.requestedBytes = 0;
+	for (std::pair<Texture* const, StreamedTexture*>& texture : a_pStreamer->textures)
+	{
+		StreamedTexture* pStreamed = texture.second;
+		const uint32_t levelCount = pStreamed->file.levelCount;
+		usedBytes += GetLevelBytes(pStreamed, pStreamed->residentLevel, levelCount);
+		if (pStreamed->lastRequestFrame == frame)
+			stats.requestedBytes += GetLevelBytes(pStreamed, pStreamed->requestedLevel, levelCount);
+
+		if (pStreamed->loading)
+		{
+			usedBytes += GetLevelBytes(pStreamed, pStreamed->loadLevel, pStreamed->residentLevel);
+			++pendingLoads;
+			continue;
+		}
+		if (pStreamed->lastRequestFrame == frame && pStreamed->requestedLevel < pStreamed->residentLevel)
+			wanted.push_back(pStreamed);
+		if (pStreamed->residentLevel < (pStreamed->lastRequestFrame == frame ? pStreamed->requestedLevel : pStreamed->minLevel))
+			evictable.push_back(pStreamed);
+	}
+
+	// largest requests first, least recently requested textures are evicted first
+	std::sort(wanted.begin(), wanted.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->requestedLevel < b->requestedLevel; });
+	std::sort(evictable.begin(), evictable.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->lastRequestFrame < b->lastRequestFrame; });
+
+	size_t nextEvicted = 0;
+	for (StreamedTexture* pStreamed : wanted)
+	{
+		if (pendingLoads >= MAX_TEXTURE_STREAMING_LOADS)
+			break;
+
+		uint64_t neededBytes = GetLevelBytes(pStreamed, pStreamed->requestedLevel, pStreamed->residentLevel);
+		while (usedBytes + neededBytes > a_pStreamer->budget && nextEvicted < evictable.size() && updates < MAX_TEXTURE_STREAMING_UPDATES)
+		{
+			StreamedTexture* pEvicted = evictable[nextEvicted++];
+			const uint32_t level = pEvicted->lastRequestFrame == frame ? pEvicted->requestedLevel : pEvicted->minLevel;
+			usedBytes -= GetLevelBytes(pEvicted, pEvicted->residentLevel, level);
+			ResizeStreamedTexture(a_pStreamer, pEvicted, level, nullptr, a_pCommandBuffer, a_Changes);
+			++updates;
+		}
+
+		// as many levels as fit, the rest once something else is evicted
+		uint32_t level = pStreamed->requestedLevel;
+		while (level < pStreamed->residentLevel && usedBytes + neededBytes > a_pStreamer->budget)
+		{
+			neededBytes -= pStreamed->file.levels[level].size;
+			++level;
+		}
+		if (level == pStreamed->residentLevel)
+			continue;
+
+		pStreamed->loading = true;
+		pStreamed->loadLevel = level;
+		pStreamed->pLoadData = (char*)malloc(static_cast<size_t>(neededBytes));
+		usedBytes += neededBytes;
+		++pendingLoads;
+
+		LoadLevels(pStreamed);
+	}
+
+	stats.textureCount = (uint32_t)a_pStreamer->textures.size();
+	stats.pendingLoads = pendingLoads;
+	stats.residentBytes = 0;
+	for (std::pair<Texture* const, StreamedTexture*>& texture : a_pStreamer->textures)
+		stats.residentBytes += GetLevelBytes(texture.second, texture.second->residentLevel, texture.second->file.levelCount);
+
+	if (frame % TEXTURE_STREAMING_REPORT_UPDATES == 0)
+	{
+		LOG(LogSeverity::INFO, "Texture streaming %u textures, %u of %u MB resident, %u MB requested, %u loads pending",
+			stats.textureCount, (uint32_t)(stats.residentBytes >> 20), (uint32_t)(a_pStreamer->budget >> 20), (uint32_t)(stats.requestedBytes >> 20),
+			stats.pendingLoads);
+	}
+
+	// requests made until the next update belong to the next frame
+	a_pStreamer->frame = frame + 1;
+}
@@ -0,0 +1,157 @@
+#include "ShaderCache.h"
+#include "FileSystem.h"
+#include "Hash.h"
+#include "Log.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#define MAX_INCLUDE_DEPTH 8
+
+// carriage returns are skipped so CRLF and LF checkouts share keys
+static uint64_t HashSource(uint64_t a_uHash, const char* a_pData, size_t a_uSize)
+{
+	size_t start = 0;
+	for (size_t i = 0; i < a_uSize; ++i)
+	{
+		if (a_pData[i] != '\r')
+			continue;
+		a_uHash = HashFnv1a64(a_pData + start, i - start, a_uHash);
+		start = i + 1;
+	}
+	return HashFnv1a64(a_pData + start, a_uSize - start, a_uHash);
+}
+
+static bool HashShaderFile(const std::string& a_sPath, uint64_t& a_uHash, uint32_t a_uDepth)
+{
+	if (a_uDepth > MAX_INCLUDE_DEPTH)
+	{
+		LOG(LogSeverity::ERR, "Shader includes nested deeper than %d levels in %s", MAX_INCLUDE_DEPTH, a_sPath.c_str());
+		return false;
+	}
+
+	FileHandle file = FileOpen(a_sPath.c_str(), "rb");
+	if (!file)
+		return false;
+
+	uint64_t size = FileSize(file);
+	char* buffer = (char*)malloc((size_t)size + 1);
+	size = FileRead(file, &buffer, size);
+	FileClose(file);
+	buffer[size] = '\0';
+
+	a_uHash = HashSource(a_uHash, buffer, size);
+
+	// includes are resolved relative to the including file
+	std::string directory = a_sPath.substr(0, a_sPath.find_last_of("/\\") + 1);
+	bool success = true;
+	const char* line = buffer;
+	while (success && line && *line)
+	{
+		const char* lineEnd = strchr(line, '\n');
+		if (!lineEnd)
+			lineEnd = buffer + size;
+
+		const char* p = line;
+		while (p < lineEnd && (*p == ' ' || *p == '\t'))
+			++p;
+
+		if (lineEnd - p > 8 && strncmp(p, "#include", 8) == 0)
+		{
+			const char* nameStart = (const char*)memchr(p, '"', lineEnd - p);
+			const char* nameEnd = nameStart ? (const char*)memchr(nameStart + 1, '"', lineEnd - nameStart - 1) : nullptr;
+			if (nameEnd)
+				success = HashShaderFile(directory + std::string(nameStart + 1, nameEnd), a_uHash, a_uDepth + 1);
+		}
+
+		line = (*lineEnd) ? lineEnd + 1 : nullptr;
+	}
+
+	free(buffer);
+	return success;
+}
+
+uint64_t ComputeShaderCacheKey(const char* a_sSourcePath, const char* a_sOptions, const char* a_sDefines)
+{
+	LOG_IF(a_sSourcePath, LogSeverity::ERR, "a_sSourcePath is NULL");
+	LOG_IF(a_sOptions, LogSeverity::ERR, "a_sOptions is NULL");
+	LOG_IF(a_sDefines, LogSeverity::ERR, "a_sDefines is NULL");
+
+	const uint32_t version = SHADER_CACHE_VERSION;
+	uint64_t hash = HashFnv1a64(&version, sizeof(version));
+	hash = HashFnv1a64(a_sOptions, strlen(a_sOptions) + 1, hash);
+	// skipped when empty so the plain shader keeps its key
+	if (*a_sDefines)
+		hash = HashFnv1a64(a_sDefines, strlen(a_sDefines) + 1, hash);
+
+	if (!HashShaderFile(a_sSourcePath, hash, 0))
+		return 0;
+
+	// 0 means no key
+	return hash ? hash : 1;
+}
+
+std::string GetShaderCacheFileName(const char* a_sShaderName, uint64_t a_uKey)
+{
+	char fileName[256];
+	snprintf(fileName, sizeof(fileName), "%s.%016llx.spv", a_sShaderName, (unsigned long long)a_uKey);
+	return fileName;
+}
+
+#if defined(_WIN32)
+bool CompileShaderWithGlslang(const char* a_sInputPath, const char* a_sOutputPath, const char* a_sOptions, const char* a_sDefines)
+{
+	char* vulkanSdkPath = nullptr;
+	size_t bufferCount = 0;
+	if (_dupenv_s(&vulkanSdkPath, &bufferCount, "VULKAN_SDK") != 0 || !vulkanSdkPath)
+	{
+		LOG(LogSeverity::ERR, "VULKAN_SDK is not set, can not compile %s", a_sInputPath);
+		return false;
+	}
+
+	std::string cmd = std::string("\"") + vulkanSdkPath + "\\Bin\\glslangValidator.exe\" -V";
+	free(vulkanSdkPath);
+	if (strcmp(a_sOptions, SHADER_OPTIONS_ANDROID) == 0)
+		cmd += " --target-env vulkan1.1 -DTARGET_ANDROID=1";
+	for (const char* define = a_sDefines; *define; )
+	{
+		const char* end = strchr(define, ' ');
+		if (!end)
+			end = define + strlen(define);
+		if (end != define)
+			cmd += " -D" + std::string(define, end);
+		define = *end ? end + 1 : end;
+	}
+	cmd += std::string(" \"") + a_sInputPath + "\" -o \"" + a_sOutputPath + "\"";
+
+	STARTUPINFOA        startupInfo;
+	PROCESS_INFORMATION processInfo;
+	memset(&startupInfo, 0, sizeof startupInfo);
+	memset(&processInfo, 0, sizeof processInfo);
+	startupInfo.cb = sizeof(STARTUPINFO);
+	startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+	startupInfo.hStdOutput = NULL;
+	startupInfo.hStdError = NULL;
+
+	if (!CreateProcessA(NULL, (LPSTR)cmd.c_str(), NULL, NULL, NULL, NULL, NULL, NULL, &startupInfo, &processInfo))
+	{
+		LOG(LogSeverity::ERR, "Failed to run glslangValidator for %s", a_sInputPath);
+		return false;
+	}
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode = 1;
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+
+	CloseHandle(processInfo.hProcess);
+	CloseHandle(processInfo.hThread);
+
+	LOG_IF(exitCode == 0, LogSeverity::ERR, "glslangValidator failed to compile %s", a_sInputPath);
+	return exitCode == 0;
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// SPIR-V cache keyed by a hash of the GLSL source, every file it includes and the
+// compile options. Binaries are named <shader>.<key>.spv, an edited shader gets a new
+// key so a stale binary is never loaded.
+
+// bump when the compiler changes in a way the options strings do not describe
+#define SHADER_CACHE_VERSION 1
+
+// the options each platform compiles with, part of the key
+#define SHADER_OPTIONS_WINDOWS	"vulkan1.0"
+#define SHADER_OPTIONS_ANDROID	"vulkan1.1 TARGET_ANDROID=1"
+
+#if defined(__ANDROID_API__)
+#define SHADER_OPTIONS SHADER_OPTIONS_ANDROID
+#else
+#define SHADER_OPTIONS SHADER_OPTIONS_WINDOWS
+#endif
+
+// precompiled binaries live next to the sources in this sub directory
+#define SHADER_CACHE_DIRECTORY "SpirV"
+
+// a_sDefines selects a variant of a shader, a space separated list of NAME or NAME=VALUE
+// returns 0 when the source can not be read
+uint64_t ComputeShaderCacheKey(const char* a_sSourcePath, const char* a_sOptions, const char* a_sDefines = "");
+std::string GetShaderCacheFileName(const char* a_sShaderName, uint64_t a_uKey);
+
+#if defined(_WIN32)
+// runs the Vulkan SDK's glslangValidator, a_sOptions is one of the SHADER_OPTIONS strings
+bool CompileShaderWithGlslang(const char* a_sInputPath, const char* a_sOutputPath, const char* a_sOptions, const char* a_sDefines = "");
+#endif
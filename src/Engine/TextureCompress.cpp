@@ -0,0 +1,630 @@
+#include "TextureCompress.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define BLOCK_PIXELS 16
+
+// BC7 mode 6 and ASTC interpolate between two endpoints with these weights out of 64
+static const int32_t bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const int32_t astcWeights8[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int32_t astcWeights4[4] = { 0, 21, 43, 64 };
+
+// ETC1 intensity modifier pairs, a pixel adds +a, +b, -a or -b to every channel of its sub block's base colour
+static const int32_t etcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// EAC alpha modifiers, scaled by the block's multiplier
+static const int32_t eacModifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 },
+	{ -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 },
+	{ -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 },
+	{ -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 },
+	{ -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+// the table holding a 0 modifier, encodes blocks of one alpha exactly
+#define EAC_EXACT_TABLE 13
+#define EAC_EXACT_INDEX 4
+
+// 4x4 weight grid without dual plane, bits 0 to 10 of a block. range 8 leaves room for 8 bit RGB endpoints,
+// range 4 for 8 bit RGBA endpoints, other combinations would need trit or quint coded endpoints
+#define ASTC_BLOCK_MODE_RANGE_8 0x53
+#define ASTC_BLOCK_MODE_RANGE_4 0x42
+#define ASTC_CEM_RGB_DIRECT 8
+#define ASTC_CEM_RGBA_DIRECT 12
+
+// little endian bit fields from bit 0 of a zeroed block up, the layout of BC7 and ASTC
+struct BlockWriter
+{
+	uint8_t*	pBlock;
+	uint32_t	position;
+};
+
+static void WriteBits(BlockWriter* a_pWriter, uint32_t a_uValue, uint32_t a_uBitCount)
+{
+	for (uint32_t i = 0; i < a_uBitCount; ++i, ++a_pWriter->position)
+	{
+		if ((a_uValue >> i) & 1)
+			a_pWriter->pBlock[a_pWriter->position >> 3] |= (uint8_t)(1 << (a_pWriter->position & 7));
+	}
+}
+
+// ETC blocks are 64 bit big endian words
+static void WriteBigEndian64(uint64_t a_uWord, uint8_t* a_pDestination)
+{
+	for (uint32_t i = 0; i < 8; ++i)
+		a_pDestination[i] = (uint8_t)(a_uWord >> (56 - i * 8));
+}
+
+static int32_t Clamp255(int32_t a_iValue)
+{
+	return std::min(std::max(a_iValue, 0), 255);
+}
+
+static int32_t Quantize(float a_fValue, int32_t a_iMax)
+{
+	return std::min(std::max((int32_t)floorf(a_fValue + 0.5f), 0), a_iMax);
+}
+
+// pixels in row major order
+static void LoadBlock(const uint8_t* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, uint32_t a_uBlockX, uint32_t a_uBlockY, uint8_t a_Block[BLOCK_PIXELS][4])
+{
+	for (uint32_t y = 0; y < TEXTURE_BLOCK_DIMENSION; ++y)
+	{
+		const uint32_t sourceY = std::min(a_uBlockY * TEXTURE_BLOCK_DIMENSION + y, a_uHeight - 1);
+		for (uint32_t x = 0; x < TEXTURE_BLOCK_DIMENSION; ++x)
+		{
+			const uint32_t sourceX = std::min(a_uBlockX * TEXTURE_BLOCK_DIMENSION + x, a_uWidth - 1);
+			memcpy(a_Block[y * TEXTURE_BLOCK_DIMENSION + x], a_pPixels + ((size_t)sourceY * a_uWidth + sourceX) * 4, 4);
+		}
+	}
+}
+
+// ends of the segment covering the block's colours along their principal axis. with 3 channels alpha is left at 255
+static void FitLine(const uint8_t a_Block[BLOCK_PIXELS][4], uint32_t a_uChannels, float a_Start[4], float a_End[4])
+{
+	float mean[4] = {};
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		for (uint32_t c = 0; c < a_uChannels; ++c)
+			mean[c] += a_Block[p][c];
+	}
+	for (uint32_t c = 0; c < a_uChannels; ++c)
+		mean[c] /= BLOCK_PIXELS;
+
+	float covariance[4][4] = {};
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		for (uint32_t i = 0; i < a_uChannels; ++i)
+		{
+			for (uint32_t j = 0; j < a_uChannels; ++j)
+				covariance[i][j] += (a_Block[p][i] - mean[i]) * (a_Block[p][j] - mean[j]);
+		}
+	}
+
+	// power iteration, starting from the column of the channel that varies most
+	uint32_t largest = 0;
+	for (uint32_t c = 1; c < a_uChannels; ++c)
+		largest = covariance[c][c] > covariance[largest][largest] ? c : largest;
+	float axis[4] = {};
+	for (uint32_t c = 0; c < a_uChannels; ++c)
+		axis[c] = covariance[c][largest];
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t i = 0; i < a_uChannels; ++i)
+		{
+			for (uint32_t j = 0; j < a_uChannels; ++j)
+				next[i] += covariance[i][j] * axis[j];
+			length += next[i] * next[i];
+		}
+		if (length < 1e-12f)
+			break;
+		length = sqrtf(length);
+		for (uint32_t c = 0; c < a_uChannels; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		float t = 0.0f;
+		for (uint32_t c = 0; c < a_uChannels; ++c)
+			t += (a_Block[p][c] - mean[c]) * axis[c];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		a_Start[c] = c < a_uChannels ? std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f) : 255.0f;
+		a_End[c] = c < a_uChannels ? std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f) : 255.0f;
+	}
+}
+
+// least squares endpoints for the chosen indices, false when every pixel uses the same weight
+static bool RefitLine(const uint8_t a_Block[BLOCK_PIXELS][4], const uint8_t a_Indices[BLOCK_PIXELS], const int32_t* a_pWeights, uint32_t a_uChannels, float a_Start[4], float a_End[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ap[4] = {}, bp[4] = {};
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		const float b = a_pWeights[a_Indices[p]] / 64.0f;
+		const float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < a_uChannels; ++c)
+		{
+			ap[c] += a * a_Block[p][c];
+			bp[c] += b * a_Block[p][c];
+		}
+	}
+
+	const float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (uint32_t c = 0; c < a_uChannels; ++c)
+	{
+		a_Start[c] = std::min(std::max((ap[c] * bb - bp[c] * ab) / determinant, 0.0f), 255.0f);
+		a_End[c] = std::min(std::max((bp[c] * aa - ap[c] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+// closest palette entry per pixel, returns the summed squared error
+static uint32_t SelectIndices(const uint8_t a_Block[BLOCK_PIXELS][4], const int32_t a_Palette[][4], uint32_t a_uLevels, uint8_t a_Indices[BLOCK_PIXELS])
+{
+	uint32_t total = 0;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		uint32_t best = UINT32_MAX;
+		for (uint32_t i = 0; i < a_uLevels; ++i)
+		{
+			uint32_t error = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const int32_t d = a_Palette[i][c] - a_Block[p][c];
+				error += (uint32_t)(d * d);
+			}
+			if (error < best)
+			{
+				best = error;
+				a_Indices[p] = (uint8_t)i;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+/* ----------------------------------------- BC7 ----------------------------------------- */
+
+struct Bc7Block
+{
+	// 7 bit endpoints, the p bit adds the eighth
+	int32_t		endpoints[2][4];
+	int32_t		pBits[2];
+	uint8_t		indices[BLOCK_PIXELS];
+	uint32_t	error;
+};
+
+// tries the p bit combinations for the segment and keeps the best in a_pBest, only both set can keep alpha at 255
+static void QuantizeBC7(const uint8_t a_Block[BLOCK_PIXELS][4], const float a_Start[4], const float a_End[4], bool a_bOpaque, Bc7Block* a_pBest)
+{
+	for (int32_t pBits = a_bOpaque ? 3 : 0; pBits < 4; ++pBits)
+	{
+		Bc7Block candidate;
+		candidate.pBits[0] = pBits & 1;
+		candidate.pBits[1] = pBits >> 1;
+
+		int32_t start[4], end[4];
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			candidate.endpoints[0][c] = Quantize((a_Start[c] - candidate.pBits[0]) * 0.5f, 127);
+			candidate.endpoints[1][c] = Quantize((a_End[c] - candidate.pBits[1]) * 0.5f, 127);
+			start[c] = candidate.endpoints[0][c] * 2 + candidate.pBits[0];
+			end[c] = candidate.endpoints[1][c] * 2 + candidate.pBits[1];
+		}
+
+		int32_t palette[16][4];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+				palette[i][c] = ((64 - bc7Weights[i]) * start[c] + bc7Weights[i] * end[c] + 32) >> 6;
+		}
+
+		candidate.error = SelectIndices(a_Block, palette, 16, candidate.indices);
+		if (candidate.error < a_pBest->error)
+			*a_pBest = candidate;
+	}
+}
+
+static void EncodeBC7Block(const uint8_t a_Block[BLOCK_PIXELS][4], uint8_t* a_pDestination)
+{
+	// opaque blocks keep alpha at 255 instead of letting it drift along the fitted line
+	bool opaque = true;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+		opaque = opaque && a_Block[p][3] == 255;
+	const uint32_t channels = opaque ? 3 : 4;
+
+	float start[4], end[4];
+	FitLine(a_Block, channels, start, end);
+
+	Bc7Block best;
+	best.error = UINT32_MAX;
+	QuantizeBC7(a_Block, start, end, opaque, &best);
+	if (best.error > 0 && RefitLine(a_Block, best.indices, bc7Weights, channels, start, end))
+		QuantizeBC7(a_Block, start, end, opaque, &best);
+
+	// the first index is stored without its top bit, swap the endpoints when it's set
+	if (best.indices[0] & 8)
+	{
+		std::swap(best.endpoints[0], best.endpoints[1]);
+		std::swap(best.pBits[0], best.pBits[1]);
+		for (uint8_t& index : best.indices)
+			index = (uint8_t)(15 - index);
+	}
+
+	memset(a_pDestination, 0, TEXTURE_BLOCK_BYTES);
+	BlockWriter writer = { a_pDestination, 0 };
+	// mode 6
+	WriteBits(&writer, 1 << 6, 7);
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		WriteBits(&writer, (uint32_t)best.endpoints[0][c], 7);
+		WriteBits(&writer, (uint32_t)best.endpoints[1][c], 7);
+	}
+	WriteBits(&writer, (uint32_t)best.pBits[0], 1);
+	WriteBits(&writer, (uint32_t)best.pBits[1], 1);
+	WriteBits(&writer, best.indices[0], 3);
+	for (uint32_t p = 1; p < BLOCK_PIXELS; ++p)
+		WriteBits(&writer, best.indices[p], 4);
+}
+
+/* ----------------------------------------- ETC2 ---------------------------------------- */
+
+// ETC orders a block's pixels by column, p is row major
+static uint32_t EtcPixelBit(uint32_t a_uPixel)
+{
+	return (a_uPixel & 3) * 4 + (a_uPixel >> 2);
+}
+
+// flip 0 splits the block into left and right 2x4 halves, flip 1 into top and bottom 4x2 halves
+static uint32_t EtcSubblock(uint32_t a_uPixel, uint32_t a_uFlip)
+{
+	return a_uFlip ? (a_uPixel >> 2) / 2 : (a_uPixel & 3) / 2;
+}
+
+// best modifier table for one sub block around its base colour, returns the squared error
+static uint32_t FitEtcSubblock(const uint8_t a_Block[BLOCK_PIXELS][4], uint32_t a_uFlip, uint32_t a_uSubblock, const int32_t a_Base[3],
+	uint32_t* a_pTable, uint8_t a_Indices[BLOCK_PIXELS])
+{
+	uint32_t bestError = UINT32_MAX;
+	for (uint32_t table = 0; table < 8; ++table)
+	{
+		uint8_t indices[BLOCK_PIXELS];
+		uint32_t tableError = 0;
+		for (uint32_t p = 0; p < BLOCK_PIXELS && tableError < bestError; ++p)
+		{
+			if (EtcSubblock(p, a_uFlip) != a_uSubblock)
+				continue;
+
+			uint32_t best = UINT32_MAX;
+			// index bit 0 picks b over a, bit 1 negates
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				const int32_t modifier = etcModifiers[table][i & 1] * ((i & 2) ? -1 : 1);
+				uint32_t error = 0;
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					const int32_t d = Clamp255(a_Base[c] + modifier) - a_Block[p][c];
+					error += (uint32_t)(d * d);
+				}
+				if (error < best)
+				{
+					best = error;
+					indices[p] = (uint8_t)i;
+				}
+			}
+			tableError += best;
+		}
+
+		if (tableError < bestError)
+		{
+			bestError = tableError;
+			*a_pTable = table;
+			for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+			{
+				if (EtcSubblock(p, a_uFlip) == a_uSubblock)
+					a_Indices[p] = indices[p];
+			}
+		}
+	}
+	return bestError;
+}
+
+// the ETC1 compatible part of ETC2, base colours are the sub block averages. differential mode when
+// the two fit 5 bits and 3 bit differences, two 4 bit colours otherwise
+static void EncodeEtc2ColorBlock(const uint8_t a_Block[BLOCK_PIXELS][4], uint8_t* a_pDestination)
+{
+	uint64_t bestWord = 0;
+	uint32_t bestError = UINT32_MAX;
+	for (uint32_t flip = 0; flip < 2; ++flip)
+	{
+		float average[2][3] = {};
+		for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				average[EtcSubblock(p, flip)][c] += a_Block[p][c] / 8.0f;
+		}
+
+		uint64_t word = (uint64_t)flip << 32;
+		int32_t base[2][3];
+		int32_t colors5[2][3];
+		bool differential = true;
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			colors5[0][c] = Quantize(average[0][c] * 31.0f / 255.0f, 31);
+			colors5[1][c] = Quantize(average[1][c] * 31.0f / 255.0f, 31);
+			const int32_t delta = colors5[1][c] - colors5[0][c];
+			differential = differential && delta >= -4 && delta <= 3;
+		}
+
+		if (differential)
+		{
+			word |= 1ull << 33;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const uint32_t shift = 59 - c * 8;
+				word |= (uint64_t)colors5[0][c] << shift;
+				word |= (uint64_t)((colors5[1][c] - colors5[0][c]) & 7) << (shift - 3);
+				base[0][c] = (colors5[0][c] << 3) | (colors5[0][c] >> 2);
+				base[1][c] = (colors5[1][c] << 3) | (colors5[1][c] >> 2);
+			}
+		}
+		else
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const uint32_t shift = 60 - c * 8;
+				const int32_t color0 = Quantize(average[0][c] * 15.0f / 255.0f, 15);
+				const int32_t color1 = Quantize(average[1][c] * 15.0f / 255.0f, 15);
+				word |= (uint64_t)color0 << shift;
+				word |= (uint64_t)color1 << (shift - 4);
+				base[0][c] = color0 * 17;
+				base[1][c] = color1 * 17;
+			}
+		}
+
+		uint32_t tables[2];
+		uint8_t indices[BLOCK_PIXELS];
+		uint32_t error = FitEtcSubblock(a_Block, flip, 0, base[0], &tables[0], indices);
+		error += FitEtcSubblock(a_Block, flip, 1, base[1], &tables[1], indices);
+		if (error >= bestError)
+			continue;
+
+		word |= (uint64_t)tables[0] << 37;
+		word |= (uint64_t)tables[1] << 34;
+		for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+		{
+			const uint32_t bit = EtcPixelBit(p);
+			word |= (uint64_t)(indices[p] >> 1) << (16 + bit);
+			word |= (uint64_t)(indices[p] & 1) << bit;
+		}
+		bestError = error;
+		bestWord = word;
+	}
+	WriteBigEndian64(bestWord, a_pDestination);
+}
+
+static void EncodeEacAlphaBlock(const uint8_t a_Block[BLOCK_PIXELS][4], uint8_t* a_pDestination)
+{
+	int32_t minAlpha = 255, maxAlpha = 0;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		minAlpha = std::min(minAlpha, (int32_t)a_Block[p][3]);
+		maxAlpha = std::max(maxAlpha, (int32_t)a_Block[p][3]);
+	}
+
+	int32_t bestBase = minAlpha, bestMultiplier = 1, bestTable = EAC_EXACT_TABLE;
+	uint8_t bestIndices[BLOCK_PIXELS];
+	memset(bestIndices, EAC_EXACT_INDEX, sizeof(bestIndices));
+
+	// the search scales each table to the block's alpha range and tries the bases around its low end
+	if (minAlpha != maxAlpha)
+	{
+		uint32_t bestError = UINT32_MAX;
+		for (int32_t table = 0; table < 16; ++table)
+		{
+			const int32_t* pModifiers = eacModifiers[table];
+			const int32_t tableRange = pModifiers[7] - pModifiers[3];
+			const int32_t multiplier0 = Quantize((float)(maxAlpha - minAlpha) / tableRange, 15);
+			for (int32_t multiplier = std::max(multiplier0 - 1, 1); multiplier <= std::min(multiplier0 + 1, 15); ++multiplier)
+			{
+				const int32_t base0 = Clamp255(minAlpha - pModifiers[3] * multiplier);
+				for (int32_t base = std::max(base0 - 1, 0); base <= std::min(base0 + 1, 255); ++base)
+				{
+					uint8_t indices[BLOCK_PIXELS];
+					uint32_t error = 0;
+					for (uint32_t p = 0; p < BLOCK_PIXELS && error < bestError; ++p)
+					{
+						uint32_t best = UINT32_MAX;
+						for (uint32_t i = 0; i < 8; ++i)
+						{
+							const int32_t d = Clamp255(base + pModifiers[i] * multiplier) - a_Block[p][3];
+							if ((uint32_t)(d * d) < best)
+							{
+								best = (uint32_t)(d * d);
+								indices[p] = (uint8_t)i;
+							}
+						}
+						error += best;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						bestBase = base;
+						bestMultiplier = multiplier;
+						bestTable = table;
+						memcpy(bestIndices, indices, sizeof(indices));
+					}
+				}
+			}
+		}
+	}
+
+	uint64_t word = (uint64_t)bestBase << 56 | (uint64_t)bestMultiplier << 52 | (uint64_t)bestTable << 48;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+		word |= (uint64_t)bestIndices[p] << (45 - 3 * EtcPixelBit(p));
+	WriteBigEndian64(word, a_pDestination);
+}
+
+static void EncodeEtc2Block(const uint8_t a_Block[BLOCK_PIXELS][4], uint8_t* a_pDestination)
+{
+	EncodeEacAlphaBlock(a_Block, a_pDestination);
+	EncodeEtc2ColorBlock(a_Block, a_pDestination + 8);
+}
+
+/* ----------------------------------------- ASTC ---------------------------------------- */
+
+struct AstcBlock
+{
+	int32_t		endpoints[2][4];
+	uint8_t		indices[BLOCK_PIXELS];
+	uint32_t	error;
+};
+
+static void QuantizeAstc(const uint8_t a_Block[BLOCK_PIXELS][4], const float a_Start[4], const float a_End[4], const int32_t* a_pWeights, uint32_t a_uLevels,
+	AstcBlock* a_pBest)
+{
+	AstcBlock candidate;
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		candidate.endpoints[0][c] = Quantize(a_Start[c], 255);
+		candidate.endpoints[1][c] = Quantize(a_End[c], 255);
+	}
+
+	// decoders expand the endpoints to 16 bits, interpolate and keep the top 8 bits for unorm8
+	int32_t palette[8][4];
+	for (uint32_t i = 0; i < a_uLevels; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			palette[i][c] = ((candidate.endpoints[0][c] * 257 * (64 - a_pWeights[i]) + candidate.endpoints[1][c] * 257 * a_pWeights[i] + 32) >> 6) >> 8;
+	}
+
+	candidate.error = SelectIndices(a_Block, palette, a_uLevels, candidate.indices);
+	if (candidate.error < a_pBest->error)
+		*a_pBest = candidate;
+}
+
+static void EncodeAstcBlock(const uint8_t a_Block[BLOCK_PIXELS][4], uint8_t* a_pDestination)
+{
+	bool opaque = true;
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+		opaque = opaque && a_Block[p][3] == 255;
+
+	const uint32_t channels = opaque ? 3 : 4;
+	const uint32_t levels = opaque ? 8 : 4;
+	const uint32_t weightBits = opaque ? 3 : 2;
+	const int32_t* pWeights = opaque ? astcWeights8 : astcWeights4;
+
+	float start[4], end[4];
+	FitLine(a_Block, channels, start, end);
+
+	AstcBlock best;
+	best.error = UINT32_MAX;
+	QuantizeAstc(a_Block, start, end, pWeights, levels, &best);
+	if (best.error > 0 && RefitLine(a_Block, best.indices, pWeights, channels, start, end))
+		QuantizeAstc(a_Block, start, end, pWeights, levels, &best);
+
+	// decoders swap and blue contract the endpoints when the second has the smaller rgb sum, keep it the larger one
+	const int32_t* e = best.endpoints[0];
+	const int32_t* f = best.endpoints[1];
+	if (f[0] + f[1] + f[2] < e[0] + e[1] + e[2])
+	{
+		std::swap(best.endpoints[0], best.endpoints[1]);
+		for (uint8_t& index : best.indices)
+			index = (uint8_t)(levels - 1 - index);
+	}
+
+	memset(a_pDestination, 0, TEXTURE_BLOCK_BYTES);
+	BlockWriter writer = { a_pDestination, 0 };
+	WriteBits(&writer, opaque ? ASTC_BLOCK_MODE_RANGE_8 : ASTC_BLOCK_MODE_RANGE_4, 11);
+	// one partition
+	WriteBits(&writer, 0, 2);
+	WriteBits(&writer, opaque ? ASTC_CEM_RGB_DIRECT : ASTC_CEM_RGBA_DIRECT, 4);
+	for (uint32_t c = 0; c < channels; ++c)
+	{
+		WriteBits(&writer, (uint32_t)best.endpoints[0][c], 8);
+		WriteBits(&writer, (uint32_t)best.endpoints[1][c], 8);
+	}
+
+	// weights are stored bit reversed from the top of the block down
+	for (uint32_t p = 0; p < BLOCK_PIXELS; ++p)
+	{
+		for (uint32_t b = 0; b < weightBits; ++b)
+		{
+			const uint32_t bit = 127 - (p * weightBits + b);
+			if ((best.indices[p] >> b) & 1)
+				a_pDestination[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+		}
+	}
+}
+
+void CompressTextureLevel(TextureFileFormat a_eFormat, const uint8_t* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, uint8_t* a_pBlocks)
+{
+	const uint32_t blocksX = (a_uWidth + TEXTURE_BLOCK_DIMENSION - 1) / TEXTURE_BLOCK_DIMENSION;
+	const uint32_t blocksY = (a_uHeight + TEXTURE_BLOCK_DIMENSION - 1) / TEXTURE_BLOCK_DIMENSION;
+
+	uint8_t block[BLOCK_PIXELS][4];
+	for (uint32_t y = 0; y < blocksY; ++y)
+	{
+		for (uint32_t x = 0; x < blocksX; ++x)
+		{
+			LoadBlock(a_pPixels, a_uWidth, a_uHeight, x, y, block);
+			uint8_t* pDestination = a_pBlocks + ((size_t)y * blocksX + x) * TEXTURE_BLOCK_BYTES;
+			switch (a_eFormat)
+			{
+			case TextureFileFormat::ASTC_4x4:	EncodeAstcBlock(block, pDestination);	break;
+			case TextureFileFormat::BC7:		EncodeBC7Block(block, pDestination);	break;
+			case TextureFileFormat::ETC2:		EncodeEtc2Block(block, pDestination);	break;
+			}
+		}
+	}
+}
+
+void DownsampleTextureLevel(const uint8_t* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, uint8_t* a_pDestination)
+{
+	const uint32_t width = std::max(a_uWidth / 2, 1u);
+	const uint32_t height = std::max(a_uHeight / 2, 1u);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint32_t y0 = std::min(y * 2, a_uHeight - 1), y1 = std::min(y * 2 + 1, a_uHeight - 1);
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint32_t x0 = std::min(x * 2, a_uWidth - 1), x1 = std::min(x * 2 + 1, a_uWidth - 1);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const uint32_t sum = a_pPixels[((size_t)y0 * a_uWidth + x0) * 4 + c] + a_pPixels[((size_t)y0 * a_uWidth + x1) * 4 + c] +
+					a_pPixels[((size_t)y1 * a_uWidth + x0) * 4 + c] + a_pPixels[((size_t)y1 * a_uWidth + x1) * 4 + c];
+				a_pDestination[((size_t)y * width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
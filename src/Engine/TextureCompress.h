@@ -0,0 +1,15 @@
+#pragma once
+
+#include "TextureFile.h"
+
+// CPU block encoders for the TextureFile formats, run offline by the TextureCompressor tool. Every block gets one
+// principal axis or average fit and a refit of the endpoints to the chosen indices, no exhaustive mode search:
+// - BC7 mode 6, one RGBA line with 16 levels
+// - ETC2 RGBA8, ETC1 individual or differential colour with an EAC alpha block
+// - ASTC 4x4, one partition with 8 levels on an RGB line for opaque blocks, 4 levels on an RGBA line otherwise
+
+// a_pPixels is a_uWidth x a_uHeight RGBA8, a_pBlocks needs GetCompressedLevelSize bytes.
+// blocks over the edge repeat the last row and column
+void CompressTextureLevel(TextureFileFormat a_eFormat, const uint8_t* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, uint8_t* a_pBlocks);
+// next mip level with a 2x2 box filter, a_pDestination needs max(a_uWidth / 2, 1) x max(a_uHeight / 2, 1) pixels
+void DownsampleTextureLevel(const uint8_t* a_pPixels, uint32_t a_uWidth, uint32_t a_uHeight, uint8_t* a_pDestination);
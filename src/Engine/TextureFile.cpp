@@ -0,0 +1,140 @@
+#include "TextureFile.h"
+
+#include <string.h>
+
+const TextureFileFormat textureFileFormats[TEXTURE_FILE_FORMAT_COUNT] = {
+	TextureFileFormat::ASTC_4x4,
+	TextureFileFormat::BC7,
+	TextureFileFormat::ETC2
+};
+
+static const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// the fixed part of a KTX2 header, the level index follows it
+struct Ktx2Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+const char* GetTextureFileFormatName(TextureFileFormat a_eFormat)
+{
+	switch (a_eFormat)
+	{
+	case TextureFileFormat::ASTC_4x4:	return "astc";
+	case TextureFileFormat::BC7:		return "bc7";
+	case TextureFileFormat::ETC2:		return "etc2";
+	}
+	return "";
+}
+
+std::string GetTextureFilePath(const std::string& a_sSourcePath, TextureFileFormat a_eFormat)
+{
+	const size_t slash = a_sSourcePath.find_last_of("/\\");
+	const size_t dot = a_sSourcePath.rfind('.');
+	const std::string stem = (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? a_sSourcePath : a_sSourcePath.substr(0, dot);
+	return stem + "." + GetTextureFileFormatName(a_eFormat) + TEXTURE_FILE_EXTENSION;
+}
+
+uint64_t GetCompressedLevelSize(uint32_t a_uWidth, uint32_t a_uHeight)
+{
+	const uint64_t blocksX = (a_uWidth + TEXTURE_BLOCK_DIMENSION - 1) / TEXTURE_BLOCK_DIMENSION;
+	const uint64_t blocksY = (a_uHeight + TEXTURE_BLOCK_DIMENSION - 1) / TEXTURE_BLOCK_DIMENSION;
+	return blocksX * blocksY * TEXTURE_BLOCK_BYTES;
+}
+
+bool ReadTextureFile(const void* a_pHeader, uint64_t a_uHeaderSize, uint64_t a_uFileSize, TextureFile* a_pFile)
+{
+	static_assert(MAX_TEXTURE_FILE_HEADER_SIZE == sizeof(Ktx2Header) + MAX_TEXTURE_FILE_LEVELS * sizeof(Ktx2Level), "header size out of date");
+
+	Ktx2Header header;
+	if (a_uHeaderSize < sizeof(header))
+		return false;
+	memcpy(&header, a_pHeader, sizeof(header));
+
+	if (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0 || header.supercompressionScheme != 0 ||
+		header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0 || header.levelCount > MAX_TEXTURE_FILE_LEVELS)
+		return false;
+
+	bool knownFormat = false;
+	for (TextureFileFormat format : textureFileFormats)
+		knownFormat = knownFormat || (uint32_t)format == header.vkFormat;
+	if (!knownFormat)
+		return false;
+
+	if (a_uHeaderSize < sizeof(header) + header.levelCount * sizeof(Ktx2Level))
+		return false;
+
+	a_pFile->format = (TextureFileFormat)header.vkFormat;
+	a_pFile->width = header.pixelWidth;
+	a_pFile->height = header.pixelHeight;
+	a_pFile->levelCount = header.levelCount;
+
+	const uint8_t* pLevelIndex = (const uint8_t*)a_pHeader + sizeof(header);
+	for (uint32_t i = 0; i < header.levelCount; ++i)
+	{
+		Ktx2Level level;
+		memcpy(&level, pLevelIndex + i * sizeof(Ktx2Level), sizeof(level));
+
+		const uint32_t width = header.pixelWidth >> i ? header.pixelWidth >> i : 1;
+		const uint32_t height = header.pixelHeight >> i ? header.pixelHeight >> i : 1;
+		if (level.byteLength != GetCompressedLevelSize(width, height) || level.byteOffset > a_uFileSize || level.byteLength > a_uFileSize - level.byteOffset)
+			return false;
+
+		a_pFile->levels[i] = { level.byteOffset, level.byteLength };
+	}
+	return true;
+}
+
+std::vector<uint8_t> WriteTextureFile(TextureFileFormat a_eFormat, uint32_t a_uWidth, uint32_t a_uHeight, uint32_t a_uLevelCount, const std::vector<uint8_t>* a_pLevels)
+{
+	Ktx2Header header = {};
+	memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+	header.vkFormat = (uint32_t)a_eFormat;
+	header.typeSize = 1;
+	header.pixelWidth = a_uWidth;
+	header.pixelHeight = a_uHeight;
+	header.faceCount = 1;
+	header.levelCount = a_uLevelCount;
+
+	std::vector<Ktx2Level> levels(a_uLevelCount);
+	uint64_t offset = sizeof(header) + a_uLevelCount * sizeof(Ktx2Level);
+	// smallest level first, each one aligned to a block
+	for (uint32_t i = a_uLevelCount; i-- > 0;)
+	{
+		offset = (offset + TEXTURE_BLOCK_BYTES - 1) / TEXTURE_BLOCK_BYTES * TEXTURE_BLOCK_BYTES;
+		levels[i] = { offset, a_pLevels[i].size(), a_pLevels[i].size() };
+		offset += a_pLevels[i].size();
+	}
+
+	std::vector<uint8_t> file(offset, 0);
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(Ktx2Level));
+	for (uint32_t i = 0; i < a_uLevelCount; ++i)
+	{
+		if (!a_pLevels[i].empty())
+			memcpy(file.data() + levels[i].byteOffset, a_pLevels[i].data(), a_pLevels[i].size());
+	}
+	return file;
+}
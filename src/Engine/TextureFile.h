@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Block compressed textures with every mip level precomputed, written offline by the TextureCompressor tool.
+// The layout is the KTX2 header and level index with no data format descriptor, key/value or supercompression
+// data, levels are stored smallest first. A compressed texture sits next to its source image as
+// <source name without extension>.<format name>.ktx2, the source is the fallback when the device can't sample any of them.
+
+#define TEXTURE_FILE_EXTENSION ".ktx2"
+// a 2^15 texel texture has 16 levels
+#define MAX_TEXTURE_FILE_LEVELS 16
+// every format here has 4x4 texel blocks of 16 bytes
+#define TEXTURE_BLOCK_DIMENSION 4
+#define TEXTURE_BLOCK_BYTES 16
+
+// the VkFormat values, stored as they are
+enum class TextureFileFormat : uint32_t
+{
+	// VK_FORMAT_ASTC_4x4_UNORM_BLOCK
+	ASTC_4x4 = 157,
+	// VK_FORMAT_BC7_UNORM_BLOCK, desktop GPUs
+	BC7 = 145,
+	// VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, every Vulkan capable Android GPU
+	ETC2 = 151
+};
+
+#define TEXTURE_FILE_FORMAT_COUNT 3
+// in order of preference when a device can sample more than one
+extern const TextureFileFormat textureFileFormats[TEXTURE_FILE_FORMAT_COUNT];
+
+struct TextureFileLevel
+{
+	// from the start of the file
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct TextureFile
+{
+	TextureFileFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	TextureFileLevel levels[MAX_TEXTURE_FILE_LEVELS];
+};
+
+// "astc", "bc7" or "etc2"
+const char* GetTextureFileFormatName(TextureFileFormat a_eFormat);
+std::string GetTextureFilePath(const std::string& a_sSourcePath, TextureFileFormat a_eFormat);
+// bytes of a level of a_uWidth x a_uHeight texels, partial blocks at the edges count as whole ones
+uint64_t GetCompressedLevelSize(uint32_t a_uWidth, uint32_t a_uHeight);
+
+// the start of a file up to the end of the largest possible level index, enough for ReadTextureFile
+#define MAX_TEXTURE_FILE_HEADER_SIZE (80 + MAX_TEXTURE_FILE_LEVELS * 24)
+
+// validates the header and level index, false for anything this loader can't upload. a_pHeader is the start of the
+// file, a_uHeaderSize bytes of it, the levels are checked against the size of the whole file
+bool ReadTextureFile(const void* a_pHeader, uint64_t a_uHeaderSize, uint64_t a_uFileSize, TextureFile* a_pFile);
+// a_pLevels[i] are the blocks of level i, largest first. returns the whole file
+std::vector<uint8_t> WriteTextureFile(TextureFileFormat a_eFormat, uint32_t a_uWidth, uint32_t a_uHeight, uint32_t a_uLevelCount, const std::vector<uint8_t>* a_pLevels);
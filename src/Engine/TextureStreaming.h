@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+// Mip streaming for textures loaded from TextureFiles (see TextureFile.h). A streamed texture starts with its levels up
+// to TEXTURE_STREAMING_MIN_SIZE, ask for more with RequestTextureSize and UpdateTextureStreaming loads them under the budget.
+// The image view changes with the resident levels, descriptors using it have to be written again.
+
+struct Renderer;
+struct Texture;
+struct Buffer;
+struct CommandBuffer;
+struct StreamedTexture;
+
+// largest level of a streamed texture loaded with it, smaller textures are loaded whole
+#define TEXTURE_STREAMING_MIN_SIZE 64
+#define DEFAULT_TEXTURE_STREAMING_BUDGET (128ull * 1024 * 1024)
+// textures resized per update, the old and the new image of each are both allocated for maxInFlightFrames frames
+#define MAX_TEXTURE_STREAMING_UPDATES 4
+// reads in flight, each holds its levels in memory until the update that uploads them
+#define MAX_TEXTURE_STREAMING_LOADS 4
+
+struct TextureStreamingStats
+{
+	uint32_t	textureCount;
+	// bytes of resident levels, against TextureStreamer::budget
+	uint64_t	residentBytes;
+	// bytes the textures requested in the last update would need
+	uint64_t	requestedBytes;
+	uint32_t	pendingLoads;
+	// levels since InitTextureStreamer
+	uint32_t	loadedLevels;
+	uint32_t	evictedLevels;
+};
+
+// the texture already has its new image, oldImageView stays valid for the frames in flight and identifies the
+// descriptors to rewrite
+struct TextureResidencyChange
+{
+	Texture*	pTexture;
+	VkImageView	oldImageView;
+};
+
+// what a resize leaves behind, destroyed maxInFlightFrames updates after the frame that recorded the copies
+struct RetiredStreamedImage
+{
+	Texture*	pTexture;
+	Buffer*		pStagingBuffer;
+	uint64_t	frame;
+};
+
+struct TextureStreamer
+{
+	Renderer*										pRenderer;
+	uint64_t										budget;
+	std::unordered_map<Texture*, StreamedTexture*>	textures;
+	// requests carry the frame they were made in, the least recently requested textures are evicted first
+	uint64_t										frame;
+	std::vector<RetiredStreamedImage>				retired;
+	TextureStreamingStats							stats;
+
+	TextureStreamer() :
+		pRenderer(nullptr), budget(DEFAULT_TEXTURE_STREAMING_BUDGET), textures(), frame(0), retired(), stats()
+	{}
+};
+
+void InitTextureStreamer(TextureStreamer* a_pStreamer, Renderer* a_pRenderer, uint64_t a_uBudget = DEFAULT_TEXTURE_STREAMING_BUDGET);
+// waits for the reads in flight and destroys the retired images, the device has to be idle. the textures themselves are
+// destroyed by their owners
+void ExitTextureStreamer(TextureStreamer* a_pStreamer);
+
+// creates the texture from the smallest levels of a TextureFile, CreateTexture calls this for textures with desc.streamed.
+// false when the file can't be used, the texture is untouched then
+bool CreateStreamedTexture(TextureStreamer* a_pStreamer, Texture** a_ppTexture, const char* a_sPath);
+// DestroyTexture calls this, nothing happens for textures that aren't streamed
+void ReleaseStreamedTexture(TextureStreamer* a_pStreamer, Texture* a_pTexture);
+
+// the texture covers about a_uTexels pixels on screen this frame, the largest request of the frame wins
+void RequestTextureSize(TextureStreamer* a_pStreamer, Texture* a_pTexture, uint32_t a_uTexels);
+// once per frame after its fence is waited on, with a_pCommandBuffer recording ahead of every pass: uploads finished
+// reads, evicts and starts new reads. a_Changes lists the textures that got a new image, their descriptors have to be
+// written again before the passes are recorded
+void UpdateTextureStreaming(TextureStreamer* a_pStreamer, CommandBuffer* a_pCommandBuffer, std::vector<TextureResidencyChange>& a_Changes);
@@ -0,0 +1,139 @@
+// Offline asset packer, writes every file under a directory into one asset archive (see AssetArchive.h).
+// Text, shaders and buffers are LZ4 compressed, images and cooked models are stored so they stay
+// readable in place. A mounted archive replaces the loose files it was built from.
+//
+// usage: AssetPacker <resource directory> <archive path>
+// the archive is skipped when it is newer than every file, delete it to force a rebuild
+
+#include "../Engine/AssetArchive.h"
+#include "../Engine/TextureFile.h"
+#include "../Engine/ModelFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// compressed already or mapped in place by the loaders
+static const char* storedExtensions[] = { ".png", ".jpg", ".jpeg", TEXTURE_FILE_EXTENSION, MODEL_FILE_EXTENSION };
+
+static bool HasExtension(const char* a_sFileName, const char* const* a_pExtensions, size_t a_uCount)
+{
+	const char* ext = strrchr(a_sFileName, '.');
+	if (!ext)
+		return false;
+
+	for (size_t i = 0; i < a_uCount; ++i)
+	{
+		if (_stricmp(ext, a_pExtensions[i]) == 0)
+			return true;
+	}
+	return false;
+}
+
+// paths relative to a_sRoot with forward slashes, archives are never packed
+static void FindFiles(const std::string& a_sRoot, const std::string& a_sRelative, std::vector<std::string>& a_Files)
+{
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((a_sRoot + "\\" + a_sRelative + "*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	static const char* archiveExtension[] = { ASSET_ARCHIVE_EXTENSION };
+	do
+	{
+		const std::string path = a_sRelative + findData.cFileName;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (strcmp(findData.cFileName, ".") != 0 && strcmp(findData.cFileName, "..") != 0)
+				FindFiles(a_sRoot, path + "/", a_Files);
+		}
+		else if (!HasExtension(findData.cFileName, archiveExtension, 1))
+		{
+			a_Files.push_back(path);
+		}
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+}
+
+static bool IsUpToDate(const std::string& a_sRoot, const std::vector<std::string>& a_Files, const std::string& a_sArchivePath)
+{
+	WIN32_FILE_ATTRIBUTE_DATA archive;
+	if (!GetFileAttributesExA(a_sArchivePath.c_str(), GetFileExInfoStandard, &archive))
+		return false;
+
+	for (const std::string& file : a_Files)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA source;
+		if (!GetFileAttributesExA((a_sRoot + "\\" + file).c_str(), GetFileExInfoStandard, &source) ||
+			CompareFileTime(&archive.ftLastWriteTime, &source.ftLastWriteTime) < 0)
+			return false;
+	}
+	return true;
+}
+
+static bool ReadWholeFile(const std::string& a_sPath, std::vector<uint8_t>& a_Data)
+{
+	FILE* pFile = fopen(a_sPath.c_str(), "rb");
+	if (!pFile)
+		return false;
+
+	_fseeki64(pFile, 0, SEEK_END);
+	const int64_t size = _ftelli64(pFile);
+	_fseeki64(pFile, 0, SEEK_SET);
+	a_Data.resize(size > 0 ? (size_t)size : 0);
+	const bool success = size >= 0 && fread(a_Data.data(), 1, a_Data.size(), pFile) == a_Data.size();
+	fclose(pFile);
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: AssetPacker <resource directory> <archive path>\n");
+		return 1;
+	}
+
+	const std::string root = argv[1];
+	const std::string archivePath = argv[2];
+	std::vector<std::string> paths;
+	FindFiles(root, "", paths);
+	if (IsUpToDate(root, paths, archivePath))
+	{
+		printf("AssetPacker: %s is up to date\n", archivePath.c_str());
+		return 0;
+	}
+
+	std::vector<AssetArchiveFile> files(paths.size());
+	uint64_t originalSize = 0;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		AssetArchiveFile& file = files[i];
+		file.path = paths[i];
+		file.compress = !HasExtension(paths[i].c_str(), storedExtensions, sizeof(storedExtensions) / sizeof(storedExtensions[0]));
+		if (!ReadWholeFile(root + "\\" + paths[i], file.data))
+		{
+			printf("AssetPacker: could not read %s\n", paths[i].c_str());
+			return 1;
+		}
+		originalSize += file.data.size();
+	}
+
+	const std::vector<uint8_t> archive = WriteAssetArchive(files);
+	FILE* pFile = fopen(archivePath.c_str(), "wb");
+	const bool written = pFile && fwrite(archive.data(), 1, archive.size(), pFile) == archive.size();
+	if (pFile)
+		fclose(pFile);
+	if (!written)
+	{
+		printf("AssetPacker: could not write %s\n", archivePath.c_str());
+		remove(archivePath.c_str());
+		return 1;
+	}
+
+	printf("AssetPacker: %u files, %u KB -> %s, %u KB\n", (uint32_t)files.size(), (uint32_t)(originalSize / 1024), archivePath.c_str(), (uint32_t)(archive.size() / 1024));
+	return 0;
+}
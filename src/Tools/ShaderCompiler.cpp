@@ -0,0 +1,118 @@
+// Offline shader precompiler, fills <shader directory>/SpirV with binaries named by
+// their shader cache key so CreateShaderModule loads them without compiling.
+//
+// usage: ShaderCompiler <shader directory> [--android]
+//   --android	compile with the android options, for packaging into the apk assets
+// binaries of edited shaders are not removed, delete the SpirV directory to clean up
+
+#include "../Engine/ShaderCache.h"
+#include "../Engine/FileSystem.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static const char* shaderExtensions[] = { ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese" };
+
+// define sets the app asks for besides the plain shader, keep in sync with its GetShaderModule calls
+struct ShaderVariant
+{
+	const char* shaderName;
+	const char* defines;
+};
+static const ShaderVariant shaderVariants[] = { { "pbr.frag", "BINDLESS" } };
+
+struct CompileCounts
+{
+	uint32_t compiled;
+	uint32_t upToDate;
+	uint32_t failed;
+};
+
+static bool IsShaderFile(const char* a_sFileName)
+{
+	const char* ext = strrchr(a_sFileName, '.');
+	if (!ext)
+		return false;
+
+	for (const char* shaderExt : shaderExtensions)
+	{
+		if (_stricmp(ext, shaderExt) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void CompileShader(const std::string& a_sShaderDirectory, const std::string& a_sOutputDirectory, const char* a_sShaderName,
+	const char* a_sOptions, const char* a_sDefines, CompileCounts& a_Counts)
+{
+	const std::string sourcePath = a_sShaderDirectory + "\\" + a_sShaderName;
+	const uint64_t key = ComputeShaderCacheKey(sourcePath.c_str(), a_sOptions, a_sDefines);
+	if (!key)
+	{
+		printf("ShaderCompiler: could not read %s or one of its includes\n", sourcePath.c_str());
+		++a_Counts.failed;
+		return;
+	}
+
+	const std::string spirvName = GetShaderCacheFileName(a_sShaderName, key);
+	const std::string outputPath = a_sOutputDirectory + "\\" + spirvName;
+	if (ExistFile(outputPath.c_str()))
+	{
+		++a_Counts.upToDate;
+	}
+	else if (CompileShaderWithGlslang(sourcePath.c_str(), outputPath.c_str(), a_sOptions, a_sDefines))
+	{
+		printf("ShaderCompiler: %s %s -> %s\n", a_sShaderName, a_sDefines, spirvName.c_str());
+		++a_Counts.compiled;
+	}
+	else
+	{
+		printf("ShaderCompiler: failed to compile %s %s\n", sourcePath.c_str(), a_sDefines);
+		++a_Counts.failed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: ShaderCompiler <shader directory> [--android]\n");
+		return 1;
+	}
+
+	const std::string shaderDirectory = argv[1];
+	const char* options = (argc > 2 && strcmp(argv[2], "--android") == 0) ? SHADER_OPTIONS_ANDROID : SHADER_OPTIONS_WINDOWS;
+	const std::string outputDirectory = shaderDirectory + "\\" + SHADER_CACHE_DIRECTORY;
+
+	if (!ExistDirectory(outputDirectory.c_str()))
+		CreateDirecroty(outputDirectory.c_str());
+
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((shaderDirectory + "\\*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		printf("ShaderCompiler: %s not found\n", shaderDirectory.c_str());
+		return 1;
+	}
+
+	CompileCounts counts = {};
+	do
+	{
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !IsShaderFile(findData.cFileName))
+			continue;
+
+		CompileShader(shaderDirectory, outputDirectory, findData.cFileName, options, "", counts);
+		for (const ShaderVariant& variant : shaderVariants)
+		{
+			if (_stricmp(variant.shaderName, findData.cFileName) == 0)
+				CompileShader(shaderDirectory, outputDirectory, findData.cFileName, options, variant.defines, counts);
+		}
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+
+	printf("ShaderCompiler: %u compiled, %u up to date, %u failed\n", counts.compiled, counts.upToDate, counts.failed);
+	return counts.failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+// Offline texture compressor, writes a block compressed copy with a full mip chain next to every
+// png and jpeg under a directory, <name>.<format>.ktx2. Textures the device can sample in one of
+// the formats load from those instead of decoding the source at runtime.
+//
+// usage: TextureCompressor <resource directory> [astc] [bc7] [etc2]
+//   formats default to all three. desktop GPUs sample bc7, android ones etc2 and most also astc
+// outputs newer than their source are skipped, delete them to force a rebuild
+
+#include "../Engine/TextureCompress.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../include/stb_image.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+static const char* imageExtensions[] = { ".png", ".jpg", ".jpeg" };
+
+static bool IsImageFile(const char* a_sFileName)
+{
+	const char* ext = strrchr(a_sFileName, '.');
+	if (!ext)
+		return false;
+
+	for (const char* imageExt : imageExtensions)
+	{
+		if (_stricmp(ext, imageExt) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void FindImages(const std::string& a_sDirectory, std::vector<std::string>& a_Images)
+{
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((a_sDirectory + "\\*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		const std::string path = a_sDirectory + "\\" + findData.cFileName;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (strcmp(findData.cFileName, ".") != 0 && strcmp(findData.cFileName, "..") != 0)
+				FindImages(path, a_Images);
+		}
+		else if (IsImageFile(findData.cFileName))
+		{
+			a_Images.push_back(path);
+		}
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+}
+
+static bool IsUpToDate(const std::string& a_sSourcePath, const std::string& a_sOutputPath)
+{
+	WIN32_FILE_ATTRIBUTE_DATA source, output;
+	if (!GetFileAttributesExA(a_sSourcePath.c_str(), GetFileExInfoStandard, &source) ||
+		!GetFileAttributesExA(a_sOutputPath.c_str(), GetFileExInfoStandard, &output))
+		return false;
+	return CompareFileTime(&output.ftLastWriteTime, &source.ftLastWriteTime) >= 0;
+}
+
+static bool CompressImage(const std::string& a_sSourcePath, const std::vector<TextureFileFormat>& a_Formats, uint32_t* a_pWritten, uint32_t* a_pUpToDate)
+{
+	std::vector<TextureFileFormat> formats;
+	for (TextureFileFormat format : a_Formats)
+	{
+		if (IsUpToDate(a_sSourcePath, GetTextureFilePath(a_sSourcePath, format)))
+			++*a_pUpToDate;
+		else
+			formats.push_back(format);
+	}
+	if (formats.empty())
+		return true;
+
+	int width = 0, height = 0, channels = 0;
+	stbi_uc* pixels = stbi_load(a_sSourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		printf("TextureCompressor: could not decode %s\n", a_sSourcePath.c_str());
+		return false;
+	}
+
+	// every level as RGBA8, the same box filtered chain for each format
+	std::vector<std::vector<uint8_t>> levelPixels;
+	std::vector<uint32_t> levelWidths, levelHeights;
+	levelPixels.emplace_back(pixels, pixels + (size_t)width * height * 4);
+	levelWidths.push_back((uint32_t)width);
+	levelHeights.push_back((uint32_t)height);
+	stbi_image_free(pixels);
+	while ((levelWidths.back() > 1 || levelHeights.back() > 1) && levelPixels.size() < MAX_TEXTURE_FILE_LEVELS)
+	{
+		const uint32_t w = levelWidths.back(), h = levelHeights.back();
+		const uint32_t nextWidth = w > 1 ? w / 2 : 1, nextHeight = h > 1 ? h / 2 : 1;
+		std::vector<uint8_t> next((size_t)nextWidth * nextHeight * 4);
+		DownsampleTextureLevel(levelPixels.back().data(), w, h, next.data());
+		levelPixels.push_back(std::move(next));
+		levelWidths.push_back(nextWidth);
+		levelHeights.push_back(nextHeight);
+	}
+	const uint32_t levelCount = (uint32_t)levelPixels.size();
+
+	bool success = true;
+	for (TextureFileFormat format : formats)
+	{
+		std::vector<std::vector<uint8_t>> levels(levelCount);
+		for (uint32_t i = 0; i < levelCount; ++i)
+		{
+			levels[i].resize((size_t)GetCompressedLevelSize(levelWidths[i], levelHeights[i]));
+			CompressTextureLevel(format, levelPixels[i].data(), levelWidths[i], levelHeights[i], levels[i].data());
+		}
+
+		const std::vector<uint8_t> file = WriteTextureFile(format, (uint32_t)width, (uint32_t)height, levelCount, levels.data());
+		const std::string outputPath = GetTextureFilePath(a_sSourcePath, format);
+		FILE* pFile = fopen(outputPath.c_str(), "wb");
+		if (!pFile || fwrite(file.data(), 1, file.size(), pFile) != file.size())
+		{
+			printf("TextureCompressor: could not write %s\n", outputPath.c_str());
+			success = false;
+		}
+		else
+		{
+			printf("TextureCompressor: %s -> %s, %u KB\n", a_sSourcePath.c_str(), outputPath.c_str(), (uint32_t)(file.size() / 1024));
+			++*a_pWritten;
+		}
+		if (pFile)
+			fclose(pFile);
+	}
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: TextureCompressor <resource directory> [astc] [bc7] [etc2]\n");
+		return 1;
+	}
+
+	std::vector<TextureFileFormat> formats;
+	for (int i = 2; i < argc; ++i)
+	{
+		bool known = false;
+		for (TextureFileFormat format : textureFileFormats)
+		{
+			if (_stricmp(argv[i], GetTextureFileFormatName(format)) == 0)
+			{
+				formats.push_back(format);
+				known = true;
+			}
+		}
+		if (!known)
+		{
+			printf("TextureCompressor: unknown format %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (formats.empty())
+		formats.assign(textureFileFormats, textureFileFormats + TEXTURE_FILE_FORMAT_COUNT);
+
+	std::vector<std::string> images;
+	FindImages(argv[1], images);
+
+	// one image per thread, block encoding dominates and images are independent
+	std::atomic<uint32_t> nextImage(0), written(0), upToDate(0), failed(0);
+	const uint32_t threadCount = std::thread::hardware_concurrency();
+	std::vector<std::thread> threads(threadCount ? threadCount : 1);
+	for (std::thread& thread : threads)
+	{
+		thread = std::thread([&]()
+		{
+			for (uint32_t i = nextImage++; i < images.size(); i = nextImage++)
+			{
+				uint32_t imageWritten = 0, imageUpToDate = 0;
+				if (!CompressImage(images[i], formats, &imageWritten, &imageUpToDate))
+					++failed;
+				written += imageWritten;
+				upToDate += imageUpToDate;
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	printf("TextureCompressor: %u written, %u up to date, %u failed\n", written.load(), upToDate.load(), failed.load());
+	return failed ? 1 : 0;
+}